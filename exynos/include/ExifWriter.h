@@ -0,0 +1,333 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HARDWARE_EXIF_WRITER_H
+#define ANDROID_HARDWARE_EXIF_WRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/* exif_attribute_t and the tag numbers come from the platform's Exif.h */
+#include "Exif.h"
+
+/*
+ * APP1 (EXIF) segment writer shared by the exynos3 and exynos4 JPEG paths.
+ *
+ * The layout of every IFD is described by a tag table below. The tables are
+ * expanded at compile time into straight line code, so the entry counts are
+ * constants and each entry is written with its tag, type and count inlined.
+ * Values that do not fit in an entry go to the data area that follows the
+ * directory, in table order. Offsets are relative to the TIFF header.
+ *
+ * The output is identical to what the old per-library writers produced,
+ * except that exif_attribute_t is no longer modified.
+ */
+
+/*
+ * Table columns are tag, type, kind, count and the exif_attribute_t field.
+ * Kinds:
+ *   U32, U16, U8   integer field, inline
+ *   BYTES          count bytes, inline and zero padded
+ *   DATA           count bytes in the data area
+ *   STRING         NUL terminated string in the data area
+ *   RATIONAL       count (s)rationals in the data area
+ *   COMMENT        string behind the undefined character code
+ *   METHOD         string behind the ASCII character code, omitted if empty
+ */
+#define EXIF_0TH_IFD_TIFF_TAGS(T)                                                       \
+    T(EXIF_TAG_IMAGE_WIDTH,         EXIF_TYPE_LONG,      U32,      1,  width)             \
+    T(EXIF_TAG_IMAGE_HEIGHT,        EXIF_TYPE_LONG,      U32,      1,  height)            \
+    T(EXIF_TAG_MAKE,                EXIF_TYPE_ASCII,     STRING,   0,  maker)             \
+    T(EXIF_TAG_MODEL,               EXIF_TYPE_ASCII,     STRING,   0,  model)             \
+    T(EXIF_TAG_ORIENTATION,         EXIF_TYPE_SHORT,     U16,      1,  orientation)       \
+    T(EXIF_TAG_SOFTWARE,            EXIF_TYPE_ASCII,     STRING,   0,  software)          \
+    T(EXIF_TAG_DATE_TIME,           EXIF_TYPE_ASCII,     DATA,     20, date_time)         \
+    T(EXIF_TAG_YCBCR_POSITIONING,   EXIF_TYPE_SHORT,     U16,      1,  ycbcr_positioning)
+    /* followed by the EXIF IFD pointer and, with GPS, the GPS IFD pointer */
+
+#define EXIF_0TH_IFD_EXIF_TAGS(T)                                                       \
+    T(EXIF_TAG_EXPOSURE_TIME,       EXIF_TYPE_RATIONAL,  RATIONAL, 1,  exposure_time)     \
+    T(EXIF_TAG_FNUMBER,             EXIF_TYPE_RATIONAL,  RATIONAL, 1,  fnumber)           \
+    T(EXIF_TAG_EXPOSURE_PROGRAM,    EXIF_TYPE_SHORT,     U16,      1,  exposure_program)  \
+    T(EXIF_TAG_ISO_SPEED_RATING,    EXIF_TYPE_SHORT,     U16,      1,  iso_speed_rating)  \
+    T(EXIF_TAG_EXIF_VERSION,        EXIF_TYPE_UNDEFINED, BYTES,    4,  exif_version)      \
+    T(EXIF_TAG_DATE_TIME_ORG,       EXIF_TYPE_ASCII,     DATA,     20, date_time)         \
+    T(EXIF_TAG_DATE_TIME_DIGITIZE,  EXIF_TYPE_ASCII,     DATA,     20, date_time)         \
+    T(EXIF_TAG_SHUTTER_SPEED,       EXIF_TYPE_SRATIONAL, RATIONAL, 1,  shutter_speed)     \
+    T(EXIF_TAG_APERTURE,            EXIF_TYPE_RATIONAL,  RATIONAL, 1,  aperture)          \
+    T(EXIF_TAG_BRIGHTNESS,          EXIF_TYPE_SRATIONAL, RATIONAL, 1,  brightness)        \
+    T(EXIF_TAG_EXPOSURE_BIAS,       EXIF_TYPE_SRATIONAL, RATIONAL, 1,  exposure_bias)     \
+    T(EXIF_TAG_MAX_APERTURE,        EXIF_TYPE_RATIONAL,  RATIONAL, 1,  max_aperture)      \
+    T(EXIF_TAG_METERING_MODE,       EXIF_TYPE_SHORT,     U16,      1,  metering_mode)     \
+    T(EXIF_TAG_FLASH,               EXIF_TYPE_SHORT,     U16,      1,  flash)             \
+    T(EXIF_TAG_FOCAL_LENGTH,        EXIF_TYPE_RATIONAL,  RATIONAL, 1,  focal_length)      \
+    T(EXIF_TAG_USER_COMMENT,        EXIF_TYPE_UNDEFINED, COMMENT,  0,  user_comment)      \
+    T(EXIF_TAG_COLOR_SPACE,         EXIF_TYPE_SHORT,     U16,      1,  color_space)       \
+    T(EXIF_TAG_PIXEL_X_DIMENSION,   EXIF_TYPE_LONG,      U32,      1,  width)             \
+    T(EXIF_TAG_PIXEL_Y_DIMENSION,   EXIF_TYPE_LONG,      U32,      1,  height)            \
+    T(EXIF_TAG_EXPOSURE_MODE,       EXIF_TYPE_LONG,      U16,      1,  exposure_mode)     \
+    T(EXIF_TAG_WHITE_BALANCE,       EXIF_TYPE_LONG,      U16,      1,  white_balance)     \
+    T(EXIF_TAG_SCENCE_CAPTURE_TYPE, EXIF_TYPE_LONG,      U16,      1,  scene_capture_type)
+
+#define EXIF_0TH_IFD_GPS_TAGS(T)                                                        \
+    T(EXIF_TAG_GPS_VERSION_ID,        EXIF_TYPE_BYTE,      BYTES,    4,  gps_version_id)  \
+    T(EXIF_TAG_GPS_LATITUDE_REF,      EXIF_TYPE_ASCII,     BYTES,    2,  gps_latitude_ref) \
+    T(EXIF_TAG_GPS_LATITUDE,          EXIF_TYPE_RATIONAL,  RATIONAL, 3,  gps_latitude)    \
+    T(EXIF_TAG_GPS_LONGITUDE_REF,     EXIF_TYPE_ASCII,     BYTES,    2,  gps_longitude_ref) \
+    T(EXIF_TAG_GPS_LONGITUDE,         EXIF_TYPE_RATIONAL,  RATIONAL, 3,  gps_longitude)   \
+    T(EXIF_TAG_GPS_ALTITUDE_REF,      EXIF_TYPE_BYTE,      U8,       1,  gps_altitude_ref) \
+    T(EXIF_TAG_GPS_ALTITUDE,          EXIF_TYPE_RATIONAL,  RATIONAL, 1,  gps_altitude)    \
+    T(EXIF_TAG_GPS_TIMESTAMP,         EXIF_TYPE_RATIONAL,  RATIONAL, 3,  gps_timestamp)   \
+    T(EXIF_TAG_GPS_PROCESSING_METHOD, EXIF_TYPE_UNDEFINED, METHOD,   0,  gps_processing_method) \
+    T(EXIF_TAG_GPS_DATESTAMP,         EXIF_TYPE_ASCII,     DATA,     11, gps_datestamp)
+
+#define EXIF_1TH_IFD_TIFF_TAGS(T)                                                       \
+    T(EXIF_TAG_IMAGE_WIDTH,         EXIF_TYPE_LONG,      U32,      1,  widthThumb)        \
+    T(EXIF_TAG_IMAGE_HEIGHT,        EXIF_TYPE_LONG,      U32,      1,  heightThumb)       \
+    T(EXIF_TAG_COMPRESSION_SCHEME,  EXIF_TYPE_SHORT,     U16,      1,  compression_scheme) \
+    T(EXIF_TAG_ORIENTATION,         EXIF_TYPE_SHORT,     U16,      1,  orientation)       \
+    T(EXIF_TAG_X_RESOLUTION,        EXIF_TYPE_RATIONAL,  RATIONAL, 1,  x_resolution)      \
+    T(EXIF_TAG_Y_RESOLUTION,        EXIF_TYPE_RATIONAL,  RATIONAL, 1,  y_resolution)      \
+    T(EXIF_TAG_RESOLUTION_UNIT,     EXIF_TYPE_SHORT,     U16,      1,  resolution_unit)
+    /* followed by the thumbnail offset and size */
+
+#define EXIF_TAG_COUNT(tag, type, kind, count, field)   + 1
+#define EXIF_TAG_WRITE(tag, type, kind, count, field)   \
+    exif_put_##kind(&c, tag, type, count, &info->field);
+
+/* compile time check that the tables match the entry counts of Exif.h */
+#define EXIF_STATIC_ASSERT(name, cond)  typedef char name[(cond) ? 1 : -1]
+
+EXIF_STATIC_ASSERT(exif_0th_tiff_check,
+                   (0 EXIF_0TH_IFD_TIFF_TAGS(EXIF_TAG_COUNT)) + 2 == NUM_0TH_IFD_TIFF);
+EXIF_STATIC_ASSERT(exif_0th_exif_check,
+                   (0 EXIF_0TH_IFD_EXIF_TAGS(EXIF_TAG_COUNT)) == NUM_0TH_IFD_EXIF);
+EXIF_STATIC_ASSERT(exif_0th_gps_check,
+                   (0 EXIF_0TH_IFD_GPS_TAGS(EXIF_TAG_COUNT)) == NUM_0TH_IFD_GPS);
+EXIF_STATIC_ASSERT(exif_1th_tiff_check,
+                   (0 EXIF_1TH_IFD_TIFF_TAGS(EXIF_TAG_COUNT)) + 2 == NUM_1TH_IFD_TIFF);
+
+#define EXIF_GPS_METHOD_MAX     100
+
+struct exif_cursor {
+    unsigned char  *start;      /* TIFF header */
+    unsigned char  *entry;      /* next directory entry */
+    unsigned int    data;       /* next free byte of the data area */
+};
+
+static inline void exif_put_u16(unsigned char *p, uint16_t v)
+{
+    p[0] = v & 0xff;
+    p[1] = v >> 8;
+}
+
+static inline void exif_put_u32(unsigned char *p, uint32_t v)
+{
+    p[0] = v & 0xff;
+    p[1] = (v >> 8) & 0xff;
+    p[2] = (v >> 16) & 0xff;
+    p[3] = v >> 24;
+}
+
+static inline void exif_put_entry(struct exif_cursor *c, uint16_t tag, uint16_t type,
+                                  uint32_t count, uint32_t value)
+{
+    unsigned char *p = c->entry;
+
+    exif_put_u16(p, tag);
+    exif_put_u16(p + 2, type);
+    exif_put_u32(p + 4, count);
+    exif_put_u32(p + 8, value);
+    c->entry = p + IFD_SIZE;
+}
+
+static inline void exif_put_data(struct exif_cursor *c, uint16_t tag, uint16_t type,
+                                 uint32_t count, const void *src, size_t len)
+{
+    exif_put_entry(c, tag, type, count, c->data);
+    memcpy(c->start + c->data, src, len);
+    c->data += len;
+}
+
+/*
+ * Starts a directory of num entries at start + offset, its data area
+ * follows the directory and the next IFD offset.
+ */
+static inline void exif_begin_ifd(struct exif_cursor *c, unsigned int offset, unsigned int num)
+{
+    exif_put_u16(c->start + offset, num);
+    c->entry = c->start + offset + NUM_SIZE;
+    c->data = offset + NUM_SIZE + num * IFD_SIZE + OFFSET_SIZE;
+}
+
+/* writes a 0 next IFD offset and returns where it is */
+static inline unsigned char *exif_end_ifd(struct exif_cursor *c)
+{
+    unsigned char *next = c->entry;
+
+    exif_put_u32(next, 0);
+    return next;
+}
+
+static inline void exif_put_U32(struct exif_cursor *c, uint16_t tag, uint16_t type,
+                                uint32_t count, const void *v)
+{
+    exif_put_entry(c, tag, type, count, *(const uint32_t *)v);
+}
+
+static inline void exif_put_U16(struct exif_cursor *c, uint16_t tag, uint16_t type,
+                                uint32_t count, const void *v)
+{
+    exif_put_entry(c, tag, type, count, *(const uint16_t *)v);
+}
+
+static inline void exif_put_U8(struct exif_cursor *c, uint16_t tag, uint16_t type,
+                               uint32_t count, const void *v)
+{
+    exif_put_entry(c, tag, type, count, *(const uint8_t *)v);
+}
+
+static inline void exif_put_BYTES(struct exif_cursor *c, uint16_t tag, uint16_t type,
+                                  uint32_t count, const void *v)
+{
+    const unsigned char *p = (const unsigned char *)v;
+    uint32_t value = 0;
+
+    for (uint32_t i = 0; i < count; i++)
+        value |= (uint32_t)p[i] << (8 * i);
+    exif_put_entry(c, tag, type, count, value);
+}
+
+static inline void exif_put_DATA(struct exif_cursor *c, uint16_t tag, uint16_t type,
+                                 uint32_t count, const void *v)
+{
+    exif_put_data(c, tag, type, count, v, count);
+}
+
+static inline void exif_put_STRING(struct exif_cursor *c, uint16_t tag, uint16_t type,
+                                   uint32_t, const void *v)
+{
+    uint32_t count = strlen((const char *)v) + 1;
+
+    exif_put_data(c, tag, type, count, v, count);
+}
+
+/* srational_t has the same layout */
+static inline void exif_put_RATIONAL(struct exif_cursor *c, uint16_t tag, uint16_t type,
+                                     uint32_t count, const void *v)
+{
+    exif_put_data(c, tag, type, count, v, count * sizeof(rational_t));
+}
+
+static inline void exif_put_COMMENT(struct exif_cursor *c, uint16_t tag, uint16_t type,
+                                    uint32_t, const void *v)
+{
+    static const unsigned char code[8] = { 0x00, 0x00, 0x00, 0x49, 0x49, 0x43, 0x53, 0x41 };
+    uint32_t len = strlen((const char *)v) + 1;
+
+    exif_put_data(c, tag, type, sizeof(code) + len, code, sizeof(code));
+    memcpy(c->start + c->data, v, len);
+    c->data += len;
+}
+
+static inline void exif_put_METHOD(struct exif_cursor *c, uint16_t tag, uint16_t type,
+                                   uint32_t, const void *v)
+{
+    static const unsigned char code[8] = { 0x41, 0x53, 0x43, 0x49, 0x49, 0x00, 0x00, 0x00 };
+    uint32_t len = strlen((const char *)v);
+
+    if (len == 0)
+        return;
+    if (len > EXIF_GPS_METHOD_MAX)
+        len = EXIF_GPS_METHOD_MAX;
+
+    exif_put_data(c, tag, type, sizeof(code) + len, code, sizeof(code));
+    memcpy(c->start + c->data, v, len);
+    c->data += len;
+}
+
+/*
+ * Builds a complete APP1 segment, marker included, at exifOut. The thumbnail
+ * IFD is only written when info->enableThumb is set and a thumbnail is given.
+ * exifOut must hold EXIF_FILE_SIZE bytes plus the thumbnail. Returns the size
+ * of the segment.
+ */
+static inline unsigned int exif_write_app1(unsigned char *exifOut,
+                                           const exif_attribute_t *info,
+                                           const unsigned char *thumbBuf,
+                                           unsigned int thumbSize)
+{
+    static const unsigned char header[4 + 6 + 8] = {
+        0xff, 0xe1, 0x00, 0x00,                         /* APP1, length */
+        0x45, 0x78, 0x69, 0x66, 0x00, 0x00,             /* "Exif" */
+        0x49, 0x49, 0x2a, 0x00, 0x08, 0x00, 0x00, 0x00, /* II, 42, IFD at 8 */
+    };
+    struct exif_cursor c;
+    unsigned char *pGpsIfdPtr = NULL;
+    unsigned char *pNextIfdOffset;
+
+    memcpy(exifOut, header, sizeof(header));
+    c.start = exifOut + 10;
+
+    //2 0th IFD TIFF Tags
+    exif_begin_ifd(&c, 8, info->enableGps ? NUM_0TH_IFD_TIFF : NUM_0TH_IFD_TIFF - 1);
+    EXIF_0TH_IFD_TIFF_TAGS(EXIF_TAG_WRITE)
+    exif_put_entry(&c, EXIF_TAG_EXIF_IFD_POINTER, EXIF_TYPE_LONG, 1, c.data);
+    if (info->enableGps) {
+        pGpsIfdPtr = c.entry;
+        c.entry += IFD_SIZE;
+    }
+    pNextIfdOffset = exif_end_ifd(&c);
+
+    //2 0th IFD Exif Private Tags
+    exif_begin_ifd(&c, c.data, NUM_0TH_IFD_EXIF);
+    EXIF_0TH_IFD_EXIF_TAGS(EXIF_TAG_WRITE)
+    exif_end_ifd(&c);
+
+    //2 0th IFD GPS Info Tags
+    if (info->enableGps) {
+        struct exif_cursor gps = { c.start, pGpsIfdPtr, 0 };
+
+        exif_put_entry(&gps, EXIF_TAG_GPS_IFD_POINTER, EXIF_TYPE_LONG, 1, c.data);
+        exif_begin_ifd(&c, c.data, info->gps_processing_method[0] ?
+                                   NUM_0TH_IFD_GPS : NUM_0TH_IFD_GPS - 1);
+        EXIF_0TH_IFD_GPS_TAGS(EXIF_TAG_WRITE)
+        exif_end_ifd(&c);
+    }
+
+    //2 1th IFD TIFF Tags
+    if (info->enableThumb && thumbBuf != NULL && thumbSize > 0) {
+        exif_put_u32(pNextIfdOffset, c.data);
+        exif_begin_ifd(&c, c.data, NUM_1TH_IFD_TIFF);
+        EXIF_1TH_IFD_TIFF_TAGS(EXIF_TAG_WRITE)
+        exif_put_entry(&c, EXIF_TAG_JPEG_INTERCHANGE_FORMAT, EXIF_TYPE_LONG, 1, c.data);
+        exif_put_entry(&c, EXIF_TAG_JPEG_INTERCHANGE_FORMAT_LEN, EXIF_TYPE_LONG, 1, thumbSize);
+        exif_end_ifd(&c);
+
+        memcpy(c.start + c.data, thumbBuf, thumbSize);
+        c.data += thumbSize;
+    }
+
+    /* the APP1 marker isn't counted in the length */
+    unsigned int size = 10 + c.data;
+    exifOut[2] = ((size - 2) >> 8) & 0xff;
+    exifOut[3] = (size - 2) & 0xff;
+
+    return size;
+}
+
+#endif /* ANDROID_HARDWARE_EXIF_WRITER_H */
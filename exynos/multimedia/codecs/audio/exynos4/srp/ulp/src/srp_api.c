@@ -22,6 +22,7 @@
 #define ALOGD(...)
 
 //#define _USE_WBUF_            /* Buffering before writing srp-rp device */
+//#define _USE_WBUF_DIRECT_     /* Write IBUF sized input without buffering */
 //#define _DUMP_TO_FILE_
 //#define _USE_FW_FROM_DISK_
 
@@ -33,9 +34,16 @@ static int srp_dev = -1;
 static int srp_ibuf_size = 0;
 static int srp_block_mode = SRP_INIT_BLOCK_MODE;
 
+/*
+ * Write buffer is a ring of wbuf_size bytes, wbuf_len bytes from wbuf_rd.
+ * The RP driver takes one IBUF per write(), so data leaves the ring in
+ * whole IBUFs only. wbuf_rd then stays a multiple of the IBUF size and an
+ * IBUF never wraps around the end of the ring.
+ */
 static unsigned char *wbuf;
 static int wbuf_size;
-static int wbuf_pos;
+static int wbuf_rd;
+static int wbuf_len;
 
 #ifdef _DUMP_TO_FILE_
 static FILE *fp_dump = NULL;
@@ -46,7 +54,8 @@ static int WriteBuff_Init(void)
 {
     if (wbuf == NULL) {
         wbuf_size = srp_ibuf_size * WBUF_LEN_MUL;
-        wbuf_pos = 0;
+        wbuf_rd = 0;
+        wbuf_len = 0;
         wbuf = (unsigned char *)malloc(wbuf_size);
         ALOGD("%s: WriteBuffer %dbytes allocated", __func__, wbuf_size);
         return 0;
@@ -68,30 +77,76 @@ static int WriteBuff_Deinit(void)
     return -1;
 }
 
-static int WriteBuff_Write(unsigned char *buff, int size_byte)
+/* Copy size_byte bytes of buff to the ring tail, or 0xFF if buff is NULL */
+static void WriteBuff_Fill(const unsigned char *buff, int size_byte)
 {
-    int write_byte;
+    int wr = (wbuf_rd + wbuf_len) % wbuf_size;
+    int len = wbuf_size - wr;
+
+    if (len > size_byte)
+        len = size_byte;
 
-    if ((wbuf_pos + size_byte) < wbuf_size) {
-        memcpy(&wbuf[wbuf_pos], buff, size_byte);
-        wbuf_pos += size_byte;
+    if (buff) {
+        memcpy(&wbuf[wr], buff, len);
+        memcpy(wbuf, buff + len, size_byte - len);
     } else {
-        ALOGE("%s: WriteBuffer is filled [%d], ignoring write [%d]", __func__, wbuf_pos, size_byte);
+        memset(&wbuf[wr], 0xFF, len);
+        memset(wbuf, 0xFF, size_byte - len);
+    }
+    wbuf_len += size_byte;
+}
+
+static int WriteBuff_Write(unsigned char *buff, int size_byte)
+{
+    if ((wbuf_len + size_byte) < wbuf_size) {
+        WriteBuff_Fill(buff, size_byte);
+    } else {
+        ALOGE("%s: WriteBuffer is filled [%d], ignoring write [%d]", __func__, wbuf_len, size_byte);
         return -1;    /* Insufficient buffer */
     }
 
-    return wbuf_pos;
+    return wbuf_len;
 }
 
+/* Remove the IBUF at the head of the ring */
 static void WriteBuff_Consume(void)
 {
-    memcpy(wbuf, &wbuf[srp_ibuf_size], srp_ibuf_size * (WBUF_LEN_MUL - 1));
-    wbuf_pos -= srp_ibuf_size;
+    wbuf_len -= srp_ibuf_size;
+    wbuf_rd = wbuf_len ? (wbuf_rd + srp_ibuf_size) % wbuf_size : 0;
 }
 
 static void WriteBuff_Flush(void)
 {
-    wbuf_pos = 0;
+    wbuf_rd = 0;
+    wbuf_len = 0;
+}
+
+/*
+ * Write one IBUF to the RP driver. Returns 0 on success, the RP decode
+ * error if the driver took the data but failed to decode it, or -1 if the
+ * write failed.
+ */
+static int WriteBuff_Send(const unsigned char *buff)
+{
+    int ret;
+    int val;
+
+    ret = write(srp_dev, buff, srp_ibuf_size); /* Write Buffer to RP Driver */
+    if (ret == -1) { /* Fail? */
+        ioctl(srp_dev, SRP_ERROR_STATE, &val);
+        if (!val) {    /* Write error? */
+            ALOGE("%s: IBUF write fail", __func__);
+            return -1;
+        }
+        ALOGE("%s: RP decode error [0x%05X]", __func__, val);
+        return val;    /* Write OK, but RP decode error */
+    }
+
+#ifdef _DUMP_TO_FILE_
+    if (fp_dump)
+        fwrite(buff, srp_ibuf_size, 1, fp_dump);
+#endif
+    return 0;
 }
 #endif
 
@@ -156,38 +211,68 @@ int SRP_Init(unsigned int ibuf_size)
 #ifdef _USE_WBUF_
 int SRP_Decode(void *buff, int size_byte)
 {
+    unsigned char *data = (unsigned char *)buff;
     int ret;
-    int val;
     int err_code = 0;
 
     if (srp_dev != -1) {
         /* Check wbuf before writing buff */
-        while (wbuf_pos >= srp_ibuf_size) { /* Write_Buffer filled? (IBUF Size)*/
+        while (wbuf_len >= srp_ibuf_size) { /* Write_Buffer filled? (IBUF Size)*/
             ALOGD("%s: Write Buffer is full, Send data to RP", __func__);
 
-            ret = write(srp_dev, wbuf, srp_ibuf_size); /* Write Buffer to RP Driver */
-            if (ret == -1) { /* Fail? */
-                ioctl(srp_dev, SRP_ERROR_STATE, &val);
-                if (!val) {    /* Write error? */
-                    ALOGE("%s: IBUF write fail", __func__);
+            ret = WriteBuff_Send(&wbuf[wbuf_rd]);
+            if (ret == -1)
+                return -1;
+            if (ret)
+                err_code = ret;
+            WriteBuff_Consume();
+        }
+
+#ifdef _USE_WBUF_DIRECT_
+        /*
+         * Top up a partly buffered IBUF from the head of buff and send it
+         * from the ring. Once the ring is empty, whole IBUFs of buff are
+         * written in place and only the tail is copied.
+         */
+        if (wbuf_len) {
+            int len = srp_ibuf_size - wbuf_len;
+
+            if (len > size_byte)
+                len = size_byte;
+
+            WriteBuff_Fill(data, len);
+            data += len;
+            size_byte -= len;
+
+            if (wbuf_len == srp_ibuf_size) {
+                ret = WriteBuff_Send(&wbuf[wbuf_rd]);
+                if (ret == -1)
                     return -1;
-                } else {       /* Write OK, but RP decode error? */
-                    err_code = val;
-                    ALOGE("%s: RP decode error [0x%05X]", __func__, err_code);
-                }
+                if (ret)
+                    err_code = ret;
+                WriteBuff_Consume();
             }
-#ifdef _DUMP_TO_FILE_
-            if (fp_dump)
-                fwrite(wbuf, srp_ibuf_size, 1, fp_dump);
-#endif
-            WriteBuff_Consume();
         }
 
-        ret = WriteBuff_Write((unsigned char *)buff, size_byte);
+        while (wbuf_len == 0 && size_byte >= srp_ibuf_size) {
+            ALOGD("%s: Send %d bytes of input to RP", __func__, srp_ibuf_size);
+
+            ret = WriteBuff_Send(data);
+            if (ret == -1)
+                return -1;
+            if (ret)
+                err_code = ret;
+
+            data += srp_ibuf_size;
+            size_byte -= srp_ibuf_size;
+        }
+#endif
+
+        ret = WriteBuff_Write(data, size_byte);
         if (ret == -1)
             return -1;  /* Buffering error */
 
-        ALOGD("%s: Write Buffer remain [%d]", __func__, wbuf_pos);
+        ALOGD("%s: Write Buffer remain [%d]", __func__, wbuf_len);
         return err_code;  /* Write Success */
     }
 
@@ -198,37 +283,22 @@ int SRP_Decode(void *buff, int size_byte)
 int SRP_Send_EOS(void)
 {
     int ret;
-    int val;
 
     if (srp_dev != -1) {
         /* Check wbuf before writing buff */
-        while (wbuf_pos) { /* Write_Buffer ramain?*/
-            if (wbuf_pos < srp_ibuf_size) {
-                memset(wbuf + wbuf_pos, 0xFF, srp_ibuf_size - wbuf_pos); /* Fill dummy data */
-                wbuf_pos = srp_ibuf_size;
-            }
+        while (wbuf_len) { /* Write_Buffer ramain?*/
+            if (wbuf_len < srp_ibuf_size)
+                WriteBuff_Fill(NULL, srp_ibuf_size - wbuf_len); /* Fill dummy data */
 
-            ret = write(srp_dev, wbuf, srp_ibuf_size); /* Write Buffer to RP Driver */
-            if (ret == -1) {  /* Fail? */
-                ret = ioctl(srp_dev, SRP_ERROR_STATE, &val);
-                if (!val) {   /* Write error? */
-                    ALOGE("%s: IBUF write fail", __func__);
-                    return -1;
-                } else {      /* RP decoe error? */
-                    ALOGE("%s: RP decode error [0x%05X]", __func__, val);
-                    return -1;
-                }
-            } else {          /* Success? */
-#ifdef _DUMP_TO_FILE_
-                if (fp_dump)
-                    fwrite(wbuf, srp_ibuf_size, 1, fp_dump);
-#endif
-                WriteBuff_Consume();
-            }
+            ret = WriteBuff_Send(&wbuf[wbuf_rd]);
+            if (ret)
+                return -1;
+            WriteBuff_Consume();
         }
 
-        memset(wbuf, 0xFF, srp_ibuf_size);      /* Fill dummy data */
+        WriteBuff_Fill(NULL, srp_ibuf_size);    /* Fill dummy data */
         write(srp_dev, wbuf, srp_ibuf_size); /* Write Buffer to RP Driver */
+        WriteBuff_Flush();
 
         /* Wait until RP decoding over */
         return ioctl(srp_dev, SRP_WAIT_EOS);
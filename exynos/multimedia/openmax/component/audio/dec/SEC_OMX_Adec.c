@@ -718,8 +718,9 @@ OMX_BOOL SEC_Preprocessor_InputData(OMX_COMPONENTTYPE *pOMXComponent)
 
     if (flagEOF == OMX_TRUE) {
         if (pSECComponent->checkTimeStamp.needSetStartTimeStamp == OMX_TRUE) {
-            /* Flush SRP buffers */
-            SRP_Flush();
+            /* Flush SRP buffers, a software codec resets itself on this frame */
+            if (pSECComponent->codecType == HW_AUDIO_DEC_CODEC)
+                SRP_Flush();
 
             pSECComponent->checkTimeStamp.needCheckStartTimeStamp = OMX_TRUE;
             pSECComponent->checkTimeStamp.startTimeStamp = inputData->timeStamp;
@@ -16,7 +16,7 @@ LOCAL_CFLAGS :=
 LOCAL_ARM_MODE := arm
 
 LOCAL_STATIC_LIBRARIES := libSEC_OMX_Adec libsecosal libsecbasecomponent \
-	libsrpapi
+	libsrpapi libstagefright_mp3dec
 LOCAL_SHARED_LIBRARIES := libc libdl libcutils libutils libui \
 	libSEC_OMX_Resourcemanager
 
@@ -26,6 +26,8 @@ LOCAL_C_INCLUDES := $(OMX_INC) \
 	$(SEC_OMX_TOP)/core \
 	$(SEC_OMX_COMPONENT)/common \
 	$(SEC_OMX_COMPONENT)/audio/dec \
+	$(TOP)/frameworks/av/media/libstagefright/codecs/mp3dec/include \
+	$(TOP)/frameworks/av/media/libstagefright/codecs/mp3dec/src \
 	$(TARGET_OUT_HEADERS)/$(SEC_COPY_HEADERS_TO)
 
 include $(BUILD_SHARED_LIBRARY)
@@ -38,6 +38,7 @@
 #include "library_register.h"
 #include "SEC_OMX_Mp3dec.h"
 #include "srp_api.h"
+#include "pvmp3decoder_api.h"
 
 #undef  SEC_LOG_TAG
 #define SEC_LOG_TAG    "SEC_MP3_DEC"
@@ -52,6 +53,156 @@ FILE *inFile;
 FILE *outFile;
 #endif
 
+/*
+ * Deep buffer mode trades latency for fewer wakeups during long playback.
+ * Compressed input is queued until a batch is there and is then fed to the
+ * SRP IBUF by IBUF, while the PCM is gathered in output buffers sized for
+ * nWakeupInterval. An output buffer is returned only once it is full.
+ */
+static void SEC_SRP_Mp3Dec_DeepBufferSize(SEC_OMX_BASECOMPONENT *pSECComponent, SEC_MP3_HANDLE *pMp3Dec)
+{
+    SEC_MP3_DEEP_BUFFER *pDeep = &pMp3Dec->deepBuffer;
+    OMX_U32              outputSize = pMp3Dec->nObufSize;
+
+    if (pDeep->bEnabled == OMX_TRUE) {
+        outputSize = pDeep->nWakeupInterval * (DEFAULT_AUDIO_SAMPLING_FREQ / 100) / 10 *
+                     DEFAULT_AUDIO_CHANNELS_NUM * (DEFAULT_AUDIO_BIT_PER_SAMPLE / 8);
+        outputSize = ((outputSize + pMp3Dec->nObufSize - 1) / pMp3Dec->nObufSize) * pMp3Dec->nObufSize;
+    }
+    pSECComponent->pSECPort[OUTPUT_PORT_INDEX].portDefinition.nBufferSize = outputSize;
+
+    /* A batch holds at least nWakeupInterval of audio at any bitrate */
+    pDeep->nBatchLen = pDeep->nWakeupInterval * (MP3_DEEP_BUFFER_MAX_BITRATE / 8);
+    pDeep->nAllocLen = pDeep->nBatchLen + pMp3Dec->nIbufSize;
+}
+
+static void SEC_SRP_Mp3Dec_DeepBufferReset(SEC_MP3_DEEP_BUFFER *pDeep)
+{
+    pDeep->nOffset = 0;
+    pDeep->nDataLen = 0;
+    pDeep->pOutBuffer = NULL;
+    pDeep->nOutLen = 0;
+    pDeep->bTimeStampValid = OMX_FALSE;
+    pDeep->nSamples = 0;
+    pDeep->nStatSamples = 0;
+    pDeep->nStatWakeups = 0;
+    pDeep->nStatSRPCalls = 0;
+}
+
+static void SEC_SRP_Mp3Dec_DeepBufferReturn(SEC_MP3_HANDLE *pMp3Dec, SEC_OMX_DATA *pOutputData)
+{
+    SEC_MP3_DEEP_BUFFER *pDeep = &pMp3Dec->deepBuffer;
+
+    if (pDeep->nOutLen == 0)
+        pDeep->outTimeStamp = pDeep->baseTimeStamp +
+            (OMX_TICKS)(pDeep->nSamples * 1000000 / pMp3Dec->pcmParam.nSamplingRate);
+
+    pOutputData->dataLen = pDeep->nOutLen;
+    pOutputData->timeStamp = pDeep->outTimeStamp;
+    pDeep->pOutBuffer = NULL;
+    pDeep->nOutLen = 0;
+
+    pDeep->nStatWakeups++;
+    if ((pDeep->nSamples - pDeep->nStatSamples) >= (OMX_U64)pMp3Dec->pcmParam.nSamplingRate * 60) {
+        pDeep->nWakeupsPerMinute = pDeep->nStatWakeups;
+        SEC_OSAL_Log(SEC_LOG_TRACE, "deep buffer: %d wakeups, %d SRP calls per minute",
+            pDeep->nStatWakeups, pDeep->nStatSRPCalls);
+        pDeep->nStatSamples = pDeep->nSamples;
+        pDeep->nStatWakeups = 0;
+        pDeep->nStatSRPCalls = 0;
+    }
+}
+
+static OMX_S32 SEC_SRP_Mp3Dec_ObufIndex(SEC_MP3_HANDLE *pMp3Dec, OMX_PTR pBuffer)
+{
+    SEC_MP3_ZERO_COPY *pZeroCopy = &pMp3Dec->zeroCopy;
+    OMX_U32            i;
+
+    for (i = 0; i < pZeroCopy->nObufNum; i++) {
+        if ((OMX_U8 *)pBuffer == pZeroCopy->pObuf + i * pMp3Dec->nObufSize)
+            return i;
+    }
+
+    return -1;
+}
+
+static OMX_BOOL SEC_SRP_Mp3Dec_IsZeroCopy(SEC_OMX_BASECOMPONENT *pSECComponent, SEC_MP3_HANDLE *pMp3Dec)
+{
+    return ((pMp3Dec->zeroCopy.nAssigned > 0) &&
+            (pMp3Dec->zeroCopy.nAssigned == pSECComponent->pSECPort[OUTPUT_PORT_INDEX].assignedBufferNum) &&
+            (pMp3Dec->deepBuffer.bEnabled == OMX_FALSE)) ? OMX_TRUE : OMX_FALSE;
+}
+
+static void SEC_SRP_Mp3Dec_ZeroCopyReset(SEC_MP3_ZERO_COPY *pZeroCopy)
+{
+    pZeroCopy->nLastObuf = -1;
+    pZeroCopy->nReadyObuf = -1;
+    pZeroCopy->nReadyLen = 0;
+}
+
+/*
+ * Returns the PCM in the OBUF it was decoded to. If that is not the OBUF of
+ * the output buffer held now, the held one goes back to the client empty and
+ * the PCM waits for the next output buffer. OMX_TRUE if the SRP was read and
+ * nothing is left waiting, as SRP_Get_PCM() does for the copying path.
+ */
+static OMX_BOOL SEC_SRP_Mp3Dec_ZeroCopyGetPCM(OMX_COMPONENTTYPE *pOMXComponent, SEC_OMX_DATA *pOutputData)
+{
+    SEC_OMX_BASECOMPONENT      *pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    SEC_OMX_AUDIODEC_COMPONENT *pAudioDec = (SEC_OMX_AUDIODEC_COMPONENT *)pSECComponent->hComponentHandle;
+    SEC_MP3_HANDLE             *pMp3Dec = (SEC_MP3_HANDLE *)pAudioDec->hCodecHandle;
+    SEC_MP3_ZERO_COPY          *pZeroCopy = &pMp3Dec->zeroCopy;
+    OMX_S32                     heldObuf = SEC_SRP_Mp3Dec_ObufIndex(pMp3Dec, pOutputData->dataBuffer);
+    OMX_S32                     readObuf;
+    OMX_U32                     i;
+    OMX_PTR                     dataBuffer = NULL;
+    unsigned int                dataLen = 0;
+    OMX_BOOL                    bRead = OMX_FALSE;
+
+    pOutputData->dataLen = 0;
+    pZeroCopy->bClient[heldObuf] = OMX_FALSE;
+
+    if (pZeroCopy->nReadyObuf < 0) {
+        /* After a flush the SRP starts over and may fill any OBUF */
+        for (i = 0; i < pZeroCopy->nObufNum; i++) {
+            if (((pZeroCopy->nLastObuf < 0) || (pZeroCopy->nLastObuf == (OMX_S32)i)) &&
+                (pZeroCopy->bClient[i] == OMX_TRUE)) {
+                SEC_OSAL_SleepMillisec(MP3_ZERO_COPY_CLIENT_WAIT);
+                return OMX_FALSE;
+            }
+        }
+
+        SRP_Get_PCM(&dataBuffer, &dataLen);
+        if (dataLen == 0)
+            return OMX_TRUE;
+
+        readObuf = SEC_SRP_Mp3Dec_ObufIndex(pMp3Dec, dataBuffer);
+        if (readObuf < 0) {
+            SEC_OSAL_Log(SEC_LOG_ERROR, "PCM is not in an OBUF: %p", dataBuffer);
+            pOutputData->dataLen = dataLen;
+            SEC_OSAL_Memcpy(pOutputData->dataBuffer, dataBuffer, dataLen);
+            return OMX_TRUE;
+        }
+
+        pZeroCopy->nLastObuf = readObuf;
+        pZeroCopy->nReadyObuf = readObuf;
+        pZeroCopy->nReadyLen = dataLen;
+        bRead = OMX_TRUE;
+    }
+
+    if (pZeroCopy->nReadyObuf == heldObuf) {
+        pOutputData->dataLen = pZeroCopy->nReadyLen;
+        pZeroCopy->bClient[heldObuf] = OMX_TRUE;
+        pZeroCopy->nReadyObuf = -1;
+        pZeroCopy->nReadyLen = 0;
+        return bRead;
+    }
+
+    pSECComponent->sec_OutputBufferReturn(pOMXComponent);
+
+    return OMX_FALSE;
+}
+
 OMX_ERRORTYPE SEC_SRP_Mp3Dec_GetParameter(
     OMX_IN    OMX_HANDLETYPE hComponent,
     OMX_IN    OMX_INDEXTYPE  nParamIndex,
@@ -141,6 +292,23 @@ OMX_ERRORTYPE SEC_SRP_Mp3Dec_GetParameter(
         SEC_OSAL_Strcpy((char *)pComponentRole->cRole, SEC_OMX_COMPONENT_MP3_DEC_ROLE);
     }
         break;
+    case OMX_IndexParamAudioDeepBuffer:
+    {
+        SEC_OMX_AUDIO_PARAM_DEEPBUFFERTYPE *pDeepParam = (SEC_OMX_AUDIO_PARAM_DEEPBUFFERTYPE *)pComponentParameterStructure;
+        SEC_MP3_HANDLE                     *pMp3Dec = NULL;
+
+        ret = SEC_OMX_Check_SizeVersion(pDeepParam, sizeof(SEC_OMX_AUDIO_PARAM_DEEPBUFFERTYPE));
+        if (ret != OMX_ErrorNone) {
+            goto EXIT;
+        }
+
+        pMp3Dec = (SEC_MP3_HANDLE *)((SEC_OMX_AUDIODEC_COMPONENT *)pSECComponent->hComponentHandle)->hCodecHandle;
+        pDeepParam->nPortIndex        = OUTPUT_PORT_INDEX;
+        pDeepParam->bEnable           = pMp3Dec->deepBuffer.bEnabled;
+        pDeepParam->nWakeupInterval   = pMp3Dec->deepBuffer.nWakeupInterval;
+        pDeepParam->nWakeupsPerMinute = pMp3Dec->deepBuffer.nWakeupsPerMinute;
+    }
+        break;
     default:
         ret = SEC_OMX_AudioDecodeGetParameter(hComponent, nParamIndex, pComponentParameterStructure);
         break;
@@ -249,6 +417,43 @@ OMX_ERRORTYPE SEC_SRP_Mp3Dec_SetParameter(
         }
     }
         break;
+    case OMX_IndexParamAudioDeepBuffer:
+    {
+        SEC_OMX_AUDIO_PARAM_DEEPBUFFERTYPE *pDeepParam = (SEC_OMX_AUDIO_PARAM_DEEPBUFFERTYPE *)pComponentParameterStructure;
+        SEC_MP3_HANDLE                     *pMp3Dec = NULL;
+
+        ret = SEC_OMX_Check_SizeVersion(pDeepParam, sizeof(SEC_OMX_AUDIO_PARAM_DEEPBUFFERTYPE));
+        if (ret != OMX_ErrorNone) {
+            goto EXIT;
+        }
+
+        /* The output buffer size depends on it */
+        if ((pSECComponent->currentState != OMX_StateLoaded) && (pSECComponent->currentState != OMX_StateWaitForResources)) {
+            ret = OMX_ErrorIncorrectStateOperation;
+            goto EXIT;
+        }
+
+        if ((pDeepParam->bEnable == OMX_TRUE) &&
+            ((pDeepParam->nWakeupInterval < MP3_DEEP_BUFFER_MIN_INTERVAL) ||
+             (pDeepParam->nWakeupInterval > MP3_DEEP_BUFFER_MAX_INTERVAL))) {
+            ret = OMX_ErrorBadParameter;
+            goto EXIT;
+        }
+
+        pMp3Dec = (SEC_MP3_HANDLE *)((SEC_OMX_AUDIODEC_COMPONENT *)pSECComponent->hComponentHandle)->hCodecHandle;
+
+        /* It batches SRP wakeups, the software decoder has none */
+        if ((pDeepParam->bEnable == OMX_TRUE) && (pMp3Dec->bSoftwareDecode == OMX_TRUE)) {
+            ret = OMX_ErrorUnsupportedSetting;
+            goto EXIT;
+        }
+
+        pMp3Dec->deepBuffer.bEnabled = pDeepParam->bEnable;
+        if (pDeepParam->bEnable == OMX_TRUE)
+            pMp3Dec->deepBuffer.nWakeupInterval = pDeepParam->nWakeupInterval;
+        SEC_SRP_Mp3Dec_DeepBufferSize(pSECComponent, pMp3Dec);
+    }
+        break;
     default:
         ret = SEC_OMX_AudioDecodeSetParameter(hComponent, nIndex, pComponentParameterStructure);
         break;
@@ -381,7 +586,10 @@ OMX_ERRORTYPE SEC_SRP_Mp3Dec_GetExtensionIndex(
         goto EXIT;
     }
 
-    ret = SEC_OMX_AudioDecodeGetExtensionIndex(hComponent, cParameterName, pIndexType);
+    if (SEC_OSAL_Strcmp(cParameterName, SEC_INDEX_PARAM_AUDIO_DEEP_BUFFER) == 0)
+        *pIndexType = (OMX_INDEXTYPE) OMX_IndexParamAudioDeepBuffer;
+    else
+        ret = SEC_OMX_AudioDecodeGetExtensionIndex(hComponent, cParameterName, pIndexType);
 
 EXIT:
     FunctionOut();
@@ -433,6 +641,171 @@ EXIT:
     return ret;
 }
 
+OMX_ERRORTYPE SEC_SRP_Mp3Dec_AllocateBuffer(
+    OMX_IN OMX_HANDLETYPE            hComponent,
+    OMX_INOUT OMX_BUFFERHEADERTYPE **ppBuffer,
+    OMX_IN OMX_U32                   nPortIndex,
+    OMX_IN OMX_PTR                   pAppPrivate,
+    OMX_IN OMX_U32                   nSizeBytes)
+{
+    OMX_ERRORTYPE          ret = OMX_ErrorNone;
+    OMX_COMPONENTTYPE     *pOMXComponent = NULL;
+    SEC_OMX_BASECOMPONENT *pSECComponent = NULL;
+    SEC_MP3_HANDLE        *pMp3Dec = NULL;
+    SEC_MP3_ZERO_COPY     *pZeroCopy = NULL;
+    OMX_U32                i = 0;
+
+    FunctionIn();
+
+    if (hComponent == NULL) {
+        ret = OMX_ErrorBadParameter;
+        goto EXIT;
+    }
+    pOMXComponent = (OMX_COMPONENTTYPE *)hComponent;
+    ret = SEC_OMX_Check_SizeVersion(pOMXComponent, sizeof(OMX_COMPONENTTYPE));
+    if (ret != OMX_ErrorNone) {
+        goto EXIT;
+    }
+    if (pOMXComponent->pComponentPrivate == NULL) {
+        ret = OMX_ErrorBadParameter;
+        goto EXIT;
+    }
+
+    pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    pMp3Dec = (SEC_MP3_HANDLE *)((SEC_OMX_AUDIODEC_COMPONENT *)pSECComponent->hComponentHandle)->hCodecHandle;
+    pZeroCopy = &pMp3Dec->zeroCopy;
+
+    /* Output buffers are allocated on a free OBUF while they fit in one */
+    if ((nPortIndex == OUTPUT_PORT_INDEX) && (nSizeBytes <= pMp3Dec->nObufSize)) {
+        for (i = 0; i < pZeroCopy->nObufNum; i++) {
+            if (pZeroCopy->pHeader[i] != NULL)
+                continue;
+
+            ret = SEC_OMX_UseBuffer(hComponent, ppBuffer, nPortIndex, pAppPrivate,
+                                    pMp3Dec->nObufSize, pZeroCopy->pObuf + i * pMp3Dec->nObufSize);
+            if (ret == OMX_ErrorNone) {
+                pZeroCopy->pHeader[i] = *ppBuffer;
+                pZeroCopy->bClient[i] = OMX_FALSE;
+                pZeroCopy->nAssigned++;
+            }
+            goto EXIT;
+        }
+    }
+
+    ret = SEC_OMX_AllocateBuffer(hComponent, ppBuffer, nPortIndex, pAppPrivate, nSizeBytes);
+
+EXIT:
+    FunctionOut();
+
+    return ret;
+}
+
+OMX_ERRORTYPE SEC_SRP_Mp3Dec_FreeBuffer(
+    OMX_IN OMX_HANDLETYPE        hComponent,
+    OMX_IN OMX_U32               nPortIndex,
+    OMX_IN OMX_BUFFERHEADERTYPE *pBufferHdr)
+{
+    OMX_ERRORTYPE          ret = OMX_ErrorNone;
+    OMX_COMPONENTTYPE     *pOMXComponent = NULL;
+    SEC_OMX_BASECOMPONENT *pSECComponent = NULL;
+    SEC_MP3_HANDLE        *pMp3Dec = NULL;
+    SEC_MP3_ZERO_COPY     *pZeroCopy = NULL;
+    OMX_U32                i = 0;
+
+    FunctionIn();
+
+    if ((hComponent == NULL) || (pBufferHdr == NULL)) {
+        ret = OMX_ErrorBadParameter;
+        goto EXIT;
+    }
+    pOMXComponent = (OMX_COMPONENTTYPE *)hComponent;
+    if (pOMXComponent->pComponentPrivate == NULL) {
+        ret = OMX_ErrorBadParameter;
+        goto EXIT;
+    }
+
+    pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    pMp3Dec = (SEC_MP3_HANDLE *)((SEC_OMX_AUDIODEC_COMPONENT *)pSECComponent->hComponentHandle)->hCodecHandle;
+    pZeroCopy = &pMp3Dec->zeroCopy;
+
+    if (nPortIndex == OUTPUT_PORT_INDEX) {
+        for (i = 0; i < pZeroCopy->nObufNum; i++) {
+            if (pZeroCopy->pHeader[i] == pBufferHdr) {
+                pZeroCopy->pHeader[i] = NULL;
+                pZeroCopy->bClient[i] = OMX_FALSE;
+                pZeroCopy->nAssigned--;
+                break;
+            }
+        }
+    }
+
+    ret = SEC_OMX_FreeBuffer(hComponent, nPortIndex, pBufferHdr);
+
+EXIT:
+    FunctionOut();
+
+    return ret;
+}
+
+OMX_ERRORTYPE SEC_SRP_Mp3Dec_FillThisBuffer(
+    OMX_IN OMX_HANDLETYPE        hComponent,
+    OMX_IN OMX_BUFFERHEADERTYPE *pBuffer)
+{
+    OMX_ERRORTYPE          ret = OMX_ErrorNone;
+    OMX_COMPONENTTYPE     *pOMXComponent = NULL;
+    SEC_OMX_BASECOMPONENT *pSECComponent = NULL;
+    SEC_MP3_HANDLE        *pMp3Dec = NULL;
+    OMX_PTR                bufferMutex = NULL;
+    OMX_BOOL               bClient = OMX_FALSE;
+    OMX_U32                i = 0;
+
+    FunctionIn();
+
+    if (hComponent == NULL) {
+        ret = OMX_ErrorBadParameter;
+        goto EXIT;
+    }
+    pOMXComponent = (OMX_COMPONENTTYPE *)hComponent;
+    if (pOMXComponent->pComponentPrivate == NULL) {
+        ret = OMX_ErrorBadParameter;
+        goto EXIT;
+    }
+
+    pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    pMp3Dec = (SEC_MP3_HANDLE *)((SEC_OMX_AUDIODEC_COMPONENT *)pSECComponent->hComponentHandle)->hCodecHandle;
+    bufferMutex = pSECComponent->secDataBuffer[OUTPUT_PORT_INDEX].bufferMutex;
+
+    for (i = 0; i < pMp3Dec->zeroCopy.nObufNum; i++) {
+        if (pMp3Dec->zeroCopy.pHeader[i] == pBuffer)
+            break;
+    }
+
+    /*
+     * The client is done with the PCM in it, the DSP may refill the OBUF.
+     * Clear it before the header is queued: once queued, the buffer thread
+     * may already deliver new PCM in it and mark it held again.
+     */
+    if (i < pMp3Dec->zeroCopy.nObufNum) {
+        SEC_OSAL_MutexLock(bufferMutex);
+        bClient = pMp3Dec->zeroCopy.bClient[i];
+        pMp3Dec->zeroCopy.bClient[i] = OMX_FALSE;
+        SEC_OSAL_MutexUnlock(bufferMutex);
+    }
+
+    ret = SEC_OMX_FillThisBuffer(hComponent, pBuffer);
+    if ((ret != OMX_ErrorNone) && (i < pMp3Dec->zeroCopy.nObufNum)) {
+        /* Not queued, the client still holds the PCM */
+        SEC_OSAL_MutexLock(bufferMutex);
+        pMp3Dec->zeroCopy.bClient[i] = bClient;
+        SEC_OSAL_MutexUnlock(bufferMutex);
+    }
+
+EXIT:
+    FunctionOut();
+
+    return ret;
+}
+
 OMX_ERRORTYPE SEC_SRP_Mp3Dec_Init(OMX_COMPONENTTYPE *pOMXComponent)
 {
     OMX_ERRORTYPE               ret = OMX_ErrorNone;
@@ -450,6 +823,40 @@ OMX_ERRORTYPE SEC_SRP_Mp3Dec_Init(OMX_COMPONENTTYPE *pOMXComponent)
     pMp3Dec->hSRPMp3Handle.bSRPSendEOS = OMX_FALSE;
     pSECComponent->getAllDelayBuffer = OMX_FALSE;
 
+    if (pMp3Dec->bSoftwareDecode == OMX_TRUE) {
+        SEC_SW_MP3_HANDLE     *pSWMp3 = &pMp3Dec->hSWMp3Handle;
+        tPVMP3DecoderExternal *pConfig = NULL;
+
+        pSWMp3->pConfig = SEC_OSAL_Malloc(sizeof(tPVMP3DecoderExternal));
+        pSWMp3->pDecoderBuf = SEC_OSAL_Malloc(pvmp3_decoderMemRequirements());
+        if ((pSWMp3->pConfig == NULL) || (pSWMp3->pDecoderBuf == NULL)) {
+            SEC_OSAL_Log(SEC_LOG_ERROR, "Software decoder alloc failed");
+            ret = OMX_ErrorInsufficientResources;
+            goto EXIT;
+        }
+
+        pConfig = (tPVMP3DecoderExternal *)pSWMp3->pConfig;
+        SEC_OSAL_Memset(pConfig, 0, sizeof(tPVMP3DecoderExternal));
+        pConfig->equalizerType = flat;
+        pConfig->crcEnabled = 0;
+        pvmp3_InitDecoder(pConfig, pSWMp3->pDecoderBuf);
+
+        pSWMp3->bConfigured = OMX_FALSE;
+        pSWMp3->nInputOffset = 0;
+        pSWMp3->nInputSamples = 0;
+    }
+
+    SEC_SRP_Mp3Dec_ZeroCopyReset(&pMp3Dec->zeroCopy);
+    SEC_SRP_Mp3Dec_DeepBufferReset(&pMp3Dec->deepBuffer);
+    if (pMp3Dec->deepBuffer.bEnabled == OMX_TRUE) {
+        pMp3Dec->deepBuffer.pBuffer = SEC_OSAL_Malloc(pMp3Dec->deepBuffer.nAllocLen);
+        if (pMp3Dec->deepBuffer.pBuffer == NULL) {
+            SEC_OSAL_Log(SEC_LOG_ERROR, "Deep buffer alloc failed");
+            ret = OMX_ErrorInsufficientResources;
+            goto EXIT;
+        }
+    }
+
 #ifdef SRP_DUMP_TO_FILE
     inFile = fopen("/data/InFile.mp3", "w+");
     outFile = fopen("/data/OutFile.pcm", "w+");
@@ -465,9 +872,25 @@ OMX_ERRORTYPE SEC_SRP_Mp3Dec_Terminate(OMX_COMPONENTTYPE *pOMXComponent)
 {
     OMX_ERRORTYPE               ret = OMX_ErrorNone;
     SEC_OMX_BASECOMPONENT      *pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    SEC_OMX_AUDIODEC_COMPONENT *pAudioDec = (SEC_OMX_AUDIODEC_COMPONENT *)pSECComponent->hComponentHandle;
+    SEC_MP3_HANDLE             *pMp3Dec = (SEC_MP3_HANDLE *)pAudioDec->hCodecHandle;
 
     FunctionIn();
 
+    if (pMp3Dec->deepBuffer.pBuffer != NULL) {
+        SEC_OSAL_Free(pMp3Dec->deepBuffer.pBuffer);
+        pMp3Dec->deepBuffer.pBuffer = NULL;
+    }
+
+    if (pMp3Dec->hSWMp3Handle.pConfig != NULL) {
+        SEC_OSAL_Free(pMp3Dec->hSWMp3Handle.pConfig);
+        pMp3Dec->hSWMp3Handle.pConfig = NULL;
+    }
+    if (pMp3Dec->hSWMp3Handle.pDecoderBuf != NULL) {
+        SEC_OSAL_Free(pMp3Dec->hSWMp3Handle.pDecoderBuf);
+        pMp3Dec->hSWMp3Handle.pDecoderBuf = NULL;
+    }
+
 #ifdef SRP_DUMP_TO_FILE
     fclose(inFile);
     fclose(outFile);
@@ -479,6 +902,127 @@ EXIT:
     return ret;
 }
 
+static OMX_ERRORTYPE SEC_SRP_Mp3_Decode_Deep(OMX_COMPONENTTYPE *pOMXComponent, SEC_OMX_DATA *pInputData, SEC_OMX_DATA *pOutputData)
+{
+    OMX_ERRORTYPE               ret = OMX_ErrorNone;
+    SEC_OMX_BASECOMPONENT      *pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    SEC_OMX_AUDIODEC_COMPONENT *pAudioDec = (SEC_OMX_AUDIODEC_COMPONENT *)pSECComponent->hComponentHandle;
+    SEC_MP3_HANDLE             *pMp3Dec = (SEC_MP3_HANDLE *)pAudioDec->hCodecHandle;
+    SEC_MP3_DEEP_BUFFER        *pDeep = &pMp3Dec->deepBuffer;
+    OMX_U32                     frameSize = pMp3Dec->pcmParam.nChannels * (pMp3Dec->pcmParam.nBitPerSample / 8);
+    OMX_S32                     returnCodec = 0;
+    unsigned long               isSRPStopped = 0;
+    OMX_PTR                     dataBuffer = NULL;
+    unsigned int                dataLen = 0;
+    OMX_U32                     len = 0;
+    OMX_BOOL                    bProgress = OMX_FALSE;
+    OMX_BOOL                    bEOS = OMX_FALSE;
+
+    FunctionIn();
+
+    pOutputData->dataLen = 0;
+
+    /* Queue new input, a repeated call brings the same input again */
+    if ((pSECComponent->reInputData == OMX_FALSE) && (pInputData->dataLen > 0)) {
+        if ((pDeep->nOffset + pDeep->nDataLen + pInputData->dataLen) > pDeep->nAllocLen) {
+            SEC_OSAL_Memmove(pDeep->pBuffer, pDeep->pBuffer + pDeep->nOffset, pDeep->nDataLen);
+            pDeep->nOffset = 0;
+        }
+        SEC_OSAL_Memcpy(pDeep->pBuffer + pDeep->nOffset + pDeep->nDataLen, pInputData->dataBuffer, pInputData->dataLen);
+        pDeep->nDataLen += pInputData->dataLen;
+    }
+
+    if (pInputData->nFlags & OMX_BUFFERFLAG_EOS) {
+        bEOS = OMX_TRUE;
+    } else if (pMp3Dec->hSRPMp3Handle.bSRPSendEOS == OMX_TRUE) { /* Flush after EOS */
+        pMp3Dec->hSRPMp3Handle.bSRPSendEOS = OMX_FALSE;
+        pSECComponent->getAllDelayBuffer = OMX_FALSE;
+    }
+
+    if ((bEOS == OMX_FALSE) && (pDeep->nDataLen < pDeep->nBatchLen))
+        goto EXIT;
+
+    if (pDeep->pOutBuffer != pOutputData->dataBuffer) {
+        pDeep->pOutBuffer = pOutputData->dataBuffer;
+        pDeep->nOutLen = 0;
+    }
+
+    while ((pDeep->nOutLen + pMp3Dec->nObufSize) <= pOutputData->allocSize) {
+        bProgress = OMX_FALSE;
+
+        if (pDeep->nDataLen > 0) {
+            len = (pDeep->nDataLen < pMp3Dec->nIbufSize) ? pDeep->nDataLen : pMp3Dec->nIbufSize;
+            returnCodec = SRP_Decode(pDeep->pBuffer + pDeep->nOffset, len);
+            pDeep->nStatSRPCalls++;
+            if (returnCodec != SRP_ERROR_IBUF_OVERFLOW) {
+                if (returnCodec < 0)
+                    SEC_OSAL_Log(SEC_LOG_ERROR, "SRP_Decode failed: %d", returnCodec);
+                pDeep->nOffset += len;
+                pDeep->nDataLen -= len;
+                bProgress = OMX_TRUE;
+            }
+        } else if ((bEOS == OMX_TRUE) && (pMp3Dec->hSRPMp3Handle.bSRPSendEOS == OMX_FALSE)) {
+            SRP_Send_EOS();
+            pMp3Dec->hSRPMp3Handle.bSRPSendEOS = OMX_TRUE;
+            pSECComponent->getAllDelayBuffer = OMX_TRUE;
+        }
+
+        returnCodec = SRP_Get_PCM(&dataBuffer, &dataLen);
+        pDeep->nStatSRPCalls++;
+        if (dataLen > 0) {
+            if (pDeep->nOutLen == 0)
+                pDeep->outTimeStamp = pDeep->baseTimeStamp +
+                    (OMX_TICKS)(pDeep->nSamples * 1000000 / pMp3Dec->pcmParam.nSamplingRate);
+            SEC_OSAL_Memcpy(pDeep->pOutBuffer + pDeep->nOutLen, dataBuffer, dataLen);
+            pDeep->nOutLen += dataLen;
+            pDeep->nSamples += dataLen / frameSize;
+            bProgress = OMX_TRUE;
+        } else if (pMp3Dec->hSRPMp3Handle.bSRPSendEOS == OMX_TRUE) {
+            returnCodec = SRP_GetParams(SRP_STOP_EOS_STATE, &isSRPStopped);
+            if (returnCodec != 0)
+                SEC_OSAL_Log(SEC_LOG_ERROR, "Fail SRP_STOP_EOS_STATE");
+            if (isSRPStopped == 1)
+                break;
+        }
+
+        if (bProgress == OMX_FALSE)
+            break;
+    }
+
+#ifdef SRP_DUMP_TO_FILE
+    if (pDeep->nOutLen > 0)
+        fwrite(pDeep->pOutBuffer, pDeep->nOutLen, 1, outFile);
+#endif
+
+    if (isSRPStopped == 1) {
+        /* All the PCM is out, the last buffer carries EOS */
+        SEC_SRP_Mp3Dec_DeepBufferReturn(pMp3Dec, pOutputData);
+        pOutputData->nFlags |= OMX_BUFFERFLAG_EOS;
+        pSECComponent->getAllDelayBuffer = OMX_FALSE;
+        pMp3Dec->hSRPMp3Handle.bSRPSendEOS = OMX_FALSE; /* for repeating one song */
+        SEC_SRP_Mp3Dec_DeepBufferReset(pDeep);
+        ret = OMX_ErrorNone;
+    } else if ((pDeep->nOutLen + pMp3Dec->nObufSize) > pOutputData->allocSize) {
+        SEC_SRP_Mp3Dec_DeepBufferReturn(pMp3Dec, pOutputData);
+        if ((pDeep->nDataLen > 0) || (pMp3Dec->hSRPMp3Handle.bSRPSendEOS == OMX_TRUE))
+            ret = OMX_ErrorInputDataDecodeYet;
+        else
+            ret = OMX_ErrorNone;
+    } else if ((pDeep->nDataLen > 0) || (pMp3Dec->hSRPMp3Handle.bSRPSendEOS == OMX_TRUE)) {
+        /* IBUF is full and no PCM is ready yet, give the SRP some time */
+        SEC_OSAL_SleepMillisec(MP3_DEEP_BUFFER_STALL_WAIT);
+        ret = OMX_ErrorInputDataDecodeYet;
+    } else {
+        /* Batch is decoded, the output buffer is kept for the next one */
+        ret = OMX_ErrorNone;
+    }
+
+EXIT:
+    FunctionOut();
+
+    return ret;
+}
+
 OMX_ERRORTYPE SEC_SRP_Mp3_Decode_Block(OMX_COMPONENTTYPE *pOMXComponent, SEC_OMX_DATA *pInputData, SEC_OMX_DATA *pOutputData)
 {
     OMX_ERRORTYPE               ret = OMX_ErrorNone;
@@ -491,6 +1035,7 @@ OMX_ERRORTYPE SEC_SRP_Mp3_Decode_Block(OMX_COMPONENTTYPE *pOMXComponent, SEC_OMX
     OMX_PTR                     dataBuffer = NULL;
     unsigned int                dataLen = 0;
     OMX_BOOL                    isSRPIbufOverflow = OMX_FALSE;
+    OMX_BOOL                    bPCMDrained = OMX_TRUE;
 
     FunctionIn();
 
@@ -504,6 +1049,29 @@ OMX_ERRORTYPE SEC_SRP_Mp3_Decode_Block(OMX_COMPONENTTYPE *pOMXComponent, SEC_OMX
     pOutputData->timeStamp = pInputData->timeStamp;
     pOutputData->nFlags = pInputData->nFlags & (~OMX_BUFFERFLAG_EOS);
 
+    /* First frame after a flush, SRP_Flush() dropped what the SRP had */
+    if ((pSECComponent->reInputData == OMX_FALSE) &&
+        (pSECComponent->checkTimeStamp.needCheckStartTimeStamp == OMX_TRUE) &&
+        (pSECComponent->checkTimeStamp.startTimeStamp == pInputData->timeStamp)) {
+        SEC_SRP_Mp3Dec_ZeroCopyReset(&pMp3Dec->zeroCopy);
+        if (pMp3Dec->deepBuffer.bEnabled == OMX_TRUE)
+            SEC_SRP_Mp3Dec_DeepBufferReset(&pMp3Dec->deepBuffer);
+    }
+
+    if (pMp3Dec->deepBuffer.bEnabled == OMX_TRUE) {
+        SEC_MP3_DEEP_BUFFER *pDeep = &pMp3Dec->deepBuffer;
+
+        if (pDeep->bTimeStampValid == OMX_FALSE) {
+            pDeep->baseTimeStamp = pInputData->timeStamp;
+            pDeep->bTimeStampValid = OMX_TRUE;
+        }
+
+        if (pMp3Dec->hSRPMp3Handle.bConfiguredSRP == OMX_TRUE) {
+            ret = SEC_SRP_Mp3_Decode_Deep(pOMXComponent, pInputData, pOutputData);
+            goto EXIT;
+        }
+    }
+
     /* Decoding mp3 frames by SRP */
     if (pSECComponent->getAllDelayBuffer == OMX_FALSE) {
         returnCodec = SRP_Decode(pInputData->dataBuffer, pInputData->dataLen);
@@ -578,12 +1146,16 @@ OMX_ERRORTYPE SEC_SRP_Mp3_Decode_Block(OMX_COMPONENTTYPE *pOMXComponent, SEC_OMX
     }
 
     /* Get decoded data from SRP */
-    returnCodec = SRP_Get_PCM(&dataBuffer, &dataLen);
-    if (dataLen > 0) {
-        pOutputData->dataLen = dataLen;
-        SEC_OSAL_Memcpy(pOutputData->dataBuffer, dataBuffer, dataLen);
+    if (SEC_SRP_Mp3Dec_IsZeroCopy(pSECComponent, pMp3Dec) == OMX_TRUE) {
+        bPCMDrained = SEC_SRP_Mp3Dec_ZeroCopyGetPCM(pOMXComponent, pOutputData);
     } else {
-        pOutputData->dataLen = 0;
+        returnCodec = SRP_Get_PCM(&dataBuffer, &dataLen);
+        if (dataLen > 0) {
+            pOutputData->dataLen = dataLen;
+            SEC_OSAL_Memcpy(pOutputData->dataBuffer, dataBuffer, dataLen);
+        } else {
+            pOutputData->dataLen = 0;
+        }
     }
 
 #ifdef SRP_DUMP_TO_FILE
@@ -597,7 +1169,7 @@ OMX_ERRORTYPE SEC_SRP_Mp3_Decode_Block(OMX_COMPONENTTYPE *pOMXComponent, SEC_OMX
             returnCodec = SRP_GetParams(SRP_STOP_EOS_STATE, &isSRPStopped);
             if (returnCodec != 0)
                 SEC_OSAL_Log(SEC_LOG_ERROR, "Fail SRP_STOP_EOS_STATE");
-            if (isSRPStopped == 1) {
+            if ((isSRPStopped == 1) && (bPCMDrained == OMX_TRUE)) {
                 pOutputData->nFlags |= OMX_BUFFERFLAG_EOS;
                 pSECComponent->getAllDelayBuffer = OMX_FALSE;
                 pMp3Dec->hSRPMp3Handle.bSRPSendEOS = OMX_FALSE; /* for repeating one song */
@@ -616,12 +1188,114 @@ EXIT:
     return ret;
 }
 
+/*
+ * Software decoding, used when the SRP is busy or not working. Every
+ * instance has its own decoder state, so several streams can be decoded at
+ * once. An input buffer may hold more than one frame, what does not fit in
+ * the output buffer is decoded on the next call.
+ */
+OMX_ERRORTYPE SEC_SW_Mp3_Decode_Block(OMX_COMPONENTTYPE *pOMXComponent, SEC_OMX_DATA *pInputData, SEC_OMX_DATA *pOutputData)
+{
+    OMX_ERRORTYPE               ret = OMX_ErrorNone;
+    SEC_OMX_BASECOMPONENT      *pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    SEC_OMX_AUDIODEC_COMPONENT *pAudioDec = (SEC_OMX_AUDIODEC_COMPONENT *)pSECComponent->hComponentHandle;
+    SEC_MP3_HANDLE             *pMp3Dec = (SEC_MP3_HANDLE *)pAudioDec->hCodecHandle;
+    SEC_SW_MP3_HANDLE          *pSWMp3 = &pMp3Dec->hSWMp3Handle;
+    tPVMP3DecoderExternal      *pConfig = (tPVMP3DecoderExternal *)pSWMp3->pConfig;
+    OMX_U32                     maxFrameLen = MP3_SW_MAX_FRAME_SAMPLES * MP3_SW_MAX_CHANNELS * sizeof(OMX_S16);
+    ERROR_CODE                  decoderErr;
+
+    FunctionIn();
+
+    if (pSECComponent->reInputData == OMX_FALSE) {
+        /* First frame after a flush, the overlap and bit reservoir are stale */
+        if ((pSECComponent->checkTimeStamp.needCheckStartTimeStamp == OMX_TRUE) &&
+            (pSECComponent->checkTimeStamp.startTimeStamp == pInputData->timeStamp))
+            pvmp3_InitDecoder(pConfig, pSWMp3->pDecoderBuf);
+
+        pSWMp3->nInputOffset = 0;
+        pSWMp3->nInputSamples = 0;
+    }
+
+    /* Timestamp of the first sample decoded by this call */
+    pOutputData->timeStamp = pInputData->timeStamp;
+    if ((pSWMp3->nInputSamples > 0) && (pMp3Dec->pcmParam.nSamplingRate > 0))
+        pOutputData->timeStamp += (OMX_TICKS)pSWMp3->nInputSamples * 1000000 / pMp3Dec->pcmParam.nSamplingRate;
+    pOutputData->nFlags = pInputData->nFlags & (~OMX_BUFFERFLAG_EOS);
+    pOutputData->dataLen = 0;
+
+    while (pSWMp3->nInputOffset < pInputData->dataLen) {
+        if ((pOutputData->allocSize - pOutputData->dataLen) < maxFrameLen) {
+            ret = OMX_ErrorInputDataDecodeYet;
+            goto EXIT;
+        }
+
+        pConfig->pInputBuffer = pInputData->dataBuffer + pSWMp3->nInputOffset;
+        pConfig->inputBufferCurrentLength = pInputData->dataLen - pSWMp3->nInputOffset;
+        pConfig->inputBufferMaxLength = 0;
+        pConfig->inputBufferUsedLength = 0;
+        pConfig->pOutputBuffer = (OMX_S16 *)(pOutputData->dataBuffer + pOutputData->dataLen);
+        pConfig->outputFrameSize = maxFrameLen / sizeof(OMX_S16);
+
+        decoderErr = pvmp3_framedecoder(pConfig, pSWMp3->pDecoderBuf);
+        if (decoderErr != NO_DECODING_ERROR) {
+            if ((decoderErr != NO_ENOUGH_MAIN_DATA_ERROR) && (decoderErr != SIDE_INFO_ERROR))
+                SEC_OSAL_Log(SEC_LOG_ERROR, "pvmp3_framedecoder failed: %d", decoderErr);
+
+            /* The frame length is unknown, drop the rest and play silence for it */
+            if (pSWMp3->bConfigured == OMX_TRUE) {
+                SEC_OSAL_Memset(pOutputData->dataBuffer + pOutputData->dataLen, 0, pSWMp3->nFrameLen);
+                pOutputData->dataLen += pSWMp3->nFrameLen;
+            }
+            pSWMp3->nInputOffset = pInputData->dataLen;
+            break;
+        }
+
+        if (pMp3Dec->pcmParam.nChannels != (OMX_U32)pConfig->num_channels ||
+            pMp3Dec->pcmParam.nSamplingRate != (OMX_U32)pConfig->samplingRate) {
+            SEC_OSAL_Log(SEC_LOG_TRACE, "numChannels(%d), samplingRate(%d)",
+                pConfig->num_channels, pConfig->samplingRate);
+
+            /* Change channel count and sampling rate information */
+            pMp3Dec->pcmParam.nChannels = pConfig->num_channels;
+            pMp3Dec->pcmParam.nSamplingRate = pConfig->samplingRate;
+
+            /* Send Port Settings changed call back */
+            (*(pSECComponent->pCallbacks->EventHandler))
+                  (pOMXComponent,
+                   pSECComponent->callbackData,
+                   OMX_EventPortSettingsChanged, /* The command was completed */
+                   OMX_DirOutput, /* This is the port index */
+                   0,
+                   NULL);
+        }
+        pSWMp3->bConfigured = OMX_TRUE;
+
+        pSWMp3->nFrameLen = pConfig->outputFrameSize * sizeof(OMX_S16);
+        pSWMp3->nInputOffset += pConfig->inputBufferUsedLength;
+        pSWMp3->nInputSamples += pConfig->outputFrameSize / pConfig->num_channels;
+        pOutputData->dataLen += pSWMp3->nFrameLen;
+
+        if (pConfig->inputBufferUsedLength == 0)
+            pSWMp3->nInputOffset = pInputData->dataLen;
+    }
+
+    if (pInputData->nFlags & OMX_BUFFERFLAG_EOS)
+        pOutputData->nFlags |= OMX_BUFFERFLAG_EOS;
+
+EXIT:
+    FunctionOut();
+
+    return ret;
+}
+
 OMX_ERRORTYPE SEC_SRP_Mp3Dec_bufferProcess(OMX_COMPONENTTYPE *pOMXComponent, SEC_OMX_DATA *pInputData, SEC_OMX_DATA *pOutputData)
 {
     OMX_ERRORTYPE          ret = OMX_ErrorNone;
     SEC_OMX_BASECOMPONENT *pSECComponent = (SEC_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
     SEC_OMX_BASEPORT      *pInputPort = &pSECComponent->pSECPort[INPUT_PORT_INDEX];
     SEC_OMX_BASEPORT      *pOutputPort = &pSECComponent->pSECPort[OUTPUT_PORT_INDEX];
+    SEC_MP3_HANDLE        *pMp3Dec = (SEC_MP3_HANDLE *)((SEC_OMX_AUDIODEC_COMPONENT *)pSECComponent->hComponentHandle)->hCodecHandle;
 
     FunctionIn();
 
@@ -643,7 +1317,10 @@ OMX_ERRORTYPE SEC_SRP_Mp3Dec_bufferProcess(OMX_COMPONENTTYPE *pOMXComponent, SEC
         goto EXIT;
     }
 
-    ret = SEC_SRP_Mp3_Decode_Block(pOMXComponent, pInputData, pOutputData);
+    if (pMp3Dec->bSoftwareDecode == OMX_TRUE)
+        ret = SEC_SW_Mp3_Decode_Block(pOMXComponent, pInputData, pOutputData);
+    else
+        ret = SEC_SRP_Mp3_Decode_Block(pOMXComponent, pInputData, pOutputData);
 
     if (ret != OMX_ErrorNone) {
         if (ret == OMX_ErrorInputDataDecodeYet) {
@@ -729,29 +1406,55 @@ OSCL_EXPORT_REF OMX_ERRORTYPE SEC_OMX_ComponentInit(OMX_HANDLETYPE hComponent, O
     pAudioDec = (SEC_OMX_AUDIODEC_COMPONENT *)pSECComponent->hComponentHandle;
     pAudioDec->hCodecHandle = (OMX_HANDLETYPE)pMp3Dec;
 
-    /* Create and Init SRP */
+    /* Create and Init SRP, decode in software if it is busy or not working */
     pMp3Dec->hSRPMp3Handle.bSRPLoaded = OMX_FALSE;
-    returnCodec = SRP_Create(SRP_INIT_BLOCK_MODE);
-    if (returnCodec < 0) {
-        SEC_OSAL_Log(SEC_LOG_ERROR, "SRP_Create failed: %d", returnCodec);
-        ret = OMX_ErrorHardware;
-        goto EXIT_ERROR_3;
-    }
-    pMp3Dec->hSRPMp3Handle.hSRPHandle = (OMX_HANDLETYPE)returnCodec; /* SRP's fd */
-    returnCodec = SRP_Init();
-    if (returnCodec < 0) {
-        SEC_OSAL_Log(SEC_LOG_ERROR, "SRP_Init failed: %d", returnCodec);
-        ret = OMX_ErrorHardware;
-        goto EXIT_ERROR_4;
+    pMp3Dec->bSoftwareDecode = OMX_TRUE;
+    if (SRP_IsOpen()) {
+        SEC_OSAL_Log(SEC_LOG_WARNING, "SRP is in use, using software decoder");
+    } else {
+        returnCodec = SRP_Create(SRP_INIT_BLOCK_MODE);
+        if (returnCodec < 0) {
+            SEC_OSAL_Log(SEC_LOG_WARNING, "SRP_Create failed: %d, using software decoder", returnCodec);
+        } else {
+            pMp3Dec->hSRPMp3Handle.hSRPHandle = (OMX_HANDLETYPE)returnCodec; /* SRP's fd */
+            returnCodec = SRP_Init();
+            if (returnCodec < 0) {
+                SEC_OSAL_Log(SEC_LOG_WARNING, "SRP_Init failed: %d, using software decoder", returnCodec);
+                SRP_Terminate();
+            } else {
+                pMp3Dec->hSRPMp3Handle.bSRPLoaded = OMX_TRUE;
+                pMp3Dec->bSoftwareDecode = OMX_FALSE;
+            }
+        }
     }
-    pMp3Dec->hSRPMp3Handle.bSRPLoaded = OMX_TRUE;
 
-    /* Get input buffer info from SRP */
-    returnCodec = SRP_Get_Ibuf_Info(&pInputBuffer, &inputBufferSize, &inputBufferNum);
-    if (returnCodec < 0) {
-        SEC_OSAL_Log(SEC_LOG_ERROR, "SRP_Get_Ibuf_Info failed: %d", returnCodec);
-        ret = OMX_ErrorHardware;
-        goto EXIT_ERROR_5;
+    if (pMp3Dec->bSoftwareDecode == OMX_FALSE) {
+        /* Get input and output buffer info from SRP */
+        returnCodec = SRP_Get_Ibuf_Info(&pInputBuffer, &inputBufferSize, &inputBufferNum);
+        if (returnCodec < 0) {
+            SEC_OSAL_Log(SEC_LOG_ERROR, "SRP_Get_Ibuf_Info failed: %d", returnCodec);
+            ret = OMX_ErrorHardware;
+            goto EXIT_ERROR_3;
+        }
+
+        returnCodec = SRP_Get_Obuf_Info(&pOutputBuffer, &outputBufferSize, &outputBufferNum);
+        if (returnCodec < 0) {
+            SEC_OSAL_Log(SEC_LOG_ERROR, "SRP_Get_Obuf_Info failed: %d", returnCodec);
+            ret = OMX_ErrorHardware;
+            goto EXIT_ERROR_3;
+        }
+
+        /* Output buffers may be allocated on the OBUFs, see SEC_SRP_Mp3Dec_AllocateBuffer() */
+        if (outputBufferNum <= MP3_ZERO_COPY_MAX_OBUF) {
+            pMp3Dec->zeroCopy.pObuf = (OMX_U8 *)pOutputBuffer;
+            pMp3Dec->zeroCopy.nObufNum = outputBufferNum;
+        }
+    } else {
+        pSECComponent->codecType = SW_CODEC;
+        inputBufferSize = DEFAULT_AUDIO_INPUT_BUFFER_SIZE;
+        inputBufferNum = MAX_AUDIO_INPUTBUFFER_NUM;
+        outputBufferSize = DEFAULT_AUDIO_OUTPUT_BUFFER_SIZE;
+        outputBufferNum = MAX_AUDIO_OUTPUTBUFFER_NUM;
     }
 
     pSECComponent->processData[INPUT_PORT_INDEX].allocSize = inputBufferSize;
@@ -759,16 +1462,13 @@ OSCL_EXPORT_REF OMX_ERRORTYPE SEC_OMX_ComponentInit(OMX_HANDLETYPE hComponent, O
     if (pSECComponent->processData[INPUT_PORT_INDEX].dataBuffer == NULL) {
         SEC_OSAL_Log(SEC_LOG_ERROR, "Input data buffer alloc failed");
         ret = OMX_ErrorInsufficientResources;
-        goto EXIT_ERROR_5;
+        goto EXIT_ERROR_3;
     }
 
-    /* Get output buffer info from SRP */
-    returnCodec = SRP_Get_Obuf_Info(&pOutputBuffer, &outputBufferSize, &outputBufferNum);
-    if (returnCodec < 0) {
-        SEC_OSAL_Log(SEC_LOG_ERROR, "SRP_Get_Obuf_Info failed: %d", returnCodec);
-        ret = OMX_ErrorHardware;
-        goto EXIT_ERROR_6;
-    }
+    pMp3Dec->nIbufSize = inputBufferSize;
+    pMp3Dec->nObufSize = outputBufferSize;
+    pMp3Dec->deepBuffer.bEnabled = OMX_FALSE;
+    pMp3Dec->deepBuffer.nWakeupInterval = MP3_DEEP_BUFFER_DEFAULT_INTERVAL;
 
     /* Set componentVersion */
     pSECComponent->componentVersion.s.nVersionMajor = VERSIONMAJOR_NUMBER;
@@ -836,6 +1536,11 @@ OSCL_EXPORT_REF OMX_ERRORTYPE SEC_OMX_ComponentInit(OMX_HANDLETYPE hComponent, O
     pOMXComponent->GetExtensionIndex = &SEC_SRP_Mp3Dec_GetExtensionIndex;
     pOMXComponent->ComponentRoleEnum = &SEC_SRP_Mp3Dec_ComponentRoleEnum;
     pOMXComponent->ComponentDeInit   = &SEC_OMX_ComponentDeinit;
+    if (pMp3Dec->zeroCopy.pObuf != NULL) {
+        pOMXComponent->AllocateBuffer = &SEC_SRP_Mp3Dec_AllocateBuffer;
+        pOMXComponent->FreeBuffer     = &SEC_SRP_Mp3Dec_FreeBuffer;
+        pOMXComponent->FillThisBuffer = &SEC_SRP_Mp3Dec_FillThisBuffer;
+    }
 
     /* ToDo: Change the function name associated with a specific codec */
     pSECComponent->sec_mfc_componentInit      = &SEC_SRP_Mp3Dec_Init;
@@ -848,15 +1553,11 @@ OSCL_EXPORT_REF OMX_ERRORTYPE SEC_OMX_ComponentInit(OMX_HANDLETYPE hComponent, O
     ret = OMX_ErrorNone;
     goto EXIT; /* This function is performed successfully. */
 
-EXIT_ERROR_6:
-    SEC_OSAL_Free(pSECComponent->processData[INPUT_PORT_INDEX].dataBuffer);
-    pSECComponent->processData[INPUT_PORT_INDEX].dataBuffer = NULL;
-    pSECComponent->processData[INPUT_PORT_INDEX].allocSize = 0;
-EXIT_ERROR_5:
-    SRP_Deinit();
-EXIT_ERROR_4:
-    SRP_Terminate();
 EXIT_ERROR_3:
+    if (pMp3Dec->hSRPMp3Handle.bSRPLoaded == OMX_TRUE) {
+        SRP_Deinit();
+        SRP_Terminate();
+    }
     SEC_OSAL_Free(pMp3Dec);
     pAudioDec->hCodecHandle = NULL;
 EXIT_ERROR_2:
@@ -39,6 +39,92 @@ typedef struct _SEC_SRP_MP3_HANDLE
     OMX_S32        returnCodec;
 } SEC_SRP_MP3_HANDLE;
 
+/* Software decoder, used when the SRP can not be opened */
+#define MP3_SW_MAX_FRAME_SAMPLES            1152    /* per channel, MPEG-1 Layer III */
+#define MP3_SW_MAX_CHANNELS                 2
+
+typedef struct _SEC_SW_MP3_HANDLE
+{
+    OMX_PTR   pConfig;          /* tPVMP3DecoderExternal */
+    OMX_PTR   pDecoderBuf;
+    OMX_BOOL  bConfigured;
+    OMX_U32   nFrameLen;        /* PCM bytes of the last frame, for concealment */
+
+    /* Bytes of the current input decoded so far, and samples they gave */
+    OMX_U32   nInputOffset;
+    OMX_U32   nInputSamples;
+} SEC_SW_MP3_HANDLE;
+
+/* Deep buffer mode */
+#define MP3_DEEP_BUFFER_DEFAULT_INTERVAL    1000    /* ms */
+#define MP3_DEEP_BUFFER_MIN_INTERVAL        100     /* ms */
+#define MP3_DEEP_BUFFER_MAX_INTERVAL        10000   /* ms */
+#define MP3_DEEP_BUFFER_MAX_BITRATE         320     /* kbps, sizes the input batch */
+#define MP3_DEEP_BUFFER_STALL_WAIT          10      /* ms, SRP is full and has no PCM yet */
+
+typedef struct _SEC_MP3_DEEP_BUFFER
+{
+    OMX_BOOL  bEnabled;
+    OMX_U32   nWakeupInterval;
+
+    /* Compressed input not sent to the SRP yet, nDataLen bytes from nOffset */
+    OMX_U8   *pBuffer;
+    OMX_U32   nAllocLen;
+    OMX_U32   nBatchLen;
+    OMX_U32   nOffset;
+    OMX_U32   nDataLen;
+
+    /* Output buffer being filled, it is returned when full */
+    OMX_U8   *pOutBuffer;
+    OMX_U32   nOutLen;
+    OMX_TICKS outTimeStamp;
+
+    /* Timestamp of the first sample since flush, and samples returned since */
+    OMX_BOOL  bTimeStampValid;
+    OMX_TICKS baseTimeStamp;
+    OMX_U64   nSamples;
+
+    /* Wakeup statistics, per minute of PCM returned */
+    OMX_U64   nStatSamples;
+    OMX_U32   nStatWakeups;
+    OMX_U32   nStatSRPCalls;
+    OMX_U32   nWakeupsPerMinute;
+} SEC_MP3_DEEP_BUFFER;
+
+/*
+ * Zero copy output. The output port buffers are allocated on the SRP OBUFs,
+ * so the PCM is returned in place. The driver fills the OBUFs in turn and
+ * refills one only after the following SRP_Get_PCM, so a read must wait
+ * until the client has given back the OBUF the previous read returned, or
+ * after a flush, all of them.
+ */
+#define MP3_ZERO_COPY_MAX_OBUF              4
+#define MP3_ZERO_COPY_CLIENT_WAIT           2       /* ms, the client still has the OBUF a read would free */
+
+typedef struct _SEC_MP3_ZERO_COPY
+{
+    /* OBUF mapping, nObufNum OBUFs of SEC_MP3_HANDLE.nObufSize bytes */
+    OMX_U8               *pObuf;
+    OMX_U32               nObufNum;
+
+    /* Output buffer header allocated on each OBUF */
+    OMX_BUFFERHEADERTYPE *pHeader[MP3_ZERO_COPY_MAX_OBUF];
+    OMX_U32               nAssigned;
+
+    /*
+     * OBUF holds PCM the client has not given back, cleared in FillThisBuffer.
+     * Guarded by the bufferMutex of the output port's data buffer.
+     */
+    OMX_BOOL              bClient[MP3_ZERO_COPY_MAX_OBUF];
+
+    /* OBUF returned by the last read, -1 after a flush */
+    OMX_S32               nLastObuf;
+
+    /* PCM read but not returned yet, it waits for the header of its OBUF */
+    OMX_S32               nReadyObuf;
+    OMX_U32               nReadyLen;
+} SEC_MP3_ZERO_COPY;
+
 typedef struct _SEC_MP3_HANDLE
 {
     /* OMX Codec specific */
@@ -47,6 +133,14 @@ typedef struct _SEC_MP3_HANDLE
 
     /* SEC SRP Codec specific */
     SEC_SRP_MP3_HANDLE      hSRPMp3Handle;
+    OMX_U32                 nIbufSize;
+    OMX_U32                 nObufSize;
+    SEC_MP3_DEEP_BUFFER     deepBuffer;
+    SEC_MP3_ZERO_COPY       zeroCopy;
+
+    /* Software Codec specific */
+    OMX_BOOL                bSoftwareDecode;
+    SEC_SW_MP3_HANDLE       hSWMp3Handle;
 } SEC_MP3_HANDLE;
 
 #ifdef __cplusplus
@@ -64,12 +64,24 @@ typedef struct _SEC_OMX_PRIORITYMGMTTYPE
     OMX_U32 nGroupID;
 } SEC_OMX_PRIORITYMGMTTYPE;
 
+typedef struct _SEC_OMX_AUDIO_PARAM_DEEPBUFFERTYPE
+{
+    OMX_U32         nSize;
+    OMX_VERSIONTYPE nVersion;
+    OMX_U32         nPortIndex;
+    OMX_BOOL        bEnable;            /* batch input and return PCM in large buffers */
+    OMX_U32         nWakeupInterval;    /* target PCM duration of an output buffer, in ms */
+    OMX_U32         nWakeupsPerMinute;  /* read only, output buffers in the last minute played */
+} SEC_OMX_AUDIO_PARAM_DEEPBUFFERTYPE;
+
 typedef enum _SEC_OMX_INDEXTYPE
 {
 #define SEC_INDEX_PARAM_ENABLE_THUMBNAIL "OMX.SEC.index.ThumbnailMode"
     OMX_IndexVendorThumbnailMode        = 0x7F000001,
 #define SEC_INDEX_CONFIG_VIDEO_INTRAPERIOD "OMX.SEC.index.VideoIntraPeriod"
     OMX_IndexConfigVideoIntraPeriod     = 0x7F000002,
+#define SEC_INDEX_PARAM_AUDIO_DEEP_BUFFER "OMX.SEC.index.AudioDeepBuffer"
+    OMX_IndexParamAudioDeepBuffer       = 0x7F000003,
 
     /* for Android Native Window */
 #define SEC_INDEX_PARAM_ENABLE_ANB "OMX.google.android.index.enableAndroidNativeBuffers"
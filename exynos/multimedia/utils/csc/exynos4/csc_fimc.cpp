@@ -129,6 +129,96 @@ EXIT:
     return ret;
 }
 
+/*
+ * open a fimc handle that can run num_bufs conversions at once
+ *
+ * @param num_bufs
+ *   number of conversions in flight[in]
+ *
+ * @return
+ *   fimc handle
+ */
+void *csc_fimc_open_async(int num_bufs)
+{
+    HardwareConverter *hw_converter = NULL;
+
+    hw_converter = new HardwareConverter(num_bufs);
+    if (hw_converter->bHWconvert_flag == 0) {
+        delete hw_converter;
+        hw_converter = NULL;
+        ALOGE("%s LINE = %d HardwareConverter failed", __func__, __LINE__);
+    }
+
+    return (void *)hw_converter;
+}
+
+/*
+ * start converting nv12t to omxformat and return without waiting
+ *
+ * @param index
+ *   slot of the conversion[out]
+ *
+ * @return
+ *   pass or fail
+ */
+CSC_FIMC_ERROR_CODE csc_fimc_convert_nv12t_async(
+    void *handle,
+    void **dst_addr,
+    void **src_addr,
+    unsigned int width,
+    unsigned int height,
+    OMX_COLOR_FORMATTYPE omxformat,
+    int *index)
+{
+    HardwareConverter *hw_converter = (HardwareConverter *)handle;
+
+    if (hw_converter == NULL)
+        return CSC_FIMC_RET_FAIL;
+
+    if (hw_converter->convertAsync(
+            (void *)src_addr, (void *)dst_addr,
+            (OMX_COLOR_FORMATTYPE)OMX_SEC_COLOR_FormatNV12TPhysicalAddress,
+            width, height, omxformat, index) == false)
+        return CSC_FIMC_RET_FAIL;
+
+    return CSC_FIMC_RET_OK;
+}
+
+/*
+ * wait for the oldest conversion started by csc_fimc_convert_nv12t_async
+ *
+ * @param index
+ *   slot of the finished conversion[out]
+ *
+ * @param dst_addr
+ *   y, cb, cr address of the result if it is in a fimc buffer[out]
+ *
+ * @return
+ *   pass or fail
+ */
+CSC_FIMC_ERROR_CODE csc_fimc_wait(void *handle, int *index, void **dst_addr)
+{
+    HardwareConverter *hw_converter = (HardwareConverter *)handle;
+
+    if (hw_converter == NULL || hw_converter->waitConvert(index, dst_addr) == false)
+        return CSC_FIMC_RET_FAIL;
+
+    return CSC_FIMC_RET_OK;
+}
+
+/*
+ * fd to poll for POLLIN when a conversion has finished
+ */
+int csc_fimc_get_fd(void *handle)
+{
+    HardwareConverter *hw_converter = (HardwareConverter *)handle;
+
+    if (hw_converter == NULL)
+        return -1;
+
+    return hw_converter->getFd();
+}
+
 #ifdef __cplusplus
 }
 #endif
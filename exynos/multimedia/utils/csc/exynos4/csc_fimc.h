@@ -99,6 +99,60 @@ CSC_FIMC_ERROR_CODE csc_fimc_convert_nv12t(
     unsigned int height,
     OMX_COLOR_FORMATTYPE omxformat);
 
+/*
+ * create and open a fimc handle for asynchronous conversion
+ *
+ * @param num_bufs
+ *   number of conversions in flight[in]
+ *
+ * @return
+ *   fimc handle
+ */
+void *csc_fimc_open_async(int num_bufs);
+
+/*
+ * start converting nv12t to omxformat, as csc_fimc_convert_nv12t,
+ * and return without waiting for it
+ *
+ * @param index
+ *   slot of the conversion[out]
+ *
+ * @return
+ *   error code
+ */
+CSC_FIMC_ERROR_CODE csc_fimc_convert_nv12t_async(
+    void *handle,
+    void **dst_addr,
+    void **src_addr,
+    unsigned int width,
+    unsigned int height,
+    OMX_COLOR_FORMATTYPE omxformat,
+    int *index);
+
+/*
+ * wait for the oldest conversion in flight
+ *
+ * @param index
+ *   slot of the finished conversion[out]
+ *
+ * @param dst_addr
+ *   y, cb, cr virtual address of the result when fimc wrote it into its
+ *   own buffer (V4L2 MMAP), to be copied out before the slot is reused.
+ *   all NULL when the result is in the dst_addr given at submit[out]
+ *
+ * @return
+ *   error code
+ */
+CSC_FIMC_ERROR_CODE csc_fimc_wait(void *handle, int *index, void **dst_addr);
+
+/*
+ * get the fd to poll for POLLIN when a conversion has finished
+ *
+ * @return
+ *   fd or -1
+ */
+int csc_fimc_get_fd(void *handle);
+
 #ifdef __cplusplus
 }
 #endif
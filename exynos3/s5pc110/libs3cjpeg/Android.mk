@@ -17,6 +17,7 @@ include $(CLEAR_VARS)
 
 LOCAL_C_INCLUDES := $(LOCAL_PATH)
 LOCAL_C_INCLUDES += $(LOCAL_PATH)/../include
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/../../../exynos/include
 
 LOCAL_SRC_FILES:= \
 	JpegEncoder.cpp
@@ -26,14 +26,15 @@
 #include <utils/Log.h>
 #include <sys/mman.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <cstring>
 
 #include "JpegEncoder.h"
-
-static const char ExifAsciiPrefix[] = { 0x41, 0x53, 0x43, 0x49, 0x49, 0x0, 0x0, 0x0 };
+#include "ExifWriter.h"
 
 namespace android {
-JpegEncoder::JpegEncoder() : available(false)
+JpegEncoder::JpegEncoder() : mExifBuf(NULL), mExifBufSize(0), mThumbScaled(false),
+                             available(false)
 {
     mArgs.mmapped_addr = (char *)MAP_FAILED;
     mArgs.enc_param       = NULL;
@@ -109,6 +110,8 @@ JpegEncoder::~JpegEncoder()
 
     delete mArgs.thumb_enc_param;
 
+    delete[] mExifBuf;
+
     if (mDevFd > 0)
         close(mDevFd);
 }
@@ -247,15 +250,35 @@ jpg_return_status JpegEncoder::encode(unsigned int *size, exif_attribute_t *exif
     ALOGD("encode E");
 
     jpg_return_status ret = JPG_FAIL;
-    unsigned char *exifOut = NULL;
     jpg_enc_proc_param *param = mArgs.enc_param;
 
     ret = checkMcu(param->sample_mode, param->width, param->height, false);
     if (ret != JPG_SUCCESS)
         return ret;
 
+    /*
+     * The thumbnail source is scaled down from the main input while the
+     * hardware encodes the main image. Only the thumbnail encode itself has
+     * to wait for the hardware.
+     */
+    pthread_t scaler;
+    bool scaling = false;
+
+    mThumbScaled = false;
+    if (exifInfo && exifInfo->enableThumb) {
+        jpg_enc_proc_param *thumbParam = mArgs.thumb_enc_param;
+
+        mArgs.in_thumb_buf = (char *)getThumbInBuf(thumbParam->width * thumbParam->height * 2);
+        if (mArgs.in_thumb_buf != NULL)
+            scaling = pthread_create(&scaler, NULL, thumbScaleThread, this) == 0;
+    }
+
     param->enc_type = JPG_MAIN;
     ret = (jpg_return_status)ioctl(mDevFd, IOCTL_JPG_ENCODE, &mArgs);
+
+    if (scaling)
+        pthread_join(scaler, NULL);
+
     if (ret != JPG_SUCCESS) {
         ALOGE("Failed to encode main image");
         return ret;
@@ -268,7 +291,7 @@ jpg_return_status JpegEncoder::encode(unsigned int *size, exif_attribute_t *exif
 
         uint_t bufSize = 0;
         if (exifInfo->enableThumb) {
-            ret = encodeThumbImg(&thumbLen);
+            ret = encodeThumbImg(&thumbLen, !mThumbScaled);
             if (ret != JPG_SUCCESS) {
                 ALOGE("Failed to encode for thumbnail image");
                 bufSize = EXIF_FILE_SIZE;
@@ -283,27 +306,30 @@ jpg_return_status JpegEncoder::encode(unsigned int *size, exif_attribute_t *exif
         if (mArgs.enc_param->file_size + bufSize > mInfo.total_buf_size)
             return ret;
 
-        exifOut = new unsigned char[bufSize];
-        if (exifOut == NULL) {
-            ALOGE("Failed to allocate for exifOut");
-            return ret;
+        /* the EXIF buffer is kept across pictures, it only ever grows */
+        if (mExifBufSize < bufSize) {
+            delete[] mExifBuf;
+            mExifBuf = new unsigned char[bufSize];
+            if (mExifBuf == NULL) {
+                ALOGE("Failed to allocate for exifOut");
+                mExifBufSize = 0;
+                return ret;
+            }
+            mExifBufSize = bufSize;
         }
-        memset(exifOut, 0, bufSize);
+        memset(mExifBuf, 0, bufSize);
 
-        ret = makeExif (exifOut, exifInfo, &exifLen);
+        ret = makeExif (mExifBuf, exifInfo, &exifLen);
         if (ret != JPG_SUCCESS) {
             ALOGE("Failed to make EXIF");
-            delete[] exifOut;
             return ret;
         }
 
         memmove(&mArgs.out_buf[exifLen + 2], &mArgs.out_buf[2], param->file_size - 2);
-        memcpy(&mArgs.out_buf[2], exifOut, exifLen);
+        memcpy(&mArgs.out_buf[2], mExifBuf, exifLen);
         param->file_size += exifLen;
     }
 
-    delete[] exifOut;
-
     *size = param->file_size;
 
 #if MAIN_DUMP
@@ -321,6 +347,20 @@ jpg_return_status JpegEncoder::encode(unsigned int *size, exif_attribute_t *exif
     return ret;
 }
 
+void *JpegEncoder::thumbScaleThread(void *arg)
+{
+    JpegEncoder *enc = (JpegEncoder *)arg;
+    jpg_enc_proc_param *param = enc->mArgs.thumb_enc_param;
+
+    enc->mThumbScaled = enc->scaleDownYuv422(enc->mArgs.in_buf,
+                                             enc->mArgs.enc_param->width,
+                                             enc->mArgs.enc_param->height,
+                                             enc->mArgs.in_thumb_buf,
+                                             param->width,
+                                             param->height);
+    return NULL;
+}
+
 jpg_return_status JpegEncoder::encodeThumbImg(unsigned int *size, bool useMain)
 {
     if (!available)
@@ -386,173 +426,6 @@ jpg_return_status JpegEncoder::makeExif (unsigned char *exifOut,
 
     ALOGD("makeExif E");
 
-    unsigned char *pCur, *pApp1Start, *pIfdStart, *pGpsIfdPtr, *pNextIfdOffset;
-    unsigned int tmp, LongerTagOffest = 0;
-    pApp1Start = pCur = exifOut;
-
-    //2 Exif Identifier Code & TIFF Header
-    pCur += 4;  // Skip 4 Byte for APP1 marker and length
-    unsigned char ExifIdentifierCode[6] = { 0x45, 0x78, 0x69, 0x66, 0x00, 0x00 };
-    memcpy(pCur, ExifIdentifierCode, 6);
-    pCur += 6;
-
-    /* Byte Order - little endian, Offset of IFD - 0x00000008.H */
-    unsigned char TiffHeader[8] = { 0x49, 0x49, 0x2A, 0x00, 0x08, 0x00, 0x00, 0x00 };
-    memcpy(pCur, TiffHeader, 8);
-    pIfdStart = pCur;
-    pCur += 8;
-
-    //2 0th IFD TIFF Tags
-    if (exifInfo->enableGps)
-        tmp = NUM_0TH_IFD_TIFF;
-    else
-        tmp = NUM_0TH_IFD_TIFF - 1;
-
-    memcpy(pCur, &tmp, NUM_SIZE);
-    pCur += NUM_SIZE;
-
-    LongerTagOffest += 8 + NUM_SIZE + tmp*IFD_SIZE + OFFSET_SIZE;
-
-    writeExifIfd(&pCur, EXIF_TAG_IMAGE_WIDTH, EXIF_TYPE_LONG,
-                 1, exifInfo->width);
-    writeExifIfd(&pCur, EXIF_TAG_IMAGE_HEIGHT, EXIF_TYPE_LONG,
-                 1, exifInfo->height);
-    writeExifIfd(&pCur, EXIF_TAG_MAKE, EXIF_TYPE_ASCII,
-                 strlen((char *)exifInfo->maker) + 1, exifInfo->maker, &LongerTagOffest, pIfdStart);
-    writeExifIfd(&pCur, EXIF_TAG_MODEL, EXIF_TYPE_ASCII,
-                 strlen((char *)exifInfo->model) + 1, exifInfo->model, &LongerTagOffest, pIfdStart);
-    writeExifIfd(&pCur, EXIF_TAG_ORIENTATION, EXIF_TYPE_SHORT,
-                 1, exifInfo->orientation);
-    writeExifIfd(&pCur, EXIF_TAG_SOFTWARE, EXIF_TYPE_ASCII,
-                 strlen((char *)exifInfo->software) + 1, exifInfo->software, &LongerTagOffest, pIfdStart);
-    writeExifIfd(&pCur, EXIF_TAG_DATE_TIME, EXIF_TYPE_ASCII,
-                 20, exifInfo->date_time, &LongerTagOffest, pIfdStart);
-    writeExifIfd(&pCur, EXIF_TAG_YCBCR_POSITIONING, EXIF_TYPE_SHORT,
-                 1, exifInfo->ycbcr_positioning);
-    writeExifIfd(&pCur, EXIF_TAG_EXIF_IFD_POINTER, EXIF_TYPE_LONG,
-                 1, LongerTagOffest);
-    if (exifInfo->enableGps) {
-        pGpsIfdPtr = pCur;
-        pCur += IFD_SIZE;   // Skip a ifd size for gps IFD pointer
-    }
-
-    pNextIfdOffset = pCur;  // Skip a offset size for next IFD offset
-    pCur += OFFSET_SIZE;
-
-    //2 0th IFD Exif Private Tags
-    pCur = pIfdStart + LongerTagOffest;
-
-    tmp = NUM_0TH_IFD_EXIF;
-    memcpy(pCur, &tmp , NUM_SIZE);
-    pCur += NUM_SIZE;
-
-    LongerTagOffest += NUM_SIZE + NUM_0TH_IFD_EXIF*IFD_SIZE + OFFSET_SIZE;
-
-    writeExifIfd(&pCur, EXIF_TAG_EXPOSURE_TIME, EXIF_TYPE_RATIONAL,
-                 1, &exifInfo->exposure_time, &LongerTagOffest, pIfdStart);
-    writeExifIfd(&pCur, EXIF_TAG_FNUMBER, EXIF_TYPE_RATIONAL,
-                 1, &exifInfo->fnumber, &LongerTagOffest, pIfdStart);
-    writeExifIfd(&pCur, EXIF_TAG_EXPOSURE_PROGRAM, EXIF_TYPE_SHORT,
-                 1, exifInfo->exposure_program);
-    writeExifIfd(&pCur, EXIF_TAG_ISO_SPEED_RATING, EXIF_TYPE_SHORT,
-                 1, exifInfo->iso_speed_rating);
-    writeExifIfd(&pCur, EXIF_TAG_EXIF_VERSION, EXIF_TYPE_UNDEFINED,
-                 4, exifInfo->exif_version);
-    writeExifIfd(&pCur, EXIF_TAG_DATE_TIME_ORG, EXIF_TYPE_ASCII,
-                 20, exifInfo->date_time, &LongerTagOffest, pIfdStart);
-    writeExifIfd(&pCur, EXIF_TAG_DATE_TIME_DIGITIZE, EXIF_TYPE_ASCII,
-                 20, exifInfo->date_time, &LongerTagOffest, pIfdStart);
-    writeExifIfd(&pCur, EXIF_TAG_SHUTTER_SPEED, EXIF_TYPE_SRATIONAL,
-                 1, (rational_t *)&exifInfo->shutter_speed, &LongerTagOffest, pIfdStart);
-    writeExifIfd(&pCur, EXIF_TAG_APERTURE, EXIF_TYPE_RATIONAL,
-                 1, &exifInfo->aperture, &LongerTagOffest, pIfdStart);
-    writeExifIfd(&pCur, EXIF_TAG_BRIGHTNESS, EXIF_TYPE_SRATIONAL,
-                 1, (rational_t *)&exifInfo->brightness, &LongerTagOffest, pIfdStart);
-    writeExifIfd(&pCur, EXIF_TAG_EXPOSURE_BIAS, EXIF_TYPE_SRATIONAL,
-                 1, (rational_t *)&exifInfo->exposure_bias, &LongerTagOffest, pIfdStart);
-    writeExifIfd(&pCur, EXIF_TAG_MAX_APERTURE, EXIF_TYPE_RATIONAL,
-                 1, &exifInfo->max_aperture, &LongerTagOffest, pIfdStart);
-    writeExifIfd(&pCur, EXIF_TAG_METERING_MODE, EXIF_TYPE_SHORT,
-                 1, exifInfo->metering_mode);
-    writeExifIfd(&pCur, EXIF_TAG_FLASH, EXIF_TYPE_SHORT,
-                 1, exifInfo->flash);
-    writeExifIfd(&pCur, EXIF_TAG_FOCAL_LENGTH, EXIF_TYPE_RATIONAL,
-                 1, &exifInfo->focal_length, &LongerTagOffest, pIfdStart);
-    char code[8] = { 0x00, 0x00, 0x00, 0x49, 0x49, 0x43, 0x53, 0x41 };
-    int commentsLen = strlen((char *)exifInfo->user_comment) + 1;
-    memmove(exifInfo->user_comment + sizeof(code), exifInfo->user_comment, commentsLen);
-    memcpy(exifInfo->user_comment, code, sizeof(code));
-    writeExifIfd(&pCur, EXIF_TAG_USER_COMMENT, EXIF_TYPE_UNDEFINED,
-                 commentsLen + sizeof(code), exifInfo->user_comment, &LongerTagOffest, pIfdStart);
-    writeExifIfd(&pCur, EXIF_TAG_COLOR_SPACE, EXIF_TYPE_SHORT,
-                 1, exifInfo->color_space);
-    writeExifIfd(&pCur, EXIF_TAG_PIXEL_X_DIMENSION, EXIF_TYPE_LONG,
-                 1, exifInfo->width);
-    writeExifIfd(&pCur, EXIF_TAG_PIXEL_Y_DIMENSION, EXIF_TYPE_LONG,
-                 1, exifInfo->height);
-    writeExifIfd(&pCur, EXIF_TAG_EXPOSURE_MODE, EXIF_TYPE_LONG,
-                 1, exifInfo->exposure_mode);
-    writeExifIfd(&pCur, EXIF_TAG_WHITE_BALANCE, EXIF_TYPE_LONG,
-                 1, exifInfo->white_balance);
-    writeExifIfd(&pCur, EXIF_TAG_SCENCE_CAPTURE_TYPE, EXIF_TYPE_LONG,
-                 1, exifInfo->scene_capture_type);
-    tmp = 0;
-    memcpy(pCur, &tmp, OFFSET_SIZE); // next IFD offset
-    pCur += OFFSET_SIZE;
-
-    //2 0th IFD GPS Info Tags
-    if (exifInfo->enableGps) {
-        writeExifIfd(&pGpsIfdPtr, EXIF_TAG_GPS_IFD_POINTER, EXIF_TYPE_LONG,
-                     1, LongerTagOffest); // GPS IFD pointer skipped on 0th IFD
-
-        pCur = pIfdStart + LongerTagOffest;
-
-        if (exifInfo->gps_processing_method[0] == 0) {
-            // don't create GPS_PROCESSING_METHOD tag if there isn't any
-            tmp = NUM_0TH_IFD_GPS - 1;
-        } else {
-            tmp = NUM_0TH_IFD_GPS;
-        }
-        memcpy(pCur, &tmp, NUM_SIZE);
-        pCur += NUM_SIZE;
-
-        LongerTagOffest += NUM_SIZE + tmp*IFD_SIZE + OFFSET_SIZE;
-
-        writeExifIfd(&pCur, EXIF_TAG_GPS_VERSION_ID, EXIF_TYPE_BYTE,
-                     4, exifInfo->gps_version_id);
-        writeExifIfd(&pCur, EXIF_TAG_GPS_LATITUDE_REF, EXIF_TYPE_ASCII,
-                     2, exifInfo->gps_latitude_ref);
-        writeExifIfd(&pCur, EXIF_TAG_GPS_LATITUDE, EXIF_TYPE_RATIONAL,
-                     3, exifInfo->gps_latitude, &LongerTagOffest, pIfdStart);
-        writeExifIfd(&pCur, EXIF_TAG_GPS_LONGITUDE_REF, EXIF_TYPE_ASCII,
-                     2, exifInfo->gps_longitude_ref);
-        writeExifIfd(&pCur, EXIF_TAG_GPS_LONGITUDE, EXIF_TYPE_RATIONAL,
-                     3, exifInfo->gps_longitude, &LongerTagOffest, pIfdStart);
-        writeExifIfd(&pCur, EXIF_TAG_GPS_ALTITUDE_REF, EXIF_TYPE_BYTE,
-                     1, exifInfo->gps_altitude_ref);
-        writeExifIfd(&pCur, EXIF_TAG_GPS_ALTITUDE, EXIF_TYPE_RATIONAL,
-                     1, &exifInfo->gps_altitude, &LongerTagOffest, pIfdStart);
-        writeExifIfd(&pCur, EXIF_TAG_GPS_TIMESTAMP, EXIF_TYPE_RATIONAL,
-                     3, exifInfo->gps_timestamp, &LongerTagOffest, pIfdStart);
-        tmp = strlen((char*)exifInfo->gps_processing_method);
-	if (tmp > 0) {
-            if (tmp > 100) {
-                tmp = 100;
-            }
-            unsigned char tmp_buf[100+sizeof(ExifAsciiPrefix)];
-            memcpy(tmp_buf, ExifAsciiPrefix, sizeof(ExifAsciiPrefix));
-            memcpy(&tmp_buf[sizeof(ExifAsciiPrefix)], exifInfo->gps_processing_method, tmp);
-            writeExifIfd(&pCur, EXIF_TAG_GPS_PROCESSING_METHOD, EXIF_TYPE_UNDEFINED,
-                         tmp+sizeof(ExifAsciiPrefix), tmp_buf, &LongerTagOffest, pIfdStart);
-        }
-        writeExifIfd(&pCur, EXIF_TAG_GPS_DATESTAMP, EXIF_TYPE_ASCII,
-                     11, exifInfo->gps_datestamp, &LongerTagOffest, pIfdStart);
-        tmp = 0;
-        memcpy(pCur, &tmp, OFFSET_SIZE); // next IFD offset
-        pCur += OFFSET_SIZE;
-    }
-
-    //2 1th IFD TIFF Tags
     char *thumbBuf;
     int thumbSize;
 
@@ -564,57 +437,7 @@ jpg_return_status JpegEncoder::makeExif (unsigned char *exifOut,
         thumbSize = mArgs.thumb_enc_param->file_size;
     }
 
-    if (exifInfo->enableThumb && (thumbBuf != NULL) && (thumbSize > 0)) {
-        tmp = LongerTagOffest;
-        memcpy(pNextIfdOffset, &tmp, OFFSET_SIZE);  // NEXT IFD offset skipped on 0th IFD
-
-        pCur = pIfdStart + LongerTagOffest;
-
-        tmp = NUM_1TH_IFD_TIFF;
-        memcpy(pCur, &tmp, NUM_SIZE);
-        pCur += NUM_SIZE;
-
-        LongerTagOffest += NUM_SIZE + NUM_1TH_IFD_TIFF*IFD_SIZE + OFFSET_SIZE;
-
-        writeExifIfd(&pCur, EXIF_TAG_IMAGE_WIDTH, EXIF_TYPE_LONG,
-                     1, exifInfo->widthThumb);
-        writeExifIfd(&pCur, EXIF_TAG_IMAGE_HEIGHT, EXIF_TYPE_LONG,
-                     1, exifInfo->heightThumb);
-        writeExifIfd(&pCur, EXIF_TAG_COMPRESSION_SCHEME, EXIF_TYPE_SHORT,
-                     1, exifInfo->compression_scheme);
-        writeExifIfd(&pCur, EXIF_TAG_ORIENTATION, EXIF_TYPE_SHORT,
-                     1, exifInfo->orientation);
-        writeExifIfd(&pCur, EXIF_TAG_X_RESOLUTION, EXIF_TYPE_RATIONAL,
-                     1, &exifInfo->x_resolution, &LongerTagOffest, pIfdStart);
-        writeExifIfd(&pCur, EXIF_TAG_Y_RESOLUTION, EXIF_TYPE_RATIONAL,
-                     1, &exifInfo->y_resolution, &LongerTagOffest, pIfdStart);
-        writeExifIfd(&pCur, EXIF_TAG_RESOLUTION_UNIT, EXIF_TYPE_SHORT,
-                     1, exifInfo->resolution_unit);
-        writeExifIfd(&pCur, EXIF_TAG_JPEG_INTERCHANGE_FORMAT, EXIF_TYPE_LONG,
-                     1, LongerTagOffest);
-        writeExifIfd(&pCur, EXIF_TAG_JPEG_INTERCHANGE_FORMAT_LEN, EXIF_TYPE_LONG,
-                     1, thumbSize);
-
-        tmp = 0;
-        memcpy(pCur, &tmp, OFFSET_SIZE); // next IFD offset
-        pCur += OFFSET_SIZE;
-
-        memcpy(pIfdStart + LongerTagOffest,
-               thumbBuf, thumbSize);
-        LongerTagOffest += thumbSize;
-    } else {
-        tmp = 0;
-        memcpy(pNextIfdOffset, &tmp, OFFSET_SIZE);  // NEXT IFD offset skipped on 0th IFD
-    }
-
-    unsigned char App1Marker[2] = { 0xff, 0xe1 };
-    memcpy(pApp1Start, App1Marker, 2);
-    pApp1Start += 2;
-
-    *size = 10 + LongerTagOffest;
-    tmp = *size - 2;    // APP1 Maker isn't counted
-    unsigned char size_mm[2] = {(tmp >> 8) & 0xFF, tmp & 0xFF};
-    memcpy(pApp1Start, size_mm, 2);
+    *size = exif_write_app1(exifOut, exifInfo, (unsigned char *)thumbBuf, thumbSize);
 
     ALOGD("makeExif X");
 
@@ -738,80 +561,4 @@ bool JpegEncoder::scaleDownYuv422(char *srcBuf, uint32_t srcWidth, uint32_t srcH
     return true;
 }
 
-inline void JpegEncoder::writeExifIfd(unsigned char **pCur,
-                                         unsigned short tag,
-                                         unsigned short type,
-                                         unsigned int count,
-                                         uint32_t value)
-{
-    memcpy(*pCur, &tag, 2);
-    *pCur += 2;
-    memcpy(*pCur, &type, 2);
-    *pCur += 2;
-    memcpy(*pCur, &count, 4);
-    *pCur += 4;
-    memcpy(*pCur, &value, 4);
-    *pCur += 4;
-}
-
-inline void JpegEncoder::writeExifIfd(unsigned char **pCur,
-                                         unsigned short tag,
-                                         unsigned short type,
-                                         unsigned int count,
-                                         unsigned char *pValue)
-{
-    char buf[4] = { 0,};
-
-    memcpy(buf, pValue, count);
-    memcpy(*pCur, &tag, 2);
-    *pCur += 2;
-    memcpy(*pCur, &type, 2);
-    *pCur += 2;
-    memcpy(*pCur, &count, 4);
-    *pCur += 4;
-    memcpy(*pCur, buf, 4);
-    *pCur += 4;
-}
-
-
-inline void JpegEncoder::writeExifIfd(unsigned char **pCur,
-                                         unsigned short tag,
-                                         unsigned short type,
-                                         unsigned int count,
-                                         unsigned char *pValue,
-                                         unsigned int *offset,
-                                         unsigned char *start)
-{
-    memcpy(*pCur, &tag, 2);
-    *pCur += 2;
-    memcpy(*pCur, &type, 2);
-    *pCur += 2;
-    memcpy(*pCur, &count, 4);
-    *pCur += 4;
-    memcpy(*pCur, offset, 4);
-    *pCur += 4;
-    memcpy(start + *offset, pValue, count);
-    *offset += count;
-}
-
-inline void JpegEncoder::writeExifIfd(unsigned char **pCur,
-                                         unsigned short tag,
-                                         unsigned short type,
-                                         unsigned int count,
-                                         rational_t *pValue,
-                                         unsigned int *offset,
-                                         unsigned char *start)
-{
-    memcpy(*pCur, &tag, 2);
-    *pCur += 2;
-    memcpy(*pCur, &type, 2);
-    *pCur += 2;
-    memcpy(*pCur, &count, 4);
-    *pCur += 4;
-    memcpy(*pCur, offset, 4);
-    *pCur += 4;
-    memcpy(start + *offset, pValue, 8 * count);
-    *offset += 8 * count;
-}
-
 };
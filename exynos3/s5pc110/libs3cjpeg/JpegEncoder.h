@@ -223,35 +223,17 @@ private:
              char *dstBuf, uint32_t dstWidth, uint32_t dstHight);
     bool scaleDownYuv422(char *srcBuf, uint32_t srcWidth, uint32_t srcHight,
                          char *dstBuf, uint32_t dstWidth, uint32_t dstHight);
+    static void *thumbScaleThread(void *arg);
 
-    inline void writeExifIfd(unsigned char **pCur,
-                                 unsigned short tag,
-                                 unsigned short type,
-                                 unsigned int count,
-                                 uint32_t value);
-    inline void writeExifIfd(unsigned char **pCur,
-                                 unsigned short tag,
-                                 unsigned short type,
-                                 unsigned int count,
-                                 unsigned char *pValue);
-    inline void writeExifIfd(unsigned char **pCur,
-                                 unsigned short tag,
-                                 unsigned short type,
-                                 unsigned int count,
-                                 rational_t *pValue,
-                                 unsigned int *offset,
-                                 unsigned char *start);
-    inline void writeExifIfd(unsigned char **pCur,
-                                 unsigned short tag,
-                                 unsigned short type,
-                                 unsigned int count,
-                                 unsigned char *pValue,
-                                 unsigned int *offset,
-                                 unsigned char *start);
     int mDevFd;
     jpg_args mArgs;
     jpg_info mInfo;
 
+    unsigned char *mExifBuf;
+    unsigned int mExifBufSize;
+    /* set by thumbScaleThread once in_thumb_buf holds the scaled main input */
+    bool mThumbScaled;
+
     bool available;
 
 };
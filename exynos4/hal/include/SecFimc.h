@@ -64,7 +64,7 @@ extern "C" {
 #include "SecRect.h"
 
 #define PFX_NODE_FIMC        "/dev/video"
-#define MAX_DST_BUFFERS     (3)
+#define MAX_DST_BUFFERS     (4)
 #define MAX_SRC_BUFFERS     (1)
 #define MAX_PLANES          (3)
 
@@ -100,6 +100,7 @@ private:
     int                         mFd;
     int                         mHwVersion;
     int                         mRotVal;
+    int                         mDstRotVal;
     bool                        mFlagGlobalAlpha;
     int                         mGlobalAlpha;
     bool                        mFlagLocalAlpha;
@@ -108,6 +109,10 @@ private:
     bool                        mFlagSetSrcParam;
     bool                        mFlagSetDstParam;
     bool                        mFlagStreamOn;
+    bool                        mFlagAsync;
+    int                         mQueued;
+    int                         mQueueTail;
+    int                         mDoneIndex;
 
     s5p_fimc_t                  mS5pFimc;
     struct v4l2_capability      mFimcCap;
@@ -165,8 +170,26 @@ public:
 
     virtual bool draw(int src_index, int dst_index);
 
+    /*
+     * Asynchronous conversion: queue() submits the current source address
+     * into the next of numOfBuf slots and returns at once, dequeue() waits
+     * for the oldest one and returns its slot. With BOARD_USE_V4L2 the
+     * destination is an MMAP slot and setDstAddr() is not used, dstBuf
+     * then points at the slot holding the result, valid until it is
+     * queued again. Otherwise the result is at the setDstAddr() address
+     * and dstBuf is NULL. getFd() polls POLLIN when a conversion is done.
+     * Do not mix with draw() on the same instance.
+     */
+    virtual bool queue(int *index);
+    virtual bool dequeue(int *index, SecBuffer **dstBuf = NULL);
+    int  getQueued(void);
+
 private:
     bool m_streamOn(void);
+#ifdef BOARD_USE_V4L2
+    void m_setSrcPlaneSize(void);
+#endif
+    bool m_streamOff(void);
     bool m_checkSrcSize(unsigned int width, unsigned int height,
                         unsigned int cropX, unsigned int cropY,
                         unsigned int *cropWidth, unsigned int *cropHeight,
@@ -90,6 +90,15 @@ private :
             int                 mLaddr;
             int                 mPaddr;
 
+            static int          reportPhysicalAddress(unsigned char *msg, int size,
+                                                      unsigned char *reply, void *data);
+            static int          reportActiveSource(unsigned char *msg, int size,
+                                                   unsigned char *reply, void *data);
+            static int          setOsdName(unsigned char *msg, int size,
+                                           unsigned char *reply, void *data);
+            static int          featureAbort(unsigned char *msg, int size,
+                                             unsigned char *reply, void *data);
+
         public:
             CECThread(sp<SecHdmi> secHdmi)
                 :Thread(false),
@@ -156,6 +165,17 @@ private :
 
     SecBuffer    mMixerBuffer[HDMI_LAYER_MAX][MAX_BUFFERS_MIXER];
 
+#if defined(BOARD_USE_V4L2)
+    /* mixer buffers owned by the driver, so a free one is known without DQBUF */
+    bool         mMixerBufQueued[HDMI_LAYER_MAX][HDMI_NUM_VIDEO_BUF];
+    int          mMixerBufNumQueued[HDMI_LAYER_MAX];
+
+    /* recently used video layer setups, least recently used goes first */
+    struct hdmi_v_config mVideoConfig[HDMI_VIDEO_CONFIG_NUM];
+    unsigned int mVideoConfigUse[HDMI_VIDEO_CONFIG_NUM];
+    unsigned int mVideoConfigTick;
+#endif
+
     void         *mFBaddr;
     unsigned int mFBsize;
     int          mFBionfd;
@@ -203,6 +223,10 @@ public :
 private:
 
     bool        m_reset(int w, int h, int colorFormat, int hdmiLayer, int hwcLayer);
+#if defined(BOARD_USE_V4L2)
+    bool        m_switchVideoLayer(int w, int h, int colorFormat);
+    struct hdmi_v_config *m_getVideoConfig(int w, int h, int colorFormat, int dstW, int dstH);
+#endif
     bool        m_startHdmi(int hdmiLayer, unsigned int num_of_plane);
     bool        m_startHdmi(int hdmiLayer);
     bool        m_stopHdmi(int hdmiLayer);
@@ -109,6 +109,29 @@ struct jpeg_config {
     int                         reserved[8];
 };
 
+#define JPEG_DEC_SESSION_MAX_BUFS   4
+
+/*
+ * A decoder that stays open and streaming across images. Fill the buffer
+ * from jpeghal_dec_session_get_inbuf() with a compressed stream, queue it,
+ * and dequeue to get the slot whose out_buf holds the picture. The output
+ * stays valid until that slot is queued again.
+ */
+struct jpeg_dec_session {
+    int                 fd;
+    int                 num_bufs;
+    int                 num_alloc;
+    int                 streaming;
+    int                 queued;
+    int                 head;       /* next slot to complete */
+    int                 tail;       /* next slot to queue */
+    int                 decoded;
+    int                 reconfigs;
+    struct jpeg_config  config;
+    struct jpeg_buf     in_buf[JPEG_DEC_SESSION_MAX_BUFS];
+    struct jpeg_buf     out_buf[JPEG_DEC_SESSION_MAX_BUFS];
+};
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -128,6 +151,13 @@ int jpeghal_enc_exe(int fd, struct jpeg_buf *in_buf, struct jpeg_buf *out_buf);
 
 int jpeghal_deinit(int fd, struct jpeg_buf *in_buf, struct jpeg_buf *out_buf);
 
+int jpeghal_dec_session_open(struct jpeg_dec_session *s, int num_bufs);
+int jpeghal_dec_session_config(struct jpeg_dec_session *s, struct jpeg_config *config);
+void *jpeghal_dec_session_get_inbuf(struct jpeg_dec_session *s, int *size);
+int jpeghal_dec_session_queue(struct jpeg_dec_session *s, int size);
+int jpeghal_dec_session_dequeue(struct jpeg_dec_session *s);
+int jpeghal_dec_session_close(struct jpeg_dec_session *s);
+
 int jpeghal_s_ctrl(int fd, int cid, int value);
 int jpeghal_g_ctrl(int fd, int id);
 
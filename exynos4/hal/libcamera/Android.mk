@@ -9,12 +9,14 @@ LOCAL_MODULE_PATH := $(TARGET_OUT_SHARED_LIBRARIES)/hw
 
 LOCAL_C_INCLUDES += \
 	$(LOCAL_PATH)/../include \
-	system/media/camera/include
+	$(LOCAL_PATH)/../../../exynos/include \
+	system/media/camera/include \
+	external/jpeg
 
 LOCAL_SRC_FILES:= \
-	SecCamera.cpp SecCameraHWInterface.cpp
+	SecCamera.cpp SecCameraHWInterface.cpp SecCameraImageOps.cpp SecCameraTrace.cpp
 
-LOCAL_SHARED_LIBRARIES:= libutils libcutils libbinder liblog libcamera_client libhardware
+LOCAL_SHARED_LIBRARIES:= libutils libcutils libbinder liblog libcamera_client libhardware libjpeg
 
 ifeq ($(TARGET_SOC), exynos4210)
 LOCAL_SHARED_LIBRARIES += libs5pjpeg
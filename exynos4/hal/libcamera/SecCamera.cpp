@@ -31,6 +31,7 @@
 #include <stdlib.h>
 #include <sys/poll.h>
 #include "SecCamera.h"
+#include "ExifWriter.h"
 #include "cutils/properties.h"
 
 using namespace android;
@@ -1420,6 +1421,8 @@ int SecCamera::getPreviewAddr(int index, SecBuffer *buffer)
     buffer->phys.extP[0] = (unsigned int)m_buffers_preview[index].phys.extP[0];
     buffer->phys.extP[1] = (unsigned int)m_buffers_preview[index].phys.extP[1];
     buffer->virt.extP[0] = m_buffers_preview[index].virt.extP[0];
+    buffer->virt.extP[1] = m_buffers_preview[index].virt.extP[1];
+    buffer->virt.extP[2] = m_buffers_preview[index].virt.extP[2];
 #else
     buffer->phys.extP[0] = fimc_v4l2_s_ctrl(m_cam_fd, V4L2_CID_PADDR_Y, index);
     CHECK((int)buffer->phys.extP[0]);
@@ -1972,6 +1975,19 @@ int SecCamera::getExif(unsigned char *pExifDst, unsigned char *pThumbSrc, int th
     return exifSize;
 }
 
+int SecCamera::getExifWithThumbnailJpeg(unsigned char *pExifDst, unsigned char *pThumbJpeg,
+                                        int thumbJpegSize)
+{
+    unsigned int exifSize;
+
+    setExifChangedAttribute();
+
+    mExifInfo.enableThumb = true;
+    makeExif(pExifDst, pThumbJpeg, (unsigned int)thumbJpegSize, &mExifInfo, &exifSize, true);
+
+    return exifSize;
+}
+
 void SecCamera::getPostViewConfig(int *width, int *height, int *size)
 {
     *width = m_snapshot_width;
@@ -1998,8 +2014,19 @@ int SecCamera::getSnapshotAndJpeg(SecBuffer *yuv_buf, int index, unsigned char *
 {
     ALOGV("%s :", __func__);
 
+    int ret = captureSnapshot(yuv_buf, &index);
+    if (ret < 0)
+        return ret;
+
+    return encodeSnapshot(yuv_buf, index, jpeg_buf, output_size);
+}
+
+int SecCamera::captureSnapshot(SecBuffer *yuv_buf, int *pIndex)
+{
+    ALOGV("%s :", __func__);
+
     int ret = 0;
-    int i;
+    int index = *pIndex;
 
 #ifdef ZERO_SHUTTER_LAG
     if (!m_camera_use_ISP){
@@ -2051,6 +2078,18 @@ int SecCamera::getSnapshotAndJpeg(SecBuffer *yuv_buf, int index, unsigned char *
     }
 #endif
 
+    *pIndex = index;
+    return 0;
+}
+
+int SecCamera::encodeSnapshot(SecBuffer *yuv_buf, int index, unsigned char *jpeg_buf,
+                                        int *output_size)
+{
+    ALOGV("%s :", __func__);
+
+    int ret = 0;
+    int i;
+
 #ifdef SAMSUNG_EXYNOS4210
     /* JPEG encode for smdkv310 */
     if (m_jpeg_fd > 0) {
@@ -4039,309 +4078,13 @@ int SecCamera::makeExif (unsigned char *exifOut,
                                         unsigned int *size,
                                         bool useMainbufForThumb)
 {
-    unsigned char *pCur, *pApp1Start, *pIfdStart, *pGpsIfdPtr, *pNextIfdOffset;
-    unsigned int tmp, LongerTagOffest = 0;
-    pApp1Start = pCur = exifOut;
-
-    //2 Exif Identifier Code & TIFF Header
-    pCur += 4;  // Skip 4 Byte for APP1 marker and length
-    unsigned char ExifIdentifierCode[6] = { 0x45, 0x78, 0x69, 0x66, 0x00, 0x00 };
-    memcpy(pCur, ExifIdentifierCode, 6);
-    pCur += 6;
-
-    /* Byte Order - little endian, Offset of IFD - 0x00000008.H */
-    unsigned char TiffHeader[8] = { 0x49, 0x49, 0x2A, 0x00, 0x08, 0x00, 0x00, 0x00 };
-    memcpy(pCur, TiffHeader, 8);
-    pIfdStart = pCur;
-    pCur += 8;
-
-    //2 0th IFD TIFF Tags
-    if (exifInfo->enableGps)
-        tmp = NUM_0TH_IFD_TIFF;
-    else
-        tmp = NUM_0TH_IFD_TIFF - 1;
-
-    memcpy(pCur, &tmp, NUM_SIZE);
-    pCur += NUM_SIZE;
-
-    LongerTagOffest += 8 + NUM_SIZE + tmp*IFD_SIZE + OFFSET_SIZE;
-
-    writeExifIfd(&pCur, EXIF_TAG_IMAGE_WIDTH, EXIF_TYPE_LONG,
-                 1, exifInfo->width);
-    writeExifIfd(&pCur, EXIF_TAG_IMAGE_HEIGHT, EXIF_TYPE_LONG,
-                 1, exifInfo->height);
-    writeExifIfd(&pCur, EXIF_TAG_MAKE, EXIF_TYPE_ASCII,
-                 strlen((char *)exifInfo->maker) + 1, exifInfo->maker, &LongerTagOffest, pIfdStart);
-    writeExifIfd(&pCur, EXIF_TAG_MODEL, EXIF_TYPE_ASCII,
-                 strlen((char *)exifInfo->model) + 1, exifInfo->model, &LongerTagOffest, pIfdStart);
-    writeExifIfd(&pCur, EXIF_TAG_ORIENTATION, EXIF_TYPE_SHORT,
-                 1, exifInfo->orientation);
-    writeExifIfd(&pCur, EXIF_TAG_SOFTWARE, EXIF_TYPE_ASCII,
-                 strlen((char *)exifInfo->software) + 1, exifInfo->software, &LongerTagOffest, pIfdStart);
-    writeExifIfd(&pCur, EXIF_TAG_DATE_TIME, EXIF_TYPE_ASCII,
-                 20, exifInfo->date_time, &LongerTagOffest, pIfdStart);
-    writeExifIfd(&pCur, EXIF_TAG_YCBCR_POSITIONING, EXIF_TYPE_SHORT,
-                 1, exifInfo->ycbcr_positioning);
-    writeExifIfd(&pCur, EXIF_TAG_EXIF_IFD_POINTER, EXIF_TYPE_LONG,
-                 1, LongerTagOffest);
-    if (exifInfo->enableGps) {
-        pGpsIfdPtr = pCur;
-        pCur += IFD_SIZE;   // Skip a ifd size for gps IFD pointer
-    }
-
-    pNextIfdOffset = pCur;  // Skip a offset size for next IFD offset
-    pCur += OFFSET_SIZE;
-
-    //2 0th IFD Exif Private Tags
-    pCur = pIfdStart + LongerTagOffest;
-
-    tmp = NUM_0TH_IFD_EXIF;
-    memcpy(pCur, &tmp , NUM_SIZE);
-    pCur += NUM_SIZE;
-
-    LongerTagOffest += NUM_SIZE + NUM_0TH_IFD_EXIF*IFD_SIZE + OFFSET_SIZE;
-
-    writeExifIfd(&pCur, EXIF_TAG_EXPOSURE_TIME, EXIF_TYPE_RATIONAL,
-                 1, &exifInfo->exposure_time, &LongerTagOffest, pIfdStart);
-    writeExifIfd(&pCur, EXIF_TAG_FNUMBER, EXIF_TYPE_RATIONAL,
-                 1, &exifInfo->fnumber, &LongerTagOffest, pIfdStart);
-    writeExifIfd(&pCur, EXIF_TAG_EXPOSURE_PROGRAM, EXIF_TYPE_SHORT,
-                 1, exifInfo->exposure_program);
-    writeExifIfd(&pCur, EXIF_TAG_ISO_SPEED_RATING, EXIF_TYPE_SHORT,
-                 1, exifInfo->iso_speed_rating);
-    writeExifIfd(&pCur, EXIF_TAG_EXIF_VERSION, EXIF_TYPE_UNDEFINED,
-                 4, exifInfo->exif_version);
-    writeExifIfd(&pCur, EXIF_TAG_DATE_TIME_ORG, EXIF_TYPE_ASCII,
-                 20, exifInfo->date_time, &LongerTagOffest, pIfdStart);
-    writeExifIfd(&pCur, EXIF_TAG_DATE_TIME_DIGITIZE, EXIF_TYPE_ASCII,
-                 20, exifInfo->date_time, &LongerTagOffest, pIfdStart);
-    writeExifIfd(&pCur, EXIF_TAG_SHUTTER_SPEED, EXIF_TYPE_SRATIONAL,
-                 1, (rational_t *)&exifInfo->shutter_speed, &LongerTagOffest, pIfdStart);
-    writeExifIfd(&pCur, EXIF_TAG_APERTURE, EXIF_TYPE_RATIONAL,
-                 1, &exifInfo->aperture, &LongerTagOffest, pIfdStart);
-    writeExifIfd(&pCur, EXIF_TAG_BRIGHTNESS, EXIF_TYPE_SRATIONAL,
-                 1, (rational_t *)&exifInfo->brightness, &LongerTagOffest, pIfdStart);
-    writeExifIfd(&pCur, EXIF_TAG_EXPOSURE_BIAS, EXIF_TYPE_SRATIONAL,
-                 1, (rational_t *)&exifInfo->exposure_bias, &LongerTagOffest, pIfdStart);
-    writeExifIfd(&pCur, EXIF_TAG_MAX_APERTURE, EXIF_TYPE_RATIONAL,
-                 1, &exifInfo->max_aperture, &LongerTagOffest, pIfdStart);
-    writeExifIfd(&pCur, EXIF_TAG_METERING_MODE, EXIF_TYPE_SHORT,
-                 1, exifInfo->metering_mode);
-    writeExifIfd(&pCur, EXIF_TAG_FLASH, EXIF_TYPE_SHORT,
-                 1, exifInfo->flash);
-    writeExifIfd(&pCur, EXIF_TAG_FOCAL_LENGTH, EXIF_TYPE_RATIONAL,
-                 1, &exifInfo->focal_length, &LongerTagOffest, pIfdStart);
-    char code[8] = { 0x00, 0x00, 0x00, 0x49, 0x49, 0x43, 0x53, 0x41 };
-    int commentsLen = strlen((char *)exifInfo->user_comment) + 1;
-    memmove(exifInfo->user_comment + sizeof(code), exifInfo->user_comment, commentsLen);
-    memcpy(exifInfo->user_comment, code, sizeof(code));
-    writeExifIfd(&pCur, EXIF_TAG_USER_COMMENT, EXIF_TYPE_UNDEFINED,
-                 commentsLen + sizeof(code), exifInfo->user_comment, &LongerTagOffest, pIfdStart);
-    writeExifIfd(&pCur, EXIF_TAG_COLOR_SPACE, EXIF_TYPE_SHORT,
-                 1, exifInfo->color_space);
-    writeExifIfd(&pCur, EXIF_TAG_PIXEL_X_DIMENSION, EXIF_TYPE_LONG,
-                 1, exifInfo->width);
-    writeExifIfd(&pCur, EXIF_TAG_PIXEL_Y_DIMENSION, EXIF_TYPE_LONG,
-                 1, exifInfo->height);
-    writeExifIfd(&pCur, EXIF_TAG_EXPOSURE_MODE, EXIF_TYPE_LONG,
-                 1, exifInfo->exposure_mode);
-    writeExifIfd(&pCur, EXIF_TAG_WHITE_BALANCE, EXIF_TYPE_LONG,
-                 1, exifInfo->white_balance);
-    writeExifIfd(&pCur, EXIF_TAG_SCENCE_CAPTURE_TYPE, EXIF_TYPE_LONG,
-                 1, exifInfo->scene_capture_type);
-    tmp = 0;
-    memcpy(pCur, &tmp, OFFSET_SIZE); // next IFD offset
-    pCur += OFFSET_SIZE;
-
-    //2 0th IFD GPS Info Tags
-    if (exifInfo->enableGps) {
-        writeExifIfd(&pGpsIfdPtr, EXIF_TAG_GPS_IFD_POINTER, EXIF_TYPE_LONG,
-                     1, LongerTagOffest); // GPS IFD pointer skipped on 0th IFD
-
-        pCur = pIfdStart + LongerTagOffest;
-
-        if (exifInfo->gps_processing_method[0] == 0) {
-            // don't create GPS_PROCESSING_METHOD tag if there isn't any
-            tmp = NUM_0TH_IFD_GPS - 1;
-        } else {
-            tmp = NUM_0TH_IFD_GPS;
-        }
-        memcpy(pCur, &tmp, NUM_SIZE);
-        pCur += NUM_SIZE;
-
-        LongerTagOffest += NUM_SIZE + tmp*IFD_SIZE + OFFSET_SIZE;
-
-        writeExifIfd(&pCur, EXIF_TAG_GPS_VERSION_ID, EXIF_TYPE_BYTE,
-                     4, exifInfo->gps_version_id);
-        writeExifIfd(&pCur, EXIF_TAG_GPS_LATITUDE_REF, EXIF_TYPE_ASCII,
-                     2, exifInfo->gps_latitude_ref);
-        writeExifIfd(&pCur, EXIF_TAG_GPS_LATITUDE, EXIF_TYPE_RATIONAL,
-                     3, exifInfo->gps_latitude, &LongerTagOffest, pIfdStart);
-        writeExifIfd(&pCur, EXIF_TAG_GPS_LONGITUDE_REF, EXIF_TYPE_ASCII,
-                     2, exifInfo->gps_longitude_ref);
-        writeExifIfd(&pCur, EXIF_TAG_GPS_LONGITUDE, EXIF_TYPE_RATIONAL,
-                     3, exifInfo->gps_longitude, &LongerTagOffest, pIfdStart);
-        writeExifIfd(&pCur, EXIF_TAG_GPS_ALTITUDE_REF, EXIF_TYPE_BYTE,
-                     1, exifInfo->gps_altitude_ref);
-        writeExifIfd(&pCur, EXIF_TAG_GPS_ALTITUDE, EXIF_TYPE_RATIONAL,
-                     1, &exifInfo->gps_altitude, &LongerTagOffest, pIfdStart);
-        writeExifIfd(&pCur, EXIF_TAG_GPS_TIMESTAMP, EXIF_TYPE_RATIONAL,
-                     3, exifInfo->gps_timestamp, &LongerTagOffest, pIfdStart);
-        tmp = strlen((char*)exifInfo->gps_processing_method);
-        if (tmp > 0) {
-            if (tmp > 100) {
-                tmp = 100;
-            }
-            static const char ExifAsciiPrefix[] = { 0x41, 0x53, 0x43, 0x49, 0x49, 0x0, 0x0, 0x0 };
-            unsigned char tmp_buf[100+sizeof(ExifAsciiPrefix)];
-            memcpy(tmp_buf, ExifAsciiPrefix, sizeof(ExifAsciiPrefix));
-            memcpy(&tmp_buf[sizeof(ExifAsciiPrefix)], exifInfo->gps_processing_method, tmp);
-            writeExifIfd(&pCur, EXIF_TAG_GPS_PROCESSING_METHOD, EXIF_TYPE_UNDEFINED,
-                         tmp+sizeof(ExifAsciiPrefix), tmp_buf, &LongerTagOffest, pIfdStart);
-        }
-        writeExifIfd(&pCur, EXIF_TAG_GPS_DATESTAMP, EXIF_TYPE_ASCII,
-                     11, exifInfo->gps_datestamp, &LongerTagOffest, pIfdStart);
-        tmp = 0;
-        memcpy(pCur, &tmp, OFFSET_SIZE); // next IFD offset
-        pCur += OFFSET_SIZE;
-    }
-
-    //2 1th IFD TIFF Tags
-
-    unsigned char *thumbBuf = thumb_buf;
-    unsigned int thumbSize = thumb_size;
-
-    if (exifInfo->enableThumb && (thumbBuf != NULL) && (thumbSize > 0)) {
-        tmp = LongerTagOffest;
-        memcpy(pNextIfdOffset, &tmp, OFFSET_SIZE);  // NEXT IFD offset skipped on 0th IFD
-
-        pCur = pIfdStart + LongerTagOffest;
-
-        tmp = NUM_1TH_IFD_TIFF;
-        memcpy(pCur, &tmp, NUM_SIZE);
-        pCur += NUM_SIZE;
-
-        LongerTagOffest += NUM_SIZE + NUM_1TH_IFD_TIFF*IFD_SIZE + OFFSET_SIZE;
-
-        writeExifIfd(&pCur, EXIF_TAG_IMAGE_WIDTH, EXIF_TYPE_LONG,
-                     1, exifInfo->widthThumb);
-        writeExifIfd(&pCur, EXIF_TAG_IMAGE_HEIGHT, EXIF_TYPE_LONG,
-                     1, exifInfo->heightThumb);
-        writeExifIfd(&pCur, EXIF_TAG_COMPRESSION_SCHEME, EXIF_TYPE_SHORT,
-                     1, exifInfo->compression_scheme);
-        writeExifIfd(&pCur, EXIF_TAG_ORIENTATION, EXIF_TYPE_SHORT,
-                     1, exifInfo->orientation);
-        writeExifIfd(&pCur, EXIF_TAG_X_RESOLUTION, EXIF_TYPE_RATIONAL,
-                     1, &exifInfo->x_resolution, &LongerTagOffest, pIfdStart);
-        writeExifIfd(&pCur, EXIF_TAG_Y_RESOLUTION, EXIF_TYPE_RATIONAL,
-                     1, &exifInfo->y_resolution, &LongerTagOffest, pIfdStart);
-        writeExifIfd(&pCur, EXIF_TAG_RESOLUTION_UNIT, EXIF_TYPE_SHORT,
-                     1, exifInfo->resolution_unit);
-        writeExifIfd(&pCur, EXIF_TAG_JPEG_INTERCHANGE_FORMAT, EXIF_TYPE_LONG,
-                     1, LongerTagOffest);
-        writeExifIfd(&pCur, EXIF_TAG_JPEG_INTERCHANGE_FORMAT_LEN, EXIF_TYPE_LONG,
-                     1, thumbSize);
-
-        tmp = 0;
-        memcpy(pCur, &tmp, OFFSET_SIZE); // next IFD offset
-        pCur += OFFSET_SIZE;
-
-        memcpy(pIfdStart + LongerTagOffest, thumbBuf, thumbSize);
-        LongerTagOffest += thumbSize;
-    } else {
-        tmp = 0;
-        memcpy(pNextIfdOffset, &tmp, OFFSET_SIZE);  // NEXT IFD offset skipped on 0th IFD
-    }
-
-    unsigned char App1Marker[2] = { 0xff, 0xe1 };
-    memcpy(pApp1Start, App1Marker, 2);
-    pApp1Start += 2;
-
-    *size = 10 + LongerTagOffest;
-    tmp = *size - 2;    // APP1 Maker isn't counted
-    unsigned char size_mm[2] = {(tmp >> 8) & 0xFF, tmp & 0xFF};
-    memcpy(pApp1Start, size_mm, 2);
+    *size = exif_write_app1(exifOut, exifInfo, thumb_buf, thumb_size);
 
     ALOGD("makeExif X");
 
     return 0;
 }
 
-inline void SecCamera::writeExifIfd(unsigned char **pCur,
-                                         unsigned short tag,
-                                         unsigned short type,
-                                         unsigned int count,
-                                         uint32_t value)
-{
-    memcpy(*pCur, &tag, 2);
-    *pCur += 2;
-    memcpy(*pCur, &type, 2);
-    *pCur += 2;
-    memcpy(*pCur, &count, 4);
-    *pCur += 4;
-    memcpy(*pCur, &value, 4);
-    *pCur += 4;
-}
-
-inline void SecCamera::writeExifIfd(unsigned char **pCur,
-                                         unsigned short tag,
-                                         unsigned short type,
-                                         unsigned int count,
-                                         unsigned char *pValue)
-{
-    char buf[4] = { 0,};
-
-    memcpy(buf, pValue, count);
-    memcpy(*pCur, &tag, 2);
-    *pCur += 2;
-    memcpy(*pCur, &type, 2);
-    *pCur += 2;
-    memcpy(*pCur, &count, 4);
-    *pCur += 4;
-    memcpy(*pCur, buf, 4);
-    *pCur += 4;
-}
-
-inline void SecCamera::writeExifIfd(unsigned char **pCur,
-                                         unsigned short tag,
-                                         unsigned short type,
-                                         unsigned int count,
-                                         unsigned char *pValue,
-                                         unsigned int *offset,
-                                         unsigned char *start)
-{
-    memcpy(*pCur, &tag, 2);
-    *pCur += 2;
-    memcpy(*pCur, &type, 2);
-    *pCur += 2;
-    memcpy(*pCur, &count, 4);
-    *pCur += 4;
-    memcpy(*pCur, offset, 4);
-    *pCur += 4;
-    memcpy(start + *offset, pValue, count);
-    *offset += count;
-}
-
-inline void SecCamera::writeExifIfd(unsigned char **pCur,
-                                         unsigned short tag,
-                                         unsigned short type,
-                                         unsigned int count,
-                                         rational_t *pValue,
-                                         unsigned int *offset,
-                                         unsigned char *start)
-{
-    memcpy(*pCur, &tag, 2);
-    *pCur += 2;
-    memcpy(*pCur, &type, 2);
-    *pCur += 2;
-    memcpy(*pCur, &count, 4);
-    *pCur += 4;
-    memcpy(*pCur, offset, 4);
-    *pCur += 4;
-    memcpy(start + *offset, pValue, 8 * count);
-    *offset += 8 * count;
-}
-
 status_t SecCamera::dump(int fd)
 {
     const size_t SIZE = 256;
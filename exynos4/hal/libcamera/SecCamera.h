@@ -513,7 +513,17 @@ public:
                                        int index,
                                        unsigned char *jpeg_buf,
                                        int *output_size);
+    /* getSnapshotAndJpeg split in two, to overlap work with the encode */
+    int             captureSnapshot(SecBuffer *yuv_buf, int *index);
+    int             encodeSnapshot(SecBuffer *yuv_buf,
+                                   int index,
+                                   unsigned char *jpeg_buf,
+                                   int *output_size);
     int             getExif(unsigned char *pExifDst, unsigned char *pThumbSrc, int thumbSize);
+    /* as getExif, for a thumbnail that has already been encoded */
+    int             getExifWithThumbnailJpeg(unsigned char *pExifDst,
+                                             unsigned char *pThumbJpeg,
+                                             int thumbJpegSize);
 
     void            getPostViewConfig(int*, int*, int*);
     void            getThumbnailConfig(int *width, int *height, int *size);
@@ -646,31 +656,6 @@ private:
     struct SecBuffer m_buffers_preview[MAX_BUFFERS];
     struct SecBuffer m_buffers_record[MAX_BUFFERS];
 
-    inline void     writeExifIfd(unsigned char **pCur,
-                                 unsigned short tag,
-                                 unsigned short type,
-                                 unsigned int count,
-                                 uint32_t value);
-    inline void     writeExifIfd(unsigned char **pCur,
-                                 unsigned short tag,
-                                 unsigned short type,
-                                 unsigned int count,
-                                 unsigned char *pValue);
-    inline void     writeExifIfd(unsigned char **pCur,
-                                 unsigned short tag,
-                                 unsigned short type,
-                                 unsigned int count,
-                                 rational_t *pValue,
-                                 unsigned int *offset,
-                                 unsigned char *start);
-    inline void     writeExifIfd(unsigned char **pCur,
-                                 unsigned short tag,
-                                 unsigned short type,
-                                 unsigned int count,
-                                 unsigned char *pValue,
-                                 unsigned int *offset,
-                                 unsigned char *start);
-
     void            setExifChangedAttribute();
     void            setExifFixedAttribute();
     int             makeExif (unsigned char *exifOut,
@@ -20,9 +20,11 @@
 #include <utils/Log.h>
 
 #include "SecCameraHWInterface.h"
+#include "SecCameraImageOps.h"
 #include <utils/threads.h>
 #include <fcntl.h>
 #include <sys/mman.h>
+#include <cutils/properties.h>
 #include <camera/Camera.h>
 #include <media/hardware/MetadataBufferType.h>
 
@@ -39,6 +41,21 @@
 #define FRONT_CAMERA_FOCUS_DISTANCES_STR           "0.20,0.25,Infinity"
 #define USE_EGL
 
+/*
+ * The compressed picture is written behind a reserved APP1 slot, so the
+ * EXIF block can be put in front of it without moving the image. The slot
+ * follows the size of the previous EXIF block, APP1 can not exceed 64KB.
+ */
+#define EXIF_SLOT_MAX_SIZE                  0x10000
+#define EXIF_SLOT_HEADROOM                  4096
+
+/*
+ * The software thumbnail goes inside APP1 next to up to EXIF_FILE_SIZE of
+ * tags, a JPEG that does not fit is encoded again at a lower quality.
+ */
+#define THUMB_JPEG_MAX_SIZE                 (EXIF_SLOT_MAX_SIZE - EXIF_FILE_SIZE)
+#define THUMB_JPEG_MIN_QUALITY              30
+
 // This hack does two things:
 // -- it sets preview to NV21 (YUV420SP)
 // -- it sets gralloc to YV12
@@ -79,6 +96,10 @@ CameraHardwareSec::CameraHardwareSec(int cameraId, camera_device_t *dev)
         :
           mCaptureInProgress(false),
           mParameters(),
+          mPreviewZeroCopy(false),
+          mPreviewCopiedBytes(0),
+          mPreviewCopiedTotal(0),
+          mPreviewFrames(0),
           mFrameSizeDelta(0),
           mCameraSensorName(NULL),
           mUseInternalISP(false),
@@ -93,12 +114,32 @@ CameraHardwareSec::CameraHardwareSec(int cameraId, camera_device_t *dev)
           mPostViewHeight(0),
           mPostViewSize(0),
           mCapIndex(0),
+          mZslCount(0),
+          mZslDepth(0),
+          mZslLastShot(0),
+          mShutterTime(0),
+          mZslBurst(false),
+          mExifSlotSize(EXIF_SLOT_MAX_SIZE),
+          mExifScratch(NULL),
+          mExifScratchSize(0),
+          mThumbnailPending(false),
+          mThumbSrc(NULL),
+          mThumbSrcWidth(0),
+          mThumbSrcHeight(0),
+          mThumbDstWidth(0),
+          mThumbDstHeight(0),
+          mThumbSwEncode(false),
+          mThumbJpeg(NULL),
+          mThumbJpegBufSize(0),
+          mThumbJpegSize(-1),
+          mLastShotLatency(0),
           mRecordHint(false),
           mTouched(0),
           mHalDevice(dev)
 {
     ALOGV("%s :", __func__);
     memset(&mCapBuffer, 0, sizeof(struct SecBuffer));
+    cam_trace_init(&mTrace, false);
     int ret = 0;
 
     mPreviewWindow = NULL;
@@ -133,6 +174,7 @@ CameraHardwareSec::CameraHardwareSec(int cameraId, camera_device_t *dev)
     mPreviewThread = new PreviewThread(this);
     mAutoFocusThread = new AutoFocusThread(this);
     mPictureThread = new PictureThread(this);
+    mThumbnailThread = new ThumbnailThread(this);
 }
 
 int CameraHardwareSec::getCameraId() const
@@ -357,6 +399,9 @@ void CameraHardwareSec::initDefaultParameters(int cameraId)
     p.set("iso", "auto");
     p.set("metering", "center");
     p.set("wdr", 0);
+#ifdef ZERO_SHUTTER_LAG
+    p.set("zsl-burst", 0);
+#endif
 
     ip.set("chk_dataline", 0);
     if (cameraId == SecCamera::CAMERA_ID_FRONT) {
@@ -438,6 +483,8 @@ CameraHardwareSec::~CameraHardwareSec()
 {
     ALOGV("%s", __func__);
     mSecCamera->DestroyCamera();
+    delete[] mExifScratch;
+    delete[] mThumbJpeg;
 }
 
 status_t CameraHardwareSec::setPreviewWindow(preview_stream_ops *w)
@@ -608,6 +655,105 @@ void CameraHardwareSec::setSkipFrame(int frame)
     mSkipFrame = frame;
 }
 
+int CameraHardwareSec::zslQueueFrame(int index, nsecs_t timestamp)
+{
+    Mutex::Autolock lock(mZslLock);
+    int held = 0;
+
+    mZslRing[mZslCount].index = index;
+    mZslRing[mZslCount].timestamp = timestamp;
+    mZslRing[mZslCount].locked = false;
+    mZslCount++;
+
+    for (int i = 0; i < mZslCount; i++)
+        if (!mZslRing[i].locked)
+            held++;
+
+    /* the ring is in arrival order, give the oldest unused frames back */
+    for (int i = 0; i < mZslCount && held > mZslDepth; ) {
+        if (mZslRing[i].locked) {
+            i++;
+            continue;
+        }
+
+        int oldest = mZslRing[i].index;
+
+        memmove(&mZslRing[i], &mZslRing[i + 1], sizeof(ZslFrame) * (mZslCount - i - 1));
+        mZslCount--;
+        held--;
+
+        if (mSecCamera->setSnapshotFrame(oldest) < 0) {
+            ALOGE("%s: Fail qbuf, index(%d)", __func__, oldest);
+            return -1;
+        }
+    }
+
+    mZslCondition.signal();
+    return 0;
+}
+
+int CameraHardwareSec::zslLockFrame(nsecs_t shutter)
+{
+    Mutex::Autolock lock(mZslLock);
+
+    for (;;) {
+        int best = -1;
+        nsecs_t bestDiff = 0;
+
+        /* frames up to the previous shot were used already, a burst moves on */
+        for (int i = 0; i < mZslCount; i++) {
+            if (mZslRing[i].locked || mZslRing[i].timestamp <= mZslLastShot)
+                continue;
+
+            nsecs_t diff = mZslRing[i].timestamp - shutter;
+            if (diff < 0)
+                diff = -diff;
+            if (best < 0 || diff < bestDiff) {
+                best = i;
+                bestDiff = diff;
+            }
+        }
+
+        if (best >= 0) {
+            mZslRing[best].locked = true;
+            mZslLastShot = mZslRing[best].timestamp;
+            ALOGV("%s: index %d, %lld us from the shutter", __func__,
+                 mZslRing[best].index, (mZslRing[best].timestamp - shutter) / 1000);
+            return mZslRing[best].index;
+        }
+
+        if (mZslCondition.waitRelative(mZslLock, seconds(1)) != NO_ERROR) {
+            ALOGE("ERR(%s):no capture frame in the ring", __func__);
+            return -1;
+        }
+    }
+}
+
+void CameraHardwareSec::zslReleaseFrame(int index)
+{
+    Mutex::Autolock lock(mZslLock);
+
+    for (int i = 0; i < mZslCount; i++) {
+        if (mZslRing[i].index != index || !mZslRing[i].locked)
+            continue;
+
+        memmove(&mZslRing[i], &mZslRing[i + 1], sizeof(ZslFrame) * (mZslCount - i - 1));
+        mZslCount--;
+
+        if (mSecCamera->setSnapshotFrame(index) < 0)
+            ALOGE("%s: Fail qbuf, index(%d)", __func__, index);
+        return;
+    }
+}
+
+void CameraHardwareSec::zslFlush()
+{
+    Mutex::Autolock lock(mZslLock);
+
+    /* stream off hands every buffer back, only forget about them */
+    mZslCount = 0;
+}
+
 int CameraHardwareSec::previewThreadWrapper()
 {
     ALOGI("%s: starting", __func__);
@@ -616,6 +762,7 @@ int CameraHardwareSec::previewThreadWrapper()
         while (!mPreviewRunning) {
             ALOGI("%s: calling mSecCamera->stopPreview() and waiting", __func__);
             mSecCamera->stopPreview();
+            zslFlush();
             /* signal that we're stopping */
             mPreviewStoppedCondition.signal();
             mPreviewCondition.wait(mPreviewLock);
@@ -626,6 +773,7 @@ int CameraHardwareSec::previewThreadWrapper()
         if (mExitPreviewThread) {
             ALOGI("%s: exiting", __func__);
             mSecCamera->stopPreview();
+            zslFlush();
             return 0;
         }
 
@@ -666,15 +814,15 @@ int CameraHardwareSec::previewThread()
         return UNKNOWN_ERROR;
     }
 
+    cam_trace_begin(&mTrace);
+
 #ifdef ZERO_SHUTTER_LAG
     if (mUseInternalISP && !mRecordHint) {
-        mCapIndex = mSecCamera->getSnapshot();
+        int capIndex = mSecCamera->getSnapshot();
 
-        if (mCapIndex >= 0) {
-            if (mSecCamera->setSnapshotFrame(mCapIndex) < 0) {
-                ALOGE("%s: Fail qbuf, index(%d)", __func__, mCapIndex);
+        if (capIndex >= 0) {
+            if (zslQueueFrame(capIndex, systemTime(SYSTEM_TIME_MONOTONIC)) < 0)
                 return INVALID_OPERATION;
-            }
         }
     }
 #endif
@@ -684,6 +832,7 @@ int CameraHardwareSec::previewThread()
         mSkipFrame--;
         mSkipFrameLock.unlock();
         ALOGV("%s: index %d skipping frame", __func__, index);
+        cam_trace_drop(&mTrace, CAM_DROP_SKIP);
         if (mSecCamera->setPreviewFrame(index) < 0) {
             ALOGE("%s: Could not qbuff[%d]!!", __func__, index);
             return UNKNOWN_ERROR;
@@ -702,31 +851,46 @@ int CameraHardwareSec::previewThread()
 
     if (mPreviewWindow && mGrallocHal && mPreviewRunning) {
 #ifdef BOARD_USE_V4L2_ION
-        hnd = (private_handle_t*)*mBufferHandle[index];
+        if (mPreviewZeroCopy) {
+            hnd = (private_handle_t*)*mBufferHandle[index];
 
-        if (mPreviewHeap) {
-            mPreviewHeap->release(mPreviewHeap);
-            mPreviewHeap = 0;
-        }
+            if (mPreviewHeap) {
+                mPreviewHeap->release(mPreviewHeap);
+                mPreviewHeap = 0;
+            }
 
-        mPreviewHeap = mGetMemoryCb(hnd->fd, frame_size, 1, 0);
+            mPreviewHeap = mGetMemoryCb(hnd->fd, frame_size, 1, 0);
 
-        hnd = NULL;
+            hnd = NULL;
 
-        mGrallocHal->unlock(mGrallocHal, *mBufferHandle[index]);
-        if (0 != mPreviewWindow->enqueue_buffer(mPreviewWindow, mBufferHandle[index])) {
-            ALOGE("%s: Could not enqueue gralloc buffer[%d]!!", __func__, index);
-            goto callbacks;
+            mGrallocHal->unlock(mGrallocHal, *mBufferHandle[index]);
+            cam_trace_mark(&mTrace, CAM_TRACE_GRALLOC_UNLOCK);
+            if (0 != mPreviewWindow->enqueue_buffer(mPreviewWindow, mBufferHandle[index])) {
+                ALOGE("%s: Could not enqueue gralloc buffer[%d]!!", __func__, index);
+                cam_trace_drop(&mTrace, CAM_DROP_WINDOW_ENQUEUE);
+                goto callbacks;
+            } else {
+                mBufferHandle[index] = NULL;
+                mStride[index] = NULL;
+            }
+            cam_trace_mark(&mTrace, CAM_TRACE_ENQUEUE);
+
+            numArray = index;
         } else {
-            mBufferHandle[index] = NULL;
-            mStride[index] = NULL;
-        }
+            if (mPreviewHeap) {
+                mPreviewHeap->release(mPreviewHeap);
+                mPreviewHeap = 0;
+            }
 
-        numArray = index;
+            mPreviewHeap = mGetMemoryCb(mPreviewCopyHeap[index]->getHeapID(), frame_size, 1, 0);
+
+            numArray = 0;
+        }
 #endif
 
         if (0 != mPreviewWindow->dequeue_buffer(mPreviewWindow, &mBufferHandle[numArray], &mStride[numArray])) {
             ALOGE("%s: Could not dequeue gralloc buffer[%d]!!", __func__, numArray);
+            cam_trace_drop(&mTrace, CAM_DROP_WINDOW_DEQUEUE);
             goto callbacks;
         }
 
@@ -734,42 +898,46 @@ int CameraHardwareSec::previewThread()
                                *mBufferHandle[numArray],
                                GRALLOC_USAGE_SW_WRITE_OFTEN | GRALLOC_USAGE_YUV_ADDR,
                                0, 0, width, height, virAddr)) {
-#ifdef BOARD_USE_V4L2
-            mSecCamera->getPreviewAddr(index, &previewAddr);
-            char *frame = (char *)previewAddr.virt.extP[0];
-#else
-            char *frame = ((char *)mPreviewHeap->data) + offset;
+            cam_trace_mark(&mTrace, CAM_TRACE_GRALLOC_LOCK);
+            if (mPreviewZeroCopy) {
+#ifdef BOARD_USE_V4L2_ION
+                mSecCamera->setUserBufferAddr(virAddr, index, PREVIEW_MODE);
 #endif
+                mPreviewCopiedBytes = 0;
+            } else {
+                char *src[3];
 
+#ifdef BOARD_USE_V4L2
+                mSecCamera->getPreviewAddr(index, &previewAddr);
+#endif
 #ifdef BOARD_USE_V4L2_ION
-            mSecCamera->setUserBufferAddr(virAddr, index, PREVIEW_MODE);
+                src[0] = previewAddr.virt.extP[0];
+                src[1] = previewAddr.virt.extP[1];
+                src[2] = previewAddr.virt.extP[2];
 #else
-            int total = frame_size + mFrameSizeDelta;
-            int h = 0;
-            char *src = frame;
-
-            /* TODO : Need to fix size of planes for supported color fmt.
-                      Currnetly we support only YV12(3 plane) and NV21(2 plane)*/
-            // Y
-            memcpy(virAddr[0],src, width * height);
-            src += width * height;
-
-            if (mPreviewFmtPlane == PREVIEW_FMT_2_PLANE) {
-                memcpy(virAddr[1], src, width * height / 2);
-            } else if (mPreviewFmtPlane == PREVIEW_FMT_3_PLANE) {
-                // U
-                memcpy(virAddr[1], src, width * height / 4);
-                src += width * height / 4;
-
-                // V
-                memcpy(virAddr[2], src, width * height / 4);
-            }
-
-            mGrallocHal->unlock(mGrallocHal, **mBufferHandle);
+#ifdef BOARD_USE_V4L2
+                char *frame = (char *)previewAddr.virt.extP[0];
+#else
+                char *frame = ((char *)mPreviewHeap->data) + offset;
 #endif
-        }
-        else
+                /* single buffer, planes follow each other */
+                src[0] = frame;
+                src[1] = src[0] + width * height;
+                src[2] = src[1] + width * height / 4;
+#endif
+                mPreviewCopiedBytes = copyPreviewFrame(virAddr, mStride[numArray], src, width, height);
+                cam_trace_mark(&mTrace, CAM_TRACE_COPY);
+
+                mGrallocHal->unlock(mGrallocHal, *mBufferHandle[numArray]);
+                cam_trace_mark(&mTrace, CAM_TRACE_GRALLOC_UNLOCK);
+            }
+        } else {
             ALOGE("%s: could not obtain gralloc buffer", __func__);
+            cam_trace_drop(&mTrace, CAM_DROP_GRALLOC_LOCK);
+        }
+
+        mPreviewFrames++;
+        mPreviewCopiedTotal += mPreviewCopiedBytes;
 
         if (mSecCamera->setPreviewFrame(index) < 0) {
             ALOGE("%s: Fail qbuf, index(%d)", __func__, index);
@@ -777,12 +945,18 @@ int CameraHardwareSec::previewThread()
         }
 
         index = 0;
-#ifndef BOARD_USE_V4L2_ION
-        if (0 != mPreviewWindow->enqueue_buffer(mPreviewWindow, *mBufferHandle)) {
-            ALOGE("Could not enqueue gralloc buffer!");
-            goto callbacks;
-        }
+        if (!mPreviewZeroCopy) {
+            if (0 != mPreviewWindow->enqueue_buffer(mPreviewWindow, mBufferHandle[numArray])) {
+                ALOGE("Could not enqueue gralloc buffer!");
+                cam_trace_drop(&mTrace, CAM_DROP_WINDOW_ENQUEUE);
+                goto callbacks;
+            }
+            cam_trace_mark(&mTrace, CAM_TRACE_ENQUEUE);
+#ifdef BOARD_USE_V4L2_ION
+            mBufferHandle[numArray] = NULL;
+            mStride[numArray] = NULL;
 #endif
+        }
     }
 
 callbacks:
@@ -839,13 +1013,18 @@ callbacks:
 #endif
 
         // Notify the client of a new frame.
-        if (mMsgEnabled & CAMERA_MSG_VIDEO_FRAME)
+        if (mMsgEnabled & CAMERA_MSG_VIDEO_FRAME) {
             mDataCbTimestamp(timestamp, CAMERA_MSG_VIDEO_FRAME,
                              mRecordHeap[numArray], recordingIndex, mCallbackCookie);
-        else
+            cam_trace_mark(&mTrace, CAM_TRACE_RECORD);
+        } else {
             mSecCamera->releaseRecordFrame(index);
+            cam_trace_drop(&mTrace, CAM_DROP_RECORD);
+        }
     }
 
+    cam_trace_end(&mTrace);
+
     return NO_ERROR;
 }
 
@@ -898,6 +1077,30 @@ status_t CameraHardwareSec::startPreviewInternal()
     ALOGD("mPreviewHeap(fd(%d), size(%d), width(%d), height(%d))",
          mSecCamera->getCameraFd(SecCamera::PREVIEW), frame_size + mFrameSizeDelta, width, height);
 
+    char trace[PROPERTY_VALUE_MAX];
+
+    property_get("camera.trace", trace, "0");
+    cam_trace_init(&mTrace, atoi(trace) != 0);
+
+#ifdef ZERO_SHUTTER_LAG
+    if (mUseInternalISP) {
+        char depth[PROPERTY_VALUE_MAX];
+        int capWidth, capHeight, capSize;
+
+        /* the driver needs a couple of buffers queued to keep streaming */
+        property_get("camera.zsl.depth", depth, "4");
+        mZslDepth = atoi(depth);
+        if (mZslDepth < 2)
+            mZslDepth = 2;
+        if (mZslDepth > CAP_BUFFERS - 2)
+            mZslDepth = CAP_BUFFERS - 2;
+
+        mSecCamera->getSnapshotSize(&capWidth, &capHeight, &capSize);
+        ALOGI("%s: ZSL ring of %d %dx%d frames (%d KB held)", __func__,
+             mZslDepth, capWidth, capHeight, mZslDepth * (capSize / 1024));
+    }
+#endif
+
 #ifdef BOARD_USE_V4L2_ION
 #ifdef ZERO_SHUTTER_LAG
 /*TODO*/
@@ -909,6 +1112,10 @@ status_t CameraHardwareSec::startPreviewInternal()
     }
 #endif
     void *vaddr[3];
+    char value[PROPERTY_VALUE_MAX];
+
+    property_get("camera.preview.zerocopy", value, "1");
+    mPreviewZeroCopy = atoi(value) != 0;
 
     for (int i = 0; i < MAX_BUFFERS; i++) {
         if (mBufferHandle[i] == NULL) {
@@ -917,17 +1124,56 @@ status_t CameraHardwareSec::startPreviewInternal()
                 return INVALID_OPERATION;
             }
         }
-        if (mGrallocHal->lock(mGrallocHal,
-                          *mBufferHandle[i],
-                          GRALLOC_USAGE_SW_WRITE_OFTEN | GRALLOC_USAGE_YUV_ADDR,
-                          0, 0, width, height, vaddr)) {
-            ALOGE("ERR(%s): Could not get virtual address!!, index = %d", __func__, i);
-            return UNKNOWN_ERROR;
+        if (!isPreviewZeroCopyCompatible(width, mStride[i]))
+            mPreviewZeroCopy = false;
+    }
+
+    if (mPreviewZeroCopy) {
+        for (int i = 0; i < MAX_BUFFERS; i++) {
+            if (mGrallocHal->lock(mGrallocHal,
+                              *mBufferHandle[i],
+                              GRALLOC_USAGE_SW_WRITE_OFTEN | GRALLOC_USAGE_YUV_ADDR,
+                              0, 0, width, height, vaddr)) {
+                ALOGE("ERR(%s): Could not get virtual address!!, index = %d", __func__, i);
+                return UNKNOWN_ERROR;
+            }
+            mSecCamera->setUserBufferAddr(vaddr, i, PREVIEW_MODE);
+        }
+    } else {
+        /* sizes match the plane lengths queued by SecCamera */
+        int y_size = ALIGN(width, 16) * ALIGN(height, 16);
+        int c_size = ALIGN(width / 2, 16) * ALIGN(height / 2, 16);
+
+        ALOGI("%s: window stride %d, width %d, copying preview frames",
+             __func__, mStride[0], width);
+
+        for (int i = 0; i < MAX_BUFFERS; i++) {
+            if (mBufferHandle[i] == NULL)
+                continue;
+            if (0 != mPreviewWindow->cancel_buffer(mPreviewWindow, mBufferHandle[i]))
+                ALOGE("%s: Fail to cancel buffer[%d]", __func__, i);
+            mBufferHandle[i] = NULL;
+            mStride[i] = NULL;
+        }
+
+        for (int i = 0; i < MAX_BUFFERS; i++) {
+            mPreviewCopyHeap[i] = new MemoryHeapBaseIon(y_size + c_size * 2);
+            if (mPreviewCopyHeap[i]->getHeapID() < 0) {
+                ALOGE("ERR(%s): Could not allocate preview buffer[%d]", __func__, i);
+                return NO_MEMORY;
+            }
+            vaddr[0] = mPreviewCopyHeap[i]->base();
+            vaddr[1] = (char *)vaddr[0] + y_size;
+            vaddr[2] = (char *)vaddr[1] + c_size;
+            mSecCamera->setUserBufferAddr(vaddr, i, PREVIEW_MODE);
         }
-        mSecCamera->setUserBufferAddr(vaddr, i, PREVIEW_MODE);
     }
 #endif
 
+    mPreviewCopiedBytes = 0;
+    mPreviewCopiedTotal = 0;
+    mPreviewFrames = 0;
+
     int ret  = mSecCamera->startPreview();
     ALOGV("%s : mSecCamera->startPreview() returned %d", __func__, ret);
 
@@ -988,6 +1234,7 @@ void CameraHardwareSec::stopPreviewInternal()
                         mStride[i] = NULL;
                     }
                 }
+                mPreviewCopyHeap[i].clear();
             }
 #endif
         }
@@ -1273,70 +1520,95 @@ void CameraHardwareSec::save_postview(const char *fname, uint8_t *buf, uint32_t
 bool CameraHardwareSec::scaleDownYuv422(char *srcBuf, uint32_t srcWidth, uint32_t srcHeight,
                                         char *dstBuf, uint32_t dstWidth, uint32_t dstHeight)
 {
-    int32_t step_x, step_y;
-    int32_t iXsrc, iXdst;
-    int32_t x, y, src_y_start_pos, dst_pos, src_pos;
-
-    if (dstWidth % 2 != 0 || dstHeight % 2 != 0) {
+    if (yuyv_scale_down((const uint8_t *)srcBuf, srcWidth, srcHeight,
+                        (uint8_t *)dstBuf, dstWidth, dstHeight) < 0) {
         ALOGE("scale_down_yuv422: invalid width, height for scaling");
         return false;
     }
 
-    step_x = srcWidth / dstWidth;
-    step_y = srcHeight / dstHeight;
+    return true;
+}
 
-    dst_pos = 0;
-    for (uint32_t y = 0; y < dstHeight; y++) {
-        src_y_start_pos = (y * step_y * (srcWidth * 2));
+bool CameraHardwareSec::YUY2toNV21(void *srcBuf, void *dstBuf, uint32_t srcWidth, uint32_t srcHeight)
+{
+    return yuyv_to_nv21((const uint8_t *)srcBuf, (uint8_t *)dstBuf, srcWidth, srcHeight) == 0;
+}
 
-        for (uint32_t x = 0; x < dstWidth; x += 2) {
-            src_pos = src_y_start_pos + (x * (step_x * 2));
+int CameraHardwareSec::thumbnailThread()
+{
+    mThumbJpegSize = -1;
 
-            dstBuf[dst_pos++] = srcBuf[src_pos    ];
-            dstBuf[dst_pos++] = srcBuf[src_pos + 1];
-            dstBuf[dst_pos++] = srcBuf[src_pos + 2];
-            dstBuf[dst_pos++] = srcBuf[src_pos + 3];
+    if (!scaleDownYuv422(mThumbSrc, mThumbSrcWidth, mThumbSrcHeight,
+                         (char *)mThumbnailHeap->base(), mThumbDstWidth, mThumbDstHeight))
+        return UNKNOWN_ERROR;
+
+    if (mThumbSwEncode) {
+        int quality = mSecCamera->getJpegThumbnailQuality();
+
+        /* the encoder fails rather than overflow mThumbJpegBufSize */
+        while (1) {
+            mThumbJpegSize = yuyv_encode_jpeg((const uint8_t *)mThumbnailHeap->base(),
+                                              mThumbDstWidth, mThumbDstHeight, quality,
+                                              mThumbJpeg, mThumbJpegBufSize);
+            if (mThumbJpegSize > 0 || quality <= THUMB_JPEG_MIN_QUALITY)
+                break;
+
+            quality = quality * 3 / 4;
+            if (quality < THUMB_JPEG_MIN_QUALITY)
+                quality = THUMB_JPEG_MIN_QUALITY;
+            ALOGW("%s: thumbnail does not fit APP1, retrying at quality %d", __func__, quality);
         }
+
+        /* the hardware thumbnail is used instead */
+        if (mThumbJpegSize <= 0)
+            ALOGW("%s: thumbnail does not fit APP1 at quality %d", __func__, quality);
     }
 
-    return true;
+    return NO_ERROR;
 }
 
-bool CameraHardwareSec::YUY2toNV21(void *srcBuf, void *dstBuf, uint32_t srcWidth, uint32_t srcHeight)
+void CameraHardwareSec::startThumbnail(char *src, int srcWidth, int srcHeight,
+                                       int width, int height)
 {
-    int32_t        x, y, src_y_start_pos, dst_cbcr_pos, dst_pos, src_pos;
-    unsigned char *srcBufPointer = (unsigned char *)srcBuf;
-    unsigned char *dstBufPointer = (unsigned char *)dstBuf;
+    char value[PROPERTY_VALUE_MAX];
 
-    dst_pos = 0;
-    dst_cbcr_pos = srcWidth*srcHeight;
-    for (uint32_t y = 0; y < srcHeight; y++) {
-        src_y_start_pos = (y * (srcWidth * 2));
+    mThumbSrc = src;
+    mThumbSrcWidth = srcWidth;
+    mThumbSrcHeight = srcHeight;
+    mThumbDstWidth = width;
+    mThumbDstHeight = height;
 
-        for (uint32_t x = 0; x < (srcWidth * 2); x += 2) {
-            src_pos = src_y_start_pos + x;
+    /* the software encoder only takes what scaleDownYuv422 produces */
+    property_get("camera.capture.swthumb", value, "1");
+    mThumbSwEncode = atoi(value) && (mSecCamera->getSnapshotPixelFormat() == V4L2_PIX_FMT_YUYV);
 
-            dstBufPointer[dst_pos++] = srcBufPointer[src_pos];
-        }
+    if (mThumbSwEncode && mThumbJpeg == NULL) {
+        mThumbJpeg = new unsigned char[THUMB_JPEG_MAX_SIZE];
+        mThumbJpegBufSize = THUMB_JPEG_MAX_SIZE;
     }
-    for (uint32_t y = 0; y < srcHeight; y += 2) {
-        src_y_start_pos = (y * (srcWidth * 2));
-
-        for (uint32_t x = 0; x < (srcWidth * 2); x += 4) {
-            src_pos = src_y_start_pos + x;
 
-            dstBufPointer[dst_cbcr_pos++] = srcBufPointer[src_pos + 3];
-            dstBufPointer[dst_cbcr_pos++] = srcBufPointer[src_pos + 1];
-        }
+    mThumbnailPending = true;
+    if (mThumbnailThread->run("CameraThumbnailThread", PRIORITY_DEFAULT) != NO_ERROR) {
+        ALOGW("%s: couldn't run thumbnail thread, doing it inline", __func__);
+        thumbnailThread();
+        mThumbnailPending = false;
     }
+}
 
-    return true;
+void CameraHardwareSec::waitThumbnail()
+{
+    if (mThumbnailPending) {
+        mThumbnailThread->join();
+        mThumbnailPending = false;
+    }
 }
 
 int CameraHardwareSec::pictureThread()
 {
     ALOGV("%s :", __func__);
 
+    nsecs_t shotTime = systemTime(SYSTEM_TIME_MONOTONIC);
+
     int jpeg_size = 0;
     int ret = NO_ERROR;
     unsigned char *jpeg_data = NULL;
@@ -1349,6 +1621,9 @@ int CameraHardwareSec::pictureThread()
     int cap_width, cap_height, cap_frame_size;
 
     int JpegImageSize = 0;
+    int capIndex = mCapIndex;
+
+    mThumbJpegSize = -1;
 
     mSecCamera->getPostViewConfig(&mPostViewWidth, &mPostViewHeight, &mPostViewSize);
     mSecCamera->getThumbnailConfig(&mThumbWidth, &mThumbHeight, &mThumbSize);
@@ -1365,7 +1640,17 @@ int CameraHardwareSec::pictureThread()
 
     ALOGV("[5B] mPostViewWidth = %d mPostViewHeight = %d\n",mPostViewWidth,mPostViewHeight);
 
-    camera_memory_t *JpegHeap = mGetMemoryCb(-1, mJpegHeapSize, 1, 0);
+    int exifSlotSize = mExifSlotSize;
+    sp<MemoryHeapBase> JpegHeap = new MemoryHeapBase(exifSlotSize + mJpegHeapSize);
+    if (JpegHeap->getHeapID() < 0) {
+        ALOGE("ERR(%s):Fail to allocate the jpeg heap(%d)", __func__, exifSlotSize + mJpegHeapSize);
+        mStateLock.lock();
+        mCaptureInProgress = false;
+        mStateLock.unlock();
+        return NO_MEMORY;
+    }
+    unsigned char *JpegOut = (unsigned char *)JpegHeap->base() + exifSlotSize;
+
 #ifdef BOARD_USE_V4L2_ION
 #ifdef ZERO_SHUTTER_LAG
     mThumbnailHeap = new MemoryHeapBaseIon(mThumbSize);
@@ -1398,45 +1683,68 @@ int CameraHardwareSec::pictureThread()
             }
 
             memcpy((unsigned char *)mThumbnailHeap->base(), (unsigned char *)thumb_addr, mThumbSize);
-            memcpy(JpegHeap->data, jpeg_data, JpegImageSize);
+            memcpy(JpegOut, jpeg_data, JpegImageSize);
         } else {
+            int encodeRet = -1;
+#ifdef ZERO_SHUTTER_LAG
+            int zslIndex = -1;
+#endif
+
             if (mMsgEnabled & CAMERA_MSG_SHUTTER)
                 mNotifyCb(CAMERA_MSG_SHUTTER, 0, 0, mCallbackCookie);
 
 #ifdef ZERO_SHUTTER_LAG
-            mSecCamera->getCaptureAddr(mCapIndex, &mCapBuffer);
+            if (!mRecordHint) {
+                capIndex = zslLockFrame(mShutterTime);
+                if (capIndex < 0)
+                    goto capture_done;
+                zslIndex = capIndex;
+            }
+
+            mSecCamera->getCaptureAddr(capIndex, &mCapBuffer);
 
             if (mCapBuffer.virt.extP[0] == NULL) {
                 ALOGE("ERR(%s):Fail on SecCamera getCaptureAddr = %0x ",
                      __func__, mCapBuffer.virt.extP[0]);
-                return UNKNOWN_ERROR;
+                goto capture_done;
             }
-
-            scaleDownYuv422((char *)mCapBuffer.virt.extP[0], cap_width, cap_height,
-                            (char *)mThumbnailHeap->base(), mThumbWidth, mThumbHeight);
 #else
 #ifdef BOARD_USE_V4L2_ION
             mCapBuffer.virt.extP[0] = (char *)mPostviewHeap[mCapIndex]->base();
 #endif
 #endif
 
-            if (mSecCamera->getSnapshotAndJpeg(&mCapBuffer, mCapIndex,
-                    (unsigned char*)JpegHeap->data, &JpegImageSize) < 0) {
+            if (mSecCamera->captureSnapshot(&mCapBuffer, &capIndex) < 0)
+                goto capture_done;
+
+            /* the thumbnail is made while the main image is encoded */
+            startThumbnail((char *)mCapBuffer.virt.extP[0], cap_width, cap_height,
+                           mThumbWidth, mThumbHeight);
+
+            encodeRet = mSecCamera->encodeSnapshot(&mCapBuffer, capIndex,
+                                                   JpegOut, &JpegImageSize);
+            waitThumbnail();
+
+capture_done:
+            /* a frame left locked would drop out of the ZSL ring for good */
+#ifdef ZERO_SHUTTER_LAG
+            if (zslIndex >= 0)
+                zslReleaseFrame(zslIndex);
+#endif
+
+            if (encodeRet < 0) {
                 mStateLock.lock();
                 mCaptureInProgress = false;
                 mStateLock.unlock();
-                JpegHeap->release(JpegHeap);
                 return UNKNOWN_ERROR;
             }
             ALOGI("snapshotandjpeg done");
 
 #ifdef ZERO_SHUTTER_LAG
-            if (!mRecordRunning)
+            /* in burst mode preview and the ring keep running for the next shot */
+            if (!mRecordRunning && !mZslBurst)
                 stopPreview();
             memset(&mCapBuffer, 0, sizeof(struct SecBuffer));
-#else
-            scaleDownYuv422((char *)mCapBuffer.virt.extP[0], cap_width, cap_height,
-                            (char *)mThumbnailHeap->base(), mThumbWidth, mThumbHeight);
 #endif
         }
     }
@@ -1460,12 +1768,24 @@ int CameraHardwareSec::pictureThread()
     mStateLock.unlock();
 
     if (mMsgEnabled & CAMERA_MSG_COMPRESSED_IMAGE) {
-        camera_memory_t *ExifHeap =
-            mGetMemoryCb(-1, EXIF_FILE_SIZE + mThumbSize, 1, 0);
+        int exifScratchSize = EXIF_FILE_SIZE +
+            (mThumbJpegSize > mThumbSize ? mThumbJpegSize : mThumbSize);
+
+        if (mExifScratchSize < exifScratchSize) {
+            delete[] mExifScratch;
+            mExifScratch = new unsigned char[exifScratchSize];
+            mExifScratchSize = exifScratchSize;
+        }
 
-        int JpegExifSize = mSecCamera->getExif((unsigned char *)ExifHeap->data,
-                                           (unsigned char *)mThumbnailHeap->base(),
-                                            mThumbSize);
+        int JpegExifSize;
+
+        if (mThumbJpegSize > 0)
+            JpegExifSize = mSecCamera->getExifWithThumbnailJpeg(mExifScratch,
+                                                                mThumbJpeg, mThumbJpegSize);
+        else
+            JpegExifSize = mSecCamera->getExif(mExifScratch,
+                                               (unsigned char *)mThumbnailHeap->base(),
+                                               mThumbSize);
         ALOGV("JpegExifSize=%d", JpegExifSize);
 
         if (JpegExifSize < 0) {
@@ -1473,23 +1793,48 @@ int CameraHardwareSec::pictureThread()
             goto out;
         }
 
-        int mJpegHeapSize_out = JpegImageSize + JpegExifSize;
-        camera_memory_t *JpegHeap_out = mGetMemoryCb(-1, mJpegHeapSize_out, 1, 0);
+        camera_memory_t *JpegHeap_out;
+
+        if (JpegExifSize <= exifSlotSize) {
+            /*
+             * SOI, then APP1 padded up to the end of the slot, which lands
+             * right behind the SOI of the encoded image.
+             */
+            unsigned char *pOut = (unsigned char *)JpegHeap->base();
+            int app1Len = exifSlotSize - 2;    // APP1 Maker isn't counted
+
+            pOut[0] = 0xFF;
+            pOut[1] = 0xD8;
+            memcpy(pOut + 2, mExifScratch, JpegExifSize);
+            memset(pOut + 2 + JpegExifSize, 0, exifSlotSize - JpegExifSize);
+            pOut[4] = (app1Len >> 8) & 0xFF;
+            pOut[5] = app1Len & 0xFF;
 
-        unsigned char *ExifStart = (unsigned char *)JpegHeap_out->data + 2;
-        unsigned char *ImageStart = ExifStart + JpegExifSize;
+            JpegHeap_out = mGetMemoryCb(JpegHeap->getHeapID(), exifSlotSize + JpegImageSize, 1, 0);
+        } else {
+            ALOGW("%s: EXIF(%d) does not fit the APP1 slot(%d), copying",
+                 __func__, JpegExifSize, exifSlotSize);
 
-        memcpy(JpegHeap_out->data, JpegHeap->data, 2);
-        memcpy(ExifStart, ExifHeap->data, JpegExifSize);
-        memcpy(ImageStart, JpegHeap->data + 2, JpegImageSize - 2);
+            JpegHeap_out = mGetMemoryCb(-1, JpegImageSize + JpegExifSize, 1, 0);
 
-        mDataCb(CAMERA_MSG_COMPRESSED_IMAGE, JpegHeap_out, 0, NULL, mCallbackCookie);
+            unsigned char *ExifStart = (unsigned char *)JpegHeap_out->data + 2;
+            unsigned char *ImageStart = ExifStart + JpegExifSize;
 
-        if (ExifHeap) {
-            ExifHeap->release(ExifHeap);
-            ExifHeap = 0;
+            memcpy(JpegHeap_out->data, JpegOut, 2);
+            memcpy(ExifStart, mExifScratch, JpegExifSize);
+            memcpy(ImageStart, JpegOut + 2, JpegImageSize - 2);
         }
 
+        mExifSlotSize = JpegExifSize + EXIF_SLOT_HEADROOM;
+        if (mExifSlotSize > EXIF_SLOT_MAX_SIZE)
+            mExifSlotSize = EXIF_SLOT_MAX_SIZE;
+
+        mDataCb(CAMERA_MSG_COMPRESSED_IMAGE, JpegHeap_out, 0, NULL, mCallbackCookie);
+
+        mLastShotLatency = systemTime(SYSTEM_TIME_MONOTONIC) - shotTime;
+        ALOGI("%s: shot to jpeg callback %lld us, %s thumbnail", __func__,
+             mLastShotLatency / 1000, mThumbJpegSize > 0 ? "software" : "hardware");
+
         if (JpegHeap_out) {
             JpegHeap_out->release(JpegHeap_out);
             JpegHeap_out = 0;
@@ -1499,11 +1844,6 @@ int CameraHardwareSec::pictureThread()
     ALOGV("%s : pictureThread end", __func__);
 
 out:
-    if (JpegHeap) {
-        JpegHeap->release(JpegHeap);
-        JpegHeap = 0;
-    }
-
     if (mRawHeap) {
         mRawHeap->release(mRawHeap);
         mRawHeap = 0;
@@ -1519,6 +1859,8 @@ status_t CameraHardwareSec::takePicture()
 {
     ALOGV("%s :", __func__);
 
+    mShutterTime = systemTime(SYSTEM_TIME_MONOTONIC);
+
 #ifdef ZERO_SHUTTER_LAG
     if (!mUseInternalISP) {
         stopPreview();
@@ -1590,15 +1932,19 @@ bool CameraHardwareSec::FindEOIMarkerInJPEG(unsigned char *pBuf, int dwBufSize,
         return false;
     }
 
+    unsigned char *p = pBuf;
     unsigned char *pBufEnd = pBuf + dwBufSize;
 
-    while (pBuf < pBufEnd) {
-        if (CheckEOIMarker(pBuf++))
+    /* let memchr find the 0xFF candidates instead of testing every byte */
+    while ((p = (unsigned char *)memchr(p, HIBYTE(JPEG_EOI_MARKER), pBufEnd - p)) != NULL) {
+        if (CheckEOIMarker(p)) {
+            *pnJPEGsize += p - pBuf;
             return true;
-
-        (*pnJPEGsize)++;
+        }
+        p++;
     }
 
+    *pnJPEGsize += dwBufSize;
     return false;
 }
 
@@ -1696,6 +2042,13 @@ bool CameraHardwareSec::SplitFrame(unsigned char *pFrame, int dwSize,
     return bRet;
 }
 
+/* padding words and the YUV start-code, everything else is JPEG data */
+static inline bool isInterleaveCode(unsigned int word)
+{
+    return word == 0xFFFFFFFF || word == 0x02FFFFFF || word == 0xFF02FFFF ||
+           (word & 0xFFFF) == 0x05FF;
+}
+
 int CameraHardwareSec::decodeInterleaveData(unsigned char *pInterleaveData,
                                                  int interleaveDataSize,
                                                  int yuvWidth,
@@ -1748,14 +2101,21 @@ int CameraHardwareSec::decodeInterleaveData(unsigned char *pInterleaveData,
                 break;
             }
         } else {
-            // Extract JPEG Data
+            // Extract JPEG Data, up to the next padding or YUV start-code
+            unsigned int *run = interleave_ptr;
+
+            do {
+                interleave_ptr++;
+                i += 4;
+            } while (i < interleaveDataSize && !isInterleaveCode(*interleave_ptr));
+
             if (pJpegData != NULL) {
-                memcpy(jpeg_ptr, interleave_ptr, 4);
-                jpeg_ptr += 4;
-                jpeg_size += 4;
+                int run_size = (unsigned char *)interleave_ptr - (unsigned char *)run;
+
+                memcpy(jpeg_ptr, run, run_size);
+                jpeg_ptr += run_size;
+                jpeg_size += run_size;
             }
-            interleave_ptr++;
-            i += 4;
         }
     }
     if (ret) {
@@ -1794,12 +2154,75 @@ status_t CameraHardwareSec::dump(int fd) const
         mInternalParameters.dump(fd, args);
         snprintf(buffer, 255, " preview running(%s)\n", mPreviewRunning?"true": "false");
         result.append(buffer);
+        snprintf(buffer, 255, " preview %s, frames(%u) copied last(%u) total(%llu)\n",
+                 mPreviewZeroCopy ? "zero copy" : "copy", mPreviewFrames,
+                 mPreviewCopiedBytes, mPreviewCopiedTotal);
+        result.append(buffer);
+        snprintf(buffer, 255, " last shot to jpeg callback(%lld us)\n", mLastShotLatency / 1000);
+        result.append(buffer);
+        snprintf(buffer, 255, " zsl ring depth(%d) held(%d) burst(%d)\n",
+                 mZslDepth, mZslCount, mZslBurst);
+        result.append(buffer);
+        cam_trace_dump(&mTrace, result);
     } else
         result.append("No camera client yet.\n");
     write(fd, result.string(), result.size());
     return NO_ERROR;
 }
 
+static size_t copy_plane(char *dst, int dst_stride, const char *src,
+                         int src_stride, int row_bytes, int rows)
+{
+    if (dst_stride == row_bytes && src_stride == row_bytes) {
+        memcpy(dst, src, row_bytes * rows);
+    } else {
+        for (int i = 0; i < rows; i++) {
+            memcpy(dst, src, row_bytes);
+            dst += dst_stride;
+            src += src_stride;
+        }
+    }
+
+    return row_bytes * rows;
+}
+
+bool CameraHardwareSec::isPreviewZeroCopyCompatible(int width, int stride) const
+{
+    /* FIMC writes every plane with a pitch of the frame width */
+    if (stride != width)
+        return false;
+
+    /* gralloc aligns YV12 chroma rows to 16 bytes */
+    if (mPreviewFmtPlane == PREVIEW_FMT_3_PLANE && ((width / 2) & 15))
+        return false;
+
+    return true;
+}
+
+size_t CameraHardwareSec::copyPreviewFrame(void *dst[3], int stride, char *src[3],
+                                           int width, int height)
+{
+    size_t copied;
+
+    /* TODO : Need to fix size of planes for supported color fmt.
+              Currnetly we support only YV12(3 plane) and NV21(2 plane)*/
+    // Y
+    copied = copy_plane((char *)dst[0], stride, src[0], width, width, height);
+
+    if (mPreviewFmtPlane == PREVIEW_FMT_2_PLANE) {
+        copied += copy_plane((char *)dst[1], stride, src[1], width, width, height / 2);
+    } else if (mPreviewFmtPlane == PREVIEW_FMT_3_PLANE) {
+        int cstride = ALIGN(stride / 2, 16);
+
+        // U
+        copied += copy_plane((char *)dst[1], cstride, src[1], width / 2, width / 2, height / 2);
+        // V
+        copied += copy_plane((char *)dst[2], cstride, src[2], width / 2, width / 2, height / 2);
+    }
+
+    return copied;
+}
+
 bool CameraHardwareSec::isSupportedPreviewSize(const int width,
                                                const int height) const
 {
@@ -2683,6 +3106,16 @@ status_t CameraHardwareSec::setParameters(const CameraParameters& params)
         }
     }
 
+#ifdef ZERO_SHUTTER_LAG
+    // zsl burst
+    int new_zsl_burst = params.getInt("zsl-burst");
+
+    if (0 <= new_zsl_burst && mUseInternalISP) {
+        mZslBurst = new_zsl_burst != 0;
+        mParameters.set("zsl-burst", new_zsl_burst);
+    }
+#endif
+
     //anti shake
     int new_anti_shake = mInternalParameters.getInt("anti-shake");
 
@@ -2940,6 +3373,10 @@ void CameraHardwareSec::release()
         mPictureThread->requestExitAndWait();
         mPictureThread.clear();
     }
+    if (mThumbnailThread != NULL) {
+        mThumbnailThread->requestExitAndWait();
+        mThumbnailThread.clear();
+    }
 
     if (mRawHeap) {
         mRawHeap->release(mRawHeap);
@@ -20,6 +20,7 @@
 #define ANDROID_HARDWARE_CAMERA_HARDWARE_SEC_H
 
 #include "SecCamera.h"
+#include "SecCameraTrace.h"
 #include <utils/threads.h>
 #include <utils/RefBase.h>
 #include <binder/MemoryBase.h>
@@ -107,6 +108,18 @@ private:
         }
     };
 
+    class ThumbnailThread : public Thread {
+        CameraHardwareSec *mHardware;
+    public:
+        ThumbnailThread(CameraHardwareSec *hw):
+        Thread(false),
+        mHardware(hw) { }
+        virtual bool threadLoop() {
+            mHardware->thumbnailThread();
+            return false;
+        }
+    };
+
     class AutoFocusThread : public Thread {
         CameraHardwareSec *mHardware;
     public:
@@ -134,6 +147,12 @@ private:
             int         pictureThread();
             bool        mCaptureInProgress;
 
+    sp<ThumbnailThread> mThumbnailThread;
+            int         thumbnailThread();
+            void        startThumbnail(char *src, int srcWidth, int srcHeight,
+                                       int width, int height);
+            void        waitThumbnail();
+
             int         save_jpeg(unsigned char *real_jpeg, int jpeg_size);
             void        save_postview(const char *fname, uint8_t *buf,
                                         uint32_t size);
@@ -161,6 +180,9 @@ private:
             void        setSkipFrame(int frame);
             bool        isSupportedPreviewSize(const int width,
                                                const int height) const;
+            bool        isPreviewZeroCopyCompatible(int width, int stride) const;
+            size_t      copyPreviewFrame(void *dst[3], int stride, char *src[3],
+                                         int width, int height);
             bool        getVideosnapshotSize(int *width, int *height);
     /* used by auto focus thread to block until it's told to run */
     mutable Mutex       mFocusLock;
@@ -189,6 +211,18 @@ private:
 
             int         mPreviewFmtPlane;
 
+    /*
+     * Zero copy preview: the window's gralloc buffers are handed to the
+     * capture driver as USERPTR buffers. When the window stride does not
+     * match what FIMC writes, frames are captured into private buffers
+     * and copied, mPreviewCopiedBytes tells how much that cost last frame.
+     */
+            bool        mPreviewZeroCopy;
+            size_t      mPreviewCopiedBytes;
+            uint64_t    mPreviewCopiedTotal;
+            uint32_t    mPreviewFrames;
+    struct cam_trace    mTrace;
+
     CameraParameters    mParameters;
     CameraParameters    mInternalParameters;
 
@@ -202,6 +236,10 @@ private:
     camera_frame_metadata_t     *mFaceData;
     camera_memory_t     *mFaceDataHeap;
 
+#ifdef BOARD_USE_V4L2_ION
+    sp<MemoryHeapBaseIon> mPreviewCopyHeap[MAX_BUFFERS];
+#endif
+
     buffer_handle_t *mBufferHandle[BUFFER_COUNT_FOR_ARRAY];
     int mStride[BUFFER_COUNT_FOR_ARRAY];
 
@@ -229,6 +267,52 @@ private:
             int         mPostViewSize;
      struct SecBuffer   mCapBuffer;
             int         mCapIndex;
+
+    /*
+     * ZSL ring: the last mZslDepth capture frames are kept out of the
+     * driver queue together with the time they were dequeued, so that
+     * takePicture can encode the one closest to the shutter. A frame goes
+     * back to the driver when it falls out of the ring, or when the picture
+     * thread is done with it.
+     */
+    struct ZslFrame {
+        int     index;
+        nsecs_t timestamp;
+        bool    locked;
+    };
+    mutable Mutex       mZslLock;
+    mutable Condition   mZslCondition;
+            ZslFrame    mZslRing[CAP_BUFFERS];
+            int         mZslCount;
+            int         mZslDepth;
+            nsecs_t     mZslLastShot;
+            nsecs_t     mShutterTime;
+            bool        mZslBurst;
+            int         zslQueueFrame(int index, nsecs_t timestamp);
+            int         zslLockFrame(nsecs_t shutter);
+            void        zslReleaseFrame(int index);
+            void        zslFlush();
+            int         mExifSlotSize;
+            unsigned char *mExifScratch;
+            int         mExifScratchSize;
+
+    /*
+     * The thumbnail is scaled down on mThumbnailThread while the hardware
+     * encodes the main image. As the hardware JPEG block is busy, it is
+     * encoded in software there too. mThumbJpegSize stays -1 when it has
+     * to go through the hardware after the main image instead.
+     */
+            bool        mThumbnailPending;
+            char       *mThumbSrc;
+            int         mThumbSrcWidth;
+            int         mThumbSrcHeight;
+            int         mThumbDstWidth;
+            int         mThumbDstHeight;
+            bool        mThumbSwEncode;
+            unsigned char *mThumbJpeg;
+            int         mThumbJpegBufSize;
+            int         mThumbJpegSize;
+            nsecs_t     mLastShotLatency;
             int         mCameraID;
 
             Vector<Size> mSupportedPreviewSizes;
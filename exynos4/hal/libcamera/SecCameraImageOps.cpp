@@ -0,0 +1,330 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "SecCameraImageOps"
+#include <utils/Log.h>
+
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __ARM_NEON__
+#include <arm_neon.h>
+#endif
+
+extern "C" {
+#include <jpeglib.h>
+}
+
+#include "SecCameraImageOps.h"
+
+/*
+ * A YUYV word holds two pixels, Y0 U Y1 V from the lowest byte up.
+ * Lines are converted four pixels at a time, NEON takes 16.
+ */
+static inline uint32_t load_word(const uint8_t *p)
+{
+    uint32_t w;
+
+    memcpy(&w, p, sizeof(w));
+    return w;
+}
+
+static inline void store_word(uint8_t *p, uint32_t w)
+{
+    memcpy(p, &w, sizeof(w));
+}
+
+static int yuyv_to_nv(const uint8_t *src, uint8_t *dst, int width, int height, bool cr_first)
+{
+    uint8_t *dst_y = dst;
+    uint8_t *dst_c = dst + width * height;
+
+    if (width <= 0 || height <= 0 || (width & 1) || (height & 1)) {
+        ALOGE("ERR(%s):invalid size %dx%d", __func__, width, height);
+        return -1;
+    }
+
+    for (int y = 0; y < height; y++) {
+        const uint8_t *s = src + y * width * 2;
+        bool chroma = !(y & 1);
+        int x = 0;
+
+#ifdef __ARM_NEON__
+        for (; x + 16 <= width; x += 16) {
+            uint8x8x4_t p = vld4_u8(s + x * 2);
+            uint8x8x2_t luma;
+
+            luma.val[0] = p.val[0];
+            luma.val[1] = p.val[2];
+            vst2_u8(dst_y + x, luma);
+
+            if (chroma) {
+                uint8x8x2_t c;
+
+                c.val[0] = cr_first ? p.val[3] : p.val[1];
+                c.val[1] = cr_first ? p.val[1] : p.val[3];
+                vst2_u8(dst_c + x, c);
+            }
+        }
+#endif
+        for (; x + 4 <= width; x += 4) {
+            uint32_t p0 = load_word(s + x * 2);
+            uint32_t p1 = load_word(s + x * 2 + 4);
+
+            store_word(dst_y + x, (p0 & 0xff) | ((p0 >> 8) & 0xff00) |
+                                  ((p1 & 0xff) << 16) | ((p1 << 8) & 0xff000000));
+            if (!chroma)
+                continue;
+
+            if (cr_first)
+                store_word(dst_c + x, (p0 >> 24) | (p0 & 0xff00) |
+                                      ((p1 >> 8) & 0xff0000) | ((p1 << 16) & 0xff000000));
+            else
+                store_word(dst_c + x, ((p0 >> 8) & 0xff) | ((p0 >> 16) & 0xff00) |
+                                      ((p1 << 8) & 0xff0000) | (p1 & 0xff000000));
+        }
+        for (; x < width; x += 2) {
+            dst_y[x]     = s[x * 2];
+            dst_y[x + 1] = s[x * 2 + 2];
+            if (chroma) {
+                dst_c[x]     = cr_first ? s[x * 2 + 3] : s[x * 2 + 1];
+                dst_c[x + 1] = cr_first ? s[x * 2 + 1] : s[x * 2 + 3];
+            }
+        }
+
+        dst_y += width;
+        if (!chroma)
+            dst_c += width;
+    }
+
+    return 0;
+}
+
+int yuyv_to_nv21(const uint8_t *src, uint8_t *dst, int width, int height)
+{
+    return yuyv_to_nv(src, dst, width, height, true);
+}
+
+int yuyv_to_nv12(const uint8_t *src, uint8_t *dst, int width, int height)
+{
+    return yuyv_to_nv(src, dst, width, height, false);
+}
+
+int yuyv_scale_down(const uint8_t *src, int src_width, int src_height,
+                    uint8_t *dst, int dst_width, int dst_height)
+{
+    int c_width = dst_width / 2;
+
+    if (dst_width <= 0 || dst_height <= 0 || (dst_width & 1) || (src_width & 1) ||
+        dst_width > src_width || dst_height > src_height) {
+        ALOGE("ERR(%s):can not scale %dx%d to %dx%d", __func__,
+             src_width, src_height, dst_width, dst_height);
+        return -1;
+    }
+
+    /*
+     * x_start[i] is the first source pixel of destination pixel i,
+     * c_start[j] the first source macro pixel of destination macro pixel j.
+     * Both tables end with a sentinel so box i is [start[i], start[i + 1]).
+     */
+    int *x_start = (int *)malloc(sizeof(int) * (dst_width + 1 + c_width + 1) +
+                                 sizeof(uint32_t) * (dst_width + c_width * 2));
+    if (x_start == NULL) {
+        ALOGE("ERR(%s):out of memory", __func__);
+        return -1;
+    }
+    int *c_start = x_start + dst_width + 1;
+    uint32_t *acc_y = (uint32_t *)(c_start + c_width + 1);
+    uint32_t *acc_u = acc_y + dst_width;
+    uint32_t *acc_v = acc_u + c_width;
+
+    for (int i = 0; i <= dst_width; i++)
+        x_start[i] = (int)((int64_t)i * src_width / dst_width);
+    for (int j = 0; j <= c_width; j++)
+        c_start[j] = x_start[j * 2] >> 1;
+
+    /*
+     * Every source pixel lands in exactly one box. The lines of a
+     * destination line are folded into per-column running sums one after
+     * the other, so each source line is read once, front to back, and the
+     * sums stay in cache.
+     */
+    int sy = 0;
+    for (int y = 0; y < dst_height; y++) {
+        int sy_end = (int)((int64_t)(y + 1) * src_height / dst_height);
+        int rows = sy_end - sy;
+
+        memset(acc_y, 0, sizeof(uint32_t) * (dst_width + c_width * 2));
+
+        for (; sy < sy_end; sy++) {
+            const uint8_t *line = src + sy * src_width * 2;
+            int x = 0, m = 0;
+
+            for (int i = 0; i < dst_width; i++) {
+                uint32_t sum = 0;
+
+                for (; x < x_start[i + 1]; x++)
+                    sum += line[x * 2];
+                acc_y[i] += sum;
+            }
+
+            for (int j = 0; j < c_width; j++) {
+                uint32_t sum_u = 0, sum_v = 0;
+
+                for (; m < c_start[j + 1]; m++) {
+                    sum_u += line[m * 4 + 1];
+                    sum_v += line[m * 4 + 3];
+                }
+                acc_u[j] += sum_u;
+                acc_v[j] += sum_v;
+            }
+        }
+
+        uint8_t *out = dst + y * dst_width * 2;
+
+        for (int j = 0; j < c_width; j++) {
+            uint32_t n0 = (x_start[j * 2 + 1] - x_start[j * 2]) * rows;
+            uint32_t n1 = (x_start[j * 2 + 2] - x_start[j * 2 + 1]) * rows;
+            uint32_t nc = (c_start[j + 1] - c_start[j]) * rows;
+
+            out[j * 4]     = (acc_y[j * 2] + n0 / 2) / n0;
+            out[j * 4 + 1] = (acc_u[j] + nc / 2) / nc;
+            out[j * 4 + 2] = (acc_y[j * 2 + 1] + n1 / 2) / n1;
+            out[j * 4 + 3] = (acc_v[j] + nc / 2) / nc;
+        }
+    }
+
+    free(x_start);
+    return 0;
+}
+
+/* libjpeg writes into the caller's buffer, running out of it is an error */
+struct jpeg_buf_dest {
+    struct jpeg_destination_mgr pub;
+    uint8_t                    *buf;
+    int                         size;
+};
+
+struct jpeg_jmp_err {
+    struct jpeg_error_mgr       pub;
+    jmp_buf                     jmp;
+};
+
+static void jpeg_jmp_error_exit(j_common_ptr cinfo)
+{
+    char msg[JMSG_LENGTH_MAX];
+
+    (*cinfo->err->format_message)(cinfo, msg);
+    ALOGE("ERR(%s):%s", __func__, msg);
+    longjmp(((struct jpeg_jmp_err *)cinfo->err)->jmp, 1);
+}
+
+static void jpeg_buf_init(j_compress_ptr cinfo)
+{
+    struct jpeg_buf_dest *dest = (struct jpeg_buf_dest *)cinfo->dest;
+
+    dest->pub.next_output_byte = dest->buf;
+    dest->pub.free_in_buffer = dest->size;
+}
+
+static boolean jpeg_buf_empty(j_compress_ptr cinfo)
+{
+    ALOGE("ERR(%s):output buffer too small", __func__);
+    longjmp(((struct jpeg_jmp_err *)cinfo->err)->jmp, 1);
+    return FALSE;
+}
+
+static void jpeg_buf_term(j_compress_ptr)
+{
+}
+
+int yuyv_encode_jpeg(const uint8_t *src, int width, int height, int quality,
+                     uint8_t *dst, int dst_size)
+{
+    struct jpeg_compress_struct cinfo;
+    struct jpeg_jmp_err jerr;
+    struct jpeg_buf_dest dest;
+    int size = -1;
+
+    if (width <= 0 || height <= 0 || (width & 1)) {
+        ALOGE("ERR(%s):invalid size %dx%d", __func__, width, height);
+        return -1;
+    }
+
+    uint8_t *line = (uint8_t *)malloc(width * 3);
+    if (line == NULL) {
+        ALOGE("ERR(%s):out of memory", __func__);
+        return -1;
+    }
+
+    cinfo.err = jpeg_std_error(&jerr.pub);
+    jerr.pub.error_exit = jpeg_jmp_error_exit;
+    jpeg_create_compress(&cinfo);
+
+    if (setjmp(jerr.jmp)) {
+        jpeg_destroy_compress(&cinfo);
+        free(line);
+        return -1;
+    }
+
+    dest.pub.init_destination = jpeg_buf_init;
+    dest.pub.empty_output_buffer = jpeg_buf_empty;
+    dest.pub.term_destination = jpeg_buf_term;
+    dest.buf = dst;
+    dest.size = dst_size;
+    cinfo.dest = &dest.pub;
+
+    cinfo.image_width = width;
+    cinfo.image_height = height;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_YCbCr;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, quality, TRUE);
+    cinfo.dct_method = JDCT_IFAST;
+    cinfo.comp_info[0].h_samp_factor = 2;
+    cinfo.comp_info[0].v_samp_factor = 1;
+
+    jpeg_start_compress(&cinfo, TRUE);
+
+    /* YCbCr in, so libjpeg only has to split Y0 U Y1 V into pixels */
+    while (cinfo.next_scanline < cinfo.image_height) {
+        const uint8_t *s = src + cinfo.next_scanline * width * 2;
+        JSAMPROW row = line;
+
+        for (int x = 0; x < width; x += 2, s += 4) {
+            uint8_t *p = line + x * 3;
+
+            p[0] = s[0];
+            p[1] = s[1];
+            p[2] = s[3];
+            p[3] = s[2];
+            p[4] = s[1];
+            p[5] = s[3];
+        }
+        jpeg_write_scanlines(&cinfo, &row, 1);
+    }
+
+    jpeg_finish_compress(&cinfo);
+    size = dst_size - dest.pub.free_in_buffer;
+
+    jpeg_destroy_compress(&cinfo);
+    free(line);
+
+    return size;
+}
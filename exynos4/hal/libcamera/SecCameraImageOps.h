@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HARDWARE_SEC_CAMERA_IMAGE_OPS_H
+#define ANDROID_HARDWARE_SEC_CAMERA_IMAGE_OPS_H
+
+#include <stdint.h>
+
+/*
+ * Software image operations used on the capture path (thumbnail and
+ * postview generation). Source and destination are packed, without
+ * padding between lines. All functions return 0 on success, -1 when the
+ * geometry is not supported.
+ */
+
+/* YUYV 4:2:2 to NV21/NV12, chroma is taken from the even lines */
+int yuyv_to_nv21(const uint8_t *src, uint8_t *dst, int width, int height);
+int yuyv_to_nv12(const uint8_t *src, uint8_t *dst, int width, int height);
+
+/*
+ * Box filtered YUYV 4:2:2 downscale for any ratio. Every destination
+ * pixel is the average of all source pixels it covers, chroma of all
+ * source macro pixels, so fine detail averages out instead of aliasing.
+ */
+int yuyv_scale_down(const uint8_t *src, int src_width, int src_height,
+                    uint8_t *dst, int dst_width, int dst_height);
+
+/*
+ * Software JPEG encode of a YUYV 4:2:2 image, sampled 4:2:2 like the
+ * hardware encoder does. Used for the thumbnail while the hardware block
+ * is busy with the main image. Returns the size of the JPEG stream, -1 if
+ * encoding failed or dst_size was too small.
+ */
+int yuyv_encode_jpeg(const uint8_t *src, int width, int height, int quality,
+                     uint8_t *dst, int dst_size);
+
+#endif /* ANDROID_HARDWARE_SEC_CAMERA_IMAGE_OPS_H */
@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "SecCameraTrace.h"
+
+using namespace android;
+
+static const char *const cam_trace_point_names[CAM_TRACE_POINTS] = {
+    "dequeue", "lock", "copy", "unlock", "enqueue", "record",
+};
+
+static const char *const cam_trace_drop_names[CAM_DROPS] = {
+    "skip", "window dequeue", "gralloc lock", "window enqueue", "record",
+};
+
+/* upper bounds of the histogram buckets in us, the last one is open */
+static const int32_t cam_trace_bounds[] = {
+    500, 1000, 2000, 4000, 8000, 16000, 33000,
+};
+
+#define CAM_TRACE_BUCKETS   (int)(sizeof(cam_trace_bounds) / sizeof(cam_trace_bounds[0]) + 1)
+
+void cam_trace_init(struct cam_trace *t, bool enabled)
+{
+    Mutex::Autolock _l(t->lock);
+
+    t->start = 0;
+    memset(&t->cur, 0, sizeof(t->cur));
+    memset(t->ring, 0, sizeof(t->ring));
+    memset((void *)t->drops, 0, sizeof(t->drops));
+    t->head = 0;
+    t->frames = 0;
+    t->enabled = enabled;
+}
+
+void cam_trace_dump(const struct cam_trace *t, String8 &result)
+{
+    char buffer[256];
+    uint32_t hist[CAM_TRACE_POINTS][CAM_TRACE_BUCKETS];
+
+    Mutex::Autolock _l(t->lock);
+
+    /* frames is bumped after head, so it never counts past this head */
+    uint32_t total = (uint32_t)android_atomic_acquire_load((volatile int32_t *)&t->frames);
+    uint32_t head = (uint32_t)android_atomic_acquire_load((volatile int32_t *)&t->head);
+    uint32_t frames = total < CAM_TRACE_RING ? total : CAM_TRACE_RING - 1;
+
+    if (!t->enabled) {
+        result.append(" preview trace off (setprop camera.trace 1)\n");
+        return;
+    }
+
+    /*
+     * The slot at head may be being rewritten, only the frames before it
+     * are read. A frame overwritten while we read can still skew one count.
+     */
+    memset(hist, 0, sizeof(hist));
+    for (uint32_t n = 1; n <= frames; n++) {
+        const struct cam_trace_frame *f = &t->ring[(head + CAM_TRACE_RING - n) % CAM_TRACE_RING];
+
+        for (int p = 1; p < CAM_TRACE_POINTS; p++) {
+            int b = 0;
+
+            if (f->us[p] < 0)
+                continue;
+            while (b < CAM_TRACE_BUCKETS - 1 && f->us[p] >= cam_trace_bounds[b])
+                b++;
+            hist[p][b]++;
+        }
+    }
+
+    snprintf(buffer, sizeof(buffer), " preview trace: %u frames, last %u, us after dequeue\n",
+             total, frames);
+    result.append(buffer);
+
+    snprintf(buffer, sizeof(buffer), "   %-8s", "");
+    result.append(buffer);
+    for (int b = 0; b < CAM_TRACE_BUCKETS - 1; b++) {
+        snprintf(buffer, sizeof(buffer), " <%6d", cam_trace_bounds[b]);
+        result.append(buffer);
+    }
+    result.append("   more\n");
+
+    for (int p = 1; p < CAM_TRACE_POINTS; p++) {
+        snprintf(buffer, sizeof(buffer), "   %-8s", cam_trace_point_names[p]);
+        result.append(buffer);
+        for (int b = 0; b < CAM_TRACE_BUCKETS; b++) {
+            snprintf(buffer, sizeof(buffer), " %7u", hist[p][b]);
+            result.append(buffer);
+        }
+        result.append("\n");
+    }
+
+    result.append("   drops:");
+    for (int d = 0; d < CAM_DROPS; d++) {
+        snprintf(buffer, sizeof(buffer), " %s(%u)", cam_trace_drop_names[d], t->drops[d]);
+        result.append(buffer);
+    }
+    result.append("\n");
+}
@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HARDWARE_SEC_CAMERA_TRACE_H
+#define ANDROID_HARDWARE_SEC_CAMERA_TRACE_H
+
+#include <stdint.h>
+#include <cutils/atomic.h>
+#include <utils/String8.h>
+#include <utils/threads.h>
+#include <utils/Timers.h>
+
+/*
+ * Per-frame trace of the preview thread. Each point is stored in
+ * microseconds since the frame was dequeued from the driver, -1 when
+ * the frame did not get there. Only the preview thread writes. A frame
+ * is published by advancing head, so the preview thread never waits for
+ * dump(); lock only keeps init() from clearing the ring under a dump.
+ * When tracing is off, every call is one test of enabled.
+ */
+enum {
+    CAM_TRACE_DEQUEUE,          /* getPreview returned the frame */
+    CAM_TRACE_GRALLOC_LOCK,     /* window buffer dequeued and locked */
+    CAM_TRACE_COPY,             /* frame copied/converted into it */
+    CAM_TRACE_GRALLOC_UNLOCK,
+    CAM_TRACE_ENQUEUE,          /* handed to the window */
+    CAM_TRACE_RECORD,           /* recording callback returned */
+    CAM_TRACE_POINTS
+};
+
+enum {
+    CAM_DROP_SKIP,              /* mSkipFrame */
+    CAM_DROP_WINDOW_DEQUEUE,
+    CAM_DROP_GRALLOC_LOCK,
+    CAM_DROP_WINDOW_ENQUEUE,
+    CAM_DROP_RECORD,            /* recording frame released unseen */
+    CAM_DROPS
+};
+
+#define CAM_TRACE_RING      128
+
+struct cam_trace_frame {
+    int32_t         us[CAM_TRACE_POINTS];
+};
+
+struct cam_trace {
+    mutable android::Mutex lock;
+    int             enabled;
+    nsecs_t         start;
+    struct cam_trace_frame cur;
+    volatile uint32_t head;     /* next slot, always < CAM_TRACE_RING */
+    volatile uint32_t frames;   /* published after head, may wrap */
+    struct cam_trace_frame ring[CAM_TRACE_RING];
+    volatile uint32_t drops[CAM_DROPS];
+};
+
+void cam_trace_init(struct cam_trace *t, bool enabled);
+void cam_trace_dump(const struct cam_trace *t, android::String8 &result);
+
+static inline void cam_trace_begin(struct cam_trace *t)
+{
+    if (!t->enabled)
+        return;
+
+    t->start = systemTime(SYSTEM_TIME_MONOTONIC);
+    for (int i = 0; i < CAM_TRACE_POINTS; i++)
+        t->cur.us[i] = -1;
+    t->cur.us[CAM_TRACE_DEQUEUE] = 0;
+}
+
+static inline void cam_trace_mark(struct cam_trace *t, int point)
+{
+    if (t->enabled)
+        t->cur.us[point] = (int32_t)((systemTime(SYSTEM_TIME_MONOTONIC) - t->start) / 1000);
+}
+
+static inline void cam_trace_drop(struct cam_trace *t, int reason)
+{
+    if (t->enabled)
+        t->drops[reason]++;
+}
+
+static inline void cam_trace_end(struct cam_trace *t)
+{
+    if (!t->enabled)
+        return;
+
+    uint32_t head = t->head;
+
+    t->ring[head] = t->cur;
+    android_atomic_release_store((head + 1) % CAM_TRACE_RING, (volatile int32_t *)&t->head);
+    android_atomic_release_store(t->frames + 1, (volatile int32_t *)&t->frames);
+}
+
+#endif /* ANDROID_HARDWARE_SEC_CAMERA_TRACE_H */
@@ -524,11 +524,16 @@ SecFimc::SecFimc()
     memset(&mS5pFimc, 0, sizeof(s5p_fimc_t));
 
     mRotVal = 0;
+    mDstRotVal = 0;
     mRealDev = -1;
     mNumOfBuf = 0;
     mHwVersion = 0;
     mGlobalAlpha = 0x0;
     mFlagStreamOn = false;
+    mFlagAsync = false;
+    mQueued = 0;
+    mQueueTail = 0;
+    mDoneIndex = -1;
     mFlagSetSrcParam = false;
     mFlagSetDstParam = false;
     mFlagGlobalAlpha = false;
@@ -581,6 +586,11 @@ bool SecFimc::create(enum DEV dev, enum MODE mode, int numOfBuf)
         break;
     }
 
+    if (numOfBuf <= 0 || MAX_DST_BUFFERS < numOfBuf) {
+        ALOGE("%s::Invalid numOfBuf(%d) (max : %d) fail", __func__, numOfBuf, MAX_DST_BUFFERS);
+        goto err;
+    }
+
     mNumOfBuf = numOfBuf;
 
     for (int i = 0; i < MAX_DST_BUFFERS; i++)
@@ -698,19 +708,8 @@ bool SecFimc::destroy()
         return false;
     }
 
-    if (mFlagStreamOn == true) {
-        if (fimc_v4l2_stream_off(mFd, V4L2_BUF_TYPE_SRC) < 0) {
-            ALOGE("%s::fimc_v4l2_stream_off() failed", __func__);
-            return false;
-        }
-#ifdef BOARD_USE_V4L2
-        if (fimc_v4l2_stream_off(mFd, V4L2_BUF_TYPE_DST) < 0) {
-            ALOGE("%s::fimc_v4l2_stream_off() failed", __func__);
-            return false;
-        }
-#endif
-        mFlagStreamOn = false;
-    }
+    if (m_streamOff() == false)
+        return false;
 
     if (fimc_v4l2_clr_buf(mFd, V4L2_BUF_TYPE_SRC, V4L2_MEMORY_TYPE_SRC) < 0) {
         ALOGE("%s::fimc_v4l2_clr_buf()[src] failed", __func__);
@@ -732,6 +731,11 @@ bool SecFimc::destroy()
         close(mFd);
     mFd = 0;
 
+    /* a later create() must set up the formats on the new fd again */
+    memset(params, 0, sizeof(*params));
+    mFlagSetSrcParam = false;
+    mFlagSetDstParam = false;
+
     mFlagCreate = false;
 
     return true;
@@ -831,6 +835,10 @@ bool SecFimc::setSrcParams(unsigned int width, unsigned int height,
     src_planes = (src_planes == -1) ? 1 : src_planes;
 
     if (mFlagSetSrcParam == true) {
+        /* buffers can not be freed while streaming */
+        if (m_streamOff() == false)
+            return false;
+
         if (fimc_v4l2_clr_buf(mFd, V4L2_BUF_TYPE_SRC, V4L2_MEMORY_TYPE_SRC) < 0) {
             ALOGE("%s::fimc_v4l2_clr_buf_src() failed", __func__);
             return false;
@@ -842,7 +850,12 @@ bool SecFimc::setSrcParams(unsigned int width, unsigned int height,
         return false;
     }
 
+#ifdef BOARD_USE_V4L2
+    /* one source buffer per slot, for queue() */
+    if (fimc_v4l2_req_buf(mFd, mNumOfBuf, V4L2_BUF_TYPE_SRC, V4L2_MEMORY_TYPE_SRC) < 0) {
+#else
     if (fimc_v4l2_req_buf(mFd, 1, V4L2_BUF_TYPE_SRC, V4L2_MEMORY_TYPE_SRC) < 0) {
+#endif
         ALOGE("%s::fimc_v4l2_req_buf()[src] failed", __func__);
         return false;
     }
@@ -981,6 +994,7 @@ bool SecFimc::setDstParams(unsigned int width, unsigned int height,
     unsigned int fimcWidth  = *cropWidth;
     unsigned int fimcHeight = *cropHeight;
     int dst_planes = m_getYuvPlanes(v4l2ColorFormat);
+    s5p_fimc_img_info oldDst = params->dst;
 
     m_checkDstSize(width, height,
                    cropX, cropY,
@@ -1037,8 +1051,20 @@ bool SecFimc::setDstParams(unsigned int width, unsigned int height,
     params->dst.color_space = v4l2ColorFormat;
     dst_planes = (dst_planes == -1) ? 1 : dst_planes;
 
+    /* same as last time: keep the buffers, and the stream going */
+    if (   (mFlagSetDstParam == true)
+        && (mDstRotVal == mRotVal)
+        && (memcmp(&oldDst, &params->dst, sizeof(oldDst)) == 0)) {
+        *cropWidth  = fimcWidth;
+        *cropHeight = fimcHeight;
+        return true;
+    }
+
 #ifdef BOARD_USE_V4L2
     if (mFlagSetDstParam == true) {
+        if (m_streamOff() == false)
+            return false;
+
         if (fimc_v4l2_clr_buf(mFd, V4L2_BUF_TYPE_DST, V4L2_MEMORY_TYPE_DST) < 0) {
             ALOGE("%s::fimc_v4l2_clr_buf_dst() failed", __func__);
             return false;
@@ -1073,6 +1099,7 @@ bool SecFimc::setDstParams(unsigned int width, unsigned int height,
     *cropWidth  = fimcWidth;
     *cropHeight = fimcHeight;
 
+    mDstRotVal = mRotVal;
     mFlagSetDstParam = true;
     return true;
 }
@@ -1198,6 +1225,10 @@ bool SecFimc::setRotVal(unsigned int rotVal)
         return false;
     }
 
+    /* per frame callers would otherwise touch the control while streaming */
+    if (mFlagSetDstParam == true && mRotVal == (int)rotVal)
+        return true;
+
     if (fimc_v4l2_s_ctrl(mFd, V4L2_ROTATE, rotVal) < 0) {
         ALOGE("%s::fimc_v4l2_s_ctrl(V4L2_ROTATE) failed", __func__);
         return false;
@@ -1358,6 +1389,11 @@ bool SecFimc::draw(int src_index, int dst_index)
         return false;
     }
 
+    if (mFlagAsync == true) {
+        ALOGE("%s::instance is used with queue()", __func__);
+        return false;
+    }
+
     s5p_fimc_params_t *params = &(mS5pFimc.params);
     bool flagStreamOn = false;
     int src_planes = m_getYuvPlanes(params->src.color_space);
@@ -1424,12 +1460,22 @@ err :
     return true;
 }
 
-bool SecFimc::m_streamOn()
+bool SecFimc::queue(int *index)
 {
 #ifdef DEBUG_LIB_FIMC
     ALOGD("%s", __func__);
 #endif
 
+    if (mFlagCreate == false) {
+        ALOGE("%s::Not yet created", __func__);
+        return false;
+    }
+
+    if (mFlagSetSrcParam == false || mFlagSetDstParam == false) {
+        ALOGE("%s::src/dst params not set", __func__);
+        return false;
+    }
+
 #ifdef BOARD_USE_V4L2
     s5p_fimc_params_t *params = &(mS5pFimc.params);
     int src_planes = m_getYuvPlanes(params->src.color_space);
@@ -1437,21 +1483,178 @@ bool SecFimc::m_streamOn()
     src_planes = (src_planes == -1) ? 1 : src_planes;
     dst_planes = (dst_planes == -1) ? 1 : dst_planes;
 
+    if (mFlagStreamOn == true && mFlagAsync == false) {
+        ALOGE("%s::instance is streaming for draw()", __func__);
+        return false;
+    }
+
+    if (mQueued == mNumOfBuf) {
+        ALOGE("%s::all %d slots are busy", __func__, mNumOfBuf);
+        return false;
+    }
+
+    int slot = mQueueTail;
+
+    /* USERPTR planes carry their length, refresh it for this source */
+    m_setSrcPlaneSize();
+
+    if (fimc_v4l2_queue(mFd, &(mSrcBuffer), V4L2_BUF_TYPE_SRC, V4L2_MEMORY_TYPE_SRC, slot, src_planes) < 0) {
+        ALOGE("%s::fimc_v4l2_queue[src](index : %d) failed", __func__, slot);
+        return false;
+    }
+
+    if (fimc_v4l2_queue(mFd, &(mDstBuffer[slot]), V4L2_BUF_TYPE_DST, V4L2_MEMORY_TYPE_DST, slot, dst_planes) < 0) {
+        ALOGE("%s::fimc_v4l2_queue[dst](index : %d) failed", __func__, slot);
+        return false;
+    }
+
+    /* the first pair has to be queued before STREAMON */
+    if (mFlagStreamOn == false) {
+        if (fimc_v4l2_stream_on(mFd, V4L2_BUF_TYPE_SRC) < 0 ||
+            fimc_v4l2_stream_on(mFd, V4L2_BUF_TYPE_DST) < 0) {
+            ALOGE("%s::fimc_v4l2_stream_on() failed", __func__);
+            return false;
+        }
+        mFlagStreamOn = true;
+    }
+
+    mFlagAsync = true;
+    mQueueTail = (slot + 1) % mNumOfBuf;
+    mQueued++;
+    *index = slot;
+#else
+    /* the overlay interface has one destination, convert right away */
+    if (mDoneIndex != -1) {
+        ALOGE("%s::previous conversion not dequeued", __func__);
+        return false;
+    }
+
+    if (draw(0, 0) == false)
+        return false;
+
+    mDoneIndex = 0;
+    mQueued = 1;
+    *index = 0;
+#endif
+
+    return true;
+}
+
+bool SecFimc::dequeue(int *index, SecBuffer **dstBuf)
+{
+#ifdef DEBUG_LIB_FIMC
+    ALOGD("%s", __func__);
+#endif
+
+    if (mQueued == 0) {
+        ALOGE("%s::nothing queued", __func__);
+        return false;
+    }
+
+#ifdef BOARD_USE_V4L2
+    s5p_fimc_params_t *params = &(mS5pFimc.params);
+    int src_planes = m_getYuvPlanes(params->src.color_space);
+    int dst_planes = m_getYuvPlanes(params->dst.color_space);
+    int src_index;
+    src_planes = (src_planes == -1) ? 1 : src_planes;
+    dst_planes = (dst_planes == -1) ? 1 : dst_planes;
+
+    if (fimc_v4l2_dequeue(mFd, V4L2_BUF_TYPE_DST, V4L2_MEMORY_TYPE_DST, index, dst_planes) < 0) {
+        ALOGE("%s::fimc_v4l2_dequeue[dst] failed", __func__);
+        return false;
+    }
+
+    if (fimc_v4l2_dequeue(mFd, V4L2_BUF_TYPE_SRC, V4L2_MEMORY_TYPE_SRC, &src_index, src_planes) < 0) {
+        ALOGE("%s::fimc_v4l2_dequeue[src] failed", __func__);
+        return false;
+    }
+
+    mQueued--;
+
+    /* V4L2_MEMORY_TYPE_DST is MMAP, the result is in our own slot */
+    if (dstBuf != NULL)
+        *dstBuf = &mDstBuffer[*index];
+#else
+    *index = mDoneIndex;
+    mDoneIndex = -1;
+    mQueued = 0;
+
+    if (dstBuf != NULL)
+        *dstBuf = NULL;
+#endif
+
+    return true;
+}
+
+int SecFimc::getQueued(void)
+{
+    return mQueued;
+}
+
+bool SecFimc::m_streamOff()
+{
+    if (mFlagStreamOn == false)
+        return true;
+
+    if (fimc_v4l2_stream_off(mFd, V4L2_BUF_TYPE_SRC) < 0) {
+        ALOGE("%s::fimc_v4l2_stream_off() failed", __func__);
+        return false;
+    }
+#ifdef BOARD_USE_V4L2
+    if (fimc_v4l2_stream_off(mFd, V4L2_BUF_TYPE_DST) < 0) {
+        ALOGE("%s::fimc_v4l2_stream_off() failed", __func__);
+        return false;
+    }
+#endif
+
+    /* stream off returns every queued buffer */
+    mFlagStreamOn = false;
+    mFlagAsync = false;
+    mQueued = 0;
+    mQueueTail = 0;
+    mDoneIndex = -1;
+
+    return true;
+}
+
+#ifdef BOARD_USE_V4L2
+void SecFimc::m_setSrcPlaneSize(void)
+{
+    s5p_fimc_params_t *params = &(mS5pFimc.params);
+    unsigned int frame = params->src.full_height * params->src.full_width;
+
     if (params->src.color_space == V4L2_PIX_FMT_RGB32) {
-        mSrcBuffer.size.extS[0] = params->src.full_height * params->src.full_width * 4;
+        mSrcBuffer.size.extS[0] = frame * 4;
 
     } else if (   (params->src.color_space == V4L2_PIX_FMT_NV12MT)
                || (params->src.color_space == V4L2_PIX_FMT_NV12M)) {
-        mSrcBuffer.size.extS[0] = params->src.full_height * params->src.full_width;
-        mSrcBuffer.size.extS[1] = params->src.full_height * params->src.full_width / 2;
+        mSrcBuffer.size.extS[0] = frame;
+        mSrcBuffer.size.extS[1] = frame / 2;
     } else if (   (params->src.color_space == V4L2_PIX_FMT_YUV420)
                || (params->src.color_space == V4L2_PIX_FMT_YUV420M)) {
-        mSrcBuffer.size.extS[0] = params->src.full_height * params->src.full_width;
-        mSrcBuffer.size.extS[1] = params->src.full_height * params->src.full_width / 4;
-        mSrcBuffer.size.extS[2] = params->src.full_height * params->src.full_width / 4;
+        mSrcBuffer.size.extS[0] = frame;
+        mSrcBuffer.size.extS[1] = frame / 4;
+        mSrcBuffer.size.extS[2] = frame / 4;
     } else {
-        mSrcBuffer.size.extS[0] = params->src.full_height * params->src.full_width * 2;
+        mSrcBuffer.size.extS[0] = frame * 2;
     }
+}
+#endif
+
+bool SecFimc::m_streamOn()
+{
+#ifdef DEBUG_LIB_FIMC
+    ALOGD("%s", __func__);
+#endif
+
+#ifdef BOARD_USE_V4L2
+    s5p_fimc_params_t *params = &(mS5pFimc.params);
+    int src_planes = m_getYuvPlanes(params->src.color_space);
+    int dst_planes = m_getYuvPlanes(params->dst.color_space);
+    src_planes = (src_planes == -1) ? 1 : src_planes;
+    dst_planes = (dst_planes == -1) ? 1 : dst_planes;
+
+    m_setSrcPlaneSize();
 
     if (fimc_v4l2_queue(mFd, &(mSrcBuffer), V4L2_BUF_TYPE_SRC, V4L2_MEMORY_TYPE_SRC, 0, src_planes) < 0) {
         ALOGE("%s::fimc_v4l2_queue(index : %d) (mSrcBufNum : %d) failed", __func__, 0, 1);
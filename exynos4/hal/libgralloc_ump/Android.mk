@@ -34,6 +34,8 @@ LOCAL_C_INCLUDES += $(LOCAL_PATH)/../include
 LOCAL_SRC_FILES := \
 	gralloc_module.cpp \
 	alloc_device.cpp \
+	gralloc_buffer_pool.cpp \
+	gralloc_carveout.cpp \
 	framebuffer_device.cpp
 
 LOCAL_MODULE := gralloc.$(TARGET_BOARD_PLATFORM)
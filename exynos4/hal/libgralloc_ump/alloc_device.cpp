@@ -33,6 +33,7 @@
 
 #include <cutils/log.h>
 #include <cutils/atomic.h>
+#include <cutils/properties.h>
 #include <hardware/hardware.h>
 #include <hardware/gralloc.h>
 #include "sec_format.h"
@@ -40,6 +41,8 @@
 #include "gralloc_priv.h"
 #include "gralloc_helper.h"
 #include "framebuffer_device.h"
+#include "gralloc_buffer_pool.h"
+#include "gralloc_carveout.h"
 
 #include "ump.h"
 #include "ump_ref_drv.h"
@@ -55,6 +58,7 @@
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <time.h>
 #include <sys/ioctl.h>
 
 #if HAVE_ANDROID_OS
@@ -83,9 +87,25 @@ static int gMemfd = 0;
 
 bool ion_dev_open = true;
 static pthread_mutex_t l_surface= PTHREAD_MUTEX_INITIALIZER;
-static int buffer_offset = 0;
 static int gfd = 0;
 
+#ifdef INSIGNAL_FIMC1
+/* FIMC1 reserved memory, mapped once and protected by l_surface */
+static struct gralloc_carveout s_fimc1;
+static void *s_fimc1_base = NULL;
+static unsigned int s_fimc1_paddr = 0;
+#endif
+
+/* recently freed UMP/ION buffers, protected by l_surface */
+static struct gralloc_buffer_pool s_pool;
+static int s_pool_users = 0;
+
+/* releases idle pool buffers, sleeps while the pool is empty */
+static pthread_t s_trim_thread;
+static pthread_cond_t s_trim_cond = PTHREAD_COND_INITIALIZER;
+static bool s_trim_exit = false;
+static bool s_trim_running = false;
+
 #ifdef USE_PARTIAL_FLUSH
 extern struct private_handle_rect *rect_list;
 extern private_handle_rect *find_rect(int secure_id);
@@ -95,48 +115,199 @@ extern int release_rect(int secure_id);
 
 #define EXYNOS4_ALIGN( value, base ) (((value) + ((base) - 1)) & ~((base) - 1))
 
-static int gralloc_alloc_buffer(alloc_device_t* dev, size_t size, int usage,
-                                buffer_handle_t* pHandle, int w, int h,
-                                int format, int bpp, int stride_raw, int stride)
+/*
+ * UMP/ION backend of the buffer pool. Everything a handle needs is
+ * created here once (ION fd, mapping, UMP import and secure id) so a
+ * recycled buffer can be handed out again without touching the kernel.
+ */
+static int gralloc_heap_alloc(void *priv, int heap, size_t size,
+                              struct gralloc_pool_buffer *buf)
 {
+    private_module_t* m = reinterpret_cast<private_module_t*>(priv);
     ump_handle ump_mem_handle;
-    void *cpu_ptr;
     ump_secure_id ump_id;
+    ion_buffer ion_fd = 0;
+    void *cpu_ptr = NULL;
+
+    switch (heap) {
+    case GRALLOC_HEAP_ION:
+        ion_fd = ion_alloc(m->ion_client, size, 0, ION_HEAP_EXYNOS_MASK);
+        if (ion_fd < 0) {
+            ALOGE("Failed to ion_alloc");
+            return -1;
+        }
 
-    size = round_up_to_page_size(size);
-#ifdef INSIGNAL_FIMC1
-    if (usage & GRALLOC_USAGE_HW_FIMC1) {
-        int dev_fd=0;
-        char node[20];
-        int ret;
-        int paddr=0;
-        int offset=0;
+        cpu_ptr = ion_map(ion_fd, size, 0);
+        if (NULL == cpu_ptr) {
+            ALOGE("Failed to ion_map");
+            ion_free(ion_fd);
+            return -1;
+        }
 
-        struct v4l2_control     vc;
-        sprintf(node, "%s", PFX_NODE_FIMC1);
+        ump_mem_handle = ump_ref_drv_ion_import(ion_fd, UMP_REF_DRV_CONSTRAINT_NONE);
+        if (UMP_INVALID_MEMORY_HANDLE == ump_mem_handle) {
+            ALOGE("gralloc_alloc_buffer() failed to import ION memory");
+            ion_unmap(cpu_ptr, size);
+            ion_free(ion_fd);
+            return -1;
+        }
+        break;
+    case GRALLOC_HEAP_UMP_CACHED:
+        ump_mem_handle = ump_ref_drv_allocate(size, UMP_REF_DRV_CONSTRAINT_USE_CACHE);
+        break;
+    default:
+        ump_mem_handle = ump_ref_drv_allocate(size, UMP_REF_DRV_CONSTRAINT_NONE);
+        break;
+    }
 
-        if (gfd == 0) {
-            gfd = open(node, O_RDWR);
+    if (UMP_INVALID_MEMORY_HANDLE == ump_mem_handle) {
+        ALOGE("gralloc_alloc_buffer() failed to allcoate UMP memory");
+        return -1;
+    }
 
-            if (gfd < 0) {
-                ALOGE("%s:: %s Post processor open error\n", __func__, node);
-                return false;
-            }
+    if (heap != GRALLOC_HEAP_ION)
+        cpu_ptr = ump_mapped_pointer_get(ump_mem_handle);
+
+    if (NULL != cpu_ptr) {
+        ump_id = ump_secure_id_get(ump_mem_handle);
+        if (UMP_INVALID_SECURE_ID != ump_id) {
+            buf->heap = heap;
+            buf->size = size;
+            buf->cpu_ptr = cpu_ptr;
+            buf->ion_fd = ion_fd;
+            buf->ump_mem_handle = ump_mem_handle;
+            buf->ump_id = ump_id;
+            return 0;
         }
+        ALOGE("gralloc_alloc_buffer() failed to retrieve valid secure id");
 
-        vc.id = V4L2_CID_RESERVED_MEM_BASE_ADDR;
-        vc.value = 0;
-        ret = ioctl(gfd, VIDIOC_G_CTRL, &vc);
-        if (ret < 0) {
-            ALOGE("Error in video VIDIOC_G_CTRL - V4L2_CID_RESERVED_MEM_BAES_ADDR (%d)\n", ret);
-            return false;
+        ump_mapped_pointer_release(ump_mem_handle);
+    } else {
+        ALOGE("gralloc_alloc_buffer() failed to map UMP memory");
+    }
+
+    ump_reference_release(ump_mem_handle);
+    if (heap == GRALLOC_HEAP_ION) {
+        ion_unmap(cpu_ptr, size);
+        ion_free(ion_fd);
+    }
+    return -1;
+}
+
+static void gralloc_heap_free(void *priv, struct gralloc_pool_buffer *buf)
+{
+    ump_mapped_pointer_release((ump_handle)buf->ump_mem_handle);
+    ump_reference_release((ump_handle)buf->ump_mem_handle);
+
+    if (buf->heap == GRALLOC_HEAP_ION) {
+        ion_unmap(buf->cpu_ptr, buf->size);
+        ion_free(buf->ion_fd);
+    }
+}
+
+/* write back CPU caches after scrubbing a recycled buffer */
+static void gralloc_heap_clean(void *priv, struct gralloc_pool_buffer *buf)
+{
+    private_module_t* m = reinterpret_cast<private_module_t*>(priv);
+
+    if (buf->heap == GRALLOC_HEAP_ION)
+        ion_msync(m->ion_client, buf->ion_fd, IMSYNC_DEV_TO_RW | IMSYNC_SYNC_FOR_DEV, buf->size, 0);
+#ifdef SAMSUNG_EXYNOS_CACHE_UMP
+    else if (buf->heap == GRALLOC_HEAP_UMP_CACHED)
+        ump_cpu_msync_now((ump_handle)buf->ump_mem_handle, UMP_MSYNC_CLEAN_AND_INVALIDATE, NULL, 0);
+#endif
+}
+
+#ifdef INSIGNAL_FIMC1
+/*
+ * Query the FIMC1 reserved region and map it once, buffers are handed
+ * out as sub ranges of this single mapping. Called with l_surface held.
+ */
+static int gralloc_fimc1_carveout_init(void)
+{
+    struct v4l2_control vc;
+    size_t size = FIMC1_RESERVED_SIZE * 1024;
+
+    if (s_fimc1_base != NULL)
+        return 0;
+
+    if (gfd == 0) {
+        gfd = open(PFX_NODE_FIMC1, O_RDWR);
+        if (gfd < 0) {
+            ALOGE("%s:: %s Post processor open error\n", __func__, PFX_NODE_FIMC1);
+            gfd = 0;
+            return -1;
+        }
+    }
+
+    vc.id = V4L2_CID_RESERVED_MEM_BASE_ADDR;
+    vc.value = 0;
+    if (ioctl(gfd, VIDIOC_G_CTRL, &vc) < 0) {
+        ALOGE("Error in video VIDIOC_G_CTRL - V4L2_CID_RESERVED_MEM_BAES_ADDR\n");
+        return -1;
+    }
+    s_fimc1_paddr = (unsigned int)vc.value;
+
+    if (gMemfd == 0) {
+        gMemfd = open(PFX_NODE_MEM, O_RDWR);
+        if (gMemfd < 0) {
+            ALOGE("%s:: %s exynos-mem open error\n", __func__, PFX_NODE_MEM);
+            gMemfd = 0;
+            return -1;
         }
-        paddr = (unsigned int)vc.value;
+    }
+
+    void *mappedAddress = mmap(0, size, PROT_READ|PROT_WRITE, MAP_SHARED, gMemfd, s_fimc1_paddr);
+    if (mappedAddress == MAP_FAILED) {
+        ALOGE("%s:: could not map FIMC1 reserved memory (%s)", __func__, strerror(errno));
+        return -1;
+    }
 
-        if ((buffer_offset + size) >= FIMC1_RESERVED_SIZE * 1024)
-            buffer_offset = 0;
+    if (gralloc_carveout_init(&s_fimc1, size, PAGE_SIZE) < 0) {
+        munmap(mappedAddress, size);
+        return -1;
+    }
+
+    s_fimc1_base = mappedAddress;
+    return 0;
+}
+
+static void gralloc_fimc1_carveout_deinit(void)
+{
+    if (s_fimc1_base == NULL)
+        return;
+
+    munmap(s_fimc1_base, FIMC1_RESERVED_SIZE * 1024);
+    gralloc_carveout_destroy(&s_fimc1);
+    s_fimc1_base = NULL;
+
+    if (0 < gMemfd) {
+        close(gMemfd);
+        gMemfd = 0;
+    }
+}
+#endif
+
+static int gralloc_alloc_buffer(alloc_device_t* dev, size_t size, int usage,
+                                buffer_handle_t* pHandle, int w, int h,
+                                int format, int bpp, int stride_raw, int stride)
+{
+    size = round_up_to_page_size(size);
+#ifdef INSIGNAL_FIMC1
+    if (usage & GRALLOC_USAGE_HW_FIMC1) {
+        size_t offset;
+
+        if (gralloc_fimc1_carveout_init() < 0)
+            return -1;
+
+        if (gralloc_carveout_alloc(&s_fimc1, size, &offset) < 0) {
+            struct gralloc_carveout_stats stats;
+            gralloc_carveout_get_stats(&s_fimc1, &stats);
+            ALOGE("%s:: FIMC1 reserved memory exhausted (req %d, free %d, largest %d, frag %d%%)",
+                    __func__, size, stats.free_bytes, stats.largest_free, stats.fragmentation);
+            return -ENOMEM;
+        }
 
-        paddr += buffer_offset;
         private_handle_t* hnd = new private_handle_t(private_handle_t::PRIV_FLAGS_USES_IOCTL, size, 0,
                 private_handle_t::LOCK_STATE_MAPPED, 0, 0);
 
@@ -146,32 +317,19 @@ static int gralloc_alloc_buffer(alloc_device_t* dev, size_t size, int usage,
         hnd->width = w;
         hnd->height = h;
         hnd->bpp = bpp;
-        hnd->paddr = paddr;
-        hnd->offset = buffer_offset;
+        hnd->paddr = s_fimc1_paddr + offset;
+        hnd->offset = offset;
         hnd->stride = stride;
         hnd->fd = gfd;
         hnd->uoffset = (EXYNOS4_ALIGN((EXYNOS4_ALIGN(hnd->width, 16) * EXYNOS4_ALIGN(hnd->height, 16)), 4096));
         hnd->voffset = (EXYNOS4_ALIGN((EXYNOS4_ALIGN((hnd->width >> 1), 16) * EXYNOS4_ALIGN((hnd->height >> 1), 16)), 4096));
-        buffer_offset += size;
-
-        if (gMemfd == 0) {
-            gMemfd = open(PFX_NODE_MEM, O_RDWR);
-            if (gMemfd < 0) {
-                ALOGE("%s:: %s exynos-mem open error\n", __func__, PFX_NODE_MEM);
-                return false;
-            }
-        }
-
-        size_t size = FIMC1_RESERVED_SIZE * 1024;
-
-        void *mappedAddress = mmap(0, size,
-               PROT_READ|PROT_WRITE, MAP_SHARED, gMemfd, (hnd->paddr - hnd->offset));
-        hnd->base = intptr_t(mappedAddress) + hnd->offset;
+        hnd->base = intptr_t(s_fimc1_base) + hnd->offset;
         return 0;
     } else {
 #endif
-        ion_buffer ion_fd = 0;
-        unsigned int ion_flags = 0;
+        struct gralloc_pool_buffer buf;
+        int heap;
+        int reused = 0;
         int priv_alloc_flag = private_handle_t::PRIV_FLAGS_USES_UMP;
 
 #ifdef  INSIGNAL_FIMC1
@@ -183,96 +341,71 @@ static int gralloc_alloc_buffer(alloc_device_t* dev, size_t size, int usage,
                 ALOGE("ERROR, failed to open ion");
                 return -1;
             }
+            heap = GRALLOC_HEAP_ION;
+            priv_alloc_flag = private_handle_t::PRIV_FLAGS_USES_ION;
+        }
+#ifdef SAMSUNG_EXYNOS_CACHE_UMP
+        else if ((usage&GRALLOC_USAGE_SW_READ_MASK) == GRALLOC_USAGE_SW_READ_OFTEN)
+            heap = GRALLOC_HEAP_UMP_CACHED;
+#endif
+        else
+            heap = GRALLOC_HEAP_UMP;
 
-            private_module_t* m = reinterpret_cast<private_module_t*>(dev->common.module);
-            ion_flags = ION_HEAP_EXYNOS_MASK;
-            ion_fd = ion_alloc(m->ion_client, size, 0, ion_flags);
-
-            if (ion_fd < 0) {
-                ALOGE("Failed to ion_alloc");
-                return -1;
-            }
-
-            cpu_ptr = ion_map(ion_fd, size, 0);
-
-            if (NULL == cpu_ptr) {
-                ALOGE("Failed to ion_map");
-                ion_free(ion_fd);
+        if (usage & GRALLOC_USAGE_PROTECTED) {
+            /* never hand out recycled memory for protected content */
+            buf.heap = heap;
+            if (gralloc_heap_alloc(dev->common.module, heap, size, &buf) < 0)
                 return -1;
-            }
+        } else if (gralloc_pool_alloc(&s_pool, heap, size, &buf, &reused) < 0) {
+            return -1;
+        }
 
-            ump_mem_handle = ump_ref_drv_ion_import(ion_fd, UMP_REF_DRV_CONSTRAINT_NONE);
+        /*
+         * Fresh heap memory comes zeroed from the kernel. A recycled buffer
+         * still holds the previous client's pixels, and the GPU, composer
+         * or HDMI may read it without ever locking it, so always scrub it.
+         */
+        if (reused) {
+            memset(buf.cpu_ptr, 0, buf.size);
+            gralloc_heap_clean(dev->common.module, &buf);
+        }
 
-            if (UMP_INVALID_MEMORY_HANDLE != ump_mem_handle) {
-                priv_alloc_flag = private_handle_t::PRIV_FLAGS_USES_ION;
-            } else {
-                ALOGE("gralloc_alloc_buffer() failed to import ION memory");
-                ion_unmap(cpu_ptr, size);
-                ion_free(ion_fd);
-                return -1;
-            }
+        private_handle_t* hnd;
+        hnd = new private_handle_t(priv_alloc_flag, buf.size, (int)buf.cpu_ptr,
+                private_handle_t::LOCK_STATE_MAPPED, buf.ump_id,
+                (ump_handle)buf.ump_mem_handle, buf.ion_fd, 0, 0);
+        if (NULL == hnd) {
+            ALOGE("gralloc_alloc_buffer() failed to allocate handle");
+            gralloc_pool_free(&s_pool, &buf);
+            return -1;
         }
-#ifdef SAMSUNG_EXYNOS_CACHE_UMP
-        else if ((usage&GRALLOC_USAGE_SW_READ_MASK) == GRALLOC_USAGE_SW_READ_OFTEN)
-            ump_mem_handle = ump_ref_drv_allocate(size, UMP_REF_DRV_CONSTRAINT_USE_CACHE);
-        else
-            ump_mem_handle = ump_ref_drv_allocate(size, UMP_REF_DRV_CONSTRAINT_NONE);
-#else
-        else
-            ump_mem_handle = ump_ref_drv_allocate(size, UMP_REF_DRV_CONSTRAINT_NONE);
-#endif
-        if (UMP_INVALID_MEMORY_HANDLE != ump_mem_handle) {
-            if (!(usage & GRALLOC_USAGE_HW_ION || usage & GRALLOC_USAGE_HW_FIMC1))
-                cpu_ptr = ump_mapped_pointer_get(ump_mem_handle);
-            if (NULL != cpu_ptr) {
-                ump_id = ump_secure_id_get(ump_mem_handle);
-                if (UMP_INVALID_SECURE_ID != ump_id) {
-                    private_handle_t* hnd;
-                    hnd = new private_handle_t(priv_alloc_flag, size, (int)cpu_ptr,
-                    private_handle_t::LOCK_STATE_MAPPED, ump_id, ump_mem_handle, ion_fd, 0, 0);
-                    if (NULL != hnd) {
-                        *pHandle = hnd;
+
+        *pHandle = hnd;
 #ifdef USE_PARTIAL_FLUSH
-                        if (hnd->flags & private_handle_t::PRIV_FLAGS_USES_UMP) {
-                            private_handle_rect *psRect;
-                            private_handle_rect *psFRect;
-                            psRect = (private_handle_rect *)calloc(1, sizeof(private_handle_rect));
-                            psRect->handle = (int)hnd->ump_id;
-                            psRect->stride = stride_raw;
-                            psFRect = find_last_rect((int)hnd->ump_id);
-                            psFRect->next = psRect;
-                        }
+        if (hnd->flags & private_handle_t::PRIV_FLAGS_USES_UMP) {
+            private_handle_rect *psRect;
+            private_handle_rect *psFRect;
+            psRect = (private_handle_rect *)calloc(1, sizeof(private_handle_rect));
+            psRect->handle = (int)hnd->ump_id;
+            psRect->stride = stride_raw;
+            psFRect = find_last_rect((int)hnd->ump_id);
+            psFRect->next = psRect;
+        }
 #endif
-                        hnd->format = format;
-                        hnd->usage = usage;
-                        hnd->width = w;
-                        hnd->height = h;
-                        hnd->bpp = bpp;
-                        hnd->stride = stride;
-                        if(hnd->format == HAL_PIXEL_FORMAT_YV12) {
-                            hnd->uoffset = ((EXYNOS4_ALIGN(hnd->width, 16) * hnd->height));
-                            hnd->voffset = ((EXYNOS4_ALIGN((hnd->width >> 1), 16) * (hnd->height >> 1)));
-                        } else {
-                            hnd->uoffset = ((EXYNOS4_ALIGN(hnd->width, 16) * EXYNOS4_ALIGN(hnd->height, 16)));
-                            hnd->voffset = ((EXYNOS4_ALIGN((hnd->width >> 1), 16) * EXYNOS4_ALIGN((hnd->height >> 1), 16)));
-                        }
-                        return 0;
-                    } else {
-                        ALOGE("gralloc_alloc_buffer() failed to allocate handle");
-                    }
-                } else {
-                    ALOGE("gralloc_alloc_buffer() failed to retrieve valid secure id");
-                }
-
-                ump_mapped_pointer_release(ump_mem_handle);
-            } else {
-                ALOGE("gralloc_alloc_buffer() failed to map UMP memory");
-            }
-
-            ump_reference_release(ump_mem_handle);
+        hnd->format = format;
+        hnd->usage = usage;
+        hnd->width = w;
+        hnd->height = h;
+        hnd->bpp = bpp;
+        hnd->stride = stride;
+        if(hnd->format == HAL_PIXEL_FORMAT_YV12) {
+            hnd->uoffset = ((EXYNOS4_ALIGN(hnd->width, 16) * hnd->height));
+            hnd->voffset = ((EXYNOS4_ALIGN((hnd->width >> 1), 16) * (hnd->height >> 1)));
         } else {
-            ALOGE("gralloc_alloc_buffer() failed to allcoate UMP memory");
+            hnd->uoffset = ((EXYNOS4_ALIGN(hnd->width, 16) * EXYNOS4_ALIGN(hnd->height, 16)));
+            hnd->voffset = ((EXYNOS4_ALIGN((hnd->width >> 1), 16) * EXYNOS4_ALIGN((hnd->height >> 1), 16)));
         }
+        return 0;
 #ifdef INSIGNAL_FIMC1
     }
 #endif
@@ -459,31 +592,38 @@ static int alloc_device_free(alloc_device_t* dev, buffer_handle_t handle)
         m->bufferMask &= ~(1<<index);
         close(hnd->fd);
     } else if (hnd->flags & private_handle_t::PRIV_FLAGS_USES_IOCTL) {
-        void* base = (void*)(intptr_t(hnd->base) - hnd->offset);
-        size_t size = FIMC1_RESERVED_SIZE * 1024;
-        if (munmap(base, size) < 0)
-            ALOGE("Could not unmap %s", strerror(errno));
-        if (0 < gMemfd) {
-            close(gMemfd);
-            gMemfd = 0;
-        }
-    } else if (hnd->flags & private_handle_t::PRIV_FLAGS_USES_UMP) {
-#ifdef USE_PARTIAL_FLUSH
-        if (!release_rect((int)hnd->ump_id))
-            ALOGE("secure id: 0x%x, release error",(int)hnd->ump_id);
+#ifdef INSIGNAL_FIMC1
+        if (gralloc_carveout_free(&s_fimc1, hnd->offset) < 0)
+            ALOGE("FIMC1 buffer at offset 0x%x was not allocated", hnd->offset);
 #endif
-        ump_mapped_pointer_release((ump_handle)hnd->ump_mem_handle);
-        ump_reference_release((ump_handle)hnd->ump_mem_handle);
-    } else if (hnd->flags & private_handle_t::PRIV_FLAGS_USES_ION) {
+    } else if (hnd->flags & (private_handle_t::PRIV_FLAGS_USES_UMP |
+                             private_handle_t::PRIV_FLAGS_USES_ION)) {
+        struct gralloc_pool_buffer buf;
+
 #ifdef USE_PARTIAL_FLUSH
         if (!release_rect((int)hnd->ump_id))
             ALOGE("secure id: 0x%x, release error",(int)hnd->ump_id);
 #endif
-        ump_mapped_pointer_release((ump_handle)hnd->ump_mem_handle);
-        ump_reference_release((ump_handle)hnd->ump_mem_handle);
+        buf.size = hnd->size;
+        buf.cpu_ptr = (void*)hnd->base;
+        buf.ion_fd = hnd->fd;
+        buf.ump_mem_handle = (void*)hnd->ump_mem_handle;
+        buf.ump_id = hnd->ump_id;
+        if (hnd->flags & private_handle_t::PRIV_FLAGS_USES_ION)
+            buf.heap = GRALLOC_HEAP_ION;
+#ifdef SAMSUNG_EXYNOS_CACHE_UMP
+        else if ((hnd->usage & GRALLOC_USAGE_SW_READ_MASK) == GRALLOC_USAGE_SW_READ_OFTEN)
+            buf.heap = GRALLOC_HEAP_UMP_CACHED;
+#endif
+        else
+            buf.heap = GRALLOC_HEAP_UMP;
 
-        ion_unmap((void*)hnd->base, hnd->size);
-        ion_free(hnd->fd);
+        if (hnd->usage & GRALLOC_USAGE_PROTECTED) {
+            gralloc_heap_free(m, &buf);
+        } else {
+            gralloc_pool_free(&s_pool, &buf);
+            pthread_cond_signal(&s_trim_cond);
+        }
     }
     pthread_mutex_unlock(&l_surface);
     delete hnd;
@@ -491,11 +631,62 @@ static int alloc_device_free(alloc_device_t* dev, buffer_handle_t handle)
     return 0;
 }
 
+static void *gralloc_pool_trim_thread(void *arg)
+{
+    pthread_mutex_lock(&l_surface);
+    while (!s_trim_exit) {
+        int64_t wait_ns = gralloc_pool_next_trim_ns(&s_pool);
+
+        if (wait_ns < 0) {
+            pthread_cond_wait(&s_trim_cond, &l_surface);
+        } else if (wait_ns > 0) {
+            struct timespec ts;
+
+            clock_gettime(CLOCK_REALTIME, &ts);
+            wait_ns += ts.tv_nsec;
+            ts.tv_sec += wait_ns / 1000000000LL;
+            ts.tv_nsec = wait_ns % 1000000000LL;
+            pthread_cond_timedwait(&s_trim_cond, &l_surface, &ts);
+        } else {
+            gralloc_pool_trim(&s_pool);
+        }
+    }
+    pthread_mutex_unlock(&l_surface);
+
+    return NULL;
+}
+
 static int alloc_device_close(struct hw_device_t *device)
 {
     alloc_device_t* dev = reinterpret_cast<alloc_device_t*>(device);
     if (dev) {
         private_module_t* m = reinterpret_cast<private_module_t*>(dev->common.module);
+        bool last;
+
+        pthread_mutex_lock(&l_surface);
+        last = (--s_pool_users == 0);
+        if (last) {
+            s_trim_exit = true;
+            pthread_cond_signal(&s_trim_cond);
+        }
+        pthread_mutex_unlock(&l_surface);
+
+        if (last && s_trim_running)
+            pthread_join(s_trim_thread, NULL);
+
+        pthread_mutex_lock(&l_surface);
+        /*
+         * the pool and the FIMC1 carveout are shared by every open device,
+         * the last close drops them
+         */
+        if (last) {
+            gralloc_pool_destroy(&s_pool);
+            s_trim_running = false;
+#ifdef INSIGNAL_FIMC1
+            gralloc_fimc1_carveout_deinit();
+#endif
+        }
+        pthread_mutex_unlock(&l_surface);
         if (ion_dev_open)
             ion_client_destroy(m->ion_client);
         delete dev;
@@ -535,6 +726,34 @@ int alloc_device_open(hw_module_t const* module, const char* name, hw_device_t**
     dev->alloc = alloc_device_alloc;
     dev->free = alloc_device_free;
 
+    struct gralloc_heap_ops ops;
+    char value[PROP_VALUE_MAX];
+    size_t pool_cap;
+    int pool_idle_ms;
+
+    ops.alloc = gralloc_heap_alloc;
+    ops.free = gralloc_heap_free;
+    ops.priv = m;
+
+    property_get("debug.gralloc.pool_kb", value, "16384");
+    pool_cap = (size_t)atoi(value) * 1024;
+    property_get("debug.gralloc.pool_idle_ms", value, "2000");
+    pool_idle_ms = atoi(value);
+
+    pthread_mutex_lock(&l_surface);
+    if (s_pool_users++ == 0) {
+        gralloc_pool_init(&s_pool, &ops, pool_cap, pool_idle_ms);
+        s_trim_exit = false;
+        if (pthread_create(&s_trim_thread, NULL, gralloc_pool_trim_thread, NULL) == 0) {
+            s_trim_running = true;
+        } else {
+            /* without the trim thread idle buffers would never be released */
+            ALOGE("%s: failed to start the pool trim thread, recycling disabled", __func__);
+            gralloc_pool_init(&s_pool, &ops, 0, pool_idle_ms);
+        }
+    }
+    pthread_mutex_unlock(&l_surface);
+
     *device = &dev->common;
 
     return 0;
@@ -0,0 +1,217 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "gralloc_buffer_pool.h"
+
+#define POOL_PAGE_SHIFT     12
+
+static int64_t pool_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* size classes are powers of two in pages: [4K, 8K), [8K, 16K), ... */
+static int pool_bucket(size_t size)
+{
+    size_t pages = size >> POOL_PAGE_SHIFT;
+    int idx = 0;
+
+    while (pages > 1 && idx < GRALLOC_POOL_NUM_BUCKETS - 1) {
+        pages >>= 1;
+        idx++;
+    }
+    return idx;
+}
+
+static void pool_release_entry(struct gralloc_buffer_pool *pool,
+                               struct gralloc_pool_entry *entry)
+{
+    pool->stats.cached_bytes -= entry->buf.size;
+    pool->stats.evictions++;
+    pool->ops.free(pool->ops.priv, &entry->buf);
+    free(entry);
+}
+
+/* drop the least recently freed entry, lists are kept newest first */
+static int pool_evict_oldest(struct gralloc_buffer_pool *pool)
+{
+    struct gralloc_pool_entry **oldest = NULL;
+
+    for (int i = 0; i < GRALLOC_POOL_NUM_BUCKETS; i++) {
+        struct gralloc_pool_entry **pp = &pool->bucket[i];
+
+        if (*pp == NULL)
+            continue;
+        while ((*pp)->next)
+            pp = &(*pp)->next;
+        if (oldest == NULL || (*pp)->freed_ns < (*oldest)->freed_ns)
+            oldest = pp;
+    }
+
+    if (oldest == NULL)
+        return -1;
+
+    struct gralloc_pool_entry *entry = *oldest;
+    *oldest = NULL;
+    pool_release_entry(pool, entry);
+    return 0;
+}
+
+void gralloc_pool_init(struct gralloc_buffer_pool *pool,
+                       const struct gralloc_heap_ops *ops,
+                       size_t cap, int idle_ms)
+{
+    memset(pool, 0, sizeof(*pool));
+    pool->ops = *ops;
+    pool->cap = cap;
+    pool->idle_ns = (int64_t)idle_ms * 1000000LL;
+}
+
+void gralloc_pool_trim(struct gralloc_buffer_pool *pool)
+{
+    int64_t now = pool_now_ns();
+
+    for (int i = 0; i < GRALLOC_POOL_NUM_BUCKETS; i++) {
+        struct gralloc_pool_entry **pp = &pool->bucket[i];
+
+        /* everything behind the first expired entry is older still */
+        while (*pp && (now - (*pp)->freed_ns) < pool->idle_ns)
+            pp = &(*pp)->next;
+
+        while (*pp) {
+            struct gralloc_pool_entry *entry = *pp;
+            *pp = entry->next;
+            pool_release_entry(pool, entry);
+        }
+    }
+}
+
+int64_t gralloc_pool_next_trim_ns(struct gralloc_buffer_pool *pool)
+{
+    int64_t now = pool_now_ns();
+    int64_t next = -1;
+
+    for (int i = 0; i < GRALLOC_POOL_NUM_BUCKETS; i++) {
+        struct gralloc_pool_entry *entry = pool->bucket[i];
+
+        if (entry == NULL)
+            continue;
+        /* the last entry of a list is the oldest one */
+        while (entry->next)
+            entry = entry->next;
+
+        int64_t left = entry->freed_ns + pool->idle_ns - now;
+        if (left < 0)
+            left = 0;
+        if (next < 0 || left < next)
+            next = left;
+    }
+    return next;
+}
+
+int gralloc_pool_alloc(struct gralloc_buffer_pool *pool, int heap, size_t size,
+                       struct gralloc_pool_buffer *buf, int *reused)
+{
+    struct gralloc_pool_entry **best = NULL;
+    int idx = pool_bucket(size);
+
+    /*
+     * A recycled buffer may be up to 25% larger than requested, which can
+     * spill into the next size class.
+     */
+    for (int i = idx; i <= idx + 1 && i < GRALLOC_POOL_NUM_BUCKETS; i++) {
+        for (struct gralloc_pool_entry **pp = &pool->bucket[i]; *pp; pp = &(*pp)->next) {
+            struct gralloc_pool_entry *entry = *pp;
+
+            if (entry->buf.heap != heap || entry->buf.size < size ||
+                entry->buf.size > size + (size >> 2))
+                continue;
+            if (best == NULL || entry->buf.size < (*best)->buf.size)
+                best = pp;
+        }
+    }
+
+    if (best) {
+        struct gralloc_pool_entry *entry = *best;
+
+        *best = entry->next;
+        *buf = entry->buf;
+        free(entry);
+
+        pool->stats.cached_bytes -= buf->size;
+        pool->stats.hits++;
+        *reused = 1;
+    } else {
+        buf->heap = heap;
+        if (pool->ops.alloc(pool->ops.priv, heap, size, buf) < 0)
+            return -1;
+
+        pool->stats.misses++;
+        *reused = 0;
+    }
+
+    pool->stats.live_bytes += buf->size;
+    if (pool->stats.live_bytes + pool->stats.cached_bytes > pool->stats.peak_bytes)
+        pool->stats.peak_bytes = pool->stats.live_bytes + pool->stats.cached_bytes;
+
+    return 0;
+}
+
+void gralloc_pool_free(struct gralloc_buffer_pool *pool,
+                       struct gralloc_pool_buffer *buf)
+{
+    struct gralloc_pool_entry *entry = NULL;
+
+    pool->stats.live_bytes -= buf->size;
+
+    if (buf->size <= pool->cap)
+        entry = (struct gralloc_pool_entry *)malloc(sizeof(*entry));
+
+    if (entry == NULL) {
+        pool->ops.free(pool->ops.priv, buf);
+        return;
+    }
+
+    while (pool->stats.cached_bytes + buf->size > pool->cap)
+        if (pool_evict_oldest(pool) < 0)
+            break;
+
+    int idx = pool_bucket(buf->size);
+
+    entry->buf = *buf;
+    entry->freed_ns = pool_now_ns();
+    entry->next = pool->bucket[idx];
+    pool->bucket[idx] = entry;
+    pool->stats.cached_bytes += buf->size;
+}
+
+void gralloc_pool_destroy(struct gralloc_buffer_pool *pool)
+{
+    for (int i = 0; i < GRALLOC_POOL_NUM_BUCKETS; i++) {
+        while (pool->bucket[i]) {
+            struct gralloc_pool_entry *entry = pool->bucket[i];
+            pool->bucket[i] = entry->next;
+            pool_release_entry(pool, entry);
+        }
+    }
+}
@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GRALLOC_BUFFER_POOL_H_
+#define GRALLOC_BUFFER_POOL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Size-class pool of recently freed gralloc buffers.
+ *
+ * The pool does not know how memory is obtained: it only talks to the
+ * backing heap through gralloc_heap_ops, so alloc_device.cpp plugs in
+ * UMP/ION while anything else (e.g. a malloc backed heap) can drive the
+ * same code. The pool is not thread safe, callers serialize access.
+ */
+
+#define GRALLOC_POOL_NUM_BUCKETS    16
+
+/* backing heap of a buffer, buffers are only recycled within one heap */
+enum {
+    GRALLOC_HEAP_UMP = 0,
+    GRALLOC_HEAP_UMP_CACHED,
+    GRALLOC_HEAP_ION,
+};
+
+struct gralloc_pool_buffer {
+    int             heap;
+    size_t          size;
+    void           *cpu_ptr;
+    int             ion_fd;
+    void           *ump_mem_handle;
+    unsigned int    ump_id;
+};
+
+struct gralloc_heap_ops {
+    int  (*alloc)(void *priv, int heap, size_t size, struct gralloc_pool_buffer *buf);
+    void (*free)(void *priv, struct gralloc_pool_buffer *buf);
+    void *priv;
+};
+
+struct gralloc_pool_entry {
+    struct gralloc_pool_buffer  buf;
+    int64_t                     freed_ns;
+    struct gralloc_pool_entry  *next;
+};
+
+struct gralloc_pool_stats {
+    unsigned int    hits;
+    unsigned int    misses;
+    unsigned int    evictions;
+    size_t          cached_bytes;
+    size_t          live_bytes;
+    size_t          peak_bytes;
+};
+
+struct gralloc_buffer_pool {
+    struct gralloc_heap_ops     ops;
+    struct gralloc_pool_entry  *bucket[GRALLOC_POOL_NUM_BUCKETS];
+    size_t                      cap;
+    int64_t                     idle_ns;
+    struct gralloc_pool_stats   stats;
+};
+
+/* cap == 0 disables recycling, buffers then go straight back to the heap */
+void gralloc_pool_init(struct gralloc_buffer_pool *pool,
+                       const struct gralloc_heap_ops *ops,
+                       size_t cap, int idle_ms);
+
+/* returns 0 on success, *reused tells whether buf held previous contents */
+int  gralloc_pool_alloc(struct gralloc_buffer_pool *pool, int heap, size_t size,
+                        struct gralloc_pool_buffer *buf, int *reused);
+
+void gralloc_pool_free(struct gralloc_buffer_pool *pool,
+                       struct gralloc_pool_buffer *buf);
+
+/*
+ * release every cached buffer that has been idle longer than the timeout,
+ * alloc and free never do, the owner runs it when next_trim_ns says so
+ */
+void gralloc_pool_trim(struct gralloc_buffer_pool *pool);
+
+/* ns until the oldest cached buffer expires, -1 if nothing is cached */
+int64_t gralloc_pool_next_trim_ns(struct gralloc_buffer_pool *pool);
+
+void gralloc_pool_destroy(struct gralloc_buffer_pool *pool);
+
+#endif /* GRALLOC_BUFFER_POOL_H_ */
@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "gralloc_carveout.h"
+
+static struct gralloc_carveout_range *range_new(size_t offset, size_t size)
+{
+    struct gralloc_carveout_range *r =
+        (struct gralloc_carveout_range *)malloc(sizeof(*r));
+
+    if (r) {
+        r->offset = offset;
+        r->size = size;
+        r->next = NULL;
+    }
+    return r;
+}
+
+static void range_list_free(struct gralloc_carveout_range *r)
+{
+    while (r) {
+        struct gralloc_carveout_range *next = r->next;
+        free(r);
+        r = next;
+    }
+}
+
+/* link r into list keeping it sorted by offset */
+static void range_insert(struct gralloc_carveout_range **list,
+                         struct gralloc_carveout_range *r)
+{
+    while (*list && (*list)->offset < r->offset)
+        list = &(*list)->next;
+    r->next = *list;
+    *list = r;
+}
+
+int gralloc_carveout_init(struct gralloc_carveout *co, size_t size, size_t align)
+{
+    memset(co, 0, sizeof(*co));
+    co->size = size;
+    co->align = align;
+    co->free_list = range_new(0, size);
+
+    return co->free_list ? 0 : -1;
+}
+
+void gralloc_carveout_destroy(struct gralloc_carveout *co)
+{
+    range_list_free(co->free_list);
+    range_list_free(co->live_list);
+    memset(co, 0, sizeof(*co));
+}
+
+int gralloc_carveout_alloc(struct gralloc_carveout *co, size_t size, size_t *offset)
+{
+    struct gralloc_carveout_range **pp;
+    struct gralloc_carveout_range *live;
+
+    size = (size + co->align - 1) & ~(co->align - 1);
+    if (size == 0)
+        return -1;
+
+    for (pp = &co->free_list; *pp; pp = &(*pp)->next)
+        if ((*pp)->size >= size)
+            break;
+
+    if (*pp == NULL) {
+        co->failures++;
+        return -1;
+    }
+
+    struct gralloc_carveout_range *hole = *pp;
+
+    if (hole->size == size) {
+        /* exact fit, the free range becomes the live one */
+        *pp = hole->next;
+        live = hole;
+    } else {
+        live = range_new(hole->offset, size);
+        if (live == NULL) {
+            co->failures++;
+            return -1;
+        }
+        hole->offset += size;
+        hole->size -= size;
+    }
+
+    range_insert(&co->live_list, live);
+    co->live_bytes += size;
+    if (co->live_bytes > co->peak_bytes)
+        co->peak_bytes = co->live_bytes;
+
+    *offset = live->offset;
+    return 0;
+}
+
+int gralloc_carveout_free(struct gralloc_carveout *co, size_t offset)
+{
+    struct gralloc_carveout_range **pp;
+    struct gralloc_carveout_range *r;
+    struct gralloc_carveout_range *prev = NULL;
+
+    for (pp = &co->live_list; *pp; pp = &(*pp)->next)
+        if ((*pp)->offset == offset)
+            break;
+
+    if (*pp == NULL)
+        return -1;
+
+    r = *pp;
+    *pp = r->next;
+    co->live_bytes -= r->size;
+
+    /* find the free neighbours and merge with them */
+    for (pp = &co->free_list; *pp && (*pp)->offset < r->offset; pp = &(*pp)->next)
+        prev = *pp;
+
+    struct gralloc_carveout_range *next = *pp;
+
+    if (next && r->offset + r->size == next->offset) {
+        r->size += next->size;
+        r->next = next->next;
+        free(next);
+    } else {
+        r->next = next;
+    }
+
+    if (prev && prev->offset + prev->size == r->offset) {
+        prev->size += r->size;
+        prev->next = r->next;
+        free(r);
+    } else {
+        *pp = r;
+    }
+
+    return 0;
+}
+
+void gralloc_carveout_get_stats(struct gralloc_carveout *co,
+                                struct gralloc_carveout_stats *stats)
+{
+    struct gralloc_carveout_range *r;
+
+    memset(stats, 0, sizeof(*stats));
+    stats->total_bytes = co->size;
+    stats->live_bytes = co->live_bytes;
+    stats->peak_bytes = co->peak_bytes;
+    stats->failures = co->failures;
+
+    for (r = co->live_list; r; r = r->next)
+        stats->live_ranges++;
+
+    for (r = co->free_list; r; r = r->next) {
+        stats->free_ranges++;
+        stats->free_bytes += r->size;
+        if (r->size > stats->largest_free)
+            stats->largest_free = r->size;
+    }
+
+    if (stats->free_bytes)
+        stats->fragmentation = 100 -
+            (unsigned int)((unsigned long long)stats->largest_free * 100 / stats->free_bytes);
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GRALLOC_CARVEOUT_H_
+#define GRALLOC_CARVEOUT_H_
+
+#include <stddef.h>
+
+/*
+ * Range allocator for the FIMC1 reserved memory.
+ *
+ * The carveout only ever holds a handful of buffers, so free and live
+ * ranges are kept in plain lists sorted by offset. Allocation is first
+ * fit, freeing coalesces with both neighbours. The allocator only deals
+ * in offsets, mapping the region is left to the caller.
+ */
+
+struct gralloc_carveout_range {
+    size_t                          offset;
+    size_t                          size;
+    struct gralloc_carveout_range  *next;
+};
+
+struct gralloc_carveout_stats {
+    size_t          total_bytes;
+    size_t          live_bytes;
+    size_t          peak_bytes;
+    size_t          free_bytes;
+    size_t          largest_free;
+    unsigned int    live_ranges;
+    unsigned int    free_ranges;
+    unsigned int    failures;
+    /* 0 when all free memory is contiguous, 100 when it is unusable */
+    unsigned int    fragmentation;
+};
+
+struct gralloc_carveout {
+    size_t                          size;
+    size_t                          align;
+    size_t                          live_bytes;
+    size_t                          peak_bytes;
+    unsigned int                    failures;
+    struct gralloc_carveout_range  *free_list;
+    struct gralloc_carveout_range  *live_list;
+};
+
+int  gralloc_carveout_init(struct gralloc_carveout *co, size_t size, size_t align);
+void gralloc_carveout_destroy(struct gralloc_carveout *co);
+
+/* returns 0 and the offset of the new range, -1 when nothing fits */
+int  gralloc_carveout_alloc(struct gralloc_carveout *co, size_t size, size_t *offset);
+
+/* returns -1 if offset does not start a live range */
+int  gralloc_carveout_free(struct gralloc_carveout *co, size_t offset);
+
+void gralloc_carveout_get_stats(struct gralloc_carveout *co,
+                                struct gralloc_carveout_stats *stats);
+
+#endif /* GRALLOC_CARVEOUT_H_ */
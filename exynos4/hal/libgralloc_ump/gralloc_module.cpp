@@ -34,6 +34,7 @@
 #include <sys/mman.h>
 #include <cutils/log.h>
 #include <cutils/atomic.h>
+#include <cutils/properties.h>
 #include <hardware/hardware.h>
 #include <hardware/gralloc.h>
 #include <fcntl.h>
@@ -51,6 +52,10 @@ static pthread_mutex_t sMapLock = PTHREAD_MUTEX_INITIALIZER;
 
 static int s_ump_is_open = 0;
 static int gMemfd = 0;
+
+/* FIMC1 reserved memory is mapped once per process and shared by all handles */
+static void *s_fimc1_base = NULL;
+static int s_fimc1_refs = 0;
 #define PFX_NODE_MEM   "/dev/exynos-mem"
 
 /* we need this for now because pmem cannot mmap at an offset */
@@ -119,14 +124,18 @@ static int gralloc_map(gralloc_module_t const* module,
     private_handle_t* hnd = (private_handle_t*)handle;
     if (!(hnd->flags & private_handle_t::PRIV_FLAGS_FRAMEBUFFER)) {
         if (hnd->flags & private_handle_t::PRIV_FLAGS_USES_IOCTL) {
-            size_t size = FIMC1_RESERVED_SIZE * 1024;
-            void *mappedAddress = mmap(0, size,
-                    PROT_READ|PROT_WRITE, MAP_SHARED, gMemfd, (hnd->paddr - hnd->offset));
-            if (mappedAddress == MAP_FAILED) {
-                ALOGE("Could not mmap %s fd(%d)", strerror(errno),hnd->fd);
-                return -errno;
+            if (s_fimc1_refs == 0) {
+                size_t size = FIMC1_RESERVED_SIZE * 1024;
+                void *mappedAddress = mmap(0, size,
+                        PROT_READ|PROT_WRITE, MAP_SHARED, gMemfd, (hnd->paddr - hnd->offset));
+                if (mappedAddress == MAP_FAILED) {
+                    ALOGE("Could not mmap %s fd(%d)", strerror(errno),hnd->fd);
+                    return -errno;
+                }
+                s_fimc1_base = mappedAddress;
             }
-            hnd->base = intptr_t(mappedAddress) + hnd->offset;
+            s_fimc1_refs++;
+            hnd->base = intptr_t(s_fimc1_base) + hnd->offset;
         } else if (hnd->flags & private_handle_t::PRIV_FLAGS_USES_ION) {
             size_t size = hnd->size;
             hnd->ion_client = ion_client_create();
@@ -162,10 +171,12 @@ static int gralloc_unmap(gralloc_module_t const* module,
     private_handle_t* hnd = (private_handle_t*)handle;
     if (!(hnd->flags & private_handle_t::PRIV_FLAGS_FRAMEBUFFER)) {
         if (hnd->flags & private_handle_t::PRIV_FLAGS_USES_IOCTL) {
-            void* base = (void*)(intptr_t(hnd->base) - hnd->offset);
-            size_t size = FIMC1_RESERVED_SIZE * 1024;
-            if (munmap(base, size) < 0)
-                ALOGE("Could not unmap %s", strerror(errno));
+            if (s_fimc1_refs > 0 && --s_fimc1_refs == 0) {
+                size_t size = FIMC1_RESERVED_SIZE * 1024;
+                if (munmap(s_fimc1_base, size) < 0)
+                    ALOGE("Could not unmap %s", strerror(errno));
+                s_fimc1_base = NULL;
+            }
         } else if (hnd->flags & private_handle_t::PRIV_FLAGS_USES_ION) {
             void* base = (void*)hnd->base;
             size_t size = hnd->size;
@@ -334,11 +345,11 @@ static int gralloc_unregister_buffer(gralloc_module_t const* module, buffer_hand
             if(hnd->base != 0)
                 gralloc_unmap(module, handle);
 
-            pthread_mutex_unlock(&s_map_lock);
-            if (0 < gMemfd) {
+            if (s_fimc1_refs == 0 && 0 < gMemfd) {
                 close(gMemfd);
                 gMemfd = 0;
             }
+            pthread_mutex_unlock(&s_map_lock);
             return 0;
         } else if (hnd->flags & private_handle_t::PRIV_FLAGS_USES_ION) {
             ump_mapped_pointer_release((ump_handle)hnd->ump_mem_handle);
@@ -360,6 +371,164 @@ static int gralloc_unregister_buffer(gralloc_module_t const* module, buffer_hand
     return 0;
 }
 
+/*
+ * Region and usage of every outstanding software lock in this process,
+ * so unlock only has to maintain what the CPU actually touched.
+ */
+struct gralloc_lock_region {
+    const private_handle_t *hnd;
+    int usage;
+    int t;
+    int h;
+};
+
+struct gralloc_cache_stats {
+    unsigned long long bytes_cleaned;
+    unsigned long long bytes_invalidated;
+    unsigned int ops;
+    unsigned int skipped;
+    unsigned int unlocks;
+};
+
+#define GRALLOC_MAX_LOCKED_BUFFERS  32
+#define GRALLOC_CACHE_STATS_PERIOD  1000
+
+static pthread_mutex_t s_region_lock = PTHREAD_MUTEX_INITIALIZER;
+static gralloc_lock_region s_locked[GRALLOC_MAX_LOCKED_BUFFERS];
+static gralloc_cache_stats s_cache_stats;
+static int s_cache_stats_enabled = -1;
+
+static bool gralloc_is_cached(const private_handle_t *hnd)
+{
+    if (hnd->flags & (private_handle_t::PRIV_FLAGS_USES_ION |
+                      private_handle_t::PRIV_FLAGS_USES_IOCTL))
+        return true;
+#ifdef SAMSUNG_EXYNOS_CACHE_UMP
+    /* same rule alloc_device uses to pick UMP_REF_DRV_CONSTRAINT_USE_CACHE */
+    if ((hnd->flags & private_handle_t::PRIV_FLAGS_USES_UMP) &&
+        (hnd->usage & GRALLOC_USAGE_SW_READ_MASK) == GRALLOC_USAGE_SW_READ_OFTEN)
+        return true;
+#endif
+    return false;
+}
+
+static int gralloc_bytes_per_pixel(int format)
+{
+    switch (format) {
+    case HAL_PIXEL_FORMAT_RGBA_8888:
+    case HAL_PIXEL_FORMAT_RGBX_8888:
+    case HAL_PIXEL_FORMAT_BGRA_8888:
+        return 4;
+    case HAL_PIXEL_FORMAT_RGB_888:
+        return 3;
+    case HAL_PIXEL_FORMAT_RGB_565:
+    case HAL_PIXEL_FORMAT_RGBA_5551:
+    case HAL_PIXEL_FORMAT_RGBA_4444:
+        return 2;
+    default:
+        return 0;
+    }
+}
+
+/*
+ * Byte range of the buffer covered by rows [t, t + h). For YUV the chroma
+ * planes follow the luma plane, so the range runs from luma row t to the
+ * end of the buffer and all planes are maintained with a single operation.
+ */
+static void gralloc_lock_range(const private_handle_t *hnd, int t, int h,
+                               size_t *offset, size_t *size)
+{
+    int bpp = gralloc_bytes_per_pixel(hnd->format);
+    size_t start, end;
+
+    *offset = 0;
+    *size = hnd->size;
+
+    if (t < 0 || h <= 0 || hnd->stride <= 0 || t + h > hnd->height)
+        return;
+
+    if (bpp) {
+        start = (size_t)t * hnd->stride * bpp;
+        end = (size_t)(t + h) * hnd->stride * bpp;
+    } else {
+        /* YUV stride is the 16 aligned luma width in bytes */
+        start = (size_t)t * hnd->stride;
+        end = hnd->size;
+    }
+
+    /* cache maintenance works on whole lines */
+    start &= ~(size_t)31;
+    end = (end + 31) & ~(size_t)31;
+    if (end > (size_t)hnd->size)
+        end = hnd->size;
+    if (start >= end)
+        return;
+
+    *offset = start;
+    *size = end - start;
+}
+
+static void gralloc_cache_account(bool clean, bool invalidate, size_t size)
+{
+    if (clean)
+        s_cache_stats.bytes_cleaned += size;
+    if (invalidate)
+        s_cache_stats.bytes_invalidated += size;
+    if (clean || invalidate)
+        s_cache_stats.ops++;
+    else
+        s_cache_stats.skipped++;
+}
+
+/*
+ * Clean and/or invalidate [offset, offset + size) of a buffer. UMP can
+ * only clean and invalidate the whole allocation, ION and the FIMC1
+ * carveout honour the range.
+ */
+static int gralloc_cache_op(const private_handle_t *hnd, bool clean, bool invalidate,
+                            size_t offset, size_t size)
+{
+    if (!clean && !invalidate)
+        return 0;
+
+    if (hnd->flags & private_handle_t::PRIV_FLAGS_USES_UMP) {
+        ump_cpu_msync_now((ump_handle)hnd->ump_mem_handle, UMP_MSYNC_CLEAN_AND_INVALIDATE, NULL, 0);
+        gralloc_cache_account(true, true, hnd->size);
+        return 0;
+    }
+
+    if (hnd->flags & private_handle_t::PRIV_FLAGS_USES_ION) {
+        long flags;
+
+        if (clean && invalidate)
+            flags = IMSYNC_DEV_TO_RW | IMSYNC_SYNC_FOR_DEV;
+        else if (clean)
+            flags = IMSYNC_DEV_TO_READ | IMSYNC_SYNC_FOR_DEV;
+        else
+            flags = IMSYNC_DEV_TO_WRITE | IMSYNC_SYNC_FOR_CPU;
+
+        ion_msync(hnd->ion_client, hnd->fd, flags, size, hnd->offset + offset);
+        gralloc_cache_account(clean, invalidate, size);
+        return 0;
+    }
+
+    if (hnd->flags & private_handle_t::PRIV_FLAGS_USES_IOCTL) {
+        int ret;
+        exynos_mem_flush_range mem;
+        mem.start = hnd->paddr + offset;
+        mem.length = size;
+
+        ret = ioctl(gMemfd, EXYNOS_MEM_PADDR_CACHE_FLUSH, &mem);
+        if (ret < 0) {
+            ALOGE("Error in exynos-mem : EXYNOS_MEM_PADDR_CACHE_FLUSH (%d)\n", ret);
+            return -1;
+        }
+        gralloc_cache_account(true, true, size);
+    }
+
+    return 0;
+}
+
 static int gralloc_lock(gralloc_module_t const* module, buffer_handle_t handle,
                         int usage, int l, int t, int w, int h, void** vaddr)
 {
@@ -384,6 +553,43 @@ static int gralloc_lock(gralloc_module_t const* module, buffer_handle_t handle,
 #endif
     }
 #endif
+
+    bool track = gralloc_is_cached(hnd);
+#if defined(SAMSUNG_EXYNOS_CACHE_UMP) && defined(USE_PARTIAL_FLUSH)
+    /* UMP partial flush keeps its own rect list */
+    if (hnd->flags & private_handle_t::PRIV_FLAGS_USES_UMP)
+        track = false;
+#endif
+
+    if ((usage & (GRALLOC_USAGE_SW_READ_MASK | GRALLOC_USAGE_SW_WRITE_MASK)) && track) {
+        gralloc_lock_region *region = NULL;
+        size_t offset, size;
+
+        pthread_mutex_lock(&s_region_lock);
+        for (int i = 0; i < GRALLOC_MAX_LOCKED_BUFFERS; i++) {
+            if (s_locked[i].hnd == hnd) {
+                region = &s_locked[i];
+                break;
+            }
+            if (region == NULL && s_locked[i].hnd == NULL)
+                region = &s_locked[i];
+        }
+        /* no free slot: unlock falls back to maintaining the whole buffer */
+        if (region) {
+            region->hnd = hnd;
+            region->usage = usage;
+            region->t = t;
+            region->h = h;
+        }
+
+        /* drop stale lines so the CPU sees what devices wrote */
+        if (usage & GRALLOC_USAGE_SW_READ_MASK) {
+            gralloc_lock_range(hnd, t, h, &offset, &size);
+            gralloc_cache_op(hnd, false, true, offset, size);
+        }
+        pthread_mutex_unlock(&s_region_lock);
+    }
+
     if (usage & (GRALLOC_USAGE_SW_READ_MASK | GRALLOC_USAGE_SW_WRITE_MASK))
         *vaddr = (void*)hnd->base;
 
@@ -413,25 +619,47 @@ static int gralloc_unlock(gralloc_module_t const* module, buffer_handle_t handle
                 (void *)(hnd->base + (psRect->stride * psRect->t)), psRect->stride * psRect->h );
         return 0;
 #endif
-        ump_cpu_msync_now((ump_handle)hnd->ump_mem_handle, UMP_MSYNC_CLEAN_AND_INVALIDATE, NULL, 0);
     }
 #endif
-    if (hnd->flags & private_handle_t::PRIV_FLAGS_USES_ION)
-        ion_msync(hnd->ion_client, hnd->fd, IMSYNC_DEV_TO_RW | IMSYNC_SYNC_FOR_DEV, hnd->size, hnd->offset);
 
-    if (hnd->flags & private_handle_t::PRIV_FLAGS_USES_IOCTL) {
-        int ret;
-        exynos_mem_flush_range mem;
-        mem.start = hnd->paddr;
-        mem.length = hnd->size;
+    if (!gralloc_is_cached(hnd))
+        return 0;
 
-        ret = ioctl(gMemfd, EXYNOS_MEM_PADDR_CACHE_FLUSH, &mem);
-        if (ret < 0) {
-            ALOGE("Error in exynos-mem : EXYNOS_MEM_PADDR_CACHE_FLUSH (%d)\n", ret);
-            return false;
+    int usage = GRALLOC_USAGE_SW_WRITE_MASK;
+    size_t offset = 0;
+    size_t size = hnd->size;
+
+    pthread_mutex_lock(&s_region_lock);
+    for (int i = 0; i < GRALLOC_MAX_LOCKED_BUFFERS; i++) {
+        if (s_locked[i].hnd == hnd) {
+            usage = s_locked[i].usage;
+            gralloc_lock_range(hnd, s_locked[i].t, s_locked[i].h, &offset, &size);
+            s_locked[i].hnd = NULL;
+            break;
         }
     }
 
+    /*
+     * Reads were invalidated at lock time, only what the CPU may have
+     * written has to be pushed out for the next device.
+     */
+    if (usage & GRALLOC_USAGE_SW_WRITE_MASK)
+        gralloc_cache_op(hnd, true, false, offset, size);
+    else
+        gralloc_cache_account(false, false, 0);
+
+    if (s_cache_stats_enabled < 0) {
+        char value[PROPERTY_VALUE_MAX];
+        property_get("debug.gralloc.cache_stats", value, "0");
+        s_cache_stats_enabled = atoi(value);
+    }
+    if (s_cache_stats_enabled &&
+        ++s_cache_stats.unlocks % GRALLOC_CACHE_STATS_PERIOD == 0)
+        ALOGD("cache maintenance: %u ops, %u skipped, %llu KB cleaned, %llu KB invalidated",
+                s_cache_stats.ops, s_cache_stats.skipped,
+                s_cache_stats.bytes_cleaned >> 10, s_cache_stats.bytes_invalidated >> 10);
+    pthread_mutex_unlock(&s_region_lock);
+
     return 0;
 }
 
@@ -17,6 +17,7 @@
 //#define LOG_NDEBUG 0
 //#define LOG_TAG "libhdmi"
 #include <cutils/log.h>
+#include <poll.h>
 
 #if defined(BOARD_USE_V4L2_ION)
 #include "ion.h"
@@ -26,6 +27,7 @@
 #include "SecHdmiV4L2Utils.h"
 
 #define CHECK_GRAPHIC_LAYER_TIME (0)
+#define CHECK_CONNECT_TIME (0)
 
 namespace android {
 
@@ -51,7 +53,27 @@ extern unsigned int cur_g2d_address;
 extern unsigned int g2d_buf_index;
 #endif
 
+#if defined(BOARD_USE_V4L2)
+/* formats the video processor reads directly, everything else goes through FIMC */
+static bool hdmi_is_vp_format(int colorFormat)
+{
+    switch (colorFormat) {
+    case HAL_PIXEL_FORMAT_YCbCr_420_SP:
+    case HAL_PIXEL_FORMAT_YCrCb_420_SP:
+    case HAL_PIXEL_FORMAT_CUSTOM_YCbCr_420_SP:
+    case HAL_PIXEL_FORMAT_CUSTOM_YCrCb_420_SP:
+    case HAL_PIXEL_FORMAT_CUSTOM_YCbCr_420_SP_TILED:
+        return true;
+    default:
+        return false;
+    }
+}
+#endif
+
 #if defined(BOARD_USES_CEC)
+/* name a TV shows for this device, at most 14 characters */
+#define CEC_OSD_NAME    "Android"
+
 SecHdmi::CECThread::~CECThread()
 {
 #ifdef DEBUG_HDMI_HW_LEVEL
@@ -62,90 +84,75 @@ SecHdmi::CECThread::~CECThread()
 
 bool SecHdmi::CECThread::threadLoop()
 {
-    unsigned char buffer[CEC_MAX_FRAME_SIZE];
-    int size;
-    unsigned char lsrc, ldst, opcode;
-
-    {
-        Mutex::Autolock lock(mThreadLoopLock);
-        mFlagRunning = true;
-
-        size = CECReceiveMessage(buffer, CEC_MAX_FRAME_SIZE, 100000);
-
-        if (!size) // no data available or ctrl-c
-            return true;
+    Mutex::Autolock lock(mThreadLoopLock);
+    mFlagRunning = true;
 
-        if (size == 1)
-            return true; // "Polling Message"
-
-        lsrc = buffer[0] >> 4;
-
-        /* ignore messages with src address == mLaddr*/
-        if (lsrc == mLaddr)
-            return true;
-
-        opcode = buffer[1];
-
-        if (CECIgnoreMessage(opcode, lsrc)) {
-            ALOGE("### ignore message coming from address 15 (unregistered)\n");
-            return true;
-        }
-
-        if (!CECCheckMessageSize(opcode, size)) {
-            ALOGE("### invalid message size: %d(opcode: 0x%x) ###\n", size, opcode);
-            return true;
-        }
-
-        /* check if message broadcasted/directly addressed */
-        if (!CECCheckMessageMode(opcode, (buffer[0] & 0x0F) == CEC_MSG_BROADCAST ? 1 : 0)) {
-            ALOGE("### invalid message mode (directly addressed/broadcast) ###\n");
-            return true;
-        }
+    /* sleeps until a message is received or stop() wakes it up */
+    if (!CECProcess(-1)) {
+        ALOGE("CECProcess() failed!!!\n");
+        mFlagRunning = false;
+        return false;
+    }
 
-        ldst = lsrc;
+    return true;
+}
 
-        //TODO: macroses to extract src and dst logical addresses
-        //TODO: macros to extract opcode
+int SecHdmi::CECThread::reportPhysicalAddress(unsigned char *msg, int size,
+                                              unsigned char *reply, void *data)
+{
+    CECThread *cec = (CECThread *)data;
+
+    /* responce with "Report Physical Address" */
+    reply[0] = (cec->mLaddr << 4) | CEC_MSG_BROADCAST;
+    reply[1] = CEC_OPCODE_REPORT_PHYSICAL_ADDRESS;
+    reply[2] = (cec->mPaddr >> 8) & 0xFF;
+    reply[3] = cec->mPaddr & 0xFF;
+    reply[4] = cec->mDevtype;
+    return 5;
+}
 
-        switch (opcode) {
-        case CEC_OPCODE_GIVE_PHYSICAL_ADDRESS:
-            /* responce with "Report Physical Address" */
-            buffer[0] = (mLaddr << 4) | CEC_MSG_BROADCAST;
-            buffer[1] = CEC_OPCODE_REPORT_PHYSICAL_ADDRESS;
-            buffer[2] = (mPaddr >> 8) & 0xFF;
-            buffer[3] = mPaddr & 0xFF;
-            buffer[4] = mDevtype;
-            size = 5;
-            break;
+int SecHdmi::CECThread::reportActiveSource(unsigned char *msg, int size,
+                                           unsigned char *reply, void *data)
+{
+    CECThread *cec = (CECThread *)data;
+
+    ALOGD("[CEC_OPCODE_REQUEST_ACTIVE_SOURCE]\n");
+    /* responce with "Active Source" */
+    reply[0] = (cec->mLaddr << 4) | CEC_MSG_BROADCAST;
+    reply[1] = CEC_OPCODE_ACTIVE_SOURCE;
+    reply[2] = (cec->mPaddr >> 8) & 0xFF;
+    reply[3] = cec->mPaddr & 0xFF;
+    ALOGD("Tx : [CEC_OPCODE_ACTIVE_SOURCE]\n");
+    return 4;
+}
 
-        case CEC_OPCODE_REQUEST_ACTIVE_SOURCE:
-            ALOGD("[CEC_OPCODE_REQUEST_ACTIVE_SOURCE]\n");
-            /* responce with "Active Source" */
-            buffer[0] = (mLaddr << 4) | CEC_MSG_BROADCAST;
-            buffer[1] = CEC_OPCODE_ACTIVE_SOURCE;
-            buffer[2] = (mPaddr >> 8) & 0xFF;
-            buffer[3] = mPaddr & 0xFF;
-            size = 4;
-            ALOGD("Tx : [CEC_OPCODE_ACTIVE_SOURCE]\n");
-            break;
+int SecHdmi::CECThread::setOsdName(unsigned char *msg, int size,
+                                   unsigned char *reply, void *data)
+{
+    CECThread *cec = (CECThread *)data;
+    int len = strlen(CEC_OSD_NAME);
 
-        case CEC_OPCODE_ABORT:
-        case CEC_OPCODE_FEATURE_ABORT:
-        default:
-            /* send "Feature Abort" */
-            buffer[0] = (mLaddr << 4) | ldst;
-            buffer[1] = CEC_OPCODE_FEATURE_ABORT;
-            buffer[2] = CEC_OPCODE_ABORT;
-            buffer[3] = 0x04; // "refused"
-            size = 4;
-            break;
-        }
+    if (len > CEC_MAX_FRAME_SIZE - 2)
+        len = CEC_MAX_FRAME_SIZE - 2;
 
-        if (CECSendMessage(buffer, size) != size)
-            ALOGE("CECSendMessage() failed!!!\n");
+    /* responce with "Set OSD Name" */
+    reply[0] = (cec->mLaddr << 4) | (msg[0] >> 4);
+    reply[1] = CEC_OPCODE_SET_OSD_NAME;
+    memcpy(&reply[2], CEC_OSD_NAME, len);
+    return len + 2;
+}
 
-    }
-    return true;
+int SecHdmi::CECThread::featureAbort(unsigned char *msg, int size,
+                                     unsigned char *reply, void *data)
+{
+    CECThread *cec = (CECThread *)data;
+
+    /* send "Feature Abort" */
+    reply[0] = (cec->mLaddr << 4) | (msg[0] >> 4);
+    reply[1] = CEC_OPCODE_FEATURE_ABORT;
+    reply[2] = CEC_OPCODE_ABORT;
+    reply[3] = 0x04; // "refused"
+    return 4;
 }
 
 bool SecHdmi::CECThread::start()
@@ -202,6 +209,11 @@ bool SecHdmi::CECThread::start()
         return false;
     }
 
+    CECSetHandler(CEC_OPCODE_GIVE_PHYSICAL_ADDRESS, reportPhysicalAddress, this);
+    CECSetHandler(CEC_OPCODE_REQUEST_ACTIVE_SOURCE, reportActiveSource, this);
+    CECSetHandler(CEC_OPCODE_GIVE_OSD_NAME, setOsdName, this);
+    CECSetDefaultHandler(featureAbort, this);
+
 #ifdef DEBUG_HDMI_HW_LEVEL
     ALOGD("request to run CECThread");
 #endif
@@ -220,6 +232,8 @@ bool SecHdmi::CECThread::stop()
     ALOGD("%s request Exit", __func__);
 #endif
     Mutex::Autolock lock(mThreadControlLock);
+    requestExit();
+    CECWakeup();
     if (requestExitAndWait() == WOULD_BLOCK) {
         ALOGE("mCECThread.requestExitAndWait() == WOULD_BLOCK");
         return false;
@@ -320,6 +334,16 @@ SecHdmi::SecHdmi():
     for (int i = 0; i < HDMI_LAYER_MAX; i++)
         for (int j = 0; j < MAX_BUFFERS_MIXER; j++)
             mMixerBuffer[i][j] = zeroBuf;
+
+    for (int i = 0; i < HDMI_LAYER_MAX; i++) {
+        for (int j = 0; j < HDMI_NUM_VIDEO_BUF; j++)
+            mMixerBufQueued[i][j] = false;
+        mMixerBufNumQueued[i] = 0;
+    }
+
+    memset(mVideoConfig, 0, sizeof(mVideoConfig));
+    memset(mVideoConfigUse, 0, sizeof(mVideoConfigUse));
+    mVideoConfigTick = 0;
 #endif
 
     memset(&mDstRect, 0 , sizeof(struct v4l2_rect));
@@ -552,6 +576,9 @@ bool SecHdmi::connect(void)
 #ifdef DEBUG_MSG_ENABLE
     ALOGD("%s", __func__);
 #endif
+#if CHECK_CONNECT_TIME
+    nsecs_t start = systemTime();
+#endif
 
     {
         Mutex::Autolock lock(mLock);
@@ -611,6 +638,10 @@ bool SecHdmi::connect(void)
 #endif
     }
 
+#if CHECK_CONNECT_TIME
+    ALOGD("%s::connect to mode set = %ld ms", __func__, long(ns2ms(systemTime() - start)));
+#endif
+
     return true;
 }
 
@@ -768,7 +799,14 @@ bool SecHdmi::flush(int srcW, int srcH, int srcColorFormat,
             hdmiLayer);
 #endif
 
-        if (m_reset(srcW, srcH, srcColorFormat, hdmiLayer, num_of_hwc_layer) == false) {
+        bool switched = false;
+
+#if defined(BOARD_USE_V4L2)
+        if (hdmiLayer == HDMI_LAYER_VIDEO)
+            switched = m_switchVideoLayer(srcW, srcH, srcColorFormat);
+#endif
+        if (switched == false &&
+            m_reset(srcW, srcH, srcColorFormat, hdmiLayer, num_of_hwc_layer) == false) {
             ALOGE("%s::m_reset(%d, %d, %d, %d, %d) fail", __func__, srcW, srcH, srcColorFormat, hdmiLayer, num_of_hwc_layer);
             return false;
         }
@@ -1532,6 +1570,91 @@ bool SecHdmi::m_reset(int w, int h, int colorFormat, int hdmiLayer, int hwcLayer
 }
 
 #if defined(BOARD_USE_V4L2)
+/*
+ * Moves the video layer to a new source geometry without m_reset: the node
+ * stays open and the DV preset is left alone. If the VP input format does
+ * not change only the crops are updated and streaming goes on, otherwise
+ * the layer is stopped and reformatted, and the next m_startHdmi restarts
+ * it. Returns false when it takes m_reset.
+ */
+bool SecHdmi::m_switchVideoLayer(int w, int h, int colorFormat)
+{
+    const int layer = HDMI_LAYER_VIDEO;
+    struct hdmi_v_config *cfg;
+    bool cropOnly;
+    int fmtW, fmtH;
+
+    if (mHdmiFd[layer] <= 0 ||
+        mHdmiInfoChange == true ||
+        colorFormat != mSrcColorFormat[layer] ||
+        hdmi_is_vp_format(colorFormat) == false)
+        return false;
+
+    cfg = m_getVideoConfig(mSrcWidth[layer], mSrcHeight[layer], colorFormat,
+                           mHdmiResolutionWidth[layer], mHdmiResolutionHeight[layer]);
+    if (cfg == NULL)
+        return false;
+    fmtW = cfg->fmt_w;
+    fmtH = cfg->fmt_h;
+
+    cfg = m_getVideoConfig(w, h, colorFormat, mHdmiDstWidth, mHdmiDstHeight);
+    if (cfg == NULL)
+        return false;
+
+    /* a stopped layer has released its buffers, it needs the full setup */
+    cropOnly = (cfg->fmt_w == fmtW && cfg->fmt_h == fmtH && mFlagHdmiStart[layer] == true);
+
+    if (cropOnly == false && mFlagHdmiStart[layer] == true && m_stopHdmi(layer) == false)
+        return false;
+
+    if (hdmi_apply_v_config(mHdmiFd[layer], cfg, &mMixerBuffer[layer][0], cropOnly) < 0) {
+        ALOGE("%s::hdmi_apply_v_config(%d, %d, %d) fail, resetting", __func__, w, h, colorFormat);
+        return false;
+    }
+
+#ifdef DEBUG_HDMI_HW_LEVEL
+    ALOGD("%s::%dx%d -> %dx%d (%s)", __func__, mSrcWidth[layer], mSrcHeight[layer], w, h,
+          cropOnly ? "crop" : "format");
+#endif
+
+    mSrcWidth[layer] = w;
+    mSrcHeight[layer] = h;
+    mHdmiResolutionWidth[layer] = mHdmiDstWidth;
+    mHdmiResolutionHeight[layer] = mHdmiDstHeight;
+    mPrevDstWidth[layer] = mHdmiDstWidth;
+    mPrevDstHeight[layer] = mHdmiDstHeight;
+
+    return true;
+}
+
+struct hdmi_v_config *SecHdmi::m_getVideoConfig(int w, int h, int colorFormat, int dstW, int dstH)
+{
+    int slot = 0;
+
+    for (int i = 0; i < HDMI_VIDEO_CONFIG_NUM; i++) {
+        struct hdmi_v_config *cfg = &mVideoConfig[i];
+
+        if (mVideoConfigUse[i] != 0 &&
+            cfg->src_w == w && cfg->src_h == h &&
+            cfg->colorFormat == colorFormat &&
+            cfg->dst_w == dstW && cfg->dst_h == dstH) {
+            mVideoConfigUse[i] = ++mVideoConfigTick;
+            return cfg;
+        }
+
+        if (mVideoConfigUse[i] < mVideoConfigUse[slot])
+            slot = i;
+    }
+
+    if (hdmi_get_v_config(colorFormat, w, h, dstW, dstH, &mVideoConfig[slot]) < 0) {
+        mVideoConfigUse[slot] = 0;
+        return NULL;
+    }
+
+    mVideoConfigUse[slot] = ++mVideoConfigTick;
+    return &mVideoConfig[slot];
+}
+
 bool SecHdmi::m_startHdmi(int hdmiLayer, unsigned int num_of_plane)
 {
 #ifdef DEBUG_MSG_ENABLE
@@ -1545,37 +1668,60 @@ bool SecHdmi::m_startHdmi(int hdmiLayer, unsigned int num_of_plane)
     ALOGD("### %s: hdmiLayer(%d) called\n", __func__, hdmiLayer);
 #endif
 
-    if (mFlagLayerEnable[hdmiLayer]) {
-        static unsigned int index = 0;
+    if (mFlagLayerEnable[hdmiLayer] == false)
+        return true;
 
-        if (mFlagHdmiStart[hdmiLayer] == false) {
-            index = 0;
-            if (tvout_std_v4l2_qbuf(mHdmiFd[hdmiLayer], V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE, V4L2_MEMORY_USERPTR,
-                                    index, num_of_plane, &mMixerBuffer[hdmiLayer][0]) < 0) {
-                ALOGE("%s::tvout_std_v4l2_qbuf(index : %d) (mSrcBufNum : %d) failed", __func__, index, HDMI_NUM_MIXER_BUF);
-                return false;
-            }
-            index++;
+    int fd = mHdmiFd[hdmiLayer];
+    int num_of_buf = (hdmiLayer == HDMI_LAYER_VIDEO) ? HDMI_NUM_VIDEO_BUF : HDMI_NUM_MIXER_BUF;
 
-            if (tvout_std_v4l2_streamon(mHdmiFd[hdmiLayer], V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE) < 0) {
-                ALOGE("%s::tvout_std_v4l2_streamon() failed", __func__);
-                return false;
-            }
+    while (buf_index < num_of_buf && mMixerBufQueued[hdmiLayer][buf_index] == true)
+        buf_index++;
 
-            mFlagHdmiStart[hdmiLayer] = true;
-        } else {
-            if (tvout_std_v4l2_qbuf(mHdmiFd[hdmiLayer], V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE, V4L2_MEMORY_USERPTR,
-                                    index, num_of_plane, &mMixerBuffer[hdmiLayer][0]) < 0) {
-                ALOGE("%s::tvout_std_v4l2_qbuf() failed", __func__);
-                return false;
-            }
+    if (buf_index == num_of_buf) {
+        ALOGE("%s::no free buffer on layer(%d)", __func__, hdmiLayer);
+        return false;
+    }
 
-            if (tvout_std_v4l2_dqbuf(mHdmiFd[hdmiLayer], V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE, V4L2_MEMORY_USERPTR, &buf_index, num_of_plane) < 0) {
-                ALOGE("%s::tvout_std_v4l2_dqbuf() failed", __func__);
-                return false;
-            }
-            index = buf_index;
+    if (tvout_std_v4l2_qbuf(fd, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE, V4L2_MEMORY_USERPTR,
+                            buf_index, num_of_plane, &mMixerBuffer[hdmiLayer][0]) < 0) {
+        ALOGE("%s::tvout_std_v4l2_qbuf(index : %d) (num_of_buf : %d) failed", __func__, buf_index, num_of_buf);
+        return false;
+    }
+    mMixerBufQueued[hdmiLayer][buf_index] = true;
+    mMixerBufNumQueued[hdmiLayer]++;
+
+    if (mFlagHdmiStart[hdmiLayer] == false) {
+        if (tvout_std_v4l2_streamon(fd, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE) < 0) {
+            ALOGE("%s::tvout_std_v4l2_streamon() failed", __func__);
+            return false;
+        }
+
+        mFlagHdmiStart[hdmiLayer] = true;
+        return true;
+    }
+
+    /*
+     * Take back the buffers the mixer is done with. Only wait when all of
+     * them are queued: with HDMI_NUM_VIDEO_BUF buffers that waits for the
+     * frame before the previous one, not for the previous one.
+     */
+    while (mMixerBufNumQueued[hdmiLayer] > 0) {
+        if (mMixerBufNumQueued[hdmiLayer] < num_of_buf) {
+            struct pollfd pfd;
+
+            pfd.fd = fd;
+            pfd.events = POLLOUT;
+            pfd.revents = 0;
+            if (poll(&pfd, 1, 0) <= 0 || !(pfd.revents & POLLOUT))
+                break;
         }
+
+        if (tvout_std_v4l2_dqbuf(fd, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE, V4L2_MEMORY_USERPTR, &buf_index, num_of_plane) < 0) {
+            ALOGE("%s::tvout_std_v4l2_dqbuf() failed", __func__);
+            return false;
+        }
+        mMixerBufQueued[hdmiLayer][buf_index] = false;
+        mMixerBufNumQueued[hdmiLayer]--;
     }
 
     return true;
@@ -1669,6 +1815,10 @@ bool SecHdmi::m_stopHdmi(int hdmiLayer)
             return -1;
         }
 
+        for (int i = 0; i < HDMI_NUM_VIDEO_BUF; i++)
+            mMixerBufQueued[hdmiLayer][i] = false;
+        mMixerBufNumQueued[hdmiLayer] = 0;
+
         mFlagHdmiStart[hdmiLayer] = false;
     }
 #else
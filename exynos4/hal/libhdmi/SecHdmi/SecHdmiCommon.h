@@ -45,6 +45,8 @@
 #define MAX_PLANES_MIXER            (3)
 
 #define HDMI_NUM_MIXER_BUF          (2)
+#define HDMI_NUM_VIDEO_BUF          (3)
+#define HDMI_VIDEO_CONFIG_NUM       (4)
 #define GRALLOC_BUF_SIZE            (32768)
 #define SIZE_1K                     (1024)
 
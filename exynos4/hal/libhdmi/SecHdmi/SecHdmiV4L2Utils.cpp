@@ -1286,79 +1286,108 @@ int hdmi_get_src_plane(int srcColorFormat, unsigned int *num_of_plane)
 #endif
 
 #if defined(BOARD_USE_V4L2)
-int hdmi_set_v_param(int fd, int layer,
-                      int srcColorFormat,
-                      int src_w, int src_h,
-                      SecBuffer * dstBuffer,
-                      int dst_x, int dst_y, int dst_w, int dst_h)
+int hdmi_get_v_config(int srcColorFormat,
+                      int src_w, int src_h, int dst_w, int dst_h,
+                      struct hdmi_v_config *cfg)
 {
-#ifdef DEBUG_HDMI_HW_LEVEL
-    ALOGD("%s", __func__);
-#endif
-
     int v4l2ColorFormat = HAL_PIXEL_FORMAT_2_V4L2_PIX(srcColorFormat);
-    int round_up_src_w;
-    int round_up_src_h;
-    unsigned int num_of_plane;
-    struct v4l2_rect rect;
+
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->colorFormat = srcColorFormat;
+    cfg->src_w = src_w;
+    cfg->src_h = src_h;
+    cfg->dst_w = dst_w;
+    cfg->dst_h = dst_h;
 
     /* src_w, src_h round up to DWORD because of VP restriction */
 #if defined(SAMSUNG_EXYNOS4x12)
-    round_up_src_w = ROUND_UP(src_w, 16);
+    cfg->fmt_w = ROUND_UP(src_w, 16);
 #else defined(SAMSUNG_EXYNOS4210)
-    round_up_src_w = ROUND_UP(src_w, 8);
+    cfg->fmt_w = ROUND_UP(src_w, 8);
 #endif
-    round_up_src_h = ROUND_UP(src_h, 8);
+    cfg->fmt_h = ROUND_UP(src_h, 8);
 
     switch (v4l2ColorFormat) {
     case V4L2_PIX_FMT_NV12:
     case V4L2_PIX_FMT_NV21:
-        dstBuffer->size.s = (round_up_src_w * round_up_src_h * 3) >> 1;
-        num_of_plane = 1;
+        cfg->plane_size[0] = (cfg->fmt_w * cfg->fmt_h * 3) >> 1;
+        cfg->num_of_plane = 1;
         break;
     case V4L2_PIX_FMT_NV12M:
     case V4L2_PIX_FMT_NV12MT:
     case V4L2_PIX_FMT_NV21M:
-        dstBuffer->size.extS[0] = (round_up_src_w * round_up_src_h * 3) >> 1;
-        dstBuffer->size.extS[1] = (round_up_src_w * round_up_src_h * 3) >> 2;
-        num_of_plane = 2;
+        cfg->plane_size[0] = (cfg->fmt_w * cfg->fmt_h * 3) >> 1;
+        cfg->plane_size[1] = (cfg->fmt_w * cfg->fmt_h * 3) >> 2;
+        cfg->num_of_plane = 2;
         break;
     default:
         ALOGE("%s::invalid color type", __func__);
-        return false;
-        break;
+        return -1;
     }
 
-    hdmi_cal_rect(src_w, src_h, dst_w, dst_h, &rect);
-    rect.left = ALIGN(rect.left, 16);
+    hdmi_cal_rect(src_w, src_h, dst_w, dst_h, &cfg->rect);
+    cfg->rect.left = ALIGN(cfg->rect.left, 16);
 
-    /* set format for VP input */
-    if (tvout_std_v4l2_s_fmt(fd, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE, V4L2_FIELD_ANY, round_up_src_w, round_up_src_h, v4l2ColorFormat, num_of_plane) < 0) {
-        ALOGE("%s::tvout_std_v4l2_s_fmt()[video layer] failed", __func__);
-        return -1;
+    return 0;
+}
+
+int hdmi_apply_v_config(int fd, const struct hdmi_v_config *cfg,
+                      SecBuffer * dstBuffer, bool crop_only)
+{
+#ifdef DEBUG_HDMI_HW_LEVEL
+    ALOGD("%s", __func__);
+#endif
+
+    if (crop_only == false) {
+        /* set format for VP input */
+        if (tvout_std_v4l2_s_fmt(fd, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE, V4L2_FIELD_ANY, cfg->fmt_w, cfg->fmt_h,
+                                 HAL_PIXEL_FORMAT_2_V4L2_PIX(cfg->colorFormat), cfg->num_of_plane) < 0) {
+            ALOGE("%s::tvout_std_v4l2_s_fmt()[video layer] failed", __func__);
+            return -1;
+        }
     }
 
     /* set crop for VP input */
-    if (tvout_std_v4l2_s_crop(fd, V4L2_BUF_TYPE_VIDEO_OVERLAY, V4L2_FIELD_ANY, 0, 0, src_w, src_h) < 0) {
+    if (tvout_std_v4l2_s_crop(fd, V4L2_BUF_TYPE_VIDEO_OVERLAY, V4L2_FIELD_ANY, 0, 0, cfg->src_w, cfg->src_h) < 0) {
         ALOGE("%s::tvout_std_v4l2_s_crop()[video layer] failed", __func__);
         return -1;
     }
 
     /* set crop for VP output */
-    if (tvout_std_v4l2_s_crop(fd, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE, V4L2_FIELD_ANY, rect.left, rect.top, rect.width, rect.height) < 0) {
+    if (tvout_std_v4l2_s_crop(fd, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE, V4L2_FIELD_ANY,
+                              cfg->rect.left, cfg->rect.top, cfg->rect.width, cfg->rect.height) < 0) {
         ALOGE("%s::tvout_std_v4l2_s_crop()[video layer] failed", __func__);
         return -1;
     }
 
-    /* request buffer for VP input */
-    if (tvout_std_v4l2_reqbuf(fd, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE, V4L2_MEMORY_USERPTR, HDMI_NUM_MIXER_BUF) < 0) {
-        ALOGE("%s::tvout_std_v4l2_reqbuf(buf_num=%d)[video layer] failed", __func__, HDMI_NUM_MIXER_BUF);
-        return -1;
+    for (unsigned int i = 0; i < cfg->num_of_plane; i++)
+        dstBuffer->size.extS[i] = cfg->plane_size[i];
+
+    if (crop_only == false) {
+        /* request buffer for VP input */
+        if (tvout_std_v4l2_reqbuf(fd, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE, V4L2_MEMORY_USERPTR, HDMI_NUM_VIDEO_BUF) < 0) {
+            ALOGE("%s::tvout_std_v4l2_reqbuf(buf_num=%d)[video layer] failed", __func__, HDMI_NUM_VIDEO_BUF);
+            return -1;
+        }
     }
 
     return 0;
 }
 
+int hdmi_set_v_param(int fd, int layer,
+                      int srcColorFormat,
+                      int src_w, int src_h,
+                      SecBuffer * dstBuffer,
+                      int dst_x, int dst_y, int dst_w, int dst_h)
+{
+    struct hdmi_v_config cfg;
+
+    if (hdmi_get_v_config(srcColorFormat, src_w, src_h, dst_w, dst_h, &cfg) < 0)
+        return -1;
+
+    return hdmi_apply_v_config(fd, &cfg, dstBuffer, false);
+}
+
 int hdmi_set_g_param(int fd, int layer,
                       int srcColorFormat,
                       int src_w, int src_h,
@@ -75,6 +75,27 @@ int tvout_v4l2_stop_overlay(int fp);
 int hdmi_init_layer(int layer);
 int hdmi_deinit_layer(int layer);
 #if defined(BOARD_USE_V4L2)
+/* video processor setup for one source geometry on one HDMI resolution */
+struct hdmi_v_config {
+    int              colorFormat;
+    int              src_w, src_h;
+    int              dst_w, dst_h;
+    int              fmt_w, fmt_h;      /* VP input format, rounded up */
+    unsigned int     num_of_plane;
+    unsigned int     plane_size[MAX_PLANES_MIXER];
+    struct v4l2_rect rect;              /* VP output crop */
+};
+
+int hdmi_get_v_config(int srcColorFormat,
+                      int src_w, int src_h, int dst_w, int dst_h,
+                      struct hdmi_v_config *cfg);
+/*
+ * Programs cfg into the video layer. With crop_only only the crops are
+ * set, which the VP takes while streaming as long as fmt_w/fmt_h and the
+ * format did not change.
+ */
+int hdmi_apply_v_config(int fd, const struct hdmi_v_config *cfg,
+                      SecBuffer * dstBuffer, bool crop_only);
 int hdmi_set_v_param(int fd, int layer,
                       int srcColorFormat,
                       int src_w, int src_h,
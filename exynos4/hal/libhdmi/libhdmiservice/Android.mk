@@ -86,6 +86,8 @@ LOCAL_C_INCLUDES += \
 LOCAL_SHARED_LIBRARIES := \
 	libbinder \
 	libutils \
+	libcutils \
+	libhardware \
 	libTVOut
 
 ifeq ($(TARGET_SIMULATOR),true)
@@ -24,6 +24,7 @@
 
 #include <stdint.h>
 #include <sys/types.h>
+#include <unistd.h>
 #include <binder/Parcel.h>
 #include <utils/Log.h>
 #include "ISecTVOut.h"
@@ -37,7 +38,8 @@ namespace android {
         SET_HDMI_HDCP,
         SET_HDMI_ROTATE,
         SET_HDMI_HWCLAYER,
-        BLIT_2_HDMI
+        BLIT_2_HDMI,
+        GET_HDMI_STATUS_FD
     };
 
     void BpSecTVOut::setHdmiCableStatus(uint32_t status)
@@ -91,7 +93,8 @@ namespace android {
                                         uint32_t dstX,
                                         uint32_t dstY,
                                         uint32_t hdmiLayer,
-                                        uint32_t num_of_hwc_layer)
+                                        uint32_t num_of_hwc_layer,
+                                        uint32_t seq)
     {
         Parcel data, reply;
         data.writeInt32(w);
@@ -104,7 +107,20 @@ namespace android {
         data.writeInt32(dstY);
         data.writeInt32(hdmiLayer);
         data.writeInt32(num_of_hwc_layer);
-        remote()->transact(BLIT_2_HDMI, data, &reply);
+        data.writeInt32(seq);
+        remote()->transact(BLIT_2_HDMI, data, &reply, IBinder::FLAG_ONEWAY);
+    }
+
+    int BpSecTVOut::getHdmiStatusFd(void)
+    {
+        Parcel data, reply;
+        if (remote()->transact(GET_HDMI_STATUS_FD, data, &reply) != NO_ERROR)
+            return -1;
+        if (reply.readInt32() != NO_ERROR)
+            return -1;
+
+        /* the parcel owns the descriptor it carries */
+        return dup(reply.readFileDescriptor());
     }
 
     IMPLEMENT_META_INTERFACE(SecTVOut, "android.os.ISecTVOut");
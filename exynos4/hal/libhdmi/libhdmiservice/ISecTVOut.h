@@ -47,7 +47,9 @@ namespace android {
                                         uint32_t dstX,
                                         uint32_t dstY,
                                         uint32_t hdmiLayer,
-                                        uint32_t num_of_hwc_layer) = 0;
+                                        uint32_t num_of_hwc_layer,
+                                        uint32_t seq) = 0;
+            virtual int getHdmiStatusFd(void) = 0;
     };
     //--------------------------------------------------------------
     class BpSecTVOut: public BpInterface<ISecTVOut>
@@ -68,7 +70,9 @@ namespace android {
                                         uint32_t dstX,
                                         uint32_t dstY,
                                         uint32_t hdmiLayer,
-                                        uint32_t num_of_hwc_layer);
+                                        uint32_t num_of_hwc_layer,
+                                        uint32_t seq);
+            virtual int getHdmiStatusFd(void);
     };
 };
 #endif
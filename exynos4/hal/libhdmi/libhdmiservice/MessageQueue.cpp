@@ -151,6 +151,29 @@ status_t MessageQueue::postMessage(
     return queueMessage(message, relTime, flags);
 }
 
+int MessageQueue::replaceMessage(
+        const sp<MessageBase>& message, nsecs_t relTime)
+{
+    Mutex::Autolock _l(mLock);
+    int dropped = 0;
+
+    LIST::iterator cur(mMessages.begin());
+    while (cur != mMessages.end()) {
+        if ((*cur)->what == message->what) {
+            LIST::iterator pos(cur++);
+            mMessages.remove(pos);
+            dropped++;
+        } else {
+            ++cur;
+        }
+    }
+
+    message->when = systemTime() + relTime;
+    mMessages.insert(message);
+    mCondition.signal();
+    return dropped;
+}
+
 status_t MessageQueue::invalidate() {
     Mutex::Autolock _l(mLock);
     mInvalidate = true;
@@ -103,6 +103,10 @@ public:
     status_t postMessage(const sp<MessageBase>& message,
             nsecs_t reltime=0, uint32_t flags = 0);
 
+    // like postMessage, but first drops the queued messages with the
+    // same 'what'. returns how many were dropped.
+    int replaceMessage(const sp<MessageBase>& message, nsecs_t reltime=0);
+
     status_t invalidate();
     
     void dump(const sp<MessageBase>& message);
@@ -24,6 +24,9 @@
 
 #define LOG_TAG "libhdmiclient"
 
+#include <sys/mman.h>
+#include <string.h>
+
 #include "SecHdmiClient.h"
 
 namespace android {
@@ -32,12 +35,29 @@ static sp<ISecTVOut> g_SecTVOutService = 0;
 
 SecHdmiClient::SecHdmiClient()
 {
-    g_SecTVOutService = m_getSecTVOutService();
     mEnable = 0;
+    mStatus = NULL;
+    mStatusStale = 0;
+    mHeldNum = 0;
+    mBlitSeq = 0;
+    if (hw_get_module(GRALLOC_HARDWARE_MODULE_ID, (const hw_module_t **)&mGralloc) != 0) {
+        ALOGE("%s::gralloc module not found, HDMI frames are not held", __func__);
+        mGralloc = NULL;
+    }
+    mDeathNotifier = new DeathNotifier(this);
+    g_SecTVOutService = m_getSecTVOutService();
+    m_mapStatus();
 }
 
 SecHdmiClient::~SecHdmiClient()
 {
+    m_unmapStatus();
+}
+
+void SecHdmiClient::DeathNotifier::binderDied(const wp<IBinder>& who)
+{
+    ALOGW("SecTVOutService died, dropping the status page");
+    android_atomic_release_store(1, &mClient->mStatusStale);
 }
 
 SecHdmiClient * SecHdmiClient::getInstance(void)
@@ -54,6 +74,23 @@ void SecHdmiClient::setHdmiCableStatus(int status)
         g_SecTVOutService->setHdmiCableStatus(status);
 }
 
+uint32_t SecHdmiClient::getHdmiCableStatus(void)
+{
+    int cable;
+
+    Mutex::Autolock lock(mStatusLock);
+
+    if (m_checkStatus() == false)
+        return 0;
+
+    if (sec_hdmi_status_read(mStatus, &cable, NULL) == false) {
+        m_unmapStatus();
+        return 0;
+    }
+
+    return (uint32_t)cable;
+}
+
 void SecHdmiClient::setHdmiMode(int mode)
 {
     //ALOGD("%s HDMI Mode: %d\n", __func__, mode);
@@ -110,13 +147,139 @@ void SecHdmiClient::blit2Hdmi(uint32_t w, uint32_t h,
                                 uint32_t dstX,
                                 uint32_t dstY,
                                 uint32_t hdmiLayer,
-                                uint32_t num_of_hwc_layer)
+                                uint32_t num_of_hwc_layer,
+                                buffer_handle_t handle)
 {
-    if (g_SecTVOutService != 0 && mEnable == 1)
-        g_SecTVOutService->blit2Hdmi(w, h, colorFormat, physYAddr, physCbAddr, physCrAddr, dstX, dstY, hdmiLayer, num_of_hwc_layer);
+    uint32_t seq = 0;
+
+    if (g_SecTVOutService == 0 || mEnable != 1)
+        return;
+
+    Mutex::Autolock lock(mStatusLock);
+
+    if (handle != NULL) {
+        /* retirement is only published through the status page */
+        if (m_checkStatus() == false)
+            return;
+
+        m_releaseHeld(false);
+        if (mHeldNum == HDMI_MAX_HELD_FRAMES) {
+            ALOGV("%s::HDMI is %d frames behind, frame skipped", __func__, mHeldNum);
+            return;
+        }
+
+        native_handle_t *held = m_holdBuffer(handle);
+        if (held == NULL)
+            return;
+
+        if (++mBlitSeq == 0)
+            ++mBlitSeq;
+        seq = mBlitSeq;
+        mHeld[mHeldNum].seq = seq;
+        mHeld[mHeldNum].handle = held;
+        mHeldNum++;
+    }
+
+    g_SecTVOutService->blit2Hdmi(w, h, colorFormat, physYAddr, physCbAddr, physCrAddr,
+                                 dstX, dstY, hdmiLayer, num_of_hwc_layer, seq);
 }
 
-sp<ISecTVOut> SecHdmiClient::m_getSecTVOutService(void)
+/* Maps the status page of the running service, mStatusLock held */
+bool SecHdmiClient::m_checkStatus(void)
+{
+    /* the page of a restarted service is a new region, map it again */
+    if (android_atomic_acquire_load(&mStatusStale) != 0 ||
+        (mStatus != NULL && sec_hdmi_status_valid(mStatus) == false))
+        m_unmapStatus();
+
+    if (mStatus == NULL && m_mapStatus() == false)
+        return false;
+
+    return true;
+}
+
+/* Takes a reference on the buffer of handle, released by m_releaseHeld() */
+native_handle_t *SecHdmiClient::m_holdBuffer(buffer_handle_t handle)
+{
+    native_handle_t *held;
+
+    if (mGralloc == NULL)
+        return NULL;
+
+    held = native_handle_clone(handle);
+    if (held == NULL)
+        return NULL;
+
+    if (mGralloc->registerBuffer(mGralloc, held) != 0) {
+        ALOGE("%s::registerBuffer() fail", __func__);
+        native_handle_close(held);
+        native_handle_delete(held);
+        return NULL;
+    }
+
+    return held;
+}
+
+/* Releases held buffers the service retired, or all of them */
+void SecHdmiClient::m_releaseHeld(bool all)
+{
+    int n = 0;
+
+    while (n < mHeldNum &&
+           (all || (mStatus != NULL && sec_hdmi_status_retired(mStatus, mHeld[n].seq)))) {
+        mGralloc->unregisterBuffer(mGralloc, mHeld[n].handle);
+        native_handle_close(mHeld[n].handle);
+        native_handle_delete(mHeld[n].handle);
+        n++;
+    }
+
+    mHeldNum -= n;
+    memmove(mHeld, mHeld + n, mHeldNum * sizeof(mHeld[0]));
+}
+
+bool SecHdmiClient::m_mapStatus(void)
+{
+    void *addr;
+    int fd;
+
+    /* called per frame, so never wait for the service to come back */
+    if (m_getSecTVOutService(false) == 0)
+        return false;
+
+    fd = g_SecTVOutService->getHdmiStatusFd();
+    if (fd < 0) {
+        ALOGE("%s::getHdmiStatusFd() fail", __func__);
+        return false;
+    }
+
+    addr = mmap(NULL, SEC_HDMI_STATUS_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        ALOGE("%s::mmap() fail", __func__);
+        return false;
+    }
+
+    mStatus = (const struct sec_hdmi_status *)addr;
+    return true;
+}
+
+void SecHdmiClient::m_unmapStatus(void)
+{
+    /* a dead service never reads them again */
+    m_releaseHeld(true);
+
+    if (mStatus != NULL)
+        munmap((void *)mStatus, SEC_HDMI_STATUS_SIZE);
+    mStatus = NULL;
+
+    if (android_atomic_acquire_load(&mStatusStale) != 0) {
+        /* look the service up again on the next map */
+        g_SecTVOutService = 0;
+        android_atomic_release_store(0, &mStatusStale);
+    }
+}
+
+sp<ISecTVOut> SecHdmiClient::m_getSecTVOutService(bool wait)
 {
     int ret = 0;
 
@@ -125,7 +288,12 @@ sp<ISecTVOut> SecHdmiClient::m_getSecTVOutService(void)
         sp<ISecTVOut> sc;
         sp<IServiceManager> sm = defaultServiceManager();
         int getSvcTimes = 0;
-        for(getSvcTimes = 0; getSvcTimes < GETSERVICETIMEOUT; getSvcTimes++) {
+        if (wait == false) {
+            binder = sm->checkService(String16("SecTVOutService"));
+            if (binder == 0)
+                return g_SecTVOutService;
+        }
+        for(getSvcTimes = 0; binder == 0 && getSvcTimes < GETSERVICETIMEOUT; getSvcTimes++) {
             binder = sm->getService(String16("SecTVOutService"));
             if (binder == 0) {
                 ALOGW("SecTVOutService not published, waiting...");
@@ -135,7 +303,8 @@ sp<ISecTVOut> SecHdmiClient::m_getSecTVOutService(void)
             }
         }
         // grab the lock again for updating g_surfaceFlinger
-        if (getSvcTimes < GETSERVICETIMEOUT) {
+        if (binder != 0) {
+            binder->linkToDeath(mDeathNotifier);
             sc = interface_cast<ISecTVOut>(binder);
             g_SecTVOutService = sc;
         } else {
@@ -31,14 +31,19 @@
 #include <stdint.h>
 #include <sys/types.h>
 #include <utils/RefBase.h>
+#include <utils/threads.h>
 #include <cutils/log.h>
 #include <binder/IBinder.h>
 #include <binder/IServiceManager.h>
+#include <hardware/gralloc.h>
 #include <surfaceflinger/ISurfaceComposer.h>
 #include <surfaceflinger/SurfaceComposerClient.h>
 #include "ISecTVOut.h"
+#include "SecHdmiStatus.h"
 
 #define GETSERVICETIMEOUT (5)
+/* frames blitted but not yet retired by SecTVOutService, newer ones are skipped */
+#define HDMI_MAX_HELD_FRAMES (4)
 
 namespace android {
 
@@ -56,16 +61,53 @@ private:
     SecHdmiClient();
     virtual ~SecHdmiClient();
     uint32_t    mEnable;
+    const struct sec_hdmi_status *mStatus;
+    /* set from binder death, the status page has to be mapped again */
+    volatile int32_t mStatusStale;
+    Mutex       mStatusLock;
+
+    class DeathNotifier : public IBinder::DeathRecipient
+    {
+    public:
+        DeathNotifier(SecHdmiClient *client) : mClient(client) {}
+        virtual void binderDied(const wp<IBinder>& who);
+    private:
+        SecHdmiClient *mClient;
+    };
+    sp<DeathNotifier> mDeathNotifier;
+
+    /*
+     * Buffers of blitted frames, held until the status page reports their
+     * sequence retired. Oldest first, guarded by mStatusLock.
+     */
+    const gralloc_module_t *mGralloc;
+    struct {
+        uint32_t         seq;
+        native_handle_t *handle;
+    }           mHeld[HDMI_MAX_HELD_FRAMES];
+    int         mHeldNum;
+    uint32_t    mBlitSeq;
 
 public:
         static SecHdmiClient * getInstance(void);
         void setHdmiCableStatus(int status);
+        /*
+         * Cable state as last published by SecTVOutService. Reads the
+         * shared status page, so it is cheap enough to call every frame.
+         */
+        uint32_t getHdmiCableStatus(void);
         void setHdmiMode(int mode);
         void setHdmiResolution(int resolution);
         void setHdmiHdcp(int enHdcp);
         void setHdmiRotate(int rotVal, uint32_t hwcLayer);
         void setHdmiHwcLayer(uint32_t hwcLayer);
         void setHdmiEnable(uint32_t enable);
+        /*
+         * Queues a frame to SecTVOutService and returns without waiting for
+         * the flush. The physical addresses belong to handle, which is held
+         * until the service is done with them. Without a handle the caller
+         * has to keep the buffer alive itself.
+         */
         virtual void blit2Hdmi(uint32_t w, uint32_t h,
                                         uint32_t colorFormat,
                                         uint32_t physYAddr,
@@ -74,10 +116,16 @@ public:
                                         uint32_t dstX,
                                         uint32_t dstY,
                                         uint32_t hdmiLayer,
-                                        uint32_t num_of_hwc_layer);
+                                        uint32_t num_of_hwc_layer,
+                                        buffer_handle_t handle = NULL);
 
 private:
-        sp<ISecTVOut> m_getSecTVOutService(void);
+        sp<ISecTVOut> m_getSecTVOutService(bool wait = true);
+        bool m_mapStatus(void);
+        void m_unmapStatus(void);
+        bool m_checkStatus(void);
+        native_handle_t *m_holdBuffer(buffer_handle_t handle);
+        void m_releaseHeld(bool all);
 
 };
 
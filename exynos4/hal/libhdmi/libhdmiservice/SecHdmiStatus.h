@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SEC_HDMI_STATUS_H
+#define SEC_HDMI_STATUS_H
+
+#include <stdint.h>
+#include <cutils/atomic.h>
+
+namespace android {
+
+/*
+ * HDMI state published by SecTVOutService in an ashmem page.
+ * SecTVOutService is the only writer, clients map the page read only and
+ * read it without a binder call. seq is odd while an update is in flight.
+ * magic is only set while the page is live, a page left behind by a
+ * service that went away reads as invalid.
+ * retired is the last blit2Hdmi() frame sequence the service no longer
+ * reads, every frame up to it has been flushed or replaced.
+ */
+struct sec_hdmi_status {
+    volatile int32_t    magic;
+    volatile int32_t    seq;
+    volatile int32_t    cable;
+    volatile int32_t    transitions;
+    volatile int32_t    retired;
+};
+
+#define SEC_HDMI_STATUS_SIZE    4096
+#define SEC_HDMI_STATUS_MAGIC   0x53484d49  /* "SHMI" */
+/* reads spinning longer than this are treated as a dead writer */
+#define SEC_HDMI_STATUS_SPIN    100000
+
+inline void sec_hdmi_status_write(struct sec_hdmi_status *st, int cable)
+{
+    android_atomic_inc(&st->seq);
+    android_memory_barrier();
+    st->cable = cable;
+    st->transitions++;
+    android_memory_barrier();
+    android_atomic_inc(&st->seq);
+}
+
+inline void sec_hdmi_status_retire(struct sec_hdmi_status *st, uint32_t seq)
+{
+    android_atomic_release_store((int32_t)seq, &st->retired);
+}
+
+/* true once the service is done with frame seq */
+inline bool sec_hdmi_status_retired(const struct sec_hdmi_status *st, uint32_t seq)
+{
+    uint32_t retired = (uint32_t)android_atomic_acquire_load(&st->retired);
+
+    return (int32_t)(seq - retired) <= 0;
+}
+
+inline bool sec_hdmi_status_valid(const struct sec_hdmi_status *st)
+{
+    return android_atomic_acquire_load(&st->magic) == SEC_HDMI_STATUS_MAGIC;
+}
+
+inline bool sec_hdmi_status_read(const struct sec_hdmi_status *st,
+                                 int *cable, int *transitions)
+{
+    int32_t seq;
+    int spin = 0;
+
+    do {
+        while ((seq = android_atomic_acquire_load(&st->seq)) & 1) {
+            if (++spin > SEC_HDMI_STATUS_SPIN)
+                return false;
+        }
+        *cable = st->cable;
+        if (transitions)
+            *transitions = st->transitions;
+        android_memory_barrier();
+    } while (seq != st->seq);
+
+    return sec_hdmi_status_valid(st);
+}
+
+}; // namespace android
+
+#endif // SEC_HDMI_STATUS_H
@@ -29,15 +29,19 @@
 #include <binder/IInterface.h>
 #include <binder/Parcel.h>
 #include <utils/Log.h>
+#include <utils/String8.h>
 #include "SecTVOutService.h"
 #include <linux/fb.h>
+#include <poll.h>
+#include <cutils/ashmem.h>
+#include <cutils/uevent.h>
 
 namespace android {
 #define DEFAULT_LCD_WIDTH               800
 #define DEFAULT_LCD_HEIGHT              480
 
-#define DIRECT_VIDEO_RENDERING          (1)
-#define DIRECT_UI_RENDERING             (0)
+#define HDMI_UEVENT_MSG_LEN             1024
+#define HDMI_HOTPLUG_POLL_MS            500
 
     enum {
         SET_HDMI_STATUS = IBinder::FIRST_CALL_TRANSACTION,
@@ -46,7 +50,8 @@ namespace android {
         SET_HDMI_HDCP,
         SET_HDMI_ROTATE,
         SET_HDMI_HWCLAYER,
-        BLIT_2_HDMI
+        BLIT_2_HDMI,
+        GET_HDMI_STATUS_FD
     };
 
     int SecTVOutService::HdmiFlushThread()
@@ -59,6 +64,84 @@ namespace android {
         return 0;
     }
 
+    /* returns SWITCH_STATE of an hdmi switch uevent, -1 for any other event */
+    static int hdmi_parse_uevent(const char *msg, int len)
+    {
+        const char *end = msg + len;
+        bool hdmi = false;
+        int state = -1;
+
+        for (; msg < end; msg += strlen(msg) + 1) {
+            if (!strcmp(msg, "SWITCH_NAME=hdmi"))
+                hdmi = true;
+            else if (!strncmp(msg, "SWITCH_STATE=", 13))
+                state = atoi(msg + 13);
+        }
+
+        return hdmi ? state : -1;
+    }
+
+    int SecTVOutService::HdmiHotplugThread()
+    {
+        char msg[HDMI_UEVENT_MSG_LEN + 2];
+        int lastStatus = hdmi_cable_status();
+        int fd = uevent_open_socket(64 * 1024, true);
+
+        /*
+         * The constructor assumed a cable to bring the HDMI path up; publish
+         * what the driver reports now, uevents only tell about later changes.
+         */
+        if (lastStatus < 0) {
+            ALOGE("%s::hdmi_cable_status() fail", __func__);
+            lastStatus = hdmiCableInserted();
+        } else {
+            lastStatus = !!lastStatus;
+            setHdmiStatus(lastStatus);
+        }
+
+        if (fd < 0)
+            ALOGW("%s::uevent socket open fail, polling the cable status", __func__);
+
+        while (!mExitHdmiHotplugThread) {
+            int status;
+
+            if (fd >= 0) {
+                struct pollfd pfd;
+
+                pfd.fd = fd;
+                pfd.events = POLLIN;
+                pfd.revents = 0;
+                if (poll(&pfd, 1, HDMI_HOTPLUG_POLL_MS) <= 0)
+                    continue;
+
+                int len = uevent_kernel_multicast_recv(fd, msg, HDMI_UEVENT_MSG_LEN);
+                if (len <= 0)
+                    continue;
+                msg[len] = msg[len + 1] = '\0';
+
+                status = hdmi_parse_uevent(msg, len);
+            } else {
+                usleep(HDMI_HOTPLUG_POLL_MS * 1000);
+                status = hdmi_cable_status();
+            }
+
+            if (status < 0)
+                continue;
+
+            status = !!status;
+            if (status == lastStatus)
+                continue;
+
+            lastStatus = status;
+            setHdmiStatus(status);
+        }
+
+        if (fd >= 0)
+            close(fd);
+
+        return 0;
+    }
+
     int SecTVOutService::instantiate()
     {
         ALOGD("SecTVOutService instantiate");
@@ -78,16 +161,60 @@ namespace android {
 #endif
         mHwcLayer = 0;
         mExitHdmiFlushThread = false;
+        mExitHdmiHotplugThread = false;
+        mStatusFd = -1;
+        mStatus = NULL;
+        memset(mBlitQueued, 0, sizeof(mBlitQueued));
+        mBlitFlushing = 0;
+        mBlitLast = 0;
+        mBlitFrames = 0;
+        mBlitDropped = 0;
+
+        m_createStatus();
 
         setLCDsize();
-        if (mSecHdmi.create(mLCD_width, mLCD_height) == false)
+        if (mSecHdmi.create(mLCD_width, mLCD_height) == false) {
             ALOGE("%s::mSecHdmi.create() fail", __func__);
-        else
+        } else {
             setHdmiStatus(1);
+            mHdmiHotplugThread = new HDMIHotplugThread(this);
+        }
 
         mHdmiFlushThread = new HDMIFlushThread(this);
     }
 
+    void SecTVOutService::m_createStatus(void)
+    {
+        void *addr;
+
+        mStatusFd = ashmem_create_region("SecTVOutStatus", SEC_HDMI_STATUS_SIZE);
+        if (mStatusFd < 0) {
+            ALOGE("%s::ashmem_create_region() fail", __func__);
+            return;
+        }
+
+        addr = mmap(NULL, SEC_HDMI_STATUS_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, mStatusFd, 0);
+        if (addr == MAP_FAILED) {
+            ALOGE("%s::mmap() fail", __func__);
+            close(mStatusFd);
+            mStatusFd = -1;
+            return;
+        }
+
+        mStatus = (struct sec_hdmi_status *)addr;
+        memset(mStatus, 0, sizeof(*mStatus));
+        android_memory_barrier();
+        mStatus->magic = SEC_HDMI_STATUS_MAGIC;
+
+        /* clients may only map it read only from now on */
+        ashmem_set_prot_region(mStatusFd, PROT_READ);
+    }
+
+    int SecTVOutService::getHdmiStatusFd(void)
+    {
+        return mStatusFd;
+    }
+
     void SecTVOutService::setLCDsize(void) {
             char const * const device_template[] = {
                 "/dev/graphics/fb%u",
@@ -123,9 +250,25 @@ namespace android {
         if (mHdmiFlushThread != NULL) {
             mHdmiFlushThread->requestExit();
             mExitHdmiFlushThread = true;
+            mHdmiEventQueue.invalidate();
             mHdmiFlushThread->requestExitAndWait();
             mHdmiFlushThread.clear();
         }
+
+        if (mHdmiHotplugThread != NULL) {
+            mHdmiHotplugThread->requestExit();
+            mExitHdmiHotplugThread = true;
+            mHdmiHotplugThread->requestExitAndWait();
+            mHdmiHotplugThread.clear();
+        }
+
+        if (mStatus != NULL) {
+            /* clients still holding the page have to notice it is gone */
+            android_atomic_release_store(0, &mStatus->magic);
+            munmap(mStatus, SEC_HDMI_STATUS_SIZE);
+        }
+        if (mStatusFd >= 0)
+            close(mStatusFd);
     }
 
     status_t SecTVOutService::onTransact(uint32_t code, const Parcel & data, Parcel * reply, uint32_t flags)
@@ -173,8 +316,19 @@ namespace android {
             uint32_t dstY   = data.readInt32();
             uint32_t hdmiLayer   = data.readInt32();
             uint32_t num_of_hwc_layer = data.readInt32();
+            uint32_t seq = data.readInt32();
 
-            blit2Hdmi(w, h, colorFormat, physYAddr, physCbAddr, physCrAddr, dstX, dstY, hdmiLayer, num_of_hwc_layer);
+            blit2Hdmi(w, h, colorFormat, physYAddr, physCbAddr, physCrAddr, dstX, dstY, hdmiLayer, num_of_hwc_layer, seq);
+        } break;
+
+        case GET_HDMI_STATUS_FD: {
+            int fd = getHdmiStatusFd();
+            if (fd < 0) {
+                reply->writeInt32(NO_INIT);
+            } else {
+                reply->writeInt32(NO_ERROR);
+                reply->writeDupFileDescriptor(fd);
+            }
         } break;
 
         default :
@@ -208,10 +362,13 @@ namespace android {
             }
 
             mHdmiCableInserted = hdmiCableInserted;
+
+            if (mStatus != NULL)
+                sec_hdmi_status_write(mStatus, hdmiCableInserted);
         }
 
         if (hdmiCableInserted() == true)
-            this->blit2Hdmi(mLCD_width, mLCD_height, HAL_PIXEL_FORMAT_BGRA_8888, 0, 0, 0, 0, 0, HDMI_MODE_UI, 0);
+            this->blit2Hdmi(mLCD_width, mLCD_height, HAL_PIXEL_FORMAT_BGRA_8888, 0, 0, 0, 0, 0, HDMI_MODE_UI, 0, 0);
     }
 
     void SecTVOutService::setHdmiMode(uint32_t mode)
@@ -267,24 +424,105 @@ namespace android {
         return;
     }
 
-    void SecTVOutService::blit2Hdmi(uint32_t w, uint32_t h, uint32_t colorFormat, 
+    /*
+     * Called on a binder thread for every composed frame, BLIT_2_HDMI is one
+     * way. The frame only goes into the flush queue, a frame of the same
+     * mode still waiting there is dropped, so a slow HDMI path never holds
+     * up the caller.
+     *
+     * The frame is passed by physical address. A client that sets seq keeps
+     * a reference on the buffer until the status page reports seq retired;
+     * seq 0 frames are not tracked.
+     */
+    void SecTVOutService::blit2Hdmi(uint32_t w, uint32_t h, uint32_t colorFormat,
                                  uint32_t pPhyYAddr, uint32_t pPhyCbAddr, uint32_t pPhyCrAddr,
                                  uint32_t dstX, uint32_t dstY,
                                  uint32_t hdmiMode,
-                                 uint32_t num_of_hwc_layer)
+                                 uint32_t num_of_hwc_layer,
+                                 uint32_t seq)
+    {
+        Mutex::Autolock _b(mBlitLock);
+
+        if (seq != 0)
+            mBlitLast = seq;
+
+        if (hdmiCableInserted() == false ||
+            (hdmiMode != HDMI_MODE_UI && hdmiMode != HDMI_MODE_VIDEO)) {
+            if (hdmiCableInserted() == true)
+                ALOGE("unmatched HDMI_MODE : %d", hdmiMode);
+            /* never queued, give it back right away */
+            m_publishRetired();
+            return;
+        }
+
+        sp<MessageBase> msg = new SecHdmiEventMsg(this, w, h, colorFormat,
+                                                  pPhyYAddr, pPhyCbAddr, pPhyCrAddr,
+                                                  dstX, dstY, hdmiMode, seq);
+
+        int dropped = mHdmiEventQueue.replaceMessage(msg);
+        mBlitQueued[hdmiMode] = seq;
+        m_publishRetired();
+
+        android_atomic_inc(&mBlitFrames);
+        if (dropped) {
+            android_atomic_add(dropped, &mBlitDropped);
+            ALOGV("%s::%d frame(s) of mode %d dropped", __func__, dropped, hdmiMode);
+        }
+    }
+
+    /* Called on the flush thread once a frame is taken from the queue */
+    void SecTVOutService::startBlit(uint32_t seq, uint32_t hdmiMode)
+    {
+        Mutex::Autolock _b(mBlitLock);
+
+        if (mBlitQueued[hdmiMode] == seq)
+            mBlitQueued[hdmiMode] = 0;
+        mBlitFlushing = seq;
+    }
+
+    /* Called on the flush thread once a frame is flushed */
+    void SecTVOutService::retireBlit(void)
+    {
+        Mutex::Autolock _b(mBlitLock);
+
+        mBlitFlushing = 0;
+        m_publishRetired();
+    }
+
+    /*
+     * Every frame older than the oldest one still waiting or being flushed
+     * has been flushed or replaced, so its buffer may go. mBlitLock held.
+     */
+    void SecTVOutService::m_publishRetired(void)
+    {
+        uint32_t retired = mBlitLast;
+        uint32_t busy[] = { mBlitQueued[HDMI_MODE_UI], mBlitQueued[HDMI_MODE_VIDEO], mBlitFlushing };
+
+        for (unsigned int i = 0; i < sizeof(busy) / sizeof(busy[0]); i++) {
+            if (busy[i] != 0 && (int32_t)(busy[i] - 1 - retired) < 0)
+                retired = busy[i] - 1;
+        }
+
+        if (mStatus != NULL)
+            sec_hdmi_status_retire(mStatus, retired);
+    }
+
+    bool SecTVOutService::flushHdmi(uint32_t w, uint32_t h, uint32_t colorFormat,
+                                 uint32_t pPhyYAddr, uint32_t pPhyCbAddr, uint32_t pPhyCrAddr,
+                                 uint32_t dstX, uint32_t dstY,
+                                 uint32_t hdmiMode)
     {
         Mutex::Autolock _l(mLock);
 
         if (hdmiCableInserted() == false)
-            return;
+            return false;
 
         int hdmiLayer = SecHdmi::HDMI_LAYER_VIDEO;
+        bool ret = true;
 #if defined(CHECK_UI_TIME) || defined(CHECK_VIDEO_TIME)
         nsecs_t start, end;
 #endif
 
-        sp<MessageBase> msg;
-
         switch (hdmiMode) {
         case HDMI_MODE_UI :
             if (mHwcLayer >= 2)
@@ -317,28 +555,20 @@ namespace android {
 #if !defined(BOARD_USES_HDMI_SUBTITLES)
             if (mHwcLayer == 0)
 #endif
-#if (DIRECT_UI_RENDERING == 1)
             {
 #ifdef CHECK_UI_TIME
                 start = systemTime();
 #endif
                 if (mSecHdmi.flush(w, h, colorFormat, pPhyYAddr, pPhyCbAddr, pPhyCrAddr, dstX, dstY,
-                                    mUILayerMode, mHwcLayer) == false)
+                                    mUILayerMode, mHwcLayer) == false) {
                     ALOGE("%s::mSecHdmi.flush() on HDMI_MODE_UI fail", __func__);
+                    ret = false;
+                }
 #ifdef CHECK_UI_TIME
                 end = systemTime();
                 ALOGD("[UI] mSecHdmi.flush[end-start] = %ld ms", long(ns2ms(end)) - long(ns2ms(start)));
 #endif
             }
-#else
-            {
-                msg = new SecHdmiEventMsg(&mSecHdmi, w, h, colorFormat, pPhyYAddr, pPhyCbAddr, pPhyCrAddr,
-                                            dstX, dstY, mUILayerMode, mHwcLayer, HDMI_MODE_UI);
-
-                /* post to HdmiEventQueue */
-                mHdmiEventQueue.postMessage(msg, 0, 0);
-            }
-#endif
             break;
 
         case HDMI_MODE_VIDEO :
@@ -351,32 +581,41 @@ namespace android {
 #endif
 #endif
 
-#if (DIRECT_VIDEO_RENDERING == 1)
 #ifdef CHECK_VIDEO_TIME
             start = systemTime();
 #endif
             if (mSecHdmi.flush(w, h, colorFormat, pPhyYAddr, pPhyCbAddr, pPhyCrAddr, dstX, dstY,
-                                SecHdmi::HDMI_LAYER_VIDEO, mHwcLayer) == false)
+                                SecHdmi::HDMI_LAYER_VIDEO, mHwcLayer) == false) {
                 ALOGE("%s::mSecHdmi.flush() on HDMI_MODE_VIDEO fail", __func__);
+                ret = false;
+            }
 #ifdef CHECK_VIDEO_TIME
             end = systemTime();
             ALOGD("[Video] mSecHdmi.flush[end-start] = %ld ms", long(ns2ms(end)) - long(ns2ms(start)));
-#endif
-#else
-            msg = new SecHdmiEventMsg(&mSecHdmi, w, h, colorFormat, pPhyYAddr, pPhyCbAddr, pPhyCrAddr,
-                                        dstX, dstY, SecHdmi::HDMI_LAYER_VIDEO, mHwcLayer, HDMI_MODE_VIDEO);
-
-            /* post to HdmiEventQueue */
-            mHdmiEventQueue.postMessage(msg, 0, 0);
 #endif
             break;
 
         default:
             ALOGE("unmatched HDMI_MODE : %d", hdmiMode);
+            ret = false;
             break;
         }
 
-        return;
+        return ret;
+    }
+
+    status_t SecTVOutService::dump(int fd, const Vector<String16>& args)
+    {
+        String8 result;
+        int32_t frames = android_atomic_acquire_load(&mBlitFrames);
+        int32_t dropped = android_atomic_acquire_load(&mBlitDropped);
+
+        result.appendFormat("SecTVOutService: cable %d, hwc layers %d\n",
+                            hdmiCableInserted(), mHwcLayer);
+        result.appendFormat("  blit frames %d, dropped %d\n", frames, dropped);
+        write(fd, result.string(), result.size());
+
+        return NO_ERROR;
     }
 
     bool SecTVOutService::hdmiCableInserted(void)
@@ -35,6 +35,7 @@
 #include "sec_format.h"
 #include "sec_utils.h"
 #include "MessageQueue.h"
+#include "SecHdmiStatus.h"
 
 namespace android {
 //#define CHECK_VIDEO_TIME
@@ -72,9 +73,29 @@ namespace android {
             mutable MessageQueue    mHdmiEventQueue;
             bool                    mExitHdmiFlushThread;
 
+            class HDMIHotplugThread : public Thread {
+                SecTVOutService *mTVOutService;
+            public:
+                HDMIHotplugThread(SecTVOutService *service):
+                Thread(false),
+                mTVOutService(service) { }
+                virtual void onFirstRef() {
+                    run("HDMIHotplugThread", PRIORITY_BACKGROUND);
+                }
+                virtual bool threadLoop() {
+                    mTVOutService->HdmiHotplugThread();
+                    return false;
+                }
+            };
+
+            sp<HDMIHotplugThread>   mHdmiHotplugThread;
+            int                     HdmiHotplugThread();
+            bool                    mExitHdmiHotplugThread;
+
             SecTVOutService();
             static int instantiate ();
             virtual status_t onTransact(uint32_t, const Parcel &, Parcel *, uint32_t);
+            virtual status_t dump(int fd, const Vector<String16>& args);
             virtual ~SecTVOutService ();
 
             virtual void                        setHdmiStatus(uint32_t status);
@@ -87,9 +108,18 @@ namespace android {
                                                 uint32_t colorFormat,
                                                 uint32_t pPhyYAddr, uint32_t pPhyCbAddr, uint32_t pPhyCrAddr,
                                                 uint32_t dstX, uint32_t dstY,
-                                                uint32_t hdmiMode, uint32_t num_of_hwc_layer);
+                                                uint32_t hdmiMode, uint32_t num_of_hwc_layer,
+                                                uint32_t seq);
+            bool                                flushHdmi(uint32_t w, uint32_t h,
+                                                uint32_t colorFormat,
+                                                uint32_t pPhyYAddr, uint32_t pPhyCbAddr, uint32_t pPhyCrAddr,
+                                                uint32_t dstX, uint32_t dstY,
+                                                uint32_t hdmiMode);
+            void                                startBlit(uint32_t seq, uint32_t hdmiMode);
+            void                                retireBlit(void);
             bool                                hdmiCableInserted(void);
             void                                setLCDsize(void);
+            int                                 getHdmiStatusFd(void);
 
         private:
             SecHdmi                     mSecHdmi;
@@ -97,76 +127,58 @@ namespace android {
             int                         mUILayerMode;
             uint32_t                    mLCD_width, mLCD_height;
             uint32_t                    mHwcLayer;
+
+            /* cable state shared with SecHdmiClient, see SecHdmiStatus.h */
+            int                         mStatusFd;
+            struct sec_hdmi_status     *mStatus;
+            void                        m_createStatus(void);
+
+            /*
+             * Sequences of the frame waiting per HDMI mode, of the frame
+             * being flushed and of the newest frame taken, 0 for none. The
+             * client holds each frame's buffer until the status page shows
+             * it retired, see m_publishRetired().
+             */
+            Mutex                       mBlitLock;
+            uint32_t                    mBlitQueued[HDMI_MODE_VIDEO + 1];
+            uint32_t                    mBlitFlushing;
+            uint32_t                    mBlitLast;
+            void                        m_publishRetired(void);
+
+            /* frames taken by blit2Hdmi(), and those replaced before being flushed */
+            volatile int32_t            mBlitFrames;
+            volatile int32_t            mBlitDropped;
     };
 
+    /*
+     * One frame for the HDMI flush thread. what is the HDMI mode, so a newer
+     * frame of the same mode replaces one still waiting in the queue.
+     */
     class SecHdmiEventMsg : public MessageBase {
         public:
-            enum {
-                HDMI_MODE_NONE = 0,
-                HDMI_MODE_UI,
-                HDMI_MODE_VIDEO,
-            };
-
-            mutable     Mutex mBlitLock;
-
-            SecHdmi     *pSecHdmi;
+            SecTVOutService *pTVOutService;
             uint32_t    mSrcWidth, mSrcHeight;
             uint32_t    mSrcColorFormat;
             uint32_t    mSrcYAddr, mSrcCbAddr, mSrcCrAddr;
             uint32_t    mDstX, mDstY;
-            uint32_t    mHdmiMode;
-            uint32_t    mHdmiLayer, mHwcLayer;
+            uint32_t    mSeq;
 
-            SecHdmiEventMsg(SecHdmi *SecHdmi, uint32_t srcWidth, uint32_t srcHeight, uint32_t srcColorFormat,
+            SecHdmiEventMsg(SecTVOutService *service, uint32_t srcWidth, uint32_t srcHeight, uint32_t srcColorFormat,
                     uint32_t srcYAddr, uint32_t srcCbAddr, uint32_t srcCrAddr,
-                    uint32_t dstX, uint32_t dstY, uint32_t hdmiLayer, uint32_t hwcLayer, uint32_t hdmiMode)
-                : pSecHdmi(SecHdmi), mSrcWidth(srcWidth), mSrcHeight(srcHeight), mSrcColorFormat(srcColorFormat),
+                    uint32_t dstX, uint32_t dstY, uint32_t hdmiMode, uint32_t seq)
+                : MessageBase(hdmiMode), pTVOutService(service),
+                mSrcWidth(srcWidth), mSrcHeight(srcHeight), mSrcColorFormat(srcColorFormat),
                 mSrcYAddr(srcYAddr), mSrcCbAddr(srcCbAddr), mSrcCrAddr(srcCrAddr),
-                mDstX(dstX), mDstY(dstY), mHdmiLayer(hdmiLayer), mHwcLayer(hwcLayer), mHdmiMode(hdmiMode) {
+                mDstX(dstX), mDstY(dstY), mSeq(seq) {
             }
 
             virtual bool handler() {
-                Mutex::Autolock _l(mBlitLock);
-                bool ret = true;
-#if defined(CHECK_UI_TIME) || defined(CHECK_VIDEO_TIME)
-                nsecs_t start, end;
-#endif
-
-                switch (mHdmiMode) {
-                case HDMI_MODE_UI:
-#ifdef CHECK_UI_TIME
-                    start = systemTime();
-#endif
-                    if (pSecHdmi->flush(mSrcWidth, mSrcHeight, mSrcColorFormat, mSrcYAddr, mSrcCbAddr, mSrcCrAddr,
-                                mDstX, mDstY, mHdmiLayer, mHwcLayer) == false) {
-                        ALOGE("%s::pSecHdmi->flush() fail on HDMI_MODE_UI", __func__);
-                        ret = false;
-                    }
-#ifdef CHECK_UI_TIME
-                    end = systemTime();
-                    ALOGD("[UI] pSecHdmi->flush[end-start] = %ld ms", long(ns2ms(end)) - long(ns2ms(start)));
-#endif
-                    break;
-                case HDMI_MODE_VIDEO:
-#ifdef CHECK_VIDEO_TIME
-                    start = systemTime();
-#endif
-                    if (pSecHdmi->flush(mSrcWidth, mSrcHeight, mSrcColorFormat, mSrcYAddr, mSrcCbAddr, mSrcCrAddr,
-                                mDstX, mDstY, mHdmiLayer, mHwcLayer) == false) {
-                        ALOGE("%s::pSecHdmi->flush() fail on HDMI_MODE_VIDEO", __func__);
-                        ret = false;
-                    }
-#ifdef CHECK_VIDEO_TIME
-                    end = systemTime();
-                    ALOGD("[VIDEO] pSecHdmi->flush[end-start] = %ld ms", long(ns2ms(end)) - long(ns2ms(start)));
-#endif
-                    break;
-                default:
-                    ALOGE("Undefined HDMI_MODE");
-                    ret = false;
-                    break;
-                }
-                return ret;
+                pTVOutService->startBlit(mSeq, what);
+                pTVOutService->flushHdmi(mSrcWidth, mSrcHeight, mSrcColorFormat,
+                                         mSrcYAddr, mSrcCbAddr, mSrcCrAddr,
+                                         mDstX, mDstY, what);
+                pTVOutService->retireBlit();
+                return true;
             }
     };
 
@@ -19,8 +19,13 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <sys/ioctl.h>
+#include <sys/epoll.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
 #include <cutils/log.h>
 
 /* drv. header */
@@ -53,6 +58,134 @@ static struct {
     { CEC_DEVICE_PLAYER,  11 },
 };
 
+/**
+ * @name Restrictions of received CEC messages
+ */
+//@{
+#define CEC_MSG_BROADCAST_ONLY      (1<<0)
+#define CEC_MSG_DIRECT_ONLY         (1<<1)
+#define CEC_MSG_NO_UNREGISTERED     (1<<2)
+//@}
+
+/**
+ * Checks of received CEC messages, indexed by opcode. @n
+ * Sizes count the whole frame, header and opcode included (HDMI 1.4 CEC). @n
+ * Message size is not checked if max_size is 0.
+ */
+#define D   CEC_MSG_DIRECT_ONLY
+#define B   CEC_MSG_BROADCAST_ONLY
+#define NU  CEC_MSG_NO_UNREGISTERED
+static const struct {
+    unsigned char min_size;
+    unsigned char max_size;
+    unsigned char flags;
+} opcodes[256] = {
+    /* One Touch Play */
+    [CEC_OPCODE_ACTIVE_SOURCE]              = {  4,  4, B },
+    [CEC_OPCODE_IMAGE_VIEW_ON]              = {  2,  2, D },
+    [CEC_OPCODE_TEXT_VIEW_ON]               = {  2,  2, D },
+    /* Routing Control */
+    [CEC_OPCODE_INACTIVE_SOURCE]            = {  4,  4, D },
+    [CEC_OPCODE_REQUEST_ACTIVE_SOURCE]      = {  2,  2, B },
+    [CEC_OPCODE_ROUTING_CHANGE]             = {  6,  6, B },
+    [CEC_OPCODE_ROUTING_INFORMATION]        = {  4,  4, B },
+    [CEC_OPCODE_SET_STREAM_PATH]            = {  4,  4, B },
+    /* Standby */
+    [CEC_OPCODE_STANDBY]                    = {  2,  2, 0 },
+    /* One Touch Record */
+    [CEC_OPCODE_RECORD_OFF]                 = {  2,  2, D },
+    [CEC_OPCODE_RECORD_ON]                  = {  3, 10, D },
+    [CEC_OPCODE_RECORD_STATUS]              = {  3,  3, D },
+    [CEC_OPCODE_RECORD_TV_SCREEN]           = {  2,  2, D },
+    /* Timer Programming */
+    [CEC_OPCODE_CLEAR_ANALOGUE_TIMER]       = { 13, 13, D },
+    [CEC_OPCODE_CLEAR_DIGITAL_TIMER]        = { 16, 16, D },
+    [CEC_OPCODE_CLEAR_EXTERNAL_TIMER]       = { 11, 12, D },
+    [CEC_OPCODE_SET_ANALOGUE_TIMER]         = { 13, 13, D },
+    [CEC_OPCODE_SET_DIGITAL_TIMER]          = { 16, 16, D },
+    [CEC_OPCODE_SET_EXTERNAL_TIMER]         = { 11, 12, D },
+    [CEC_OPCODE_SET_TIMER_PROGRAM_TITLE]    = {  3, 16, D },
+    [CEC_OPCODE_TIMER_CLEARED_STATUS]       = {  3,  3, D },
+    [CEC_OPCODE_TIMER_STATUS]               = {  3,  5, D },
+    /* System Information */
+    [CEC_OPCODE_CEC_VERSION]                = {  3,  3, D },
+    [CEC_OPCODE_GET_CEC_VERSION]            = {  2,  2, D },
+    [CEC_OPCODE_GIVE_PHYSICAL_ADDRESS]      = {  2,  2, D },
+    [CEC_OPCODE_GET_MENU_LANGUAGE]          = {  2,  2, D },
+    [CEC_OPCODE_REPORT_PHYSICAL_ADDRESS]    = {  5,  5, B },
+    [CEC_OPCODE_SET_MENU_LANGUAGE]          = {  5,  5, B },
+    /* Deck Control */
+    [CEC_OPCODE_DECK_CONTROL]               = {  3,  3, D | NU },
+    [CEC_OPCODE_DECK_STATUS]                = {  3,  3, D },
+    [CEC_OPCODE_GIVE_DECK_STATUS]           = {  3,  3, D },
+    [CEC_OPCODE_PLAY]                       = {  3,  3, D | NU },
+    /* Tuner Control */
+    [CEC_OPCODE_GIVE_TUNER_DEVICE_STATUS]   = {  3,  3, D },
+    [CEC_OPCODE_SELECT_ANALOGUE_SERVICE]    = {  6,  6, D },
+    [CEC_OPCODE_SELECT_DIGITAL_SERVICE]     = {  9,  9, D },
+    [CEC_OPCODE_TUNER_DEVICE_STATUS]        = {  7, 10, D },
+    [CEC_OPCODE_TUNER_STEP_DECREMENT]       = {  2,  2, D },
+    [CEC_OPCODE_TUNER_STEP_INCREMENT]       = {  2,  2, D },
+    /* Vendor Specific Commands */
+    [CEC_OPCODE_DEVICE_VENDOR_ID]           = {  5,  5, B },
+    [CEC_OPCODE_GET_DEVICE_VENDOR_ID]       = {  2,  2, D },
+    [CEC_OPCODE_VENDOR_COMMAND]             = {  2, 16, D },
+    [CEC_OPCODE_VENDOR_COMMAND_WITH_ID]     = {  5, 16, 0 },
+    [CEC_OPCODE_VENDOR_REMOTE_BUTTON_DOWN]  = {  2, 16, 0 },
+    [CEC_OPCODE_VENDOR_REMOVE_BUTTON_UP]    = {  2,  2, 0 },
+    /* OSD Display, Device OSD Transfer */
+    [CEC_OPCODE_SET_OSD_STRING]             = {  4, 16, D },
+    [CEC_OPCODE_GIVE_OSD_NAME]              = {  2,  2, D },
+    [CEC_OPCODE_SET_OSD_NAME]               = {  3, 16, D },
+    /* Device Menu Control, Remote Control Passthrough */
+    [CEC_OPCODE_MENU_REQUEST]               = {  3,  3, D },
+    [CEC_OPCODE_MENU_STATUS]                = {  3,  3, D },
+    [CEC_OPCODE_USER_CONTROL_PRESSED]       = {  3, 16, D },
+    [CEC_OPCODE_USER_CONTROL_RELEASED]      = {  2,  2, D },
+    /* Power Status */
+    [CEC_OPCODE_GIVE_DEVICE_POWER_STATUS]   = {  2,  2, D },
+    [CEC_OPCODE_REPORT_POWER_STATUS]        = {  3,  3, D },
+    /* General Protocol */
+    [CEC_OPCODE_FEATURE_ABORT]              = {  4,  4, D },
+    [CEC_OPCODE_ABORT]                      = {  2,  2, D },
+    /* System Audio Control, Audio Rate Control */
+    [CEC_OPCODE_GIVE_AUDIO_STATUS]          = {  2,  2, D },
+    [CEC_OPCODE_GIVE_SYSTEM_AUDIO_MODE_STATUS] = { 2, 2, D },
+    [CEC_OPCODE_REPORT_AUDIO_STATUS]        = {  3,  3, D },
+    [CEC_OPCODE_SET_SYSTEM_AUDIO_MODE]      = {  3,  3, 0 },
+    [CEC_OPCODE_SYSTEM_AUDIO_MODE_REQUEST]  = {  2,  4, D },
+    [CEC_OPCODE_SYSTEM_AUDIO_MODE_STATUS]   = {  3,  3, D },
+    [CEC_OPCODE_SET_AUDIO_RATE]             = {  3,  3, D },
+    /* CDC - 1.4 */
+    [0xf8]                                  = {  5, 16, 0 },
+};
+#undef D
+#undef B
+#undef NU
+
+/**
+ * Handlers of received CEC messages, indexed by opcode.
+ */
+static struct cec_handler {
+    CECMessageHandler handler;
+    void *data;
+} handlers[256], default_handler;
+
+/**
+ * Queue of outgoing CEC frames. Only CECProcess() removes frames.
+ */
+static struct {
+    unsigned char buffer[CEC_MAX_FRAME_SIZE];
+    int size;
+    int retry;
+} tx_queue[CEC_TX_QUEUE_SIZE];
+
+static int tx_head;
+static int tx_count;
+/** time to send the head of the queue, in ms */
+static long long tx_due;
+static pthread_mutex_t tx_lock = PTHREAD_MUTEX_INITIALIZER;
+
 static int CECSetLogicalAddr(unsigned int laddr);
 
 #ifdef CEC_DEBUG
@@ -60,6 +193,9 @@ inline static void CECPrintFrame(unsigned char *buffer, unsigned int size);
 #endif
 
 static int fd = -1;
+static int epfd = -1;
+static int wake_fds[2] = { -1, -1 };
+static unsigned int cur_laddr = CEC_LADDR_UNREGISTERED;
 
 /**
  * Open device driver and assign CEC file descriptor.
@@ -68,17 +204,49 @@ static int fd = -1;
  */
 int CECOpen()
 {
-    int res = 1;
+    struct epoll_event ev;
 
     if (fd != -1)
         CECClose();
 
     if ((fd = open(CEC_DEVICE_NAME, O_RDWR)) < 0) {
         ALOGE("Can't open %s!\n", CEC_DEVICE_NAME);
-        res = 0;
+        return 0;
     }
 
-    return res;
+    /* CECProcess() sleeps until the device or the wake up pipe is readable */
+    if (pipe(wake_fds) < 0) {
+        ALOGE("pipe() failed!\n");
+        wake_fds[0] = wake_fds[1] = -1;
+        CECClose();
+        return 0;
+    }
+    fcntl(wake_fds[0], F_SETFL, O_NONBLOCK);
+    fcntl(wake_fds[1], F_SETFL, O_NONBLOCK);
+
+    if ((epfd = epoll_create(2)) < 0) {
+        ALOGE("epoll_create() failed!\n");
+        CECClose();
+        return 0;
+    }
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        ALOGE("epoll_ctl() failed!\n");
+        CECClose();
+        return 0;
+    }
+
+    ev.data.fd = wake_fds[0];
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, wake_fds[0], &ev) < 0) {
+        ALOGE("epoll_ctl() failed!\n");
+        CECClose();
+        return 0;
+    }
+
+    return 1;
 }
 
 /**
@@ -98,6 +266,23 @@ int CECClose()
         fd = -1;
     }
 
+    if (epfd != -1) {
+        close(epfd);
+        epfd = -1;
+    }
+
+    if (wake_fds[0] != -1) {
+        close(wake_fds[0]);
+        close(wake_fds[1]);
+        wake_fds[0] = wake_fds[1] = -1;
+    }
+
+    pthread_mutex_lock(&tx_lock);
+    tx_head = tx_count = 0;
+    pthread_mutex_unlock(&tx_lock);
+
+    cur_laddr = CEC_LADDR_UNREGISTERED;
+
     return res;
 }
 
@@ -249,6 +434,8 @@ int CECSetLogicalAddr(unsigned int laddr)
         return 0;
     }
 
+    cur_laddr = laddr;
+
     return 1;
 }
 
@@ -278,23 +465,13 @@ void CECPrintFrame(unsigned char *buffer, unsigned int size)
  *
  * @return 1 if message should be ignored, otherwise, return 0.
  */
-//TODO: not finished
 int CECIgnoreMessage(unsigned char opcode, unsigned char lsrc)
 {
-    int retval = 0;
-
     /* if a message coming from address 15 (unregistered) */
-    if (lsrc == CEC_LADDR_UNREGISTERED) {
-        switch (opcode) {
-        case CEC_OPCODE_DECK_CONTROL:
-        case CEC_OPCODE_PLAY:
-            retval = 1;
-        default:
-            break;
-        }
-    }
+    if (lsrc == CEC_LADDR_UNREGISTERED)
+        return (opcodes[opcode].flags & CEC_MSG_NO_UNREGISTERED) ? 1 : 0;
 
-    return retval;
+    return 0;
 }
 
 /**
@@ -305,49 +482,12 @@ int CECIgnoreMessage(unsigned char opcode, unsigned char lsrc)
  *
  * @return 0 if message should be ignored, otherwise, return 1.
  */
-//TODO: not finished
 int CECCheckMessageSize(unsigned char opcode, int size)
 {
-    int retval = 1;
-
-    switch (opcode) {
-    case CEC_OPCODE_REQUEST_ACTIVE_SOURCE:
-        if (size != 1)
-            retval = 0;
-        break;
-    case CEC_OPCODE_SET_SYSTEM_AUDIO_MODE:
-        if (size != 2)
-            retval = 0;
-        break;
-    case CEC_OPCODE_PLAY:
-    case CEC_OPCODE_DECK_CONTROL:
-    case CEC_OPCODE_SET_MENU_LANGUAGE:
-    case CEC_OPCODE_ACTIVE_SOURCE:
-    case CEC_OPCODE_ROUTING_INFORMATION:
-    case CEC_OPCODE_SET_STREAM_PATH:
-        if (size != 3)
-            retval = 0;
-        break;
-    case CEC_OPCODE_FEATURE_ABORT:
-    case CEC_OPCODE_DEVICE_VENDOR_ID:
-    case CEC_OPCODE_REPORT_PHYSICAL_ADDRESS:
-        if (size != 4)
-            retval = 0;
-        break;
-    case CEC_OPCODE_ROUTING_CHANGE:
-        if (size != 5)
-            retval = 0;
-        break;
-    /* CDC - 1.4 */
-    case 0xf8:
-        if (!(size > 5 && size <= 16))
-            retval = 0;
-        break;
-    default:
-        break;
-    }
+    if (!opcodes[opcode].max_size)
+        return 1;
 
-    return retval;
+    return (size >= opcodes[opcode].min_size && size <= opcodes[opcode].max_size) ? 1 : 0;
 }
 
 /**
@@ -358,29 +498,271 @@ int CECCheckMessageSize(unsigned char opcode, int size)
  *
  * @return 0 if message should be ignored, otherwise, return 1.
  */
-//TODO: not finished
 int CECCheckMessageMode(unsigned char opcode, int broadcast)
 {
-    int retval = 1;
-
-    switch (opcode) {
-    case CEC_OPCODE_REQUEST_ACTIVE_SOURCE:
-    case CEC_OPCODE_SET_MENU_LANGUAGE:
-    case CEC_OPCODE_ACTIVE_SOURCE:
-        if (!broadcast)
-            retval = 0;
-        break;
-    case CEC_OPCODE_GIVE_PHYSICAL_ADDRESS:
-    case CEC_OPCODE_DECK_CONTROL:
-    case CEC_OPCODE_PLAY:
-    case CEC_OPCODE_FEATURE_ABORT:
-    case CEC_OPCODE_ABORT:
-        if (broadcast)
-            retval = 0;
-        break;
-    default:
-        break;
+    if (broadcast)
+        return (opcodes[opcode].flags & CEC_MSG_DIRECT_ONLY) ? 0 : 1;
+
+    return (opcodes[opcode].flags & CEC_MSG_BROADCAST_ONLY) ? 0 : 1;
+}
+
+/**
+ * Set handler of received CEC message.
+ *
+ * @param opcode    [in] opcode of message.
+ * @param handler   [in] handler, NULL to use the default handler.
+ * @param data      [in] data passed to handler.
+ *
+ * @return 1 if success, otherwise, return 0.
+ */
+int CECSetHandler(unsigned char opcode, CECMessageHandler handler, void *data)
+{
+    handlers[opcode].handler = handler;
+    handlers[opcode].data = data;
+
+    return 1;
+}
+
+/**
+ * Set handler of received CEC messages that have no own handler.
+ *
+ * @param handler   [in] handler, NULL to drop such messages.
+ * @param data      [in] data passed to handler.
+ *
+ * @return 1 if success, otherwise, return 0.
+ */
+int CECSetDefaultHandler(CECMessageHandler handler, void *data)
+{
+    default_handler.handler = handler;
+    default_handler.data = data;
+
+    return 1;
+}
+
+/**
+ * Queue CEC message. It is sent by CECProcess(), and retransmitted with @n
+ * growing delay up to CEC_TX_RETRY times if sending fails.
+ *
+ * @param *buffer   [in] pointer to buffer address where message located.
+ * @param size      [in] message size.
+ *
+ * @return 1 if message is queued, otherwise, return 0.
+ */
+int CECQueueMessage(unsigned char *buffer, int size)
+{
+    int res = 1;
+
+    if (size <= 0 || size > CEC_MAX_FRAME_SIZE) {
+        ALOGE("size should not exceed %d\n", CEC_MAX_FRAME_SIZE);
+        return 0;
     }
 
-    return retval;
+    pthread_mutex_lock(&tx_lock);
+    if (tx_count == CEC_TX_QUEUE_SIZE) {
+        ALOGE("CEC queue is full!\n");
+        res = 0;
+    } else {
+        int i = (tx_head + tx_count) % CEC_TX_QUEUE_SIZE;
+
+        memcpy(tx_queue[i].buffer, buffer, size);
+        tx_queue[i].size = size;
+        tx_queue[i].retry = 0;
+        if (tx_count++ == 0)
+            tx_due = 0;
+    }
+    pthread_mutex_unlock(&tx_lock);
+
+    if (res)
+        CECWakeup();
+
+    return res;
+}
+
+/**
+ * Wake up CECProcess() waiting in another thread.
+ *
+ * @return 1 if success, otherwise, return 0.
+ */
+int CECWakeup()
+{
+    unsigned char c = 0;
+
+    if (wake_fds[1] == -1)
+        return 0;
+
+    /* a full pipe already wakes it up */
+    if (write(wake_fds[1], &c, 1) < 0 && errno != EAGAIN)
+        return 0;
+
+    return 1;
+}
+
+/**
+ * Get monotonic time in ms.
+ */
+static long long CECNow()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * Send queued messages which are due. @n
+ * Sending uses the blocking CECSendMessage(), write() returns after @n
+ * the driver finished the transmission, so a frame takes its bus time @n
+ * (about 2.4 ms per byte) of this thread.
+ *
+ * @return time to next retransmission in ms, or -1 if queue is empty.
+ */
+static int CECFlushQueue()
+{
+    int wait = -1;
+
+    pthread_mutex_lock(&tx_lock);
+    while (tx_count) {
+        long long now = CECNow();
+        int i = tx_head;
+        int sent;
+
+        if (tx_due > now) {
+            wait = (int)(tx_due - now);
+            break;
+        }
+
+        /* only this thread removes frames, the head stays valid unlocked */
+        pthread_mutex_unlock(&tx_lock);
+        sent = (CECSendMessage(tx_queue[i].buffer, tx_queue[i].size) == tx_queue[i].size);
+        pthread_mutex_lock(&tx_lock);
+
+        if (!sent && tx_queue[i].retry < CEC_TX_RETRY) {
+            tx_due = CECNow() + (CEC_TX_BACKOFF_MS << tx_queue[i].retry);
+            tx_queue[i].retry++;
+            continue;
+        }
+
+        if (!sent)
+            ALOGE("CECSendMessage() failed, opcode 0x%x dropped!\n",
+                  tx_queue[i].size > 1 ? tx_queue[i].buffer[1] : 0);
+
+        tx_head = (tx_head + 1) % CEC_TX_QUEUE_SIZE;
+        tx_count--;
+        tx_due = 0;
+    }
+    pthread_mutex_unlock(&tx_lock);
+
+    return wait;
+}
+
+/**
+ * Receive a CEC message, check it and pass it to its handler.
+ *
+ * @return 0 if the device failed, otherwise, return 1.
+ */
+static int CECDispatch()
+{
+    unsigned char buffer[CEC_MAX_FRAME_SIZE];
+    unsigned char reply[CEC_MAX_FRAME_SIZE];
+    unsigned char lsrc, opcode;
+    struct cec_handler *h;
+    int size;
+
+    size = read(fd, buffer, CEC_MAX_FRAME_SIZE);
+#if CEC_DEBUG
+    ALOGI("CECDispatch() : size(%d)", size);
+    if (size > 0)
+        CECPrintFrame(buffer, size);
+#endif
+
+    if (size < 0) {
+        if (errno == EINTR || errno == EAGAIN)
+            return 1;
+        ALOGE("read() failed!\n");
+        return 0;
+    }
+
+    if (size <= 1) // no data available or "Polling Message"
+        return 1;
+
+    lsrc = buffer[0] >> 4;
+
+    /* ignore messages with src address == own address */
+    if (lsrc == cur_laddr)
+        return 1;
+
+    opcode = buffer[1];
+
+    if (CECIgnoreMessage(opcode, lsrc)) {
+        ALOGE("### ignore message coming from address 15 (unregistered)\n");
+        return 1;
+    }
+
+    if (!CECCheckMessageSize(opcode, size)) {
+        ALOGE("### invalid message size: %d(opcode: 0x%x) ###\n", size, opcode);
+        return 1;
+    }
+
+    /* check if message broadcasted/directly addressed */
+    if (!CECCheckMessageMode(opcode, (buffer[0] & 0x0F) == CEC_MSG_BROADCAST ? 1 : 0)) {
+        ALOGE("### invalid message mode (directly addressed/broadcast) ###\n");
+        return 1;
+    }
+
+    h = handlers[opcode].handler ? &handlers[opcode] : &default_handler;
+    if (!h->handler)
+        return 1;
+
+    size = h->handler(buffer, size, reply, h->data);
+    if (size > 0)
+        CECQueueMessage(reply, size);
+
+    return 1;
+}
+
+/**
+ * Run CEC message engine once. Sleeps until a message is received, @n
+ * a queued message is due, CECWakeup() is called or timeout expires, @n
+ * then handles received messages and sends queued ones.
+ *
+ * @param timeout   [in] timeout in ms, -1 to wait without timeout.
+ *
+ * @return 1 if success, otherwise, return 0. @n
+ * It also returns 0 once the device reports an error or hang up, @n
+ * so a caller looping on it stops instead of spinning.
+ */
+int CECProcess(int timeout)
+{
+    struct epoll_event events[2];
+    int wait, n, i;
+
+    if (fd == -1) {
+        ALOGE("open device first!\n");
+        return 0;
+    }
+
+    wait = CECFlushQueue();
+    if (wait < 0 || (timeout >= 0 && timeout < wait))
+        wait = timeout;
+
+    n = epoll_wait(epfd, events, 2, wait);
+    if (n < 0)
+        return (errno == EINTR) ? 1 : 0;
+
+    for (i = 0; i < n; i++) {
+        if (events[i].data.fd == wake_fds[0]) {
+            unsigned char buf[16];
+            while (read(wake_fds[0], buf, sizeof(buf)) > 0)
+                ;
+        } else if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+            ALOGE("CEC device error or hang up!\n");
+            return 0;
+        } else if (!CECDispatch()) {
+            return 0;
+        }
+    }
+
+    CECFlushQueue();
+
+    return 1;
 }
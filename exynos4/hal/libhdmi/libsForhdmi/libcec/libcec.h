@@ -192,11 +192,36 @@ enum CECDeviceType {
     CEC_DEVICE_AUDIO,
 };
 
+/** Number of outgoing CEC frames that can be queued */
+#define CEC_TX_QUEUE_SIZE                 8
+/** Number of retransmissions of an outgoing CEC frame */
+#define CEC_TX_RETRY                      5
+/** Delay before first retransmission in ms, doubled every retry */
+#define CEC_TX_BACKOFF_MS                 10
+
+/**
+ * Handler of received CEC message.
+ *
+ * @param msg    [in] received frame, header block first.
+ * @param size   [in] frame size.
+ * @param reply  [out] frame to send back, CEC_MAX_FRAME_SIZE bytes.
+ * @param data   [in] data given when handler was set.
+ *
+ * @return size of reply frame, or 0 if there is no reply.
+ */
+typedef int (*CECMessageHandler)(unsigned char *msg, int size,
+                                 unsigned char *reply, void *data);
+
 int CECOpen();
 int CECClose();
 int CECAllocLogicalAddress(int paddr, enum CECDeviceType devtype);
 int CECSendMessage(unsigned char *buffer, int size);
 int CECReceiveMessage(unsigned char *buffer, int size, long timeout);
+int CECSetHandler(unsigned char opcode, CECMessageHandler handler, void *data);
+int CECSetDefaultHandler(CECMessageHandler handler, void *data);
+int CECQueueMessage(unsigned char *buffer, int size);
+int CECProcess(int timeout);
+int CECWakeup();
 
 int CECIgnoreMessage(unsigned char opcode, unsigned char lsrc);
 int CECCheckMessageSize(unsigned char opcode, int size);
@@ -31,6 +31,11 @@
 
 #define DDC_DEBUG 0
 
+/**
+ * @brief E-DDC block size, a segment holds two blocks.
+ */
+#define EDDC_BLOCK_SIZE     (0x80)
+
 /**
  * @brief DDC device name.
  * User should change this.
@@ -234,6 +239,85 @@ int EDDCRead(unsigned char segpointer, unsigned char segment, unsigned char addr
     return ret;
 }
 
+/**
+ * Read consecutive blocks though E-DDC. Each segment is read by one @n
+ * segment pointer, offset and read message, and as many segments as @n
+ * fit in I2C_RDRW_IOCTL_MAX_MSGS are read by one ioctl.
+ * @param   segpointer  [in]    Segment pointer
+ * @param   addr        [in]    Device address
+ * @param   block       [in]    First block to read
+ * @param   count       [in]    Number of blocks to read
+ * @param   buffer      [out]   Pointer to buffer to store data
+ * @return  If succeed in reading, return 1; Otherwise, return 0.
+ */
+int EDDCReadBlocks(unsigned char segpointer, unsigned char addr,
+  unsigned int block, unsigned int count, unsigned char* buffer)
+{
+    struct i2c_rdwr_ioctl_data msgset;
+    struct i2c_msg msgs[I2C_RDRW_IOCTL_MAX_MSGS];
+    unsigned char segments[I2C_RDRW_IOCTL_MAX_MSGS / 3];
+    unsigned char offsets[I2C_RDRW_IOCTL_MAX_MSGS / 3];
+    unsigned int end = block + count;
+
+    if (!DDCFileAvailable()) {
+#if DDC_DEBUG
+        ALOGE("%s: I2C_DDC is not available!!!!", __func__);
+#endif
+        return 0;
+    }
+
+    while (block < end) {
+        int nmsgs = 0, n = 0;
+
+        while (block < end && nmsgs + 3 <= I2C_RDRW_IOCTL_MAX_MSGS) {
+            // rest of the segment, or up to the last block
+            unsigned int blocks = (block % 2 == 0 && block + 1 < end) ? 2 : 1;
+
+            segments[n] = block / 2;
+            offsets[n] = (block % 2) * EDDC_BLOCK_SIZE;
+
+            // set segment pointer
+            msgs[nmsgs].addr  = segpointer>>1;
+            // ignore ack only if segment is "0"
+            msgs[nmsgs].flags = (segments[n] == 0) ? I2C_M_IGNORE_NAK : 0;
+            msgs[nmsgs].len   = 1;
+            msgs[nmsgs].buf   = &segments[n];
+            nmsgs++;
+
+            // set offset
+            msgs[nmsgs].addr  = addr>>1;
+            msgs[nmsgs].flags = 0;
+            msgs[nmsgs].len   = 1;
+            msgs[nmsgs].buf   = &offsets[n];
+            nmsgs++;
+
+            // read data
+            msgs[nmsgs].addr  = addr>>1;
+            msgs[nmsgs].flags = I2C_M_RD;
+            msgs[nmsgs].len   = blocks * EDDC_BLOCK_SIZE;
+            msgs[nmsgs].buf   = buffer;
+            nmsgs++;
+
+            buffer += blocks * EDDC_BLOCK_SIZE;
+            block += blocks;
+            n++;
+        }
+
+        msgset.nmsgs = nmsgs;
+        msgset.msgs  = msgs;
+
+        // eddc read
+        if (ioctl(ddc_fd, I2C_RDWR, &msgset) < 0) {
+#if DDC_DEBUG
+            ALOGE("%s: ioctl(I2C_RDWR) failed!!!", __func__);
+#endif
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
 /**
  * Write data though DDC. For more information of DDC, refer DDC Spec.
  * @param   addr    [in]    Device address
@@ -26,6 +26,8 @@ int DDCRead(unsigned char addr, unsigned char offset, unsigned int size, unsigne
 int DDCWrite(unsigned char addr, unsigned char offset, unsigned int size, unsigned char* buffer);
 int EDDCRead(unsigned char segpointer, unsigned char segment, unsigned char addr,
   unsigned char offset, unsigned int size, unsigned char* buffer);
+int EDDCReadBlocks(unsigned char segpointer, unsigned char addr,
+  unsigned int block, unsigned int count, unsigned char* buffer);
 int DDCClose();
 
 #ifdef __cplusplus
@@ -34,6 +34,8 @@
 
 #define NUM_OF_VIC_FOR_3D           16
 
+#define EDID_READ_RETRY             (3)
+
 /**
  * @var gEdidData
  * Pointer to EDID data
@@ -46,13 +48,6 @@ static unsigned char* gEdidData;
  */
 static int gExtensions;
 
-
-/**
- * @var aVIC
- * This contains first 16 VIC in EDID
- */
-static unsigned char aVIC[NUM_OF_VIC_FOR_3D];
-
 //! Structure for parsing video timing parameter in EDID
 static const struct edid_params {
     /** H Total */
@@ -152,6 +147,84 @@ static const struct edid_3d_mandatory {
     { v1280x720p_50Hz, HDMI_3D_TB_FORMAT },     // 1280x720p @ 50Hz
 };
 
+#define NUM_OF_VIDEO_PARAMS         (sizeof(aVideoParams)/sizeof(aVideoParams[0]))
+#define NUM_OF_3D_STRUCTURE         (HDMI_3D_SSH_FORMAT + 1)
+#define EDID_MAX_SAD                (32)
+#define EDID_CACHE_NUM              (4)
+
+#define EDID_SET_BIT(map, n)        ((map)[(n) >> 5] |= 1U << ((n) & 31))
+#define EDID_TEST_BIT(map, n)       ((map)[(n) >> 5] & (1U << ((n) & 31)))
+
+//! Capabilities of a sink, parsed once when its EDID is read
+struct edid_caps {
+    /** 1 if an EDID extension contains a HDMI VSDB */
+    int hdmi;
+
+    /** Established timings of EDID block */
+    unsigned char et;
+
+    /** Color space bytes of all timing extensions, or'ed */
+    unsigned char cs;
+
+    /** Bitmap of VICs in the SVDs of timing extensions */
+    unsigned int vic[128/32];
+
+    /** Bitmap of aVideoParams entries described by a DTD */
+    unsigned int dtd[(NUM_OF_VIDEO_PARAMS + 31)/32];
+
+    /** First 16 VIC in EDID, for the 3D structure mask */
+    unsigned char aVIC[NUM_OF_VIC_FOR_3D];
+
+    /** CEC physical address of first HDMI VSDB, -1 if there is none */
+    int phyAddr;
+
+    /** Deep color byte of HDMI VSDB, -1 if not available */
+    int deepColor;
+
+    /** Max TMDS clock in 5MHz unit, 0 if not available */
+    unsigned int maxTMDS;
+
+    /** 1 if there is an extended colorimetry block */
+    int colorimetryPresent;
+    unsigned char colorimetry;
+    unsigned char metadata;
+
+    /** Short Audio Descriptors of timing extensions, in EDID order */
+    unsigned char sad[EDID_MAX_SAD][3];
+    int numSAD;
+
+    /** Supported 3D structures per video format, [format][16:9 ratio] */
+    unsigned short structure3D[NUM_OF_VIDEO_PARAMS][2];
+};
+
+//! Parsed EDID of a sink seen before
+struct edid_cache {
+    /** EDID data, NULL if the entry is free */
+    unsigned char *data;
+
+    /** Number of EDID extensions */
+    int extensions;
+
+    /** Last use of the entry, the oldest entry is replaced first */
+    unsigned int stamp;
+
+    /** Capabilities parsed from data */
+    struct edid_caps caps;
+};
+
+/**
+ * @var gCaps
+ * Capabilities of current sink, NULL if EDID is not read
+ */
+static const struct edid_caps *gCaps;
+
+/**
+ * @var gCache
+ * EDIDs read so far, so reconnecting a sink does not read and parse it again
+ */
+static struct edid_cache gCache[EDID_CACHE_NUM];
+static unsigned int gCacheStamp;
+
 /**
  * Calculate a checksum.
  *
@@ -181,7 +254,8 @@ static int CalcChecksum(const unsigned char* const buffer, const int size)
 }
 
 /**
- * Read EDID Block(128 bytes)
+ * Read EDID Block(128 bytes). A block with wrong checksum is read again, @n
+ * up to EDID_READ_RETRY times.
  *
  * @param   blockNum    [in]    Number of block to read @n
  *                  For example, EDID block = 0, EDID first Extension = 1, and so on.
@@ -191,7 +265,7 @@ static int CalcChecksum(const unsigned char* const buffer, const int size)
  */
 static int ReadEDIDBlock(const unsigned int blockNum, unsigned char* const outBuffer)
 {
-    int segNum, offset, dataPtr;
+    int segNum, offset, dataPtr, retry;
 
     // check parameter
     if (outBuffer == NULL) {
@@ -204,15 +278,19 @@ static int ReadEDIDBlock(const unsigned int blockNum, unsigned char* const outBu
     offset = (blockNum % 2) * SIZEOFEDIDBLOCK;
     dataPtr = (blockNum) * SIZEOFEDIDBLOCK;
 
-    // read block
-    if (!EDDCRead(EDID_SEGMENT_POINTER, segNum, EDID_ADDR, offset, SIZEOFEDIDBLOCK, outBuffer)) {
-        DPRINTF("Fail to Read %dth EDID Block\n", blockNum);
-        return 0;
-    }
+    // read block, again if it is corrupted on the way
+    for (retry = 0; ; retry++) {
+        if (!EDDCRead(EDID_SEGMENT_POINTER, segNum, EDID_ADDR, offset, SIZEOFEDIDBLOCK, outBuffer)) {
+            DPRINTF("Fail to Read %dth EDID Block\n", blockNum);
+            return 0;
+        }
+
+        if (CalcChecksum(outBuffer, SIZEOFEDIDBLOCK))
+            break;
 
-    if (!CalcChecksum(outBuffer, SIZEOFEDIDBLOCK)) {
         DPRINTF("CheckSum fail : %dth EDID Block\n", blockNum);
-        return 0;
+        if (retry + 1 >= EDID_READ_RETRY)
+            return 0;
     }
 
     // print data
@@ -240,34 +318,104 @@ static inline int EDIDValid(void)
 }
 
 /**
- * Search HDMI Vender Specific Data Block(VSDB) in EDID extension block.
+ * Read consecutive EDID Blocks. They are read together, then blocks @n
+ * with wrong checksum are read again one by one.
  *
- * @param   extension   [in]    the number of EDID extension block to check
+ * @param   blockNum    [in]    Number of first block to read
+ * @param   count       [in]    Number of blocks to read
+ * @param   outBuffer   [out]   Pointer to buffer to store EDID data
  *
- * @return  if there is a HDMI VSDB, return the offset from start of @n
- *        EDID extension block. if there is no VSDB, return 0.
+ * @return  If fail to read, return 0; Otherwise, return 1.
  */
-static int GetVSDBOffset(const int extension)
+static int ReadEDIDBlocks(const unsigned int blockNum, const unsigned int count,
+                          unsigned char* const outBuffer)
 {
-    unsigned int BlockOffset = extension*SIZEOFEDIDBLOCK;
-    unsigned int offset = BlockOffset + EDID_DATA_BLOCK_START_POS;
-    unsigned int tag,blockLen,DTDOffset;
+    unsigned int i;
+    int read;
+
+    read = EDDCReadBlocks(EDID_SEGMENT_POINTER, EDID_ADDR, blockNum, count, outBuffer);
+    if (!read)
+        DPRINTF("Fail to Read %d EDID Blocks from %dth\n", count, blockNum);
+
+    for (i = 0; i < count; i++) {
+        unsigned char *block = outBuffer + i*SIZEOFEDIDBLOCK;
+
+        if (read && CalcChecksum(block, SIZEOFEDIDBLOCK))
+            continue;
+
+        if (!ReadEDIDBlock(blockNum + i, block))
+            return 0;
+    }
+
+    return 1;
+}
+
+/**
+ * Read the checksum byte of an EDID Block.
+ *
+ * @param   blockNum    [in]    Number of block to read
+ * @param   outSum      [out]   Checksum of the block
+ *
+ * @return  If fail to read, return 0; Otherwise, return 1.
+ */
+static int ReadEDIDChecksum(const unsigned int blockNum, unsigned char* const outSum)
+{
+    int segNum, offset;
+
+    segNum = blockNum / 2;
+    offset = (blockNum % 2) * SIZEOFEDIDBLOCK + SIZEOFEDIDBLOCK - 1;
 
-    if (!EDIDValid() || (extension > gExtensions)) {
-        DPRINTF("EDID Data is not available\n");
+    if (!EDDCRead(EDID_SEGMENT_POINTER, segNum, EDID_ADDR, offset, 1, outSum)) {
+        DPRINTF("Fail to Read checksum of %dth EDID Block\n", blockNum);
         return 0;
     }
 
-    DTDOffset = gEdidData[BlockOffset + EDID_DETAILED_TIMING_OFFSET_POS];
+    return 1;
+}
+
+/**
+ * Get the end of data block collection in EDID extension block.
+ *
+ * @param   extension   [in]    the number of EDID extension block
+ *
+ * @return  the offset of first DTD from start of EDID data.
+ */
+static unsigned int GetDataBlockEnd(const int extension)
+{
+    unsigned int BlockOffset = extension*SIZEOFEDIDBLOCK;
+    unsigned int DTDOffset = gEdidData[BlockOffset + EDID_DETAILED_TIMING_OFFSET_POS];
+
+    if (DTDOffset > SIZEOFEDIDBLOCK)
+        DTDOffset = SIZEOFEDIDBLOCK;
+
+    return BlockOffset + DTDOffset;
+}
+
+/**
+ * Search HDMI Vender Specific Data Block(VSDB) in EDID extension block.
+ *
+ * @param   extension   [in]    the number of EDID extension block to check
+ *
+ * @return  if there is a HDMI VSDB, return the offset from start of @n
+ *        EDID data. if there is no VSDB, return 0.
+ */
+static unsigned int GetVSDBOffset(const int extension)
+{
+    unsigned int offset = extension*SIZEOFEDIDBLOCK + EDID_DATA_BLOCK_START_POS;
+    unsigned int EndOffset = GetDataBlockEnd(extension);
+    unsigned int tag,blockLen;
 
     // check if there is HDMI VSDB
-    while (offset < BlockOffset + DTDOffset) {
+    while (offset < EndOffset) {
         // find the block tag and length
         // tag
         tag = gEdidData[offset] & EDID_TAG_CODE_MASK;
         // block len
         blockLen = (gEdidData[offset] & EDID_DATA_BLOCK_SIZE_MASK) + 1;
 
+        if (offset + blockLen > EndOffset)
+            break;
+
         // check if it is HDMI VSDB
         // if so, check identifier value, if it's hdmi vsbd - return offset
         if (tag == EDID_VSDB_TAG_VAL &&
@@ -286,170 +434,127 @@ static int GetVSDBOffset(const int extension)
 }
 
 /**
- * Check if Sink supports the HDMI mode.
- * @return  If Sink supports HDMI mode, return 1; Otherwise, return 0.
+ * Check if EDID extension block is timing extension block or not.
+ * @param   extension   [in] The number of EDID extension block to check
+ * @param   hdmi        [in] 1 if Sink supports the HDMI mode
+ * @return  If the block is timing extension, return 1; Otherwise, return 0.
  */
-static int CheckHDMIMode(void)
+static int IsTimingExtension(const int extension, const int hdmi)
 {
-    int i;
+    const unsigned char *block = gEdidData + extension*SIZEOFEDIDBLOCK;
 
-    // read EDID
-    if (!EDIDRead())
+    if (block[EDID_TIMING_EXT_TAG_ADDR_POS] != EDID_TIMING_EXT_TAG_VAL)
         return 0;
 
-    // find VSDB
-    for (i = 1; i <= gExtensions; i++)
-        if (GetVSDBOffset(i) > 0) // if there is a VSDB, it means RX support HDMI mode
-            return 1;
+    // check extension revsion number
+    // revision num == 3
+    if (block[EDID_TIMING_EXT_REV_NUMBER_POS] == 3)
+        return 1;
 
-    return 0;
+    // revison num != 3 && DVI mode
+    return !hdmi && block[EDID_TIMING_EXT_REV_NUMBER_POS] != 2;
 }
 
 /**
- * Check if EDID extension block is timing extension block or not.
- * @param   extension   [in] The number of EDID extension block to check
- * @return  If the block is timing extension, return 1; Otherwise, return 0.
+ * Check if a Detailed Timing Descriptor(DTD) describes the video format.
+ * @param   videoFormat [in]    Video format to check
+ * @param   dtd         [in]    Pointer to DTD
+ * @return  If the DTD describes the video format, return 1; Otherwise, return 0.
  */
-static int IsTimingExtension(const int extension)
+static int IsVideoDTD(const enum VideoFormat videoFormat, const unsigned char* const dtd)
 {
-    int ret = 0;
-    if (!EDIDValid() || (extension > gExtensions)) {
-        DPRINTF("EDID Data is not available\n");
-        return ret;
+    unsigned int hblank = 0, hactive = 0, vblank = 0, vactive = 0, pixelclock = 0;
+    unsigned int vHActive = 0, vVActive = 0, vVBlank = 0;
+    unsigned int EDIDpixelclock;
+
+    // get pixel clock
+    pixelclock = (dtd[EDID_DTD_PIXELCLOCK_POS2] << SIZEOFBYTE);
+    pixelclock |= dtd[EDID_DTD_PIXELCLOCK_POS1];
+
+    // get HBLANK value in pixels
+    hblank = dtd[EDID_DTD_HBLANK_POS2] & EDID_DTD_HBLANK_POS2_MASK;
+    hblank <<= SIZEOFBYTE; // lower 4 bits
+    hblank |= dtd[EDID_DTD_HBLANK_POS1];
+
+    // get HACTIVE value in pixels
+    hactive = dtd[EDID_DTD_HACTIVE_POS2] & EDID_DTD_HACTIVE_POS2_MASK;
+    hactive <<= (SIZEOFBYTE/2); // upper 4 bits
+    hactive |= dtd[EDID_DTD_HACTIVE_POS1];
+
+    // get VBLANK value in pixels
+    vblank = dtd[EDID_DTD_VBLANK_POS2] & EDID_DTD_VBLANK_POS2_MASK;
+    vblank <<= SIZEOFBYTE; // lower 4 bits
+    vblank |= dtd[EDID_DTD_VBLANK_POS1];
+
+    // get VACTIVE value in pixels
+    vactive = dtd[EDID_DTD_VACTIVE_POS2] & EDID_DTD_VACTIVE_POS2_MASK;
+    vactive <<= (SIZEOFBYTE/2); // upper 4 bits
+    vactive |= dtd[EDID_DTD_VACTIVE_POS1];
+
+    vHActive = aVideoParams[videoFormat].HTotal - aVideoParams[videoFormat].HBlank;
+    if (aVideoParams[videoFormat].interlaced == 1) {
+        if (aVideoParams[videoFormat].VIC == v1920x1080i_50Hz_1250) { // VTOP and VBOT are same
+            vVActive = (aVideoParams[videoFormat].VTotal - aVideoParams[videoFormat].VBlank*2)/2;
+            vVBlank = aVideoParams[videoFormat].VBlank;
+        } else {
+            vVActive = (aVideoParams[videoFormat].VTotal - aVideoParams[videoFormat].VBlank*2 - 1)/2;
+            vVBlank = aVideoParams[videoFormat].VBlank;
+        }
+    } else {
+        vVActive = aVideoParams[videoFormat].VTotal - aVideoParams[videoFormat].VBlank;
+        vVBlank = aVideoParams[videoFormat].VBlank;
     }
 
-    if (gEdidData[extension*SIZEOFEDIDBLOCK] == EDID_TIMING_EXT_TAG_VAL) {
-        // check extension revsion number
-        // revision num == 3
-        if (gEdidData[extension*SIZEOFEDIDBLOCK + EDID_TIMING_EXT_REV_NUMBER_POS] == 3)
-            ret = 1;
-        // revison num != 3 && DVI mode
-        else if (!CheckHDMIMode() &&
-                gEdidData[extension*SIZEOFEDIDBLOCK + EDID_TIMING_EXT_REV_NUMBER_POS] != 2)
-            ret = 1;
-    }
-    return ret;
+    if (hblank != aVideoParams[videoFormat].HBlank || vblank != vVBlank // blank
+        || hactive != vHActive || vactive != vVActive) //line
+        return 0;
+
+    EDIDpixelclock = aVideoParams[videoFormat].PixelClock;
+    EDIDpixelclock /= 100; pixelclock /= 100;
+
+    return pixelclock == EDIDpixelclock;
 }
 
 /**
- * Check if the video format is contained in - @n
- * Detailed Timing Descriptor(DTD) of EDID extension block.
- * @param   extension   [in]    Number of EDID extension block to check
- * @param   videoFormat [in]    Video format to check
- * @return  If the video format is contained in DTD of EDID extension block, -@n
- *        return 1; Otherwise, return 0.
+ * Mark video formats described by Detailed Timing Descriptors(DTD).
+ * @param   caps        [out]   Capabilities to update
+ * @param   StartOffset [in]    Offset of first DTD from start of EDID data
+ * @param   EndOffset   [in]    Offset of end of DTDs from start of EDID data
  */
-static int IsContainVideoDTD(const int extension,const enum VideoFormat videoFormat)
+static void ParseDTD(struct edid_caps * const caps,
+                     const unsigned int StartOffset, const unsigned int EndOffset)
 {
-    int i, StartOffset, EndOffset;
-
-    if (!EDIDValid() || (extension > gExtensions)) {
-        DPRINTF("EDID Data is not available\n");
-        return 0;
-    }
-
-    // if edid block( 0th block )
-    if (extension == 0) {
-        StartOffset = EDID_DTD_START_ADDR;
-        EndOffset = StartOffset + EDID_DTD_TOTAL_LENGTH;
-    } else { // if edid extension block
-        StartOffset = extension*SIZEOFEDIDBLOCK + gEdidData[extension*SIZEOFEDIDBLOCK + EDID_DETAILED_TIMING_OFFSET_POS];
-        EndOffset = (extension+1)*SIZEOFEDIDBLOCK;
-    }
+    unsigned int i, format;
 
-    // check DTD(Detailed Timing Description)
-    for (i = StartOffset; i < EndOffset; i+= EDID_DTD_BYTE_LENGTH) {
-        unsigned int hblank = 0, hactive = 0, vblank = 0, vactive = 0, interlaced = 0, pixelclock = 0;
-        unsigned int vHActive = 0, vVActive = 0, vVBlank = 0;
-
-        // get pixel clock
-        pixelclock = (gEdidData[i+EDID_DTD_PIXELCLOCK_POS2] << SIZEOFBYTE);
-        pixelclock |= gEdidData[i+EDID_DTD_PIXELCLOCK_POS1];
-
-        if (!pixelclock)
+    for (i = StartOffset; i + EDID_DTD_BYTE_LENGTH <= EndOffset; i += EDID_DTD_BYTE_LENGTH) {
+        // skip monitor descriptors
+        if (!gEdidData[i+EDID_DTD_PIXELCLOCK_POS1] && !gEdidData[i+EDID_DTD_PIXELCLOCK_POS2])
             continue;
 
-        // get HBLANK value in pixels
-        hblank = gEdidData[i+EDID_DTD_HBLANK_POS2] & EDID_DTD_HBLANK_POS2_MASK;
-        hblank <<= SIZEOFBYTE; // lower 4 bits
-        hblank |= gEdidData[i+EDID_DTD_HBLANK_POS1];
-
-        // get HACTIVE value in pixels
-        hactive = gEdidData[i+EDID_DTD_HACTIVE_POS2] & EDID_DTD_HACTIVE_POS2_MASK;
-        hactive <<= (SIZEOFBYTE/2); // upper 4 bits
-        hactive |= gEdidData[i+EDID_DTD_HACTIVE_POS1];
-
-        // get VBLANK value in pixels
-        vblank = gEdidData[i+EDID_DTD_VBLANK_POS2] & EDID_DTD_VBLANK_POS2_MASK;
-        vblank <<= SIZEOFBYTE; // lower 4 bits
-        vblank |= gEdidData[i+EDID_DTD_VBLANK_POS1];
-
-        // get VACTIVE value in pixels
-        vactive = gEdidData[i+EDID_DTD_VACTIVE_POS2] & EDID_DTD_VACTIVE_POS2_MASK;
-        vactive <<= (SIZEOFBYTE/2); // upper 4 bits
-        vactive |= gEdidData[i+EDID_DTD_VACTIVE_POS1];
-
-        vHActive = aVideoParams[videoFormat].HTotal - aVideoParams[videoFormat].HBlank;
-        if (aVideoParams[videoFormat].interlaced == 1) {
-            if (aVideoParams[videoFormat].VIC == v1920x1080i_50Hz_1250) { // VTOP and VBOT are same
-                vVActive = (aVideoParams[videoFormat].VTotal - aVideoParams[videoFormat].VBlank*2)/2;
-                vVBlank = aVideoParams[videoFormat].VBlank;
-            } else {
-                vVActive = (aVideoParams[videoFormat].VTotal - aVideoParams[videoFormat].VBlank*2 - 1)/2;
-                vVBlank = aVideoParams[videoFormat].VBlank;
-            }
-        } else {
-            vVActive = aVideoParams[videoFormat].VTotal - aVideoParams[videoFormat].VBlank;
-            vVBlank = aVideoParams[videoFormat].VBlank;
-        }
-
-        // get Interlaced Mode Value
-        interlaced = (int)(gEdidData[i+EDID_DTD_INTERLACE_POS] & EDID_DTD_INTERLACE_MASK);
-        if (interlaced)
-            interlaced = 1;
-
-        DPRINTF("EDID: hblank = %d,vblank = %d, hactive = %d, vactive = %d\n"
-                            ,hblank,vblank,hactive,vactive);
-        DPRINTF("REQ: hblank = %d,vblank = %d, hactive = %d, vactive = %d\n"
-                            ,aVideoParams[videoFormat].HBlank
-                            ,vVBlank,vHActive,vVActive);
-
-        if (hblank == aVideoParams[videoFormat].HBlank && vblank == vVBlank // blank
-            && hactive == vHActive && vactive == vVActive) { //line
-            unsigned int EDIDpixelclock = aVideoParams[videoFormat].PixelClock;
-            EDIDpixelclock /= 100; pixelclock /= 100;
-
-            if (pixelclock == EDIDpixelclock) {
-                DPRINTF("Sink Support the Video mode\n");
-                return 1;
+        for (format = 0; format < NUM_OF_VIDEO_PARAMS; format++) {
+            if (IsVideoDTD((enum VideoFormat)format, gEdidData + i)) {
+                DPRINTF("Sink Support the Video mode %d\n", format);
+                EDID_SET_BIT(caps->dtd, format);
             }
         }
     }
-    return 0;
 }
 
 /**
- * Check if a VIC(Video Identification Code) is contained in -@n
- * EDID extension block.
- * @param   extension   [in]    Number of EDID extension block to check
- * @param   VIC      [in]   VIC to check
- * @return  If the VIC is contained in contained in EDID extension block, -@n
- *        return 1; Otherwise, return 0.
+ * Parse the data block collection of EDID extension block.
+ * @param   caps        [out]   Capabilities to update
+ * @param   extension   [in]    The number of EDID extension block
+ * @param   timing      [in]    1 if the block is timing extension
+ * @param   vicCount    [in/out] Number of VIC saved in caps->aVIC
  */
-static int IsContainVIC(const int extension, const int VIC)
+static void ParseDataBlocks(struct edid_caps * const caps, const int extension,
+                            const int timing, int * const vicCount)
 {
-    unsigned int StartAddr = extension*SIZEOFEDIDBLOCK;
-    unsigned int ExtAddr = StartAddr + EDID_DATA_BLOCK_START_POS;
-    unsigned int tag,blockLen;
-    unsigned int DTDStartAddr = gEdidData[StartAddr + EDID_DETAILED_TIMING_OFFSET_POS];
-
-    if (!EDIDValid() || (extension > gExtensions)) {
-        DPRINTF("EDID Data is not available\n");
-        return 0;
-    }
+    unsigned int ExtAddr = extension*SIZEOFEDIDBLOCK + EDID_DATA_BLOCK_START_POS;
+    unsigned int EndAddr = GetDataBlockEnd(extension);
+    unsigned int tag,blockLen,i;
 
-    // while
-    while (ExtAddr < StartAddr + DTDStartAddr) {
+    while (ExtAddr < EndAddr) {
         // find the block tag and length
         // tag
         tag = gEdidData[ExtAddr] & EDID_TAG_CODE_MASK;
@@ -458,317 +563,94 @@ static int IsContainVIC(const int extension, const int VIC)
         DPRINTF("tag = %d\n",tag);
         DPRINTF("blockLen = %d\n",blockLen-1);
 
-        // check if it is short video description
+        if (ExtAddr + blockLen > EndAddr)
+            break;
+
+        // Short Video Descriptors
         if (tag == EDID_SHORT_VID_DEC_TAG_VAL) {
-            // if so, check SVD
-            unsigned int i;
             for (i = 1; i < blockLen; i++) {
-                DPRINTF("EDIDVIC = %d\n",gEdidData[ExtAddr+i] & EDID_SVD_VIC_MASK);
-                DPRINTF("VIC = %d\n",VIC);
+                unsigned int vic = gEdidData[ExtAddr+i] & EDID_SVD_VIC_MASK;
+                DPRINTF("EDIDVIC = %d\n",vic);
+
+                // first 16 VIC of all extensions
+                if (*vicCount < NUM_OF_VIC_FOR_3D)
+                    caps->aVIC[(*vicCount)++] = vic;
+                if (timing)
+                    EDID_SET_BIT(caps->vic, vic);
+            }
+        }
 
-                // check VIC with SVDB
-                if (VIC == (gEdidData[ExtAddr+i] & EDID_SVD_VIC_MASK)) {
-                    DPRINTF("Sink Device supports requested video mode\n");
-                    return 1;
-                }
+        // Short Audio Descriptors
+        if (timing && tag == EDID_SHORT_AUD_DEC_TAG_VAL) {
+            for (i = 1; i + 2 < blockLen && caps->numSAD < EDID_MAX_SAD; i += 3) {
+                memcpy(caps->sad[caps->numSAD++], gEdidData + ExtAddr + i, 3);
             }
         }
+
+        // extended colorimetry, only the first block is used
+        if (timing && !caps->colorimetryPresent &&
+            tag == EDID_EXTENDED_TAG_VAL && // extended tag
+            gEdidData[ExtAddr+1] == EDID_EXTENDED_COLORIMETRY_VAL && // colorimetry block
+            (blockLen-1) == EDID_EXTENDED_COLORIMETRY_BLOCK_LEN) { // check length
+            caps->colorimetryPresent = 1;
+            caps->colorimetry = gEdidData[ExtAddr + 2];
+            caps->metadata = gEdidData[ExtAddr + 3];
+
+            DPRINTF("EDID extened colorimetry = %x\n",caps->colorimetry);
+            DPRINTF("EDID gamut metadata profile = %x\n",caps->metadata);
+        }
+
         // else find next block
         ExtAddr += blockLen;
     }
-
-    return 0;
 }
 
 /**
  * Check if EDID contains the video format.
+ * @param   caps        [in]    Capabilities of Sink
  * @param   videoFormat [in]    Video format to check
  * @param   pixelRatio  [in]    Pixel aspect ratio of video format to check
  * @return  if EDID contains the video format, return 1; Otherwise, return 0.
  */
-static int CheckResolution(const enum VideoFormat videoFormat,
+static int CheckResolution(const struct edid_caps * const caps,
+                            const enum VideoFormat videoFormat,
                             const enum PixelAspectRatio pixelRatio)
 {
-    int i, vic;
-
-    // read EDID
-    if (!EDIDRead())
-        return 0;
+    unsigned int vic = (pixelRatio == HDMI_PIXEL_RATIO_16_9) ?
+            aVideoParams[videoFormat].VIC16_9 : aVideoParams[videoFormat].VIC;
 
     // check ET(Established Timings) for 640x480p@60Hz
     if (videoFormat == v640x480p_60Hz // if it's 640x480p@60Hz
-        && (gEdidData[EDID_ET_POS] & EDID_ET_640x480p_VAL)) // it support
+        && (caps->et & EDID_ET_640x480p_VAL)) // it support
          return 1;
 
-    // check STI(Standard Timing Identification)
-    // do not need
-
-    // check DTD(Detailed Timing Description) of EDID block(0th)
-    if (IsContainVideoDTD(0,videoFormat))
-        return 1;
-
-    // check EDID Extension
-    vic = (pixelRatio == HDMI_PIXEL_RATIO_16_9) ?
-            aVideoParams[videoFormat].VIC16_9 : aVideoParams[videoFormat].VIC;
-
-    // find VSDB
-    for (i = 1; i <= gExtensions; i++) {
-        if (IsTimingExtension(i)) // if it's timing block
-            if (IsContainVIC(i, vic) || IsContainVideoDTD(i, videoFormat))
-                return 1;
-    }
-
-    return 0;
-}
-
-/**
- * Check if EDID supports the color depth.
- * @param   depth [in]  Color depth
- * @param   space [in]  Color space
- * @return  If EDID supports the color depth, return 1; Otherwise, return 0.
- */
-static int CheckColorDepth(const enum ColorDepth depth,const enum ColorSpace space)
-{
-    int i;
-    unsigned int StartAddr;
-
-    // if color depth == 24 bit, no need to check
-    if (depth == HDMI_CD_24)
-        return 1;
-
-    // check EDID data is valid or not
-    // read EDID
-    if (!EDIDRead())
-        return 0;
-
-    // find VSDB
-    for (i = 1; i <= gExtensions; i++) {
-        if (IsTimingExtension(i) // if it's timing block
-            && ((StartAddr = GetVSDBOffset(i)) > 0)) { // check block
-            int blockLength = gEdidData[StartAddr] & EDID_DATA_BLOCK_SIZE_MASK;
-            if (blockLength >= EDID_DC_POS) {
-                // get supported DC value
-                int deepColor = gEdidData[StartAddr + EDID_DC_POS] & EDID_DC_MASK;
-                DPRINTF("EDID deepColor = %x\n",deepColor);
-                // check supported DeepColor
-                // if YCBCR444
-                if (space == HDMI_CS_YCBCR444) {
-                    if ( !(deepColor & EDID_DC_YCBCR_VAL))
-                        return 0;
-                }
-
-                // check colorDepth
-                switch (depth) {
-                case HDMI_CD_36:
-                    deepColor &= EDID_DC_36_VAL;
-                    break;
-                case HDMI_CD_30:
-                    deepColor &= EDID_DC_30_VAL;
-                    break;
-                default :
-                    deepColor = 0;
-                }
-                if (deepColor)
-                    return 1;
-                else
-                    return 0;
-            }
-        }
-    }
-
-    return 0;
-}
-
-/**
- * Check if EDID supports the color space.
- * @param   space [in]  Color space
- * @return  If EDID supports the color space, return 1; Otherwise, return 0.
- */
-static int CheckColorSpace(const enum ColorSpace space)
-{
-    int i;
-
-    // RGB is default
-    if (space == HDMI_CS_RGB)
-        return 1;
-
-    // check EDID data is valid or not
-    // read EDID
-    if (!EDIDRead())
-        return 0;
-
-    // find VSDB
-    for (i = 1; i <= gExtensions; i++) {
-        if (IsTimingExtension(i)) { // if it's timing block
-            // read Color Space
-            int CS = gEdidData[i*SIZEOFEDIDBLOCK + EDID_COLOR_SPACE_POS];
-
-            if ((space == HDMI_CS_YCBCR444 && (CS & EDID_YCBCR444_CS_MASK)) || // YCBCR444
-                    (space == HDMI_CS_YCBCR422 && (CS & EDID_YCBCR422_CS_MASK))) // YCBCR422
-                return 1;
-        }
-    }
-    return 0;
-}
-
-/**
- * Check if EDID supports the colorimetry.
- * @param   color [in]  Colorimetry
- * @return  If EDID supports the colorimetry, return 1; Otherwise, return 0.
- */
-static int CheckColorimetry(const enum HDMIColorimetry color)
-{
-    int i;
-
-    // do not need to parse if not extended colorimetry
-    if (color == HDMI_COLORIMETRY_NO_DATA ||
-            color == HDMI_COLORIMETRY_ITU601 ||
-            color == HDMI_COLORIMETRY_ITU709)
-        return 1;
-
-    // read EDID
-    if (!EDIDRead())
-       return 0;
-
-    // find VSDB
-    for (i = 1; i <= gExtensions; i++) {
-        if (IsTimingExtension(i)) { // if it's timing block
-            // check address
-            unsigned int ExtAddr = i*SIZEOFEDIDBLOCK + EDID_DATA_BLOCK_START_POS;
-            unsigned int EndAddr = i*SIZEOFEDIDBLOCK + gEdidData[i*SIZEOFEDIDBLOCK + EDID_DETAILED_TIMING_OFFSET_POS];
-            unsigned int tag,blockLen;
-
-            while (ExtAddr < EndAddr) {
-                // find the block tag and length
-                // tag
-                tag = gEdidData[ExtAddr] & EDID_TAG_CODE_MASK;
-                // block len
-                blockLen = (gEdidData[ExtAddr] & EDID_DATA_BLOCK_SIZE_MASK) + 1;
-
-                // check if it is colorimetry block
-                if (tag == EDID_EXTENDED_TAG_VAL && // extended tag
-                    gEdidData[ExtAddr+1] == EDID_EXTENDED_COLORIMETRY_VAL && // colorimetry block
-                    (blockLen-1) == EDID_EXTENDED_COLORIMETRY_BLOCK_LEN) { // check length
-                    // get supported DC value
-                    int colorimetry = (gEdidData[ExtAddr + 2]);
-                    int metadata = (gEdidData[ExtAddr + 3]);
-
-                    DPRINTF("EDID extened colorimetry = %x\n",colorimetry);
-                    DPRINTF("EDID gamut metadata profile = %x\n",metadata);
-
-                    // check colorDepth
-                    switch (color) {
-                    case HDMI_COLORIMETRY_EXTENDED_xvYCC601:
-                        if (colorimetry & EDID_XVYCC601_MASK && metadata)
-                            return 1;
-                        break;
-                    case HDMI_COLORIMETRY_EXTENDED_xvYCC709:
-                        if (colorimetry & EDID_XVYCC709_MASK && metadata)
-                            return 1;
-                        break;
-                    default:
-                        break;
-                    }
-                    return 0;
-                }
-                // else find next block
-                ExtAddr += blockLen;
-            }
-        }
-    }
-
-    return 0;
-}
-
-/**
- * Get Max TMDS clock that HDMI Rx can receive.
- * @return  If available, return MaxTMDS clock; Otherwise, return 0.
- */
-static unsigned int GetMaxTMDS(void)
-{
-    int i;
-    unsigned int StartAddr;
-
-    // find VSDB
-    for (i = 1; i <= gExtensions; i++) {
-        if (IsTimingExtension(i) // if it's timing block
-            && ((StartAddr = GetVSDBOffset(i)) > 0)) { // check block
-            int blockLength = gEdidData[StartAddr] & EDID_DATA_BLOCK_SIZE_MASK;
-            if (blockLength >= EDID_MAX_TMDS_POS) {
-                // get supported DC value
-                return gEdidData[StartAddr + EDID_MAX_TMDS_POS];
-            }
-        }
-    }
-
-    return 0;
-}
-
-/**
- * Save first 16 VIC of EDID
- */
-static void SaveVIC(void)
-{
-    int extension;
-    int vic_count = 0;
-    for (extension = 1; extension <= gExtensions && vic_count < NUM_OF_VIC_FOR_3D; extension++) {
-        unsigned int StartAddr = extension*SIZEOFEDIDBLOCK;
-        unsigned int ExtAddr = StartAddr + EDID_DATA_BLOCK_START_POS;
-        unsigned int tag,blockLen;
-        unsigned int DTDStartAddr = gEdidData[StartAddr + EDID_DETAILED_TIMING_OFFSET_POS];
-
-        while (ExtAddr < StartAddr + DTDStartAddr) {
-            // find the block tag and length
-            // tag
-            tag = gEdidData[ExtAddr] & EDID_TAG_CODE_MASK;
-            // block len
-            blockLen = (gEdidData[ExtAddr] & EDID_DATA_BLOCK_SIZE_MASK) + 1;
-
-            // check if it is short video description
-            if (tag == EDID_SHORT_VID_DEC_TAG_VAL) {
-                // if so, check SVD
-                unsigned int edid_index;
-                for (edid_index = 1; edid_index < blockLen && vic_count < NUM_OF_VIC_FOR_3D; edid_index++) {
-                    DPRINTF("EDIDVIC = %d\r\n", gEdidData[ExtAddr+edid_index] & EDID_SVD_VIC_MASK);
-
-                    // check VIC with SVDB
-                    aVIC[vic_count++] = (gEdidData[ExtAddr+edid_index] & EDID_SVD_VIC_MASK);
-                }
-            }
-            // else find next block
-            ExtAddr += blockLen;
-        }
-    }
+    // check DTD of EDID block and timing extensions, SVD of timing extensions
+    return EDID_TEST_BIT(caps->dtd, videoFormat) || EDID_TEST_BIT(caps->vic, vic);
 }
 
 /**
- * Check if Rx supports requested 3D format.
- * @param   pVideo [in]   HDMI Video Parameter
+ * Check if Rx supports requested 3D format, from HDMI VSDBs.
+ * @param   caps        [in]    Capabilities of Sink, other than 3D
+ * @param   videoFormat [in]    Video format to check
+ * @param   pixelRatio  [in]    Pixel aspect ratio of video format to check
+ * @param   format      [in]    3D structure to check
  * @return  If Rx supports requested 3D format, return 1; Otherwise, return 0.
  */
-static int EDID3DFormatSupport(const struct HDMIVideoParameter * const pVideo)
+static int Check3DFormat(const struct edid_caps * const caps,
+                         const enum VideoFormat videoFormat,
+                         const enum PixelAspectRatio pixelRatio,
+                         const enum HDMI3DVideoStructure format)
 {
-    int edid_index;
+    int extension, edid_index;
     unsigned int StartAddr;
     unsigned int vic;
-    vic = (pVideo->pixelAspectRatio == HDMI_PIXEL_RATIO_16_9) ?
-            aVideoParams[pVideo->resolution].VIC16_9 : aVideoParams[pVideo->resolution].VIC;
-
-    // if format == 2D, no need to check
-    if (pVideo->hdmi_3d_format == HDMI_2D_VIDEO_FORMAT)
-        return 1;
-
-    // check EDID data is valid or not
-    if (!EDIDRead())
-        return 0;
-
-    // save first 16 VIC to check
-    SaveVIC();
+    vic = (pixelRatio == HDMI_PIXEL_RATIO_16_9) ?
+            aVideoParams[videoFormat].VIC16_9 : aVideoParams[videoFormat].VIC;
 
     // find VSDB
-    for (edid_index = 1; edid_index <= gExtensions; edid_index++) {
-        if (IsTimingExtension(edid_index) // if it's timing block
-            && ((StartAddr = GetVSDBOffset(edid_index)) > 0)) { // check block
+    for (extension = 1; extension <= gExtensions; extension++) {
+        if (IsTimingExtension(extension, caps->hdmi) // if it's timing block
+            && ((StartAddr = GetVSDBOffset(extension)) > 0)) { // check block
             unsigned int blockLength = gEdidData[StartAddr] & EDID_DATA_BLOCK_SIZE_MASK;
             unsigned int VSDBHdmiVideoPre = 0;
             unsigned int VSDB3DPresent = 0;
@@ -806,16 +688,12 @@ static int EDID3DFormatSupport(const struct HDMIVideoParameter * const pVideo)
             HDMIVICLen = (gEdidData[StartAddr + EDID_HDMI_EXT_LENGTH_POS]
                     & EDID_HDMI_VSDB_VIC_LEN_MASK) >> EDID_HDMI_VSDB_VIC_LEN_BIT;
 
-            if (pVideo->hdmi_3d_format == HDMI_VIC_FORMAT) {
-                if (HDMIVICLen) {
-                    for (edid_index = 0; edid_index < (int)HDMIVICLen; edid_index++) {
-                        if (vic == gEdidData[StartAddr + EDID_HDMI_EXT_LENGTH_POS + edid_index])
-                            return 1;
-                    }
-                    return 0;
-                } else {
-                    return 0;
+            if (format == HDMI_VIC_FORMAT) {
+                for (edid_index = 0; edid_index < (int)HDMIVICLen; edid_index++) {
+                    if (vic == gEdidData[StartAddr + EDID_HDMI_EXT_LENGTH_POS + edid_index])
+                        return 1;
                 }
+                return 0;
             }
 
             // HDMI_3D_LEN
@@ -838,11 +716,11 @@ static int EDID3DFormatSupport(const struct HDMIVideoParameter * const pVideo)
             if (VSDB3DPresent) {
                 DPRINTF("VSDB 3D Present!!!\r\n");
                 // check with 3D madatory format
-                if (CheckResolution(pVideo->resolution, pVideo->pixelAspectRatio)) {
+                if (CheckResolution(caps, videoFormat, pixelRatio)) {
                     int size = sizeof(edid_3d)/sizeof(struct edid_3d_mandatory);
                     for (edid_index = 0; edid_index < size; edid_index++) {
-                        if (edid_3d[edid_index].resolution == pVideo->resolution &&
-                            edid_3d[edid_index].hdmi_3d_format == pVideo->hdmi_3d_format )
+                        if (edid_3d[edid_index].resolution == videoFormat &&
+                            edid_3d[edid_index].hdmi_3d_format == format)
                             return 1;
                     }
                 }
@@ -869,18 +747,15 @@ static int EDID3DFormatSupport(const struct HDMIVideoParameter * const pVideo)
                     Hdmi3DMask |= gEdidData[StartAddr + EDID_HDMI_EXT_LENGTH_POS + HDMIVICLen + 4];
                     DPRINTF("VSDB 3D Structure!!! = [0x%02x]\r\n",Hdmi3DStructure);
                     DPRINTF("VSDB 3D Mask!!! = [0x%02x]\r\n",Hdmi3DMask);
-                    DPRINTF("Current 3D Video format!!! = [%d]\r\n",pVideo->hdmi_3d_format);
-                    DPRINTF("Current 3D Video format!!! = [0x%02x]\r\n",1<<pVideo->hdmi_3d_format);
                 }
 
                 // check 3D Structure and Mask
-                if (Hdmi3DStructure & (1<<pVideo->hdmi_3d_format)) {
+                if (Hdmi3DStructure & (1<<format)) {
                     DPRINTF("VSDB 3D Structure Contains Current Video Structure!!!\r\n");
                     // check first 16 EDID
                     for (edid_index = 0; edid_index < NUM_OF_VIC_FOR_3D; edid_index++) {
-                        DPRINTF("VIC = %d, EDID Vic = %d!!!\r\n",vic,aVIC[edid_index]);
                         if (Hdmi3DMask & (1<<edid_index)) {
-                            if (vic == aVIC[edid_index]) {
+                            if (vic == caps->aVIC[edid_index]) {
                                 DPRINTF("VSDB 3D Mask Contains Current Video format!!!\r\n");
                                 return 1;
                             }
@@ -907,7 +782,8 @@ static int EDID3DFormatSupport(const struct HDMIVideoParameter * const pVideo)
                                                  (VSDB3DMultiPresent>>EDID_HDMI_3D_MULTI_PRESENT_BIT) * 2 + edid_index * 2]
                                                  & EDID_HDMI_3D_STRUCTURE_MASK;
                         Hdmi3DStructure = (1<<Hdmi3DStructure);
-                        if (Hdmi3DStructure == pVideo->hdmi_3d_format && vic == aVIC[VICOrder])
+                        if (Hdmi3DStructure == format &&
+                            VICOrder < NUM_OF_VIC_FOR_3D && vic == caps->aVIC[VICOrder])
                             return 1;
                     }
                 }
@@ -918,6 +794,321 @@ static int EDID3DFormatSupport(const struct HDMIVideoParameter * const pVideo)
     return 0;
 }
 
+/**
+ * Parse EDID data into the capabilities of Sink.
+ * Every query afterwards is answered from the capabilities only.
+ * @param   caps    [out]   Capabilities of Sink
+ */
+static void ParseEDID(struct edid_caps * const caps)
+{
+    int i, ratio, format, structure;
+    int vicCount = 0;
+    int tmdsFound = 0;
+
+    memset(caps, 0, sizeof(*caps));
+    caps->phyAddr = -1;
+    caps->deepColor = -1;
+
+    caps->et = gEdidData[EDID_ET_POS];
+
+    // DTD(Detailed Timing Description) of EDID block(0th)
+    ParseDTD(caps, EDID_DTD_START_ADDR, EDID_DTD_START_ADDR + EDID_DTD_TOTAL_LENGTH);
+
+    // if there is a VSDB, it means RX support HDMI mode
+    for (i = 1; i <= gExtensions; i++) {
+        if (GetVSDBOffset(i) > 0) {
+            caps->hdmi = 1;
+            break;
+        }
+    }
+
+    for (i = 1; i <= gExtensions; i++) {
+        unsigned int BlockOffset = i*SIZEOFEDIDBLOCK;
+        int timing = IsTimingExtension(i, caps->hdmi);
+        unsigned int StartAddr;
+        unsigned int blockLength;
+
+        ParseDataBlocks(caps, i, timing, &vicCount);
+        if (!timing)
+            continue;
+
+        // read Color Space
+        caps->cs |= gEdidData[BlockOffset + EDID_COLOR_SPACE_POS];
+
+        // DTD of timing extension
+        if (GetDataBlockEnd(i) >= BlockOffset + EDID_DATA_BLOCK_START_POS)
+            ParseDTD(caps, GetDataBlockEnd(i), BlockOffset + SIZEOFEDIDBLOCK);
+
+        StartAddr = GetVSDBOffset(i);
+        if (!StartAddr)
+            continue;
+
+        blockLength = gEdidData[StartAddr] & EDID_DATA_BLOCK_SIZE_MASK;
+
+        if (caps->phyAddr < 0) {
+            caps->phyAddr = gEdidData[StartAddr + EDID_CEC_PHYICAL_ADDR] << 8;
+            caps->phyAddr |= gEdidData[StartAddr + EDID_CEC_PHYICAL_ADDR+1];
+            DPRINTF("phyAddr = %x\n",caps->phyAddr);
+        }
+
+        if (caps->deepColor < 0 && blockLength >= EDID_DC_POS) {
+            caps->deepColor = gEdidData[StartAddr + EDID_DC_POS] & EDID_DC_MASK;
+            DPRINTF("EDID deepColor = %x\n",caps->deepColor);
+        }
+
+        if (!tmdsFound && blockLength >= EDID_MAX_TMDS_POS) {
+            caps->maxTMDS = gEdidData[StartAddr + EDID_MAX_TMDS_POS];
+            tmdsFound = 1;
+        }
+    }
+
+    // 3D structures of every video format
+    for (format = 0; format < (int)NUM_OF_VIDEO_PARAMS; format++) {
+        for (ratio = 0; ratio < 2; ratio++) {
+            for (structure = 0; structure < NUM_OF_3D_STRUCTURE; structure++) {
+                if (Check3DFormat(caps, (enum VideoFormat)format,
+                                  ratio ? HDMI_PIXEL_RATIO_16_9 : HDMI_PIXEL_RATIO_4_3,
+                                  (enum HDMI3DVideoStructure)structure))
+                    caps->structure3D[format][ratio] |= 1 << structure;
+            }
+        }
+    }
+}
+
+/**
+ * Check if Sink supports the HDMI mode.
+ * @return  If Sink supports HDMI mode, return 1; Otherwise, return 0.
+ */
+static int CheckHDMIMode(void)
+{
+    // read EDID
+    if (!EDIDRead())
+        return 0;
+
+    return gCaps->hdmi;
+}
+
+/**
+ * Check if EDID supports the color depth.
+ * @param   depth [in]  Color depth
+ * @param   space [in]  Color space
+ * @return  If EDID supports the color depth, return 1; Otherwise, return 0.
+ */
+static int CheckColorDepth(const enum ColorDepth depth,const enum ColorSpace space)
+{
+    int deepColor;
+
+    // if color depth == 24 bit, no need to check
+    if (depth == HDMI_CD_24)
+        return 1;
+
+    // check EDID data is valid or not
+    // read EDID
+    if (!EDIDRead())
+        return 0;
+
+    // get supported DC value
+    deepColor = gCaps->deepColor;
+    if (deepColor < 0)
+        return 0;
+
+    // check supported DeepColor
+    // if YCBCR444
+    if (space == HDMI_CS_YCBCR444) {
+        if ( !(deepColor & EDID_DC_YCBCR_VAL))
+            return 0;
+    }
+
+    // check colorDepth
+    switch (depth) {
+    case HDMI_CD_36:
+        deepColor &= EDID_DC_36_VAL;
+        break;
+    case HDMI_CD_30:
+        deepColor &= EDID_DC_30_VAL;
+        break;
+    default :
+        deepColor = 0;
+    }
+
+    return deepColor ? 1 : 0;
+}
+
+/**
+ * Check if EDID supports the color space.
+ * @param   space [in]  Color space
+ * @return  If EDID supports the color space, return 1; Otherwise, return 0.
+ */
+static int CheckColorSpace(const enum ColorSpace space)
+{
+    // RGB is default
+    if (space == HDMI_CS_RGB)
+        return 1;
+
+    // check EDID data is valid or not
+    // read EDID
+    if (!EDIDRead())
+        return 0;
+
+    if ((space == HDMI_CS_YCBCR444 && (gCaps->cs & EDID_YCBCR444_CS_MASK)) || // YCBCR444
+            (space == HDMI_CS_YCBCR422 && (gCaps->cs & EDID_YCBCR422_CS_MASK))) // YCBCR422
+        return 1;
+
+    return 0;
+}
+
+/**
+ * Check if EDID supports the colorimetry.
+ * @param   color [in]  Colorimetry
+ * @return  If EDID supports the colorimetry, return 1; Otherwise, return 0.
+ */
+static int CheckColorimetry(const enum HDMIColorimetry color)
+{
+    // do not need to parse if not extended colorimetry
+    if (color == HDMI_COLORIMETRY_NO_DATA ||
+            color == HDMI_COLORIMETRY_ITU601 ||
+            color == HDMI_COLORIMETRY_ITU709)
+        return 1;
+
+    // read EDID
+    if (!EDIDRead())
+       return 0;
+
+    if (!gCaps->colorimetryPresent)
+        return 0;
+
+    // check colorDepth
+    switch (color) {
+    case HDMI_COLORIMETRY_EXTENDED_xvYCC601:
+        if (gCaps->colorimetry & EDID_XVYCC601_MASK && gCaps->metadata)
+            return 1;
+        break;
+    case HDMI_COLORIMETRY_EXTENDED_xvYCC709:
+        if (gCaps->colorimetry & EDID_XVYCC709_MASK && gCaps->metadata)
+            return 1;
+        break;
+    default:
+        break;
+    }
+
+    return 0;
+}
+
+/**
+ * Check if Rx supports requested 3D format.
+ * @param   pVideo [in]   HDMI Video Parameter
+ * @return  If Rx supports requested 3D format, return 1; Otherwise, return 0.
+ */
+static int EDID3DFormatSupport(const struct HDMIVideoParameter * const pVideo)
+{
+    int ratio = (pVideo->pixelAspectRatio == HDMI_PIXEL_RATIO_16_9);
+
+    // if format == 2D, no need to check
+    if (pVideo->hdmi_3d_format == HDMI_2D_VIDEO_FORMAT)
+        return 1;
+
+    // check EDID data is valid or not
+    if (!EDIDRead())
+        return 0;
+
+    return (gCaps->structure3D[pVideo->resolution][ratio] & (1 << pVideo->hdmi_3d_format)) ? 1 : 0;
+}
+
+/**
+ * Look up the EDID of Rx in the cache. @n
+ * EDID block must be same, extension blocks are compared by their checksum.
+ * @param   block [in]   EDID block(0th) of Rx
+ * @return  If the EDID is cached, return the entry; Otherwise, return NULL.
+ */
+static struct edid_cache *FindCachedEDID(const unsigned char* const block)
+{
+    unsigned char sums[256];
+    int extensions = block[EDID_EXTENSION_NUMBER_POS];
+    int sumsRead = 0;
+    int i, ext;
+
+    for (i = 0; i < EDID_CACHE_NUM; i++) {
+        struct edid_cache *entry = &gCache[i];
+
+        if (!entry->data || memcmp(entry->data, block, SIZEOFEDIDBLOCK))
+            continue;
+
+        // read checksum of extensions once
+        if (!sumsRead) {
+            for (ext = 1; ext <= extensions; ext++) {
+                if (!ReadEDIDChecksum(ext, &sums[ext]))
+                    return NULL;
+            }
+            sumsRead = 1;
+        }
+
+        for (ext = 1; ext <= extensions; ext++) {
+            if (entry->data[(ext+1)*SIZEOFEDIDBLOCK - 1] != sums[ext])
+                break;
+        }
+        if (ext > extensions)
+            return entry;
+    }
+
+    return NULL;
+}
+
+/**
+ * Read EDID extensions of Rx and parse EDID into a cache entry.
+ * @param   block [in]   EDID block(0th) of Rx
+ * @return  If success, return the entry; Otherwise, return NULL.
+ */
+static struct edid_cache *ReadEDID(const unsigned char* const block)
+{
+    struct edid_cache *entry = &gCache[0];
+    unsigned char *data;
+    int extensions, i;
+
+    // get extension
+    extensions = block[EDID_EXTENSION_NUMBER_POS];
+
+    // prepare buffer
+    data = (unsigned char*)malloc((extensions+1)*SIZEOFEDIDBLOCK);
+    if (!data)
+        return NULL;
+
+    // copy EDID Block 0
+    memcpy(data,block,SIZEOFEDIDBLOCK);
+
+    // read EDID Extension 1~extensions
+    if (extensions && !ReadEDIDBlocks(1, extensions, data+SIZEOFEDIDBLOCK)) {
+        free(data);
+        return NULL;
+    }
+
+    // check if extension is more than 1, and first extension block is not block map.
+    if (extensions > 1 && data[SIZEOFEDIDBLOCK] != EDID_BLOCK_MAP_EXT_TAG_VAL) {
+        DPRINTF("EDID has more than 1 extension but, first extension block is not block map\n");
+        free(data);
+        return NULL;
+    }
+
+    // use a free entry, or replace the least recently used one
+    for (i = 0; i < EDID_CACHE_NUM; i++) {
+        if (!gCache[i].data) {
+            entry = &gCache[i];
+            break;
+        }
+        if (gCache[i].stamp < entry->stamp)
+            entry = &gCache[i];
+    }
+
+    free(entry->data);
+    entry->data = data;
+    entry->extensions = extensions;
+
+    gEdidData = data;
+    gExtensions = extensions;
+    ParseEDID(&entry->caps);
+
+    return entry;
+}
+
 /**
  * Initialize EDID library. This will intialize DDC library.
  * @return  If success, return 1; Otherwise, return 0.
@@ -942,13 +1133,15 @@ int EDIDClose(void)
 }
 
 /**
- * Read EDID data of Rx.
+ * Read EDID data of Rx. @n
+ * If Rx was connected before, only EDID block and the checksums of @n
+ * extensions are read and the parsed EDID is taken from the cache.
  * @return If success, return 1; Otherwise, return 0;
  */
 int EDIDRead(void)
 {
-    int block,dataPtr;
     unsigned char temp[SIZEOFEDIDBLOCK];
+    struct edid_cache *entry;
 
     // if already read??
     if (EDIDValid())
@@ -959,46 +1152,32 @@ int EDIDRead(void)
     if (!ReadEDIDBlock(0,temp))
         return 0;
 
-    // get extension
-    gExtensions = temp[EDID_EXTENSION_NUMBER_POS];
-
-    // prepare buffer
-    gEdidData = (unsigned char*)malloc((gExtensions+1)*SIZEOFEDIDBLOCK);
-    if (!gEdidData)
-        return 0;
-
-    // copy EDID Block 0
-    memcpy(gEdidData,temp,SIZEOFEDIDBLOCK);
-
-    // read EDID Extension
-    for (block = 1,dataPtr = SIZEOFEDIDBLOCK; block <= gExtensions; block++,dataPtr+=SIZEOFEDIDBLOCK) {
-        // read extension 1~gExtensions
-        if (!ReadEDIDBlock(block, gEdidData+dataPtr)) {
-            // reset buffer
-            EDIDReset();
+    entry = FindCachedEDID(temp);
+    if (entry) {
+        DPRINTF("EDID is cached\n");
+    } else {
+        entry = ReadEDID(temp);
+        if (!entry)
             return 0;
-        }
     }
 
-    // check if extension is more than 1, and first extension block is not block map.
-    if (gExtensions > 1 && gEdidData[SIZEOFEDIDBLOCK] != EDID_BLOCK_MAP_EXT_TAG_VAL) {
-        // reset buffer
-        DPRINTF("EDID has more than 1 extension but, first extension block is not block map\n");
-        EDIDReset();
-        return 0;
-    }
+    entry->stamp = ++gCacheStamp;
+
+    gEdidData = entry->data;
+    gExtensions = entry->extensions;
+    gCaps = &entry->caps;
 
     return 1;
 }
 
 /**
- * Reset stored EDID data.
+ * Reset stored EDID data. Parsed EDID stays in the cache.
  */
 void EDIDReset(void)
 {
     if (gEdidData) {
-        free(gEdidData);
         gEdidData = NULL;
+        gCaps = NULL;
         DPRINTF("\t\t\t\tEDID is reset!!!\n");
     }
 }
@@ -1010,32 +1189,17 @@ void EDIDReset(void)
  */
 int EDIDGetCECPhysicalAddress(int* const outAddr)
 {
-    int i;
-    unsigned int StartAddr;
-
     // check EDID data is valid or not
     // read EDID
     if (!EDIDRead())
         return 0;
 
-    // find VSDB
-    for (i = 1; i <= gExtensions; i++) {
-        if (IsTimingExtension(i) // if it's timing block
-            && (StartAddr = GetVSDBOffset(i)) > 0) { // check block
-            // get supported DC value
-            // int tempDC1 = (int)(gEdidData[tempAddr+EDID_DC_POS]);
-            int phyAddr = gEdidData[StartAddr + EDID_CEC_PHYICAL_ADDR] << 8;
-            phyAddr |= gEdidData[StartAddr + EDID_CEC_PHYICAL_ADDR+1];
-
-            DPRINTF("phyAddr = %x\n",phyAddr);
-
-            *outAddr = phyAddr;
+    if (gCaps->phyAddr < 0)
+        return 0;
 
-            return 1;
-        }
-    }
+    *outAddr = gCaps->phyAddr;
 
-    return 0;
+    return 1;
 }
 
 /**
@@ -1077,8 +1241,13 @@ int EDIDVideoResolutionSupport(struct HDMIVideoParameter * const video)
         return 0;
     }
 
+    if ((unsigned int)video->resolution >= NUM_OF_VIDEO_PARAMS) {
+        DPRINTF("Unknown Video Resolution %d\n", video->resolution);
+        return 0;
+    }
+
     // get max tmds
-    MaxTMDS = GetMaxTMDS()*5;
+    MaxTMDS = gCaps->maxTMDS*5;
 
     // Check MAX TMDS
     TMDSClock = aVideoParams[video->resolution].PixelClock/100;
@@ -1094,7 +1263,7 @@ int EDIDVideoResolutionSupport(struct HDMIVideoParameter * const video)
     }
 
     // check resolution
-    if (!CheckResolution(video->resolution,video->pixelAspectRatio)) {
+    if (!CheckResolution(gCaps,video->resolution,video->pixelAspectRatio)) {
         DPRINTF("Video Resolution Not Supported\n");
         return 0;
     }
@@ -1188,73 +1357,44 @@ int EDIDAudioModeSupport(struct HDMIAudioParameter * const audio)
         return 0;
     }
 
-    // check EDID Extension
-    // find timing block
-    for (i = 1; i <= gExtensions; i++) {
-        if (IsTimingExtension(i)) { // if it's timing block
-            // find Short Audio Description
-            unsigned int StartAddr = i*SIZEOFEDIDBLOCK;
-            unsigned int ExtAddr = StartAddr + EDID_DATA_BLOCK_START_POS;
-            unsigned int tag,blockLen;
-            unsigned int DTDStartAddr = gEdidData[StartAddr + EDID_DETAILED_TIMING_OFFSET_POS];
-
-            while (ExtAddr < StartAddr + DTDStartAddr) {
-                // find the block tag and length
-                // tag
-                tag = gEdidData[ExtAddr] & EDID_TAG_CODE_MASK;
-                // block len
-                blockLen = (gEdidData[ExtAddr] & EDID_DATA_BLOCK_SIZE_MASK) + 1;
-
-                DPRINTF("tag = %d\n",tag);
-                DPRINTF("blockLen = %d\n",blockLen-1);
-
-                // check if it is short video description
-                if (tag == EDID_SHORT_AUD_DEC_TAG_VAL) {
-                    // if so, check SAD
-                    unsigned int j, channelNum;
-                    int audioFormat,sampleFreq,wordLen;
-                    for (j = 1; j < blockLen; j += 3) {
-                        audioFormat = gEdidData[ExtAddr+j] & EDID_SAD_CODE_MASK;
-                        channelNum = gEdidData[ExtAddr+j] & EDID_SAD_CHANNEL_MASK;
-                        sampleFreq = gEdidData[ExtAddr+j+1];
-                        wordLen = gEdidData[ExtAddr+j+2];
-
-                        DPRINTF("request = %d, EDIDAudioFormatCode = %d\n",(audio->formatCode)<<3, audioFormat);
-                        DPRINTF("request = %d, EDIDChannelNumber= %d\n",(audio->channelNum)-1, channelNum);
-                        DPRINTF("request = %d, EDIDSampleFreq= %d\n",1<<(audio->sampleFreq), sampleFreq);
-                        DPRINTF("request = %d, EDIDWordLeng= %d\n",1<<(audio->wordLength), wordLen);
-
-                        // check parameter
-                        // check audioFormat
-                        if (audioFormat & ( (audio->formatCode) << 3) &&  // format code
-                                channelNum >= ( (audio->channelNum) -1) &&  // channel number
-                                (sampleFreq & (1<<(audio->sampleFreq)))) { // sample frequency
-                            if (audioFormat == LPCM_FORMAT) { // check wordLen
-                                int ret = 0;
-                                switch (audio->wordLength) {
-                                case WORD_16:
-                                case WORD_17:
-                                case WORD_18:
-                                case WORD_19:
-                                case WORD_20:
-                                    ret = wordLen & (1<<1);
-                                    break;
-                                case WORD_21:
-                                case WORD_22:
-                                case WORD_23:
-                                case WORD_24:
-                                    ret = wordLen & (1<<2);
-                                    break;
-                                }
-                                return ret;
-                            }
-                            return 1; // if not LPCM
-                        }
-                    }
+    // check Short Audio Descriptions of timing extensions
+    for (i = 0; i < gCaps->numSAD; i++) {
+        const unsigned char *sad = gCaps->sad[i];
+        int audioFormat = sad[0] & EDID_SAD_CODE_MASK;
+        unsigned int channelNum = sad[0] & EDID_SAD_CHANNEL_MASK;
+        int sampleFreq = sad[1];
+        int wordLen = sad[2];
+
+        DPRINTF("request = %d, EDIDAudioFormatCode = %d\n",(audio->formatCode)<<3, audioFormat);
+        DPRINTF("request = %d, EDIDChannelNumber= %d\n",(audio->channelNum)-1, channelNum);
+        DPRINTF("request = %d, EDIDSampleFreq= %d\n",1<<(audio->sampleFreq), sampleFreq);
+        DPRINTF("request = %d, EDIDWordLeng= %d\n",1<<(audio->wordLength), wordLen);
+
+        // check parameter
+        // check audioFormat
+        if (audioFormat & ( (audio->formatCode) << 3) &&  // format code
+                channelNum >= ( (audio->channelNum) -1) &&  // channel number
+                (sampleFreq & (1<<(audio->sampleFreq)))) { // sample frequency
+            if (audioFormat == LPCM_FORMAT) { // check wordLen
+                int ret = 0;
+                switch (audio->wordLength) {
+                case WORD_16:
+                case WORD_17:
+                case WORD_18:
+                case WORD_19:
+                case WORD_20:
+                    ret = wordLen & (1<<1);
+                    break;
+                case WORD_21:
+                case WORD_22:
+                case WORD_23:
+                case WORD_24:
+                    ret = wordLen & (1<<2);
+                    break;
                 }
-                // else find next block
-                ExtAddr += blockLen;
+                return ret;
             }
+            return 1; // if not LPCM
         }
     }
 
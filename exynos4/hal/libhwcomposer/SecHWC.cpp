@@ -30,6 +30,8 @@
 #include <EGL/egl.h>
 #include <fcntl.h>
 #include <hardware_legacy/uevent.h>
+#include <poll.h>
+#include <sys/eventfd.h>
 #include <sys/prctl.h>
 #include <sys/resource.h>
 
@@ -665,6 +667,18 @@ static int hwc_prepare(hwc_composer_device_1_t *dev, size_t numDisplays, hwc_dis
     return 0;
 }
 
+static unsigned int hwc_count_ioctls(struct hwc_context_t *ctx)
+{
+    unsigned int total, skipped;
+
+    fimc_get_ioctl_count(&total, &skipped);
+
+    for (int i = 0; i < NUM_OF_WIN; i++)
+        total += ctx->win[i].num_ioctls;
+
+    return total;
+}
+
 static int hwc_set(hwc_composer_device_1_t *dev,
                    size_t numDisplays,
                    hwc_display_contents_1_t** displays)
@@ -680,6 +694,10 @@ static int hwc_set(hwc_composer_device_1_t *dev,
     struct sec_rect src_work_rect;
     struct sec_rect dst_work_rect;
     bool need_swap_buffers = ctx->num_of_fb_layer > 0;
+    unsigned int ioctls_before = hwc_count_ioctls(ctx);
+#if defined(BOARD_USES_HDMI)
+    buffer_handle_t hdmi_handle = NULL;
+#endif
 
     memset(&src_img, 0, sizeof(src_img));
     memset(&dst_img, 0, sizeof(dst_img));
@@ -764,6 +782,9 @@ static int hwc_set(hwc_composer_device_1_t *dev,
                 // initialize the src & dist context for fimc
                 set_src_dst_img_rect(cur, win, &src_img, &dst_img,
                                 &src_work_rect, &dst_work_rect, i);
+#if defined(BOARD_USES_HDMI)
+                hdmi_handle = cur->handle;
+#endif
 
                 ret = runFimc(ctx,
                             &src_img, &src_work_rect,
@@ -820,6 +841,12 @@ static int hwc_set(hwc_composer_device_1_t *dev,
             return HWC_EGL_ERROR;
     }
 
+    ctx->stats.frames++;
+    ctx->stats.last_frame_ioctls = hwc_count_ioctls(ctx) - ioctls_before;
+    ctx->stats.total_ioctls += ctx->stats.last_frame_ioctls;
+    if (ctx->stats.last_frame_ioctls > ctx->stats.max_frame_ioctls)
+        ctx->stats.max_frame_ioctls = ctx->stats.last_frame_ioctls;
+
 #if defined(BOARD_USES_HDMI)
     android::SecHdmiClient *mHdmiClient = android::SecHdmiClient::getInstance();
 
@@ -875,7 +902,7 @@ static int hwc_set(hwc_composer_device_1_t *dev,
                                     (unsigned int)addr->addr_y, (unsigned int)addr->addr_cbcr, (unsigned int)addr->addr_cbcr,
                                     0, 0,
                                     android::SecHdmiClient::HDMI_MODE_VIDEO,
-                                    ctx->num_of_hwc_layer);
+                                    ctx->num_of_hwc_layer, hdmi_handle);
         } else if ((src_img.format == HAL_PIXEL_FORMAT_YCbCr_420_SP) ||
                     (src_img.format == HAL_PIXEL_FORMAT_YCrCb_420_SP) ||
                     (src_img.format == HAL_PIXEL_FORMAT_YCbCr_420_P) ||
@@ -887,7 +914,7 @@ static int hwc_set(hwc_composer_device_1_t *dev,
                                     (unsigned int)ctx->fimc.params.src.buf_addr_phy_cr,
                                     0, 0,
                                     android::SecHdmiClient::HDMI_MODE_VIDEO,
-                                    ctx->num_of_hwc_layer);
+                                    ctx->num_of_hwc_layer, hdmi_handle);
         } else {
             SEC_HWC_Log(HWC_LOG_ERROR, "%s: Unsupported format = %d", __func__, src_img.format);
         }
@@ -904,6 +931,51 @@ static void hwc_registerProcs(struct hwc_composer_device_1* dev,
     ctx->procs = const_cast<hwc_procs_t *>(procs);
 }
 
+static void hwc_dump(struct hwc_composer_device_1* dev, char *buff, int buff_len)
+{
+    struct hwc_context_t* ctx = (struct hwc_context_t*)dev;
+    struct hwc_stats_t *stats = &ctx->stats;
+    unsigned int fimc_ioctls, fimc_ioctls_skipped;
+    int len;
+
+    if (buff_len <= 0)
+        return;
+
+    fimc_get_ioctl_count(&fimc_ioctls, &fimc_ioctls_skipped);
+    len = snprintf(buff, buff_len,
+            "  frames %u, fimc runs %u\n"
+            "  ioctls last frame %u, max %u, avg %u.%02u\n"
+            "  fimc ioctls issued %u, skipped by shadow state %u\n",
+            stats->frames, stats->fimc_runs,
+            stats->last_frame_ioctls, stats->max_frame_ioctls,
+            stats->frames ? stats->total_ioctls / stats->frames : 0,
+            stats->frames ? (stats->total_ioctls * 100 / stats->frames) % 100 : 0,
+            fimc_ioctls, fimc_ioctls_skipped);
+
+    if (len < buff_len) {
+        struct hwc_vsync_model *vm = &ctx->vsync_model;
+        unsigned int samples = vm->jitter_samples ? vm->jitter_samples : 1;
+        unsigned int reported = vm->reported_samples ? vm->reported_samples : 1;
+
+        len += snprintf(buff + len, buff_len - len,
+                "  vsync period %lld ns, hw events %u, predicted %u, coalesced %u, resyncs %u\n"
+                "  vsync jitter hw %llu ns, reported %llu ns\n",
+                (long long)vm->period, vm->hw_events, vm->synthesized, vm->coalesced, vm->resyncs,
+                (unsigned long long)(vm->raw_jitter_sum / samples),
+                (unsigned long long)(vm->reported_jitter_sum / reported));
+    }
+
+    for (int i = 0; i < NUM_OF_WIN && len < buff_len; i++) {
+        struct hwc_win_info_t *win = &ctx->win[i];
+        len += snprintf(buff + len, buff_len - len,
+                "  win %d: %s, rect {%d,%d,%d,%d}, buf_index %d, fb ioctls %u\n",
+                i, win->power_state ? "on" : "off",
+                win->rect_info.x, win->rect_info.y,
+                win->rect_info.w, win->rect_info.h,
+                win->buf_index, win->num_ioctls);
+    }
+}
+
 static int hwc_query(struct hwc_composer_device_1* dev,
         int what, int* value)
 {
@@ -916,7 +988,7 @@ static int hwc_query(struct hwc_composer_device_1* dev,
         break;
     case HWC_VSYNC_PERIOD:
         // vsync period in nanosecond
-        value[0] = 1000000000.0 / 57;
+        value[0] = HWC_VSYNC_NOMINAL_PERIOD;
         break;
     default:
         // unsupported query
@@ -936,65 +1008,146 @@ static int hwc_eventControl(struct hwc_composer_device_1* dev, int dpy,
         int err = ioctl(ctx->global_lcd_win.fd, S3CFB_SET_VSYNC_INT, &val);
         if (err < 0)
             return -errno;
-        
+
+        /*
+         * wake the vsync thread so it re-arms or drops its prediction timer,
+         * the phase from before a pause would only predict stale refreshes
+         */
+        if (val && !ctx->vsync_enabled)
+            ctx->vsync_resync = 1;
+        ctx->vsync_enabled = val;
+        if (ctx->vsync_event_fd >= 0) {
+            uint64_t one = 1;
+            write(ctx->vsync_event_fd, &one, sizeof(one));
+        }
+
         return 0;
     }
     return -EINVAL;
 }
 
+static int64_t hwc_systemTime(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (int64_t)t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+static void hwc_vsync_deliver(hwc_context_t *ctx, int64_t timestamp)
+{
+    if (timestamp && ctx->vsync_enabled && ctx->procs && ctx->procs->vsync)
+        ctx->procs->vsync(ctx->procs, 0, timestamp);
+}
+
+/* the timestamps are plain decimal, avoid strtoull on every refresh */
+static int64_t hwc_parse_timestamp(const char *s, const char *end)
+{
+    int64_t v = 0;
+
+    while (s < end && *s >= '0' && *s <= '9')
+        v = v * 10 + (*s++ - '0');
+
+    return v;
+}
+
+/* ms until a missing hw event should be replaced by a predicted one */
+static int hwc_vsync_timeout(hwc_context_t *ctx)
+{
+    int64_t next;
+    int64_t wait;
+
+    if (ctx->vsync_resync) {
+        ctx->vsync_resync = 0;
+        vsync_model_reset(&ctx->vsync_model);
+    }
+
+    next = vsync_model_next(&ctx->vsync_model);
+
+    if (!ctx->vsync_enabled || next == 0)
+        return -1;
+
+    wait = next + ctx->vsync_model.period / 4 - hwc_systemTime();
+    if (wait <= 0)
+        return 0;
+
+    return (int)((wait + 999999) / 1000000);
+}
+
 #ifdef SYSFS_VSYNC_NOTIFICATION
 static void *hwc_vsync_sysfs_loop(void *data)
 {
-    static char buf[4096];
+    char buf[32];
+    struct pollfd fds[2];
     int vsync_timestamp_fd;
-    fd_set exceptfds;
-    int res;
-    int64_t timestamp = 0;
     hwc_context_t * ctx = (hwc_context_t *)(data);
 
     vsync_timestamp_fd = open("/sys/devices/platform/samsung-pd.2/s3cfb.0/vsync_time", O_RDONLY);
     char thread_name[64] = "hwcVsyncThread";
     prctl(PR_SET_NAME, (unsigned long) &thread_name, 0, 0, 0);
     setpriority(PRIO_PROCESS, 0, -20);
-    memset(buf, 0, sizeof(buf));
-    
+
     SEC_HWC_Log(HWC_LOG_DEBUG,"Using sysfs mechanism for VSYNC notification");
 
-    FD_ZERO(&exceptfds);
-    FD_SET(vsync_timestamp_fd, &exceptfds);
-    do {
-        ssize_t len = read(vsync_timestamp_fd, buf, sizeof(buf));
-        timestamp = strtoull(buf, NULL, 0);
-        if(ctx->procs)
-            ctx->procs->vsync(ctx->procs, 0, timestamp);
-        select(vsync_timestamp_fd + 1, NULL, NULL, &exceptfds, NULL);
-        lseek(vsync_timestamp_fd, 0, SEEK_SET);
-    } while (1);
+    /* sysfs_notify only fires after the attribute has been read once */
+    pread(vsync_timestamp_fd, buf, sizeof(buf), 0);
+
+    fds[0].fd = vsync_timestamp_fd;
+    fds[0].events = POLLPRI | POLLERR;
+    fds[1].fd = ctx->vsync_event_fd;
+    fds[1].events = POLLIN;
 
+    while (!ctx->vsync_exit) {
+        int res = poll(fds, 2, hwc_vsync_timeout(ctx));
+
+        if (res == 0) {
+            hwc_vsync_deliver(ctx,
+                    vsync_model_predict(&ctx->vsync_model, hwc_systemTime()));
+            continue;
+        }
+        if (res < 0)
+            continue;
+
+        if (fds[1].revents & POLLIN) {
+            uint64_t val;
+            read(ctx->vsync_event_fd, &val, sizeof(val));
+        }
+
+        if (fds[0].revents & (POLLPRI | POLLERR)) {
+            ssize_t len = pread(vsync_timestamp_fd, buf, sizeof(buf), 0);
+            if (len <= 0)
+                continue;
+
+            int64_t timestamp = hwc_parse_timestamp(buf, buf + len);
+            hwc_vsync_deliver(ctx, vsync_model_update(&ctx->vsync_model, timestamp));
+        }
+    }
+
+    if (vsync_timestamp_fd >= 0)
+        close(vsync_timestamp_fd);
     return NULL;
 }
 #endif
 
 void handle_vsync_uevent(hwc_context_t *ctx, const char *buff, int len)
 {
-    uint64_t timestamp = 0;
+    static const char key[] = "VSYNC=";
     const char *s = buff;
+    const char *end = buff + len;
 
     if(!ctx->procs || !ctx->procs->vsync)
        return;
 
     s += strlen(s) + 1;
 
-    while(*s) {
-        if (!strncmp(s, "VSYNC=", strlen("VSYNC=")))
-            timestamp = strtoull(s + strlen("VSYNC="), NULL, 0);
-
+    while (s < end && *s) {
+        if (!strncmp(s, key, sizeof(key) - 1)) {
+            int64_t timestamp = hwc_parse_timestamp(s + sizeof(key) - 1, end);
+            hwc_vsync_deliver(ctx, vsync_model_update(&ctx->vsync_model, timestamp));
+            return;
+        }
         s += strlen(s) + 1;
-        if (s - buff >= len)
-            break;
     }
-
-    ctx->procs->vsync(ctx->procs, 0, timestamp);
 }
 
 static void *hwc_vsync_thread(void *data)
@@ -1002,11 +1155,33 @@ static void *hwc_vsync_thread(void *data)
     hwc_context_t *ctx = (hwc_context_t *)(data);
     char uevent_desc[4096];
 
+    struct pollfd fds[2];
+
     memset(uevent_desc, 0, sizeof(uevent_desc));
     setpriority(PRIO_PROCESS, 0, HAL_PRIORITY_URGENT_DISPLAY);
     uevent_init();
 
-    while(true) {
+    fds[0].fd = uevent_get_fd();
+    fds[0].events = POLLIN;
+    fds[1].fd = ctx->vsync_event_fd;
+    fds[1].events = POLLIN;
+
+    while (!ctx->vsync_exit) {
+        int res = poll(fds, 2, hwc_vsync_timeout(ctx));
+
+        if (res == 0) {
+            hwc_vsync_deliver(ctx,
+                    vsync_model_predict(&ctx->vsync_model, hwc_systemTime()));
+            continue;
+        }
+
+        if (res > 0 && (fds[1].revents & POLLIN)) {
+            uint64_t val;
+            read(ctx->vsync_event_fd, &val, sizeof(val));
+        }
+
+        if (res < 0 || !(fds[0].revents & POLLIN))
+            continue;
 
         int len = uevent_next_event(uevent_desc, sizeof(uevent_desc) - 2);
 
@@ -1024,6 +1199,16 @@ static int hwc_device_close(struct hw_device_t *dev)
     int ret = 0;
     int i;
     if (ctx) {
+        /* the eventfd is the only way to wake the vsync thread out of poll */
+        if (ctx->vsync_event_fd >= 0) {
+            uint64_t one = 1;
+
+            ctx->vsync_exit = 1;
+            write(ctx->vsync_event_fd, &one, sizeof(one));
+            pthread_join(ctx->vsync_thread, NULL);
+            close(ctx->vsync_event_fd);
+        }
+
         if (destroyFimc(&ctx->fimc) < 0) {
             SEC_HWC_Log(HWC_LOG_ERROR, "%s::destroyFimc fail", __func__);
             ret = -1;
@@ -1085,6 +1270,7 @@ static int hwc_device_open(const struct hw_module_t* module, const char* name,
     dev->device.eventControl         = hwc_eventControl;
     dev->device.blank                = hwc_blank;
     dev->device.query                = hwc_query;
+    dev->device.dump                 = hwc_dump;
     dev->device.registerProcs        = hwc_registerProcs;
     *device = &dev->device.common;
 
@@ -1155,6 +1341,11 @@ static int hwc_device_open(const struct hw_module_t* module, const char* name,
         goto err;
     }
 
+    vsync_model_init(&dev->vsync_model, HWC_VSYNC_NOMINAL_PERIOD);
+    dev->vsync_event_fd = eventfd(0, EFD_NONBLOCK);
+    if (dev->vsync_event_fd < 0)
+        SEC_HWC_Log(HWC_LOG_ERROR, "%s::eventfd() failed : %s", __func__, strerror(errno));
+
 #ifndef SYSFS_VSYNC_NOTIFICATION
     err = pthread_create(&dev->vsync_thread, NULL, hwc_vsync_thread, dev);
     if (err) {
@@ -188,6 +188,7 @@ int window_set_pos(struct hwc_win_info_t *win)
     win->var_info.activate &= ~FB_ACTIVATE_MASK;
     win->var_info.activate |= FB_ACTIVATE_FORCE;
 
+    win->num_ioctls++;
     if (ioctl(win->fd, FBIOPUT_VSCREENINFO, &(win->var_info)) < 0) {
         SEC_HWC_Log(HWC_LOG_ERROR, "%s::FBIOPUT_VSCREENINFO(%d, %d) fail",
           __func__, win->rect_info.w, win->rect_info.h);
@@ -197,6 +198,7 @@ int window_set_pos(struct hwc_win_info_t *win)
     window.x = win->rect_info.x;
     window.y = win->rect_info.y;
 
+    win->num_ioctls++;
     if (ioctl(win->fd, S3CFB_WIN_POSITION, &window) < 0) {
         SEC_HWC_Log(HWC_LOG_ERROR, "%s::S3CFB_WIN_POSITION(%d, %d) fail",
             __func__, window.x, window.y);
@@ -237,6 +239,7 @@ int window_pan_display(struct hwc_win_info_t *win)
     struct fb_var_screeninfo *lcd_info = &(win->lcd_info);
 
 #ifdef ENABLE_FIMD_VSYNC
+    win->num_ioctls++;
     if (ioctl(win->fd, FBIO_WAITFORVSYNC, 0) < 0)
         SEC_HWC_Log(HWC_LOG_ERROR, "%s::FBIO_WAITFORVSYNC fail(%s)",
                 __func__, strerror(errno));
@@ -244,6 +247,7 @@ int window_pan_display(struct hwc_win_info_t *win)
 
     lcd_info->yoffset = lcd_info->yres * win->buf_index;
 
+    win->num_ioctls++;
     if (ioctl(win->fd, FBIOPAN_DISPLAY, lcd_info) < 0) {
         SEC_HWC_Log(HWC_LOG_ERROR, "%s::FBIOPAN_DISPLAY(%d / %d / %d) fail(%s)",
             __func__,
@@ -258,6 +262,7 @@ int window_pan_display(struct hwc_win_info_t *win)
 int window_show(struct hwc_win_info_t *win)
 {
     if (win->power_state == 0) {
+        win->num_ioctls++;
         if (ioctl(win->fd, FBIOBLANK, FB_BLANK_UNBLANK) < 0) {
             SEC_HWC_Log(HWC_LOG_ERROR, "%s::FBIOBLANK failed : (%d:%s)",
                 __func__, win->fd, strerror(errno));
@@ -271,6 +276,7 @@ int window_show(struct hwc_win_info_t *win)
 int window_hide(struct hwc_win_info_t *win)
 {
     if (win->power_state == 1) {
+        win->num_ioctls++;
         if (ioctl(win->fd, FBIOBLANK, FB_BLANK_POWERDOWN) < 0) {
             SEC_HWC_Log(HWC_LOG_ERROR, "%s::FBIOBLANK failed : (%d:%s)",
              __func__, win->fd, strerror(errno));
@@ -304,19 +310,37 @@ int window_get_global_lcd_info(struct hwc_context_t *ctx)
     return 0;
 }
 
-int fimc_v4l2_set_src(int fd, unsigned int hw_ver, s5p_fimc_img_info *src)
+/* FIMC ioctls issued, and those the shadow state let runFimcCore() skip */
+static unsigned int fimc_ioctls_issued;
+static unsigned int fimc_ioctls_skipped;
+
+void fimc_get_ioctl_count(unsigned int *issued, unsigned int *skipped)
+{
+    *issued  = fimc_ioctls_issued;
+    *skipped = fimc_ioctls_skipped;
+}
+
+int fimc_v4l2_set_src(int fd, unsigned int hw_ver, s5p_fimc_img_info *src,
+        int reconfig)
 {
     struct v4l2_format  fmt;
     struct v4l2_cropcap cropcap;
     struct v4l2_crop    crop;
     struct v4l2_requestbuffers req;
 
+    /* format and crop survive REQBUFS(0), so only reprogram them on change */
+    if (!reconfig) {
+        fimc_ioctls_skipped += 2;   /* S_FMT, S_CROP */
+        goto request_buffers;
+    }
+
     fmt.fmt.pix.width       = src->full_width;
     fmt.fmt.pix.height      = src->full_height;
     fmt.fmt.pix.pixelformat = src->color_space;
     fmt.fmt.pix.field       = V4L2_FIELD_NONE;
     fmt.type                = V4L2_BUF_TYPE_OUTPUT;
 
+    fimc_ioctls_issued++;
     if (ioctl(fd, VIDIOC_S_FMT, &fmt) < 0) {
         SEC_HWC_Log(HWC_LOG_ERROR, "%s::VIDIOC_S_FMT failed : errno=%d (%s)"
                 " : fd=%d\n", __func__, errno, strerror(errno), fd);
@@ -335,6 +359,7 @@ int fimc_v4l2_set_src(int fd, unsigned int hw_ver, s5p_fimc_img_info *src)
         crop.c.top    = 0;
     }
 
+    fimc_ioctls_issued++;
     if (ioctl(fd, VIDIOC_S_CROP, &crop) < 0) {
         SEC_HWC_Log(HWC_LOG_ERROR, "%s::Error in video VIDIOC_S_CROP :"
                 "crop.c.left : (%d), crop.c.top : (%d), crop.c.width : (%d), crop.c.height : (%d)",
@@ -342,11 +367,13 @@ int fimc_v4l2_set_src(int fd, unsigned int hw_ver, s5p_fimc_img_info *src)
         return -1;
     }
 
+request_buffers:
     /* input buffer type */
     req.count       = 1;
     req.memory      = V4L2_MEMORY_USERPTR;
     req.type        = V4L2_BUF_TYPE_OUTPUT;
 
+    fimc_ioctls_issued++;
     if (ioctl(fd, VIDIOC_REQBUFS, &req) < 0) {
         SEC_HWC_Log(HWC_LOG_ERROR, "%s::Error in VIDIOC_REQBUFS", __func__);
         return -1;
@@ -356,7 +383,8 @@ int fimc_v4l2_set_src(int fd, unsigned int hw_ver, s5p_fimc_img_info *src)
 }
 
 int fimc_v4l2_set_dst(int fd, s5p_fimc_img_info *dst,
-        int rotation, int hflip, int vflip, unsigned int addr)
+        int rotation, int hflip, int vflip, unsigned int addr,
+        struct v4l2_framebuffer *fbuf_out)
 {
     struct v4l2_format      sFormat;
     struct v4l2_control     vc;
@@ -367,6 +395,7 @@ int fimc_v4l2_set_dst(int fd, s5p_fimc_img_info *dst,
     vc.id = V4L2_CID_ROTATION;
     vc.value = rotation;
 
+    fimc_ioctls_issued++;
     ret = ioctl(fd, VIDIOC_S_CTRL, &vc);
     if (ret < 0) {
         SEC_HWC_Log(HWC_LOG_ERROR,
@@ -378,6 +407,7 @@ int fimc_v4l2_set_dst(int fd, s5p_fimc_img_info *dst,
     vc.id = V4L2_CID_HFLIP;
     vc.value = hflip;
 
+    fimc_ioctls_issued++;
     ret = ioctl(fd, VIDIOC_S_CTRL, &vc);
     if (ret < 0) {
         SEC_HWC_Log(HWC_LOG_ERROR,
@@ -389,6 +419,7 @@ int fimc_v4l2_set_dst(int fd, s5p_fimc_img_info *dst,
     vc.id = V4L2_CID_VFLIP;
     vc.value = vflip;
 
+    fimc_ioctls_issued++;
     ret = ioctl(fd, VIDIOC_S_CTRL, &vc);
     if (ret < 0) {
         SEC_HWC_Log(HWC_LOG_ERROR,
@@ -398,6 +429,7 @@ int fimc_v4l2_set_dst(int fd, s5p_fimc_img_info *dst,
     }
 
     /* set size, format & address for destination image (DMA-OUTPUT) */
+    fimc_ioctls_issued++;
     ret = ioctl(fd, VIDIOC_G_FBUF, &fbuf);
     if (ret < 0) {
         SEC_HWC_Log(HWC_LOG_ERROR, "%s::Error in video VIDIOC_G_FBUF (%d)", __func__, ret);
@@ -409,12 +441,16 @@ int fimc_v4l2_set_dst(int fd, s5p_fimc_img_info *dst,
     fbuf.fmt.height      = dst->full_height;
     fbuf.fmt.pixelformat = dst->color_space;
 
+    fimc_ioctls_issued++;
     ret = ioctl(fd, VIDIOC_S_FBUF, &fbuf);
     if (ret < 0) {
         SEC_HWC_Log(HWC_LOG_ERROR, "%s::Error in video VIDIOC_S_FBUF (%d)", __func__, ret);
         return -1;
     }
 
+    if (fbuf_out)
+        memcpy(fbuf_out, &fbuf, sizeof(fbuf));
+
     /* set destination window */
     sFormat.type             = V4L2_BUF_TYPE_VIDEO_OVERLAY;
     sFormat.fmt.win.w.left   = dst->start_x;
@@ -422,6 +458,7 @@ int fimc_v4l2_set_dst(int fd, s5p_fimc_img_info *dst,
     sFormat.fmt.win.w.width  = dst->width;
     sFormat.fmt.win.w.height = dst->height;
 
+    fimc_ioctls_issued++;
     ret = ioctl(fd, VIDIOC_S_FMT, &sFormat);
     if (ret < 0) {
         SEC_HWC_Log(HWC_LOG_ERROR, "%s::Error in video VIDIOC_S_FMT (%d)", __func__, ret);
@@ -431,8 +468,25 @@ int fimc_v4l2_set_dst(int fd, s5p_fimc_img_info *dst,
     return 0;
 }
 
+int fimc_v4l2_set_dst_addr(int fd, struct v4l2_framebuffer *fbuf, unsigned int addr)
+{
+    int ret;
+
+    fbuf->base = (void *)addr;
+
+    fimc_ioctls_issued++;
+    ret = ioctl(fd, VIDIOC_S_FBUF, fbuf);
+    if (ret < 0) {
+        SEC_HWC_Log(HWC_LOG_ERROR, "%s::Error in video VIDIOC_S_FBUF (%d)", __func__, ret);
+        return -1;
+    }
+
+    return 0;
+}
+
 int fimc_v4l2_stream_on(int fd, enum v4l2_buf_type type)
 {
+    fimc_ioctls_issued++;
     if (-1 == ioctl(fd, VIDIOC_STREAMON, &type)) {
         SEC_HWC_Log(HWC_LOG_ERROR, "Error in VIDIOC_STREAMON\n");
         return -1;
@@ -452,6 +506,7 @@ int fimc_v4l2_queue(int fd, struct fimc_buf *fimc_buf, enum v4l2_buf_type type,
     buf.index       = index;
     buf.type        = type;
 
+    fimc_ioctls_issued++;
     ret = ioctl(fd, VIDIOC_QBUF, &buf);
     if (0 > ret) {
         SEC_HWC_Log(HWC_LOG_ERROR, "Error in VIDIOC_QBUF : (%d)", ret);
@@ -468,6 +523,7 @@ int fimc_v4l2_dequeue(int fd, struct fimc_buf *fimc_buf, enum v4l2_buf_type type
     buf.memory      = V4L2_MEMORY_USERPTR;
     buf.type        = type;
 
+    fimc_ioctls_issued++;
     if (-1 == ioctl(fd, VIDIOC_DQBUF, &buf)) {
         SEC_HWC_Log(HWC_LOG_ERROR, "Error in VIDIOC_DQBUF\n");
         return -1;
@@ -478,6 +534,7 @@ int fimc_v4l2_dequeue(int fd, struct fimc_buf *fimc_buf, enum v4l2_buf_type type
 
 int fimc_v4l2_stream_off(int fd, enum v4l2_buf_type type)
 {
+    fimc_ioctls_issued++;
     if (-1 == ioctl(fd, VIDIOC_STREAMOFF, &type)) {
         SEC_HWC_Log(HWC_LOG_ERROR, "Error in VIDIOC_STREAMOFF\n");
         return -1;
@@ -494,6 +551,7 @@ int fimc_v4l2_clr_buf(int fd, enum v4l2_buf_type type)
     req.memory  = V4L2_MEMORY_USERPTR;
     req.type    = type;
 
+    fimc_ioctls_issued++;
     if (ioctl(fd, VIDIOC_REQBUFS, &req) == -1) {
         SEC_HWC_Log(HWC_LOG_ERROR, "Error in VIDIOC_REQBUFS");
     }
@@ -508,6 +566,7 @@ int fimc_v4l2_S_ctrl(int fd)
     vc.id = V4L2_CID_CACHEABLE;
     vc.value = 1;
 
+    fimc_ioctls_issued++;
     if (ioctl(fd, VIDIOC_S_CTRL, &vc) < 0) {
         SEC_HWC_Log(HWC_LOG_ERROR, "Error in VIDIOC_S_CTRL");
         return -1;
@@ -916,6 +975,17 @@ static unsigned int get_yuv_planes(unsigned int fmt)
         return yuv_list[sel].planes;
 }
 
+static inline bool fimc_img_geometry_equal(s5p_fimc_img_info *a, s5p_fimc_img_info *b)
+{
+    return (a->full_width  == b->full_width)  &&
+           (a->full_height == b->full_height) &&
+           (a->start_x     == b->start_x)     &&
+           (a->start_y     == b->start_y)     &&
+           (a->width       == b->width)       &&
+           (a->height      == b->height)      &&
+           (a->color_space == b->color_space);
+}
+
 static int runFimcCore(struct hwc_context_t *ctx,
         unsigned int src_phys_addr, sec_img *src_img, sec_rect *src_rect,
         uint32_t src_color_space,
@@ -924,6 +994,9 @@ static int runFimcCore(struct hwc_context_t *ctx,
 {
     s5p_fimc_t        * fimc = &ctx->fimc;
     s5p_fimc_params_t * params = &(fimc->params);
+    struct hwc_fimc_shadow_t *shadow = &ctx->fimc_shadow;
+    bool dst_reconfig;
+    bool src_reconfig;
 
     struct fimc_buf fimc_src_buf;
     int src_bpp, src_planes;
@@ -1065,9 +1138,35 @@ static int runFimcCore(struct hwc_context_t *ctx,
      *   - set buffer type (V4L2_MEMORY_USERPTR)
      */
 
-    if (fimc_v4l2_set_dst(fimc->dev_fd, &params->dst, rotate_value, hflip, vflip, dst_phys_addr) < 0) {
-        SEC_HWC_Log(HWC_LOG_ERROR, "fimc_v4l2_set_dst is failed\n");
-        return -1;
+    dst_reconfig = !shadow->valid ||
+                   (shadow->rotation != rotate_value) ||
+                   (shadow->hflip != hflip) || (shadow->vflip != vflip) ||
+                   !fimc_img_geometry_equal(&shadow->dst, &params->dst);
+
+    if (dst_reconfig) {
+        shadow->valid = 0;
+        if (fimc_v4l2_set_dst(fimc->dev_fd, &params->dst, rotate_value,
+                              hflip, vflip, dst_phys_addr, &shadow->fbuf) < 0) {
+            SEC_HWC_Log(HWC_LOG_ERROR, "fimc_v4l2_set_dst is failed\n");
+            return -1;
+        }
+        shadow->dst      = params->dst;
+        shadow->rotation = rotate_value;
+        shadow->hflip    = hflip;
+        shadow->vflip    = vflip;
+        shadow->dst_addr = dst_phys_addr;
+    } else if (shadow->dst_addr != dst_phys_addr) {
+        /* S_CTRL x3, G_FBUF, S_FMT: only the address moves */
+        fimc_ioctls_skipped += 5;
+        if (fimc_v4l2_set_dst_addr(fimc->dev_fd, &shadow->fbuf, dst_phys_addr) < 0) {
+            SEC_HWC_Log(HWC_LOG_ERROR, "fimc_v4l2_set_dst_addr is failed\n");
+            shadow->valid = 0;
+            return -1;
+        }
+        shadow->dst_addr = dst_phys_addr;
+    } else {
+        /* S_CTRL x3, G_FBUF, S_FBUF, S_FMT */
+        fimc_ioctls_skipped += 6;
     }
 
    /* 4. Set configuration related to source (DMA-INPUT)
@@ -1076,10 +1175,16 @@ static int runFimcCore(struct hwc_context_t *ctx,
      *   - set input buffer
      *   - set buffer type (V4L2_MEMORY_USERPTR)
      */
-    if (fimc_v4l2_set_src(fimc->dev_fd, fimc->hw_ver, &params->src) < 0) {
+    src_reconfig = dst_reconfig ||
+                   !fimc_img_geometry_equal(&shadow->src, &params->src);
+
+    if (fimc_v4l2_set_src(fimc->dev_fd, fimc->hw_ver, &params->src, src_reconfig) < 0) {
         SEC_HWC_Log(HWC_LOG_ERROR, "fimc_v4l2_set_src is failed\n");
+        shadow->valid = 0;
         return -1;
     }
+    shadow->src   = params->src;
+    shadow->valid = 1;
 
     /* 5. Set input dma address (Y/RGB, Cb, Cr)
      *    - zero copy : mfc, camera
@@ -1126,9 +1231,11 @@ static int runFimcCore(struct hwc_context_t *ctx,
     /* 6. Run FIMC
      *    - stream on => queue => dequeue => stream off => clear buf
      */
+    ctx->stats.fimc_runs++;
     if (fimc_handle_oneshot(fimc->dev_fd, &fimc_src_buf, NULL) < 0) {
         ALOGE("fimcrun fail");            
         fimc_v4l2_clr_buf(fimc->dev_fd, V4L2_BUF_TYPE_OUTPUT);
+        shadow->valid = 0;
         return -1;
     }
 
@@ -1277,3 +1384,148 @@ int check_yuv_format(unsigned int color_format) {
         return 0;
     }
 }
+
+/*****************************************************************************/
+/* vsync model: phase and frequency are corrected by err/4 and err/8 */
+#define VSYNC_PHASE_GAIN_SHIFT      2
+#define VSYNC_FREQ_GAIN_SHIFT       3
+#define VSYNC_LOCK_THRESHOLD        4
+/* predictions in a row without a hw event before the model gives up */
+#define VSYNC_MAX_PREDICTED         8
+
+static inline int64_t vsync_abs(int64_t v)
+{
+    return (v < 0) ? -v : v;
+}
+
+void vsync_model_init(struct hwc_vsync_model *model, int64_t period)
+{
+    memset(model, 0, sizeof(*model));
+    model->nominal_period = period;
+    model->period = period;
+}
+
+/*
+ * Forget the phase, e.g. when vsync is enabled again after a pause. The
+ * period estimate is kept, the model relocks on the next hw events.
+ */
+void vsync_model_reset(struct hwc_vsync_model *model)
+{
+    model->ref = 0;
+    model->locked = 0;
+    model->predicted_run = 0;
+    model->last_interval = 0;
+}
+
+/*
+ * Feed one hardware timestamp. Returns the filtered timestamp to report,
+ * or 0 when this refresh was already reported by vsync_model_predict().
+ */
+int64_t vsync_model_update(struct hwc_vsync_model *model, int64_t timestamp)
+{
+    int64_t delta, predicted, err, interval;
+    int64_t n;
+
+    model->hw_events++;
+    model->predicted_run = 0;
+
+    if (model->ref == 0) {
+        model->ref = timestamp;
+        return timestamp;
+    }
+
+    delta = timestamp - model->ref;
+    n = (delta + model->period / 2) / model->period;
+    predicted = model->ref + n * model->period;
+    err = timestamp - predicted;
+
+    if (delta < -model->period) {
+        /* time went backwards, restart from this event */
+        model->ref = timestamp;
+        model->period = model->nominal_period;
+        model->locked = 0;
+        model->last_interval = 0;
+        model->resyncs++;
+        return timestamp;
+    }
+
+    if (n == 0) {
+        /*
+         * Late event for a refresh that was already synthesized, only
+         * pull the phase towards it.
+         */
+        model->ref += err >> VSYNC_PHASE_GAIN_SHIFT;
+        return 0;
+    }
+
+    if (vsync_abs(err) > model->period / 4) {
+        /* lost track (blank, clock change...), restart from this event */
+        model->ref = timestamp;
+        model->period = model->nominal_period;
+        model->locked = 0;
+        model->last_interval = 0;
+        model->resyncs++;
+        return timestamp;
+    }
+
+    if (n > 1)
+        model->coalesced += n - 1;
+
+    model->period += err / (n << VSYNC_FREQ_GAIN_SHIFT);
+    /* never drift further than 10% from the panel refresh */
+    if (model->period > model->nominal_period + model->nominal_period / 10)
+        model->period = model->nominal_period + model->nominal_period / 10;
+    if (model->period < model->nominal_period - model->nominal_period / 10)
+        model->period = model->nominal_period - model->nominal_period / 10;
+
+    interval = (predicted + (err >> VSYNC_PHASE_GAIN_SHIFT) - model->ref) / n;
+    model->ref = predicted + (err >> VSYNC_PHASE_GAIN_SHIFT);
+    model->locked++;
+
+    model->raw_jitter_sum += vsync_abs(err);
+    model->jitter_samples++;
+
+    /* what a consumer sees: change of the reported refresh interval */
+    if (model->last_interval) {
+        model->reported_jitter_sum += vsync_abs(interval - model->last_interval);
+        model->reported_samples++;
+    }
+    model->last_interval = interval;
+
+    return model->ref;
+}
+
+/* expected time of the next refresh, 0 while the model is not locked */
+int64_t vsync_model_next(struct hwc_vsync_model *model)
+{
+    if (model->locked < VSYNC_LOCK_THRESHOLD)
+        return 0;
+
+    return model->ref + model->period;
+}
+
+/*
+ * Called when no hardware event showed up in time. Returns a predicted
+ * timestamp for the missed refresh, or 0 if it is not overdue yet.
+ */
+int64_t vsync_model_predict(struct hwc_vsync_model *model, int64_t now)
+{
+    int64_t next = vsync_model_next(model);
+
+    if (next == 0 || now < next + model->period / 4)
+        return 0;
+
+    /* the hw stopped reporting, do not free-run on the old phase */
+    if (++model->predicted_run > VSYNC_MAX_PREDICTED) {
+        vsync_model_reset(model);
+        return 0;
+    }
+
+    /* report the last refresh before now, not a burst of stale ones */
+    next += ((now - next) / model->period) * model->period;
+
+    model->ref = next;
+    model->synthesized++;
+
+    return next;
+}
@@ -127,6 +127,9 @@ struct hwc_win_info_t {
     int        status;
     int        vsync;
 
+    /* number of fb ioctls issued on this window, for hwc_dump */
+    unsigned int num_ioctls;
+
     struct fb_fix_screeninfo fix_info;
     struct fb_var_screeninfo var_info;
     struct fb_var_screeninfo lcd_info;
@@ -143,6 +146,56 @@ enum {
     HWC_VIRT_MEM_TYPE,
 };
 
+/*
+ * Last configuration programmed into the FIMC post processor.
+ * runFimcCore() compares the next request against it and only issues
+ * the V4L2 ioctls for the parts that actually changed.
+ */
+struct hwc_fimc_shadow_t {
+    int                     valid;
+    s5p_fimc_img_info       src;
+    s5p_fimc_img_info       dst;
+    int                     rotation;
+    int                     hflip;
+    int                     vflip;
+    unsigned int            dst_addr;
+    struct v4l2_framebuffer fbuf;
+};
+
+struct hwc_stats_t {
+    unsigned int frames;
+    unsigned int fimc_runs;
+    unsigned int last_frame_ioctls;
+    unsigned int max_frame_ioctls;
+    unsigned int total_ioctls;
+};
+
+/* nominal FIMD refresh, also reported through HWC_VSYNC_PERIOD */
+#define HWC_VSYNC_NOMINAL_PERIOD    (1000000000LL / 57)
+
+/*
+ * Software model of the display refresh. A small PLL tracks period and
+ * phase of the hardware vsync timestamps, so jittery events can be
+ * smoothed and a late or coalesced event replaced by a predicted one.
+ */
+struct hwc_vsync_model {
+    int64_t      nominal_period;
+    int64_t      period;            /* estimated period, ns */
+    int64_t      ref;               /* filtered timestamp of the last vsync */
+    int          locked;            /* consecutive in-phase hw events */
+    int          predicted_run;     /* predictions since the last hw event */
+    int64_t      last_interval;     /* last reported refresh interval, ns */
+
+    unsigned int hw_events;
+    unsigned int synthesized;
+    unsigned int coalesced;
+    unsigned int resyncs;
+    uint64_t     raw_jitter_sum;    /* |hw - predicted|, ns */
+    unsigned int jitter_samples;
+    uint64_t     reported_jitter_sum;   /* |interval - previous interval|, ns */
+    unsigned int reported_samples;
+};
+
 #ifdef SKIP_DUMMY_UI_LAY_DRAWING
 struct hwc_ui_lay_info{
     uint32_t   layer_prev_buf;
@@ -168,9 +221,16 @@ struct hwc_context_t {
 
     struct fb_var_screeninfo  lcd_info;
     s5p_fimc_t                fimc;
+    struct hwc_fimc_shadow_t  fimc_shadow;
+    struct hwc_stats_t        stats;
     hwc_procs_t               *procs;
     pthread_t                 uevent_thread;
     pthread_t                 vsync_thread;
+    struct hwc_vsync_model    vsync_model;
+    int                       vsync_enabled;
+    volatile int              vsync_resync;      /* vsync was enabled, model phase is stale */
+    int                       vsync_event_fd;
+    volatile int              vsync_exit;        /* set by hwc_device_close */
 
     int                       num_of_fb_layer;
     int                       num_of_hwc_layer;
@@ -288,5 +348,12 @@ int runFimc(struct hwc_context_t *ctx,
 	    struct sec_img *dst_img, struct sec_rect *dst_rect,
 	    uint32_t transform);
 int check_yuv_format(unsigned int color_format);
+void fimc_get_ioctl_count(unsigned int *issued, unsigned int *skipped);
+
+void    vsync_model_init   (struct hwc_vsync_model *model, int64_t period);
+void    vsync_model_reset  (struct hwc_vsync_model *model);
+int64_t vsync_model_update (struct hwc_vsync_model *model, int64_t timestamp);
+int64_t vsync_model_predict(struct hwc_vsync_model *model, int64_t now);
+int64_t vsync_model_next   (struct hwc_vsync_model *model);
 
 #endif /* ANDROID_SEC_HWC_UTILS_H_*/
@@ -19,12 +19,12 @@
 #include "SecFimc.h"
 #include "HardwareConverter.h"
 
-HardwareConverter::HardwareConverter()
+HardwareConverter::HardwareConverter(int numOfBuf)
 {
     SecFimc* handle_fimc = new SecFimc();
     mSecFimc = (void *)handle_fimc;
 
-    if (handle_fimc->create(SecFimc::DEV_0, SecFimc::MODE_MULTI_BUF, 1) == false)
+    if (handle_fimc->create(SecFimc::DEV_0, SecFimc::MODE_MULTI_BUF, numOfBuf) == false)
         bHWconvert_flag = 0;
     else
         bHWconvert_flag = 1;
@@ -47,6 +47,74 @@ bool HardwareConverter::convert(
 {
     SecFimc* handle_fimc = (SecFimc*)mSecFimc;
 
+    if (!setup(src_addr, dst_addr, src_format, width, height, dst_format))
+        return false;
+
+    if (!handle_fimc->draw(0, 0)) {
+        ALOGE("%s:: handleOneShot() failed", __func__);
+        return false;
+    }
+
+    return true;
+}
+
+bool HardwareConverter::convertAsync(
+    void * src_addr,
+    void *dst_addr,
+    OMX_COLOR_FORMATTYPE src_format,
+    int32_t width,
+    int32_t height,
+    OMX_COLOR_FORMATTYPE dst_format,
+    int *index)
+{
+    SecFimc* handle_fimc = (SecFimc*)mSecFimc;
+
+    if (!setup(src_addr, dst_addr, src_format, width, height, dst_format))
+        return false;
+
+    if (!handle_fimc->queue(index)) {
+        ALOGE("%s:: queue() failed", __func__);
+        return false;
+    }
+
+    return true;
+}
+
+bool HardwareConverter::waitConvert(int *index, void **dst_addr)
+{
+    SecFimc* handle_fimc = (SecFimc*)mSecFimc;
+    SecBuffer *dst_buf = NULL;
+
+    if (!handle_fimc->dequeue(index, &dst_buf)) {
+        ALOGE("%s:: dequeue() failed", __func__);
+        return false;
+    }
+
+    if (dst_addr != NULL) {
+        for (int i = 0; i < 3; i++)
+            dst_addr[i] = (dst_buf != NULL) ? (void *)dst_buf->virt.extP[i] : NULL;
+    }
+
+    return true;
+}
+
+int HardwareConverter::getFd(void)
+{
+    SecFimc* handle_fimc = (SecFimc*)mSecFimc;
+
+    return handle_fimc->getFd();
+}
+
+bool HardwareConverter::setup(
+    void * src_addr,
+    void *dst_addr,
+    OMX_COLOR_FORMATTYPE src_format,
+    int32_t width,
+    int32_t height,
+    OMX_COLOR_FORMATTYPE dst_format)
+{
+    SecFimc* handle_fimc = (SecFimc*)mSecFimc;
+
     int rotate_value = 0;
     unsigned int src_crop_x = 0;
     unsigned int src_crop_y = 0;
@@ -112,11 +180,6 @@ bool HardwareConverter::convert(
         break;
     }
 
-    if (!handle_fimc->draw(0, 0)) {
-        ALOGE("%s:: handleOneShot() failed", __func__);
-        return false;
-    }
-
     return true;
 }
 
@@ -22,7 +22,7 @@
 
 class HardwareConverter {
 public:
-    HardwareConverter();
+    HardwareConverter(int numOfBuf = 1);
     ~HardwareConverter();
     bool convert(
         void * src_addr,
@@ -31,9 +31,37 @@ public:
         int32_t width,
         int32_t height,
         OMX_COLOR_FORMATTYPE dst_format);
+    /*
+     * Submit a conversion and return while FIMC works on it, up to
+     * numOfBuf of them. waitConvert() completes the oldest; getFd() can
+     * be polled for POLLIN instead of blocking in it.
+     *
+     * When FIMC can only write into its own buffers (V4L2 MMAP) dst_addr
+     * of convertAsync() is ignored. waitConvert() then returns the Y, Cb,
+     * Cr virtual addresses of the result in dst_addr, valid until the
+     * next convertAsync() reuses the slot; the caller copies it out.
+     * If the result went to the submitted dst_addr they are all NULL.
+     */
+    bool convertAsync(
+        void * src_addr,
+        void * dst_addr,
+        OMX_COLOR_FORMATTYPE src_format,
+        int32_t width,
+        int32_t height,
+        OMX_COLOR_FORMATTYPE dst_format,
+        int *index);
+    bool waitConvert(int *index, void **dst_addr = NULL);
+    int getFd(void);
     bool bHWconvert_flag;
 private:
     void *mSecFimc;
+    bool setup(
+        void * src_addr,
+        void * dst_addr,
+        OMX_COLOR_FORMATTYPE src_format,
+        int32_t width,
+        int32_t height,
+        OMX_COLOR_FORMATTYPE dst_format);
     unsigned int OMXtoHarPixelFomrat(OMX_COLOR_FORMATTYPE omx_format);
 };
 
@@ -202,7 +202,7 @@ static int jpeg_v4l2_reqbufs(int fd, int buf_cnt, struct jpeg_buf *buf)
     return ret;
 }
 
-static int jpeg_v4l2_querybuf(int fd, struct jpeg_buf *buf)
+static int jpeg_v4l2_querybuf(int fd, struct jpeg_buf *buf, int index)
 {
     struct v4l2_buffer v4l2_buf;
     struct v4l2_plane plane[JPEG_MAX_PLANE_CNT];
@@ -211,7 +211,7 @@ static int jpeg_v4l2_querybuf(int fd, struct jpeg_buf *buf)
 
     memset(plane, 0, (int)JPEG_MAX_PLANE_CNT * sizeof(struct v4l2_plane));
 
-    v4l2_buf.index = 0;
+    v4l2_buf.index = index;
     v4l2_buf.type = buf->buf_type;
     v4l2_buf.memory = buf->memory;
     v4l2_buf.length = buf->num_planes;
@@ -239,7 +239,8 @@ static int jpeg_v4l2_querybuf(int fd, struct jpeg_buf *buf)
     return ret;
 }
 
-static int jpeg_v4l2_qbuf(int fd, struct jpeg_buf *buf)
+/* bytesused only matters for a compressed input, 0 leaves it to the driver */
+static int jpeg_v4l2_qbuf(int fd, struct jpeg_buf *buf, int index, int bytesused)
 {
     struct v4l2_buffer v4l2_buf;
     struct v4l2_plane plane[JPEG_MAX_PLANE_CNT];
@@ -249,11 +250,12 @@ static int jpeg_v4l2_qbuf(int fd, struct jpeg_buf *buf)
     memset(&v4l2_buf, 0, sizeof(struct v4l2_buffer));
     memset(plane, 0, (int)JPEG_MAX_PLANE_CNT * sizeof(struct v4l2_plane));
 
-    v4l2_buf.index = 0;
+    v4l2_buf.index = index;
     v4l2_buf.type = buf->buf_type;
     v4l2_buf.memory = buf->memory;
     v4l2_buf.length = buf->num_planes;
     v4l2_buf.m.planes = plane;
+    v4l2_buf.m.planes[0].bytesused = bytesused;
 
     if (buf->memory == V4L2_MEMORY_USERPTR) {
         for (i = 0; i < buf->num_planes; i++) {
@@ -274,12 +276,16 @@ static int jpeg_v4l2_qbuf(int fd, struct jpeg_buf *buf)
 static int jpeg_v4l2_dqbuf(int fd, enum v4l2_buf_type type, enum v4l2_memory memory)
 {
     struct v4l2_buffer buf;
+    struct v4l2_plane plane[JPEG_MAX_PLANE_CNT];
     int ret = 0;
 
     memset(&buf, 0, sizeof(struct v4l2_buffer));
+    memset(plane, 0, (int)JPEG_MAX_PLANE_CNT * sizeof(struct v4l2_plane));
 
     buf.type = type;
     buf.memory = memory;
+    buf.length = JPEG_MAX_PLANE_CNT;
+    buf.m.planes = plane;
 
     ret = ioctl(fd, VIDIOC_DQBUF, &buf);
     if (ret < 0) {
@@ -287,7 +293,7 @@ static int jpeg_v4l2_dqbuf(int fd, enum v4l2_buf_type type, enum v4l2_memory mem
         return -1;
     }
 
-    return ret;
+    return buf.index;
 }
 
 static int jpeg_v4l2_streamon(int fd, enum v4l2_buf_type type)
@@ -436,7 +442,7 @@ int jpeghal_set_inbuf(int fd, struct jpeg_buf *buf)
     }
 
     if (buf->memory == V4L2_MEMORY_MMAP) {
-        ret = jpeg_v4l2_querybuf(fd, buf);
+        ret = jpeg_v4l2_querybuf(fd, buf, 0);
         if (ret < 0) {
             ALOGE("[%s:%d]: Input QUERYBUF failed", __func__, ret);
             return -1;
@@ -459,7 +465,7 @@ int jpeghal_set_outbuf(int fd, struct jpeg_buf *buf)
     }
 
     if (buf->memory == V4L2_MEMORY_MMAP) {
-        ret = jpeg_v4l2_querybuf(fd, buf);
+        ret = jpeg_v4l2_querybuf(fd, buf, 0);
         if (ret < 0) {
             ALOGE("[%s:%d]: Output QUERYBUF failed", __func__, ret);
             return -1;
@@ -473,13 +479,13 @@ static int jpeg_exe(int fd, struct jpeg_buf *in_buf, struct jpeg_buf *out_buf)
 {
     int ret = 0;
 
-    ret = jpeg_v4l2_qbuf(fd, in_buf);
+    ret = jpeg_v4l2_qbuf(fd, in_buf, 0, 0);
     if (ret < 0) {
         ALOGE("[%s:%d]: Input QBUF failed", __func__, ret);
         return -1;
     }
 
-    ret = jpeg_v4l2_qbuf(fd, out_buf);
+    ret = jpeg_v4l2_qbuf(fd, out_buf, 0, 0);
     if (ret < 0) {
         ALOGE("[%s:%d]: Output QBUF failed", __func__, ret);
         return -1;
@@ -538,6 +544,219 @@ int jpeghal_deinit(int fd, struct jpeg_buf *in_buf, struct jpeg_buf *out_buf)
     return ret;
 }
 
+/*
+ * Decode session: the device, its buffers and its streaming state are kept
+ * from one image to the next. Buffers are only reallocated when an image
+ * does not fit the current configuration, and up to num_bufs decodes can
+ * be queued before the first one is dequeued.
+ */
+static void jpeg_dec_session_free(struct jpeg_dec_session *s)
+{
+    int i, j;
+
+    if (s->streaming) {
+        jpeg_v4l2_streamoff(s->fd, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE);
+        jpeg_v4l2_streamoff(s->fd, V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE);
+        s->streaming = 0;
+    }
+
+    for (i = 0; i < s->num_alloc; i++) {
+        for (j = 0; j < s->in_buf[i].num_planes; j++)
+            munmap((char *)s->in_buf[i].start[j], s->in_buf[i].length[j]);
+        for (j = 0; j < s->out_buf[i].num_planes; j++)
+            munmap((char *)s->out_buf[i].start[j], s->out_buf[i].length[j]);
+    }
+
+    if (s->num_alloc) {
+        jpeg_v4l2_reqbufs(s->fd, 0, &s->in_buf[0]);
+        jpeg_v4l2_reqbufs(s->fd, 0, &s->out_buf[0]);
+        s->num_alloc = 0;
+    }
+
+    s->queued = 0;
+    s->head = 0;
+    s->tail = 0;
+}
+
+int jpeghal_dec_session_open(struct jpeg_dec_session *s, int num_bufs)
+{
+    memset(s, 0, sizeof(*s));
+    /* fd 0 is a valid descriptor, close() must not touch it */
+    s->fd = -1;
+
+    if (num_bufs < 1 || num_bufs > JPEG_DEC_SESSION_MAX_BUFS) {
+        ALOGE("[%s]: invalid buffer count %d", __func__, num_bufs);
+        return -1;
+    }
+
+    s->fd = jpeghal_dec_init();
+    if (s->fd < 0)
+        return -1;
+
+    s->num_bufs = num_bufs;
+
+    return 0;
+}
+
+int jpeghal_dec_session_config(struct jpeg_dec_session *s, struct jpeg_config *config)
+{
+    struct jpeg_config *cur = &s->config;
+    int i;
+    int ret = 0;
+
+    /* same geometry and the stream fits the input buffers: keep streaming */
+    if (s->num_alloc &&
+        cur->width == config->width && cur->height == config->height &&
+        cur->scaled_width == config->scaled_width &&
+        cur->scaled_height == config->scaled_height &&
+        cur->num_planes == config->num_planes &&
+        cur->pix.dec_fmt.in_fmt == config->pix.dec_fmt.in_fmt &&
+        cur->pix.dec_fmt.out_fmt == config->pix.dec_fmt.out_fmt &&
+        config->sizeJpeg <= cur->sizeJpeg)
+        return 0;
+
+    if (s->queued) {
+        ALOGE("[%s]: %d decodes still queued", __func__, s->queued);
+        return -1;
+    }
+
+    jpeg_dec_session_free(s);
+
+    /* leave room for bigger streams of the same geometry */
+    *cur = *config;
+    cur->sizeJpeg = (config->sizeJpeg + config->sizeJpeg / 4 + 4095) & ~4095;
+
+    ret = jpeghal_dec_setconfig(s->fd, cur);
+    if (ret < 0)
+        return -1;
+
+    for (i = 0; i < s->num_bufs; i++) {
+        s->in_buf[i].num_planes = 1;
+        s->in_buf[i].memory = V4L2_MEMORY_MMAP;
+        s->in_buf[i].buf_type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+
+        s->out_buf[i].num_planes = cur->num_planes;
+        s->out_buf[i].memory = V4L2_MEMORY_MMAP;
+        s->out_buf[i].buf_type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+    }
+
+    ret = jpeg_v4l2_reqbufs(s->fd, s->num_bufs, &s->in_buf[0]);
+    if (ret < 0) {
+        ALOGE("[%s:%d]: Input REQBUFS failed", __func__, ret);
+        return -1;
+    }
+
+    ret = jpeg_v4l2_reqbufs(s->fd, s->num_bufs, &s->out_buf[0]);
+    if (ret < 0) {
+        ALOGE("[%s:%d]: Output REQBUFS failed", __func__, ret);
+        jpeg_v4l2_reqbufs(s->fd, 0, &s->in_buf[0]);
+        return -1;
+    }
+
+    for (i = 0; i < s->num_bufs; i++) {
+        if (jpeg_v4l2_querybuf(s->fd, &s->in_buf[i], i) < 0 ||
+            jpeg_v4l2_querybuf(s->fd, &s->out_buf[i], i) < 0) {
+            ALOGE("[%s]: QUERYBUF %d failed", __func__, i);
+            s->num_alloc = i;
+            jpeg_dec_session_free(s);
+            return -1;
+        }
+    }
+
+    s->num_alloc = s->num_bufs;
+    s->reconfigs++;
+
+    return ret;
+}
+
+void *jpeghal_dec_session_get_inbuf(struct jpeg_dec_session *s, int *size)
+{
+    if (!s->num_alloc || s->queued == s->num_alloc)
+        return NULL;
+
+    *size = s->in_buf[s->tail].length[0];
+
+    return s->in_buf[s->tail].start[0];
+}
+
+int jpeghal_dec_session_queue(struct jpeg_dec_session *s, int size)
+{
+    int slot = s->tail;
+    int ret = 0;
+
+    if (!s->num_alloc || s->queued == s->num_alloc) {
+        ALOGE("[%s]: no free buffer", __func__);
+        return -1;
+    }
+
+    ret = jpeg_v4l2_qbuf(s->fd, &s->in_buf[slot], slot, size);
+    if (ret < 0) {
+        ALOGE("[%s:%d]: Input QBUF failed", __func__, ret);
+        return -1;
+    }
+
+    ret = jpeg_v4l2_qbuf(s->fd, &s->out_buf[slot], slot, 0);
+    if (ret < 0) {
+        ALOGE("[%s:%d]: Output QBUF failed", __func__, ret);
+        return -1;
+    }
+
+    /* the driver wants buffers queued before the first STREAMON */
+    if (!s->streaming) {
+        if (jpeg_v4l2_streamon(s->fd, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE) < 0 ||
+            jpeg_v4l2_streamon(s->fd, V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE) < 0)
+            return -1;
+        s->streaming = 1;
+    }
+
+    s->tail = (slot + 1) % s->num_alloc;
+    s->queued++;
+
+    return slot;
+}
+
+int jpeghal_dec_session_dequeue(struct jpeg_dec_session *s)
+{
+    int in_index, out_index;
+
+    if (!s->queued) {
+        ALOGE("[%s]: nothing queued", __func__);
+        return -1;
+    }
+
+    in_index = jpeg_v4l2_dqbuf(s->fd, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE, V4L2_MEMORY_MMAP);
+    out_index = jpeg_v4l2_dqbuf(s->fd, V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE, V4L2_MEMORY_MMAP);
+    if (in_index < 0 || out_index < 0) {
+        ALOGE("[%s]: JPEG decoding is failed", __func__);
+        return -1;
+    }
+
+    if (out_index != s->head)
+        ALOGW("[%s]: decode %d finished out of order (expected %d)",
+              __func__, out_index, s->head);
+
+    s->head = (out_index + 1) % s->num_alloc;
+    s->queued--;
+    s->decoded++;
+
+    return out_index;
+}
+
+int jpeghal_dec_session_close(struct jpeg_dec_session *s)
+{
+    int ret = 0;
+
+    ALOGV("[%s]: %d images decoded, %d buffer setups", __func__, s->decoded, s->reconfigs);
+
+    jpeg_dec_session_free(s);
+
+    if (s->fd >= 0)
+        ret = close(s->fd);
+    s->fd = -1;
+
+    return ret;
+}
+
 int jpeghal_s_ctrl(int fd, int cid, int value)
 {
     struct v4l2_control vc;